@@ -189,4 +189,83 @@ private:
     JUCE_DECLARE_NON_COPYABLE (ArcTable)
 };
 
+/** Sorts nodes so that each comes after every node feeding it.
+
+    Returns indexes in to nodeIds in rendering order.  This runs in linear
+    time.  When the arcs form a feedback loop the first node of the loop in
+    nodeIds is taken as if it had no inputs.
+*/
+template <class ArcType>
+juce::Array<int> sortTopologically (const juce::Array<uint32>& nodeIds,
+                                    const juce::OwnedArray<ArcType>& arcs)
+{
+    const int numNodes = nodeIds.size();
+    juce::HashMap<uint32, int> indexes;
+    for (int i = 0; i < numNodes; ++i)
+        indexes.set (nodeIds.getUnchecked (i), i);
+
+    // count each node pair once, nodes are often joined on several ports
+    juce::Array<juce::SortedSet<int>> outputs;
+    outputs.resize (numNodes);
+    juce::Array<int> numInputs;
+    numInputs.insertMultiple (0, 0, numNodes);
+
+    for (const auto* const arc : arcs)
+    {
+        if (! indexes.contains (arc->sourceNode) || ! indexes.contains (arc->destNode))
+            continue;
+
+        const int src = indexes[arc->sourceNode];
+        const int dst = indexes[arc->destNode];
+        if (src == dst)
+            continue;
+
+        auto& outs = outputs.getReference (src);
+        if (! outs.contains (dst))
+        {
+            outs.add (dst);
+            numInputs.getReference (dst)++;
+        }
+    }
+
+    juce::Array<int> order;
+    order.ensureStorageAllocated (numNodes);
+    juce::Array<bool> added;
+    added.insertMultiple (0, false, numNodes);
+
+    for (int i = 0; i < numNodes; ++i)
+    {
+        if (numInputs.getUnchecked (i) == 0)
+        {
+            order.add (i);
+            added.set (i, true);
+        }
+    }
+
+    int next = 0, nextForced = 0;
+    while (order.size() < numNodes)
+    {
+        if (next == order.size())
+        {
+            // only feedback loops are left
+            while (added.getUnchecked (nextForced))
+                ++nextForced;
+            order.add (nextForced);
+            added.set (nextForced, true);
+        }
+
+        const int node = order.getUnchecked (next++);
+        for (const auto dst : outputs.getReference (node))
+        {
+            if (--numInputs.getReference (dst) == 0 && ! added.getUnchecked (dst))
+            {
+                order.add (dst);
+                added.set (dst, true);
+            }
+        }
+    }
+
+    return order;
+}
+
 } // namespace element
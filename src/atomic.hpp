@@ -94,6 +94,52 @@ private:
     Val values[2];
 };
 
+/** Passes values from one writer to one reader at a time without locks.
+
+    The writer fills in write() and calls publish(), the reader gets the
+    latest published value from read().  Neither side ever waits and the
+    reader never sees a value which is half written.
+*/
+template <typename Val>
+class TripleBuffer
+{
+public:
+    explicit TripleBuffer (const Val& initial = Val())
+    {
+        values[0] = values[1] = values[2] = initial;
+    }
+
+    /** Returns the value to fill in, this doesn't hold the last one
+        published.  Writer only.
+     */
+    inline Val& write() noexcept { return values[back]; }
+
+    /** Makes the written value the one the reader gets next.  Writer only. */
+    inline void publish() noexcept
+    {
+        back = middle.exchange (back | fresh, std::memory_order_acq_rel) & indexMask;
+    }
+
+    /** Returns the latest value published.  Reader only. */
+    inline const Val& read() noexcept
+    {
+        if ((middle.load (std::memory_order_relaxed) & fresh) != 0)
+            front = middle.exchange (front, std::memory_order_acq_rel) & indexMask;
+        return values[front];
+    }
+
+private:
+    enum
+    {
+        indexMask = 3,
+        fresh = 4
+    };
+
+    Val values[3];
+    std::atomic<int> middle { 1 };
+    int front = 0, back = 2;
+};
+
 class AtomicLock
 {
 public:
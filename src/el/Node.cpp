@@ -3,7 +3,18 @@
 // @pragma nostrip
 
 #include "sol_helpers.hpp"
+#include "services/engineservice.hpp"
 #include "session/node.hpp"
+#include "context.hpp"
+#include "services.hpp"
+
+static element::EngineService* el_Node_engineService (lua_State* L)
+{
+    sol::state_view lua (L);
+    if (auto* context = lua.globals().get_or<element::Context*> ("el.context", nullptr))
+        return context->getServices().findChild<element::EngineService>();
+    return nullptr;
+}
 
 EL_PLUGIN_EXPORT int luaopen_el_Node (lua_State* L)
 {
@@ -67,6 +78,23 @@ EL_PLUGIN_EXPORT int luaopen_el_Node (lua_State* L)
         "ismuted",
         &Node::isMuted,
 
+        /// True if frozen, or being frozen.
+        // @function Node:isfrozen
+        "isfrozen",
+        &Node::isFrozen,
+
+        /// Freeze or unfreeze.
+        // A frozen node's output is rendered in the background and played
+        // in its place.  Saved with the session.
+        // @function Node:setfrozen
+        // @bool frozen True to freeze
+        // @bool[opt] unload Release the plugin while frozen
+        // @return True if successful
+        "setfrozen",
+        [] (Node& self, bool frozen, sol::optional<bool> unload) -> bool {
+            return self.setFrozen (frozen, unload.value_or (false)).wasOk();
+        },
+
         /// Display name.
         // Will be a user-defined name or name provided by the plugin.
         // @function Node:displayname
@@ -122,6 +150,46 @@ EL_PLUGIN_EXPORT int luaopen_el_Node (lua_State* L)
         "restorestate",
         &Node::restorePluginState,
 
+        /// Start a batch of edits.
+        // Edits made to this graph aren't compiled until the matching
+        // commit, so many edits only compile the graph once.  Every
+        // beginbatch must be paired with a commit, otherwise the graph
+        // never recompiles; prefer Node:batch which always commits.
+        // @function Node:beginbatch
+        "beginbatch",
+        [] (const Node& self, sol::this_state L) {
+            if (auto* engine = el_Node_engineService (L))
+                engine->beginBatch (self);
+        },
+
+        /// End a batch of edits.
+        // @function Node:commit
+        "commit",
+        [] (const Node& self, sol::this_state L) {
+            if (auto* engine = el_Node_engineService (L))
+                engine->commit (self);
+        },
+
+        /// Make a batch of edits.
+        // Calls f between beginbatch and commit.  The batch is committed
+        // even if f raises an error, which is then raised again.
+        // @function Node:batch
+        // @func f Function making the edits, passed this node
+        "batch",
+        [] (const Node& self, sol::protected_function f, sol::this_state L) {
+            auto* engine = el_Node_engineService (L);
+            if (engine != nullptr)
+                engine->beginBatch (self);
+            sol::protected_function_result result = f (self);
+            if (engine != nullptr)
+                engine->commit (self);
+            if (! result.valid())
+            {
+                sol::error err = result;
+                throw err;
+            }
+        },
+
         /// Write node to file.
         // @function Node:writefile
         // @string f Absolute file path to save to
@@ -23,6 +23,8 @@
 #include "engine/midichannelmap.hpp"
 #include "engine/midiengine.hpp"
 #include "engine/miditranspose.hpp"
+#include "engine/renderguard.hpp"
+#include "engine/renderscheduler.hpp"
 #include "engine/transport.hpp"
 #include "engine/rootgraph.hpp"
 #include "context.hpp"
@@ -31,13 +33,101 @@
 
 namespace element {
 
-struct RootGraphRender : public AsyncUpdater
+/** Counts audio callbacks that took longer than the audio they rendered */
+struct XrunCounter
+{
+    std::atomic<int> xruns { 0 };
+
+    void beginBlock() noexcept
+    {
+        blockStart = Time::getHighResolutionTicks();
+    }
+
+    void endBlock (const int numSamples, const double sampleRate) noexcept
+    {
+        if (sampleRate <= 0.0)
+            return;
+
+        const auto elapsed = Time::getHighResolutionTicks() - blockStart;
+        const auto budget = (int64) ((double) Time::getHighResolutionTicksPerSecond() * numSamples / sampleRate);
+        if (elapsed > budget)
+            xruns.fetch_add (1, std::memory_order_relaxed);
+    }
+
+    void reset() noexcept
+    {
+        xruns.store (0);
+    }
+
+private:
+    int64 blockStart = 0;
+};
+
+/** Everything the audio callback renders: the root graphs, the buffers they
+    render in to and the configuration they were prepared for.
+
+    A state isn't changed once it has been published.  The message thread
+    builds a new one for every change and the callback picks it up at the
+    start of its next block, the state it replaced is deleted later on the
+    message thread.
+ */
+struct RenderState
+{
+    /** A root graph and its private buffers. Slots are shared by consecutive
+        states so a graph keeps its tail when others are added or removed.
+     */
+    struct Slot : public ReferenceCountedObject
+    {
+        Slot (RootGraph* g, const int numChannels, const int numSamples)
+            : graph (g), audio (jmax (1, numChannels), jmax (1, numSamples)) {}
+
+        RootGraph* const graph;
+        AudioSampleBuffer audio;
+        MidiBuffer midi;
+
+        // samples the graph keeps rendering for, zero or less means it's parked
+        int tail = 0;
+    };
+
+    ReferenceCountedArray<Slot> slots;
+
+    // the n'th set holds n independent tasks, one per graph rendering in a
+    // block.  Task i renders the slot at liveSlots[i]
+    Array<Array<GraphTask>> taskSets;
+    Array<int> liveSlots;
+
+    double sampleRate = 0.0;
+    int numInputChans = 0;
+    int numOutputChans = 0;
+    int tailSamples = 0;
+
+    AudioSampleBuffer audioOut { 1, 1 };
+    MidiBuffer midiOut;
+
+    RenderState* nextRetired = nullptr;
+
+    int size() const noexcept { return slots.size(); }
+    Slot& getSlot (const int index) const noexcept { return *slots.getObjectPointerUnchecked (index); }
+    RootGraph* getGraph (const int index) const noexcept { return getSlot (index).graph; }
+};
+
+struct RootGraphRender : public AsyncUpdater,
+                         private RenderScheduler::Job
 {
     std::function<void()> onActiveGraphChanged;
+    XrunCounter xruns;
 
     RootGraphRender()
     {
         graphs.ensureStorageAllocated (32);
+        state = createState().release();
+    }
+
+    ~RootGraphRender()
+    {
+        delete pending.exchange (nullptr);
+        delete state;
+        reclaim();
     }
 
     void handleAsyncUpdate() override
@@ -46,38 +136,40 @@ struct RootGraphRender : public AsyncUpdater
             onActiveGraphChanged();
     }
 
-    const int setCurrentGraph (const int index)
+    //==========================================================================
+    /** Called by the audio thread before rendering, picks up the last state
+        published by the message thread.
+     */
+    void beginBlock()
     {
-        if (index == currentGraph)
-            return currentGraph;
-        currentGraph = index;
-        triggerAsyncUpdate();
-        return currentGraph;
+        rendering.store (true);
+        if (auto* const next = pending.exchange (nullptr))
+            adopt (next);
     }
 
-    const int getCurrentGraphIndex() const { return currentGraph; }
+    /** Called by the audio thread when it's done with the current state */
+    void endBlock() { rendering.store (false); }
 
-    RootGraph* getCurrentGraph() const
-    {
-        return isPositiveAndBelow (currentGraph, graphs.size()) ? graphs.getUnchecked (currentGraph)
-                                                                : nullptr;
-    }
+    /** Returns the sample rate of the state being rendered. Audio thread only */
+    double getSampleRate() const noexcept { return state->sampleRate; }
 
-    void prepareBuffers (const int numIns, const int numOuts, const int numSamples)
+    const int setCurrentGraph (const int index)
     {
-        numInputChans = numIns;
-        numOutputChans = numOuts;
-        audioTemp.setSize (jmax (numIns, numOuts), numSamples);
-        audioOut.setSize (audioTemp.getNumChannels(), audioTemp.getNumSamples());
+        if (index == currentGraph.get())
+            return index;
+        currentGraph.set (index);
+        triggerAsyncUpdate();
+        return index;
     }
 
-    void releaseBuffers()
+    const int getCurrentGraphIndex() const { return currentGraph.get(); }
+
+    /** Keeps a parked graph rendering for another tail window. Use this when
+        it's known the graph is about to become audible */
+    void warmGraph (const int index)
     {
-        numInputChans = numOutputChans = 0;
-        midiOut.clear();
-        midiTemp.clear();
-        audioTemp.setSize (1, 1);
-        audioOut.setSize (1, 1);
+        if (isPositiveAndBelow (index, state->size()))
+            state->getSlot (index).tail = jmax (1, state->tailSamples);
     }
 
     void dumpGraphs()
@@ -86,16 +178,19 @@ struct RootGraphRender : public AsyncUpdater
 
     void renderGraphs (AudioSampleBuffer& buffer, MidiBuffer& midi)
     {
+        auto& s = *state;
+
         if (program.wasRequested())
         {
             const int nextGraph = findGraphForProgram (program);
-            if (nextGraph != currentGraph)
+            if (nextGraph != currentGraph.get())
                 setCurrentGraph (nextGraph);
             program.reset();
         }
 
-        auto* const current = getCurrentGraph();
-        auto* const last = (lastGraph >= 0 && lastGraph < graphs.size()) ? getGraph (lastGraph) : nullptr;
+        const int currentIndex = currentGraph.get();
+        auto* const current = isPositiveAndBelow (currentIndex, s.size()) ? s.getGraph (currentIndex) : nullptr;
+        auto* const last = isPositiveAndBelow (lastGraph, s.size()) ? s.getGraph (lastGraph) : nullptr;
 
         if (current == nullptr || last == nullptr)
         {
@@ -106,27 +201,71 @@ struct RootGraphRender : public AsyncUpdater
 
         const int numSamples = buffer.getNumSamples();
         const int numChans = buffer.getNumChannels();
-        const bool graphChanged = lastGraph != currentGraph;
+        const bool graphChanged = lastGraph != currentIndex;
         const bool shouldProcess = true;
         const RootGraph::RenderMode mode = current->getRenderMode();
         const bool modeChanged = graphChanged && mode != last->getRenderMode();
 
+        // a program change this block selects a graph on the next one, wake it
+        // up now so it isn't cold when it fades in.
+        {
+            MidiBuffer::Iterator iter (midi);
+            MidiMessage msg;
+            int frame = 0;
+
+            // setup a program change if present
+            while (iter.getNextEvent (msg, frame) && frame < numSamples)
+            {
+                if (! msg.isProgramChange())
+                    continue;
+                program.program = msg.getProgramChangeNumber();
+                program.channel = msg.getChannel();
+            }
+
+            if (program.wasRequested())
+                warmGraph (findGraphForProgram (program));
+        }
+
+        for (int g = 0; g < s.size(); ++g)
+        {
+            auto& slot = s.getSlot (g);
+            auto* const graph = slot.graph;
+            const bool audible = graph == current
+                || (! graph->isSingle() && ! current->isSingle());
+
+            // audible graphs stay warm, everything else renders until its tail
+            // window has passed and then parks
+            const bool fading = graphChanged && (graph == last || (modeChanged && ! graph->isSingle()));
+            if (audible || fading)
+                slot.tail = jmax (1, s.tailSamples);
+        }
+
         if (shouldProcess)
         {
+            auto& audioOut = s.audioOut;
+            auto& midiOut = s.midiOut;
             audioOut.setSize (buffer.getNumChannels(), buffer.getNumSamples(), false, false, true);
-            audioTemp.setSize (buffer.getNumChannels(), buffer.getNumSamples(), false, false, true);
 
             // clear the mixing area
             for (int i = numChans; --i >= 0;)
                 audioOut.clear (i, 0, numSamples);
             midiOut.clear();
 
-            for (auto* const graph : graphs)
+            for (int g = 0; g < s.size(); ++g)
             {
+                auto& slot = s.getSlot (g);
+                if (slot.tail <= 0)
+                    continue;
+
+                auto* const graph = slot.graph;
+                auto& audioTemp = slot.audio;
+                auto& midiTemp = slot.midi;
+                audioTemp.setSize (buffer.getNumChannels(), buffer.getNumSamples(), false, false, true);
+
                 // copy inputs, clear outs if more than input count
-                for (int i = 0; i < numInputChans; ++i)
+                for (int i = 0; i < s.numInputChans; ++i)
                     audioTemp.copyFrom (i, 0, buffer, i, 0, numSamples);
-                for (int i = numInputChans; i < numChans; ++i)
+                for (int i = s.numInputChans; i < numChans; ++i)
                     audioTemp.clear (i, 0, numSamples);
 
                 // clear so messages: avoids feedback loop when IO node ins are
@@ -156,27 +295,48 @@ struct RootGraphRender : public AsyncUpdater
                     // current single graph or parallel graphs get MIDI always
                     midiTemp.addEvents (midi, 0, numSamples, 0);
                 }
+            }
 
-                {
-                    MidiBuffer* tmpArray[] = { &midiTemp };
-                    MidiPipe midiPipe (tmpArray, 1);
+            // parked graphs aren't tasks at all
+            int numLive = 0;
+            for (int g = 0; g < s.size(); ++g)
+                if (s.getSlot (g).tail > 0)
+                    s.liveSlots.getReference (numLive++) = g;
+            if (numLive > peakLive.load (std::memory_order_relaxed))
+                peakLive.store (numLive, std::memory_order_relaxed);
+
+            // graphs don't share anything, so render them concurrently into
+            // their own buffers and sum once everything has finished.  a lone
+            // graph renders here without waking the workers, and the scheduler
+            // is only locked while it's resized, render serially then too
+            const ScopedTryLock stl (schedulerLock);
+            if (numLive > 1 && stl.isLocked() && scheduler.getNumThreads() > 1)
+            {
+                scheduler.perform (s.taskSets.getReference (numLive), *this);
+            }
+            else
+            {
+                for (int i = 0; i < numLive; ++i)
+                    performTask (i);
+            }
 
-                    const ScopedLock sl (graph->getPropertyLock());
-                    if (graph->isSuspended())
-                    {
-                        graph->renderBypassed (audioTemp, midiPipe);
-                    }
-                    else
-                    {
-                        graph->render (audioTemp, midiPipe);
-                    }
-                }
+            for (int g = 0; g < s.size(); ++g)
+            {
+                auto& slot = s.getSlot (g);
+                if (slot.tail <= 0)
+                    continue;
+
+                slot.tail -= numSamples;
+
+                auto* const graph = slot.graph;
+                const auto& audioTemp = slot.audio;
+                const auto& midiTemp = slot.midi;
 
                 if (graphChanged && ((current->isSingle() && current != graph) || (modeChanged && ! current->isSingle() && graph->isSingle())))
 
                 {
                     // DBG("  FADE OUT LAST GRAPH: " << graph->engineIndex);
-                    for (int i = 0; i < numOutputChans; ++i)
+                    for (int i = 0; i < s.numOutputChans; ++i)
                         audioOut.addFromWithRamp (i, 0, audioTemp.getReadPointer (i), numSamples, 1.f, 0.f);
                 }
                 else if ((graph == current && graph->isSingle()) || (! graph->isSingle() && (current != nullptr) && ! current->isSingle()))
@@ -185,12 +345,12 @@ struct RootGraphRender : public AsyncUpdater
                     if (graphChanged && (graph->isSingle() || (modeChanged && ! graph->isSingle() && ! current->isSingle())))
                     {
                         // DBG("  FADE IN NEW GRAPH: " << graph->engineIndex);
-                        for (int i = 0; i < numOutputChans; ++i)
+                        for (int i = 0; i < s.numOutputChans; ++i)
                             audioOut.addFromWithRamp (i, 0, audioTemp.getReadPointer (i), numSamples, 0.f, 1.f);
                     }
                     else
                     {
-                        for (int i = 0; i < numOutputChans; ++i)
+                        for (int i = 0; i < s.numOutputChans; ++i)
                             audioOut.addFrom (i, 0, audioTemp, i, 0, numSamples);
                     }
 
@@ -201,19 +361,6 @@ struct RootGraphRender : public AsyncUpdater
             for (int i = 0; i < numChans; ++i)
                 buffer.copyFrom (i, 0, audioOut, i, 0, numSamples);
 
-            MidiBuffer::Iterator iter (midi);
-            MidiMessage msg;
-            int frame = 0;
-
-            // setup a program change if present
-            while (iter.getNextEvent (msg, frame) && frame < numSamples)
-            {
-                if (! msg.isProgramChange())
-                    continue;
-                program.program = msg.getProgramChangeNumber();
-                program.channel = msg.getChannel();
-            }
-
             // done with input, swap it with the rendered output
             midi.swapWith (midiOut);
         }
@@ -224,7 +371,29 @@ struct RootGraphRender : public AsyncUpdater
                 zeromem (buffer.getWritePointer (i), sizeof (float) * (size_t) numSamples);
         }
 
-        lastGraph = currentGraph;
+        lastGraph = currentIndex;
+    }
+
+    //==========================================================================
+    /** Sets the configuration graphs render with. Every graph gets fresh
+        buffers and starts out parked. Not realtime safe! */
+    void prepareBuffers (const int numIns, const int numOuts, const int numSamples, const double newSampleRate)
+    {
+        numInputChans = numIns;
+        numOutputChans = numOuts;
+        blockSize = numSamples;
+        sampleRate = newSampleRate;
+
+        slots.clear();
+        for (auto* const graph : graphs)
+            slots.add (createSlot (graph));
+        publish();
+    }
+
+    /** Not realtime safe! */
+    void releaseBuffers()
+    {
+        prepareBuffers (0, 0, 1, 0.0);
     }
 
     /** not realtime safe! */
@@ -232,38 +401,115 @@ struct RootGraphRender : public AsyncUpdater
     {
         graphs.add (graph);
         graph->engineIndex = graphs.size() - 1;
-
-        if (graph->engineIndex == 0)
-        {
-            setCurrentGraph (0);
-            lastGraph = 0;
-        }
-
+        slots.add (createSlot (graph));
+        publish();
         return true;
     }
 
-    /** not realtime safe! AudioEngine's callback should be locked when you call this */
+    /** not realtime safe! The graph can still be rendering when this returns,
+        call waitForCallback() before releasing it.
+     */
     void removeGraph (RootGraph* graph)
     {
         jassert (graphs.contains (graph));
-        graphs.removeFirstMatchingValue (graph);
+        const int index = graphs.indexOf (graph);
+        graphs.remove (index);
+        slots.remove (index);
+        publish();
         graph->engineIndex = -1;
         updateIndexes();
-        if (currentGraph >= graphs.size())
-            currentGraph = graphs.size() - 1;
-        if (lastGraph >= graphs.size())
-            lastGraph = graphs.size() - 1;
+    }
+
+    /** Blocks until the audio thread no longer renders states published
+        before the last one.  Returns right away if nothing is rendering.
+     */
+    void waitForCallback() const
+    {
+        // a callback starting after the last state was published picks it up
+        // before it renders anything, only the one in progress matters.
+        while (pending.load() != nullptr && rendering.load())
+            Thread::sleep (1);
+    }
+
+    /** Gives the scheduler a thread per graph rendering at once, up to the
+        number of CPUs.  It grows as soon as more graphs render together and
+        shrinks once fewer have for a few seconds, one graph renders on the
+        audio thread alone.  Message thread only.
+     */
+    void updateScheduler()
+    {
+        const int numCpus = jmax (1, SystemStats::getNumCpus());
+        const int live = jmin (numCpus, peakLive.exchange (0, std::memory_order_relaxed));
+        recentPeakLive = jmax (recentPeakLive, live);
+
+        const int numThreads = scheduler.getNumThreads();
+        int newNumThreads = numThreads;
+        if (live > numThreads)
+            newNumThreads = live;
+
+        const auto now = Time::getMillisecondCounter();
+        if (now - peakWindowStart >= shrinkDelayMs)
+        {
+            if (recentPeakLive < numThreads)
+                newNumThreads = jmax (1, recentPeakLive);
+            recentPeakLive = 0;
+            peakWindowStart = now;
+        }
+
+        if (newNumThreads != numThreads)
+        {
+            EL_ASSERT_NOT_RENDERING();
+            const ScopedLock sl (schedulerLock);
+            scheduler.setNumThreads (newNumThreads);
+        }
+    }
+
+    /** Deletes states the audio thread has finished with. Message thread only */
+    void reclaim()
+    {
+        auto* s = retired.exchange (nullptr);
+        while (s != nullptr)
+        {
+            auto* const next = s->nextRetired;
+            delete s;
+            s = next;
+        }
     }
 
     int size() const { return graphs.size(); }
 
     RootGraph* getGraph (const int i) const { return graphs.getUnchecked (i); }
-    int getGraphIndex() const { return currentGraph; }
+    int getGraphIndex() const { return currentGraph.get(); }
     const Array<RootGraph*>& getGraphs() const { return graphs; }
 
 private:
+    // owned by the message thread
     Array<RootGraph*> graphs;
-    int currentGraph = -1;
+    ReferenceCountedArray<RenderState::Slot> slots;
+    double sampleRate = 0.0;
+    int blockSize = 0;
+    int numInputChans = 0;
+    int numOutputChans = 0;
+    static constexpr double parkTailSeconds = 1.0;
+
+    // outlives the states, resized when the number of graphs rendering
+    // together changes, see updateScheduler()
+    CriticalSection schedulerLock;
+    RenderScheduler scheduler;
+    int numScheduledTasks = 0;
+    std::atomic<int> peakLive { 0 };
+    int recentPeakLive = 0;
+    uint32 peakWindowStart = 0;
+    static constexpr uint32 shrinkDelayMs = 3000;
+
+    // handed from the message thread to the audio thread and back
+    std::atomic<RenderState*> pending { nullptr };
+    std::atomic<RenderState*> retired { nullptr };
+    std::atomic<bool> rendering { false };
+
+    // owned by the audio thread
+    RenderState* state = nullptr;
+    Atomic<int> currentGraph { -1 };
     int lastGraph = -1;
 
     struct ProgramRequest
@@ -279,36 +525,136 @@ private:
 
     } program;
 
-    int numInputChans = -1;
-    int numOutputChans = -1;
-    AudioSampleBuffer audioOut, audioTemp;
-
-    MidiBuffer midiOut, midiTemp;
-
     void updateIndexes()
     {
         for (int i = 0; i < graphs.size(); ++i)
             graphs.getUnchecked (i)->engineIndex = i;
     }
 
+    RenderState::Slot* createSlot (RootGraph* graph) const
+    {
+        return new RenderState::Slot (graph, jmax (numInputChans, numOutputChans), blockSize);
+    }
+
+    /** Every graph rendering in a block becomes a task, the scheduler's
+        threads are sized by updateScheduler() */
+    std::unique_ptr<RenderState> createState()
+    {
+        auto s = std::make_unique<RenderState>();
+        s->slots = slots;
+        for (int n = 0; n <= slots.size(); ++n)
+        {
+            Array<GraphTask> tasks;
+            tasks.resize (n);
+            s->taskSets.add (tasks);
+        }
+        s->liveSlots.resize (slots.size());
+
+        if (slots.size() > numScheduledTasks)
+        {
+            EL_ASSERT_NOT_RENDERING();
+            const ScopedLock sl (schedulerLock);
+            scheduler.prepare (s->taskSets.getLast());
+            numScheduledTasks = slots.size();
+        }
+
+        s->sampleRate = sampleRate;
+        s->numInputChans = numInputChans;
+        s->numOutputChans = numOutputChans;
+        s->tailSamples = roundToInt (sampleRate * parkTailSeconds);
+        s->audioOut.setSize (jmax (1, numInputChans, numOutputChans), jmax (1, blockSize));
+        return s;
+    }
+
+    void publish()
+    {
+        // a state the audio thread never picked up can go straight away
+        delete pending.exchange (createState().release());
+        reclaim();
+    }
+
+    void retire (RenderState* s) noexcept
+    {
+        auto* head = retired.load();
+        do
+        {
+            s->nextRetired = head;
+        } while (! retired.compare_exchange_weak (head, s));
+    }
+
+    /** Swaps in a new state, the current and last graphs follow their graphs
+        to where they are in the new list. */
+    void adopt (RenderState* next)
+    {
+        auto* const old = state;
+        const int currentIndex = currentGraph.get();
+        auto* const current = isPositiveAndBelow (currentIndex, old->size()) ? old->getGraph (currentIndex) : nullptr;
+        auto* const last = isPositiveAndBelow (lastGraph, old->size()) ? old->getGraph (lastGraph) : nullptr;
+
+        state = next;
+        retire (old);
+
+        if (old->size() == 0 && state->size() > 0)
+        {
+            setCurrentGraph (0);
+            lastGraph = 0;
+            return;
+        }
+
+        setCurrentGraph (findGraph (current, currentIndex));
+        lastGraph = findGraph (last, lastGraph);
+    }
+
+    int findGraph (RootGraph* graph, const int fallback) const noexcept
+    {
+        for (int i = 0; i < state->size(); ++i)
+            if (state->getGraph (i) == graph)
+                return i;
+        return jmin (fallback, state->size() - 1);
+    }
+
+    void performTask (int index) override
+    {
+        // also the entry point of the scheduler's workers
+        const ScopedRenderGuard guard;
+        auto& slot = state->getSlot (state->liveSlots.getUnchecked (index));
+        if (slot.tail <= 0)
+            return;
+
+        auto* const graph = slot.graph;
+        MidiBuffer* tmpArray[] = { &slot.midi };
+        MidiPipe midiPipe (tmpArray, 1);
+
+        // graphs swap programs without locking, see GraphNode::renderGraph()
+        if (graph->isSuspended())
+        {
+            graph->renderBypassed (slot.audio, midiPipe);
+        }
+        else
+        {
+            graph->render (slot.audio, midiPipe);
+        }
+    }
+
     int findGraphForProgram (const ProgramRequest& r) const
     {
         if (isPositiveAndBelow (program.program, 128))
         {
-            for (int i = 0; i < graphs.size(); ++i)
+            for (int i = 0; i < state->size(); ++i)
             {
-                auto* const g = graphs.getUnchecked (i);
+                auto* const g = state->getGraph (i);
                 if (g->midiProgram == r.program && g->acceptsMidiChannel (program.channel))
-                    return g->engineIndex;
+                    return i;
             }
         }
 
-        return currentGraph;
+        return currentGraph.get();
     }
 };
 
 class AudioEngine::Private : public AudioIODeviceCallback,
                              public MidiInputCallback,
+                             public MidiKeyboardState::Listener,
                              public Value::Listener,
                              public MidiClock::Listener,
                              public Timer
@@ -352,18 +698,20 @@ public:
     void timerCallback() override
     {
         midiIOMonitor->notify();
+        graphs.reclaim();
+        graphs.updateScheduler();
     }
 
-    RootGraph* getCurrentGraph() const { return graphs.getCurrentGraph(); }
+    /** Returns the graph last rendered as the current one. Message thread only */
+    RootGraph* getCurrentGraph() const
+    {
+        const int index = graphs.getGraphIndex();
+        return isPositiveAndBelow (index, graphs.size()) ? graphs.getGraph (index) : nullptr;
+    }
 
     void onCurrentGraphChanged()
     {
-        int currentGraph = -1;
-        {
-            ScopedLock sl (lock);
-            currentGraph = graphs.getGraphIndex();
-        }
-
+        const int currentGraph = graphs.getGraphIndex();
         auto session = engine.getWorld().getSession();
         if (currentGraph >= 0 && currentGraph != session->getActiveGraphIndex())
         {
@@ -382,7 +730,10 @@ public:
                                            int numSamples,
                                            const AudioIODeviceCallbackContext& context) override
     {
+        const ScopedRenderGuard renderGuard;
         jassert (sampleRate > 0 && blockSize > 0);
+        inputClock.advance (Time::getMillisecondCounterHiRes() * 0.001, numSamples);
+        graphs.xruns.beginBlock();
         int totalNumChans = 0;
         ScopedNoDenormals denormals;
         if (numInputChannels > numOutputChannels)
@@ -425,55 +776,56 @@ public:
 
         const bool wasPlaying = transport.isPlaying();
         AudioSampleBuffer buffer (channels, totalNumChans, numSamples);
+        auto& midiEngine = engine.world.getMidiEngine();
+        midiEngine.collectMidiInput (incomingMidi, inputClock, numSamples);
         processCurrentGraph (buffer, incomingMidi);
 
+        if (midiEngine.hasDefaultMidiOutput())
         {
-            ScopedLock lockMidiOut (engine.world.getMidiEngine().getMidiOutputLock());
-            if (auto* const midiOut = engine.world.getMidiEngine().getDefaultMidiOutput())
+            if (sendMidiClockToInput.get() != 1 && generateMidiClock.get() == 1)
             {
-                if (sendMidiClockToInput.get() != 1 && generateMidiClock.get() == 1)
+                if (wasPlaying != transport.isPlaying())
                 {
-                    if (wasPlaying != transport.isPlaying())
+                    if (transport.isPlaying())
                     {
-                        if (transport.isPlaying())
-                        {
-                            incomingMidi.addEvent (transport.getPositionFrames() <= 0
-                                                       ? MidiMessage::midiStart()
-                                                       : MidiMessage::midiContinue(),
-                                                   0);
-                        }
-                        else
-                        {
-                            incomingMidi.addEvent (MidiMessage::midiStop(), 0);
-                        }
+                        incomingMidi.addEvent (transport.getPositionFrames() <= 0
+                                                   ? MidiMessage::midiStart()
+                                                   : MidiMessage::midiContinue(),
+                                               0);
+                    }
+                    else
+                    {
+                        incomingMidi.addEvent (MidiMessage::midiStop(), 0);
                     }
-
-                    midiClockMaster.setTempo (transport.getTempo());
-                    midiClockMaster.render (incomingMidi, numSamples);
                 }
 
-                const double delayMs = midiOutLatency.get();
-                if (! incomingMidi.isEmpty())
-                {
-                    midiIOMonitor->sent();
-#if JUCE_WINDOWS
-                    midiOut->sendBlockOfMessagesNow (incomingMidi);
-#else
-                    midiOut->sendBlockOfMessages (incomingMidi, delayMs + Time::getMillisecondCounterHiRes(), sampleRate);
-#endif
-                }
+                midiClockMaster.setTempo (transport.getTempo());
+                midiClockMaster.render (incomingMidi, numSamples);
+            }
+
+            if (! incomingMidi.isEmpty())
+            {
+                // heard when the block leaves the device, plus the user's trim
+                const double samplePeriod = 1.0 / inputClock.getEstimatedSampleRate();
+                const double blockTime = inputClock.getEndTime()
+                                         + outputLatencySamples * samplePeriod
+                                         + midiOutLatency.get() * 0.001;
+                midiIOMonitor->sent();
+                midiEngine.sendMidiOutput (incomingMidi, blockTime, samplePeriod);
             }
         }
 
         incomingMidi.clear();
+        graphs.xruns.endBlock (numSamples, graphs.getSampleRate());
     }
 
     void processCurrentGraph (AudioBuffer<float>& buffer, MidiBuffer& midi)
     {
         const int numSamples = buffer.getNumSamples();
-        messageCollector.removeNextBlockOfMessages (midi, numSamples);
+        hostInput.collect (midi, inputClock, numSamples);
+        userInput.collect (midi, inputClock, numSamples);
 
-        const ScopedLock sl (lock);
+        graphs.beginBlock();
         const bool shouldProcess = shouldBeLocked.get() == 0;
         const bool wasPlaying = transport.isPlaying();
         transport.preProcess (numSamples);
@@ -511,6 +863,8 @@ public:
                 zeromem (buffer.getWritePointer (i), sizeof (float) * (size_t) numSamples);
         }
 
+        graphs.endBlock();
+
         if (transport.isPlaying())
             transport.advance (numSamples);
 
@@ -530,24 +884,25 @@ public:
         const int newBlockSize = device->getCurrentBufferSizeSamples();
         const int numChansIn = device->getActiveInputChannels().countNumberOfSetBits();
         const int numChansOut = device->getActiveOutputChannels().countNumberOfSetBits();
+        outputLatencySamples = device->getOutputLatencyInSamples();
         audioAboutToStart (newSampleRate, newBlockSize, numChansIn, numChansOut);
     }
 
     void audioAboutToStart (const double newSampleRate, const int newBlockSize, const int numChansIn, const int numChansOut)
     {
-        const ScopedLock sl (lock);
-
         sampleRate = newSampleRate;
         blockSize = newBlockSize;
         numInputChans = numChansIn;
         numOutputChans = numChansOut;
 
         midiClock.reset (sampleRate, blockSize);
-        messageCollector.reset (sampleRate);
-        keyboardState.addListener (&messageCollector);
+        hostInput.clear();
+        userInput.clear();
+        inputClock.reset (sampleRate, blockSize);
+        keyboardState.addListener (this);
         channels.calloc ((size_t) jmax (numChansIn, numChansOut) + 2);
 
-        graphs.prepareBuffers (numInputChans, numOutputChans, blockSize);
+        graphs.prepareBuffers (numInputChans, numOutputChans, blockSize, sampleRate);
 
         if (isPrepared)
         {
@@ -566,8 +921,7 @@ public:
 
     void audioStopped()
     {
-        const ScopedLock sl (lock);
-        keyboardState.removeListener (&messageCollector);
+        keyboardState.removeListener (this);
         if (isPrepared)
             releaseResources();
         isPrepared = false;
@@ -577,11 +931,39 @@ public:
         graphs.releaseBuffers();
     }
 
-    void handleIncomingMidiMessage (MidiInput*, const MidiMessage& message) override
+    void handleIncomingMidiMessage (MidiInput* source, const MidiMessage& message) override
     {
         if (! message.isActiveSense() && ! message.isMidiClock())
             midiIOMonitor->received();
-        messageCollector.addMessageToQueue (message);
+
+        // devices are queued by the midi engine and collected per block, this
+        // is the host's MIDI passed on while rendering in plugin mode
+        if (source == nullptr)
+            hostInput.push (message);
+
+        handleMidiClockMessage (message);
+    }
+
+    /** Queues a message from anywhere but the audio thread */
+    void addUserMessage (const MidiMessage& message)
+    {
+        EL_ASSERT_NOT_RENDERING();
+        const ScopedLock sl (userInputLock);
+        userInput.push (message);
+    }
+
+    void handleNoteOn (MidiKeyboardState*, int channel, int note, float velocity) override
+    {
+        addUserMessage (MidiMessage::noteOn (channel, note, velocity));
+    }
+
+    void handleNoteOff (MidiKeyboardState*, int channel, int note, float velocity) override
+    {
+        addUserMessage (MidiMessage::noteOff (channel, note, velocity));
+    }
+
+    void handleMidiClockMessage (const MidiMessage& message)
+    {
         const bool clockWanted = processMidiClock.get() > 0 && sessionWantsExternalClock.get() > 0;
         if (clockWanted && message.isMidiClock())
         {
@@ -607,7 +989,6 @@ public:
         jassert (graph);
         if (isPrepared)
             prepareGraph (graph, sampleRate, blockSize);
-        ScopedLock sl (lock);
         if (graphs.addGraph (graph))
         {
             graph->renderingSequenceChanged.connect (
@@ -617,10 +998,8 @@ public:
 
     void removeGraph (RootGraph* graph)
     {
-        {
-            ScopedLock sl (lock);
-            graphs.removeGraph (graph);
-        }
+        graphs.removeGraph (graph);
+        graphs.waitForCallback();
 
         graph->renderingSequenceChanged.disconnect_all_slots();
         if (isPrepared)
@@ -704,7 +1083,6 @@ private:
     Value tempoValue;
     Atomic<float> nextTempo;
 
-    CriticalSection lock;
     double sampleRate = 0.0;
     int blockSize = 0;
     bool isPrepared = false;
@@ -714,7 +1092,12 @@ private:
     HeapBlock<float*> channels;
     AudioSampleBuffer tempBuffer;
     MidiBuffer incomingMidi;
-    MidiMessageCollector messageCollector;
+    // the host's block, and messages from the GUI and other threads which
+    // take turns on userInputLock so the audio thread never waits for them
+    MidiInputQueue hostInput, userInput;
+    CriticalSection userInputLock;
+    MidiBlockClock inputClock;
+    int outputLatencySamples = 0;
     MidiKeyboardState keyboardState;
 
     AudioSampleBuffer graphBuffer;
@@ -830,7 +1213,6 @@ bool AudioEngine::removeGraph (RootGraph* graph)
 
 RootGraph* AudioEngine::getGraph (const int index)
 {
-    ScopedLock sl (priv->lock);
     if (isPositiveAndBelow (index, priv->graphs.size()))
         return priv->graphs.getGraph (index);
     return nullptr;
@@ -841,9 +1223,13 @@ void AudioEngine::addMidiMessage (const MidiMessage msg, bool handleOnDeviceQueu
     if (priv == nullptr)
         return;
     if (handleOnDeviceQueue)
-        priv->handleIncomingMidiMessage (nullptr, msg);
-    else
-        priv->messageCollector.addMessageToQueue (msg);
+    {
+        if (! msg.isActiveSense() && ! msg.isMidiClock())
+            priv->midiIOMonitor->received();
+        priv->handleMidiClockMessage (msg);
+    }
+
+    priv->addUserMessage (msg);
 }
 
 void AudioEngine::setActiveGraph (const int index)
@@ -918,9 +1304,13 @@ void AudioEngine::processExternalBuffers (AudioBuffer<float>& buffer, MidiBuffer
 {
     if (priv)
     {
+        const ScopedRenderGuard renderGuard;
+        priv->inputClock.advance (Time::getMillisecondCounterHiRes() * 0.001, buffer.getNumSamples());
+        priv->graphs.xruns.beginBlock();
         if (getRunMode() == RunMode::Plugin)
-            world.getMidiEngine().processMidiBuffer (midi, buffer.getNumSamples(), priv->sampleRate);
+            world.getMidiEngine().processMidiBuffer (midi, buffer.getNumSamples(), priv->graphs.getSampleRate());
         priv->processCurrentGraph (buffer, midi);
+        priv->graphs.xruns.endBlock (buffer.getNumSamples(), priv->graphs.getSampleRate());
     }
 }
 
@@ -962,23 +1352,19 @@ void AudioEngine::updateExternalLatencySamples()
 {
     int latencySamples = 0;
 
-    {
-        ScopedLock sl (priv->lock);
-
-        auto* current = priv->getCurrentGraph();
-        if (nullptr == current)
-            return;
+    auto* current = priv->getCurrentGraph();
+    if (nullptr == current)
+        return;
 
-        if (current->getRenderMode() == RootGraph::SingleGraph)
-        {
-            latencySamples = current->getLatencySamples();
-        }
-        else
-        {
-            for (auto* const graph : priv->graphs.getGraphs())
-                if (graph->getRenderMode() == RootGraph::Parallel)
-                    latencySamples = jmax (latencySamples, graph->getLatencySamples());
-        }
+    if (current->getRenderMode() == RootGraph::SingleGraph)
+    {
+        latencySamples = current->getLatencySamples();
+    }
+    else
+    {
+        for (auto* const graph : priv->graphs.getGraphs())
+            if (graph->getRenderMode() == RootGraph::Parallel)
+                latencySamples = jmax (latencySamples, graph->getLatencySamples());
     }
 
     priv->latencySamples = latencySamples;
@@ -995,4 +1381,15 @@ MidiIOMonitorPtr AudioEngine::getMidiIOMonitor() const
     return priv != nullptr ? priv->midiIOMonitor : nullptr;
 }
 
+int AudioEngine::getNumXruns() const
+{
+    return priv != nullptr ? priv->graphs.xruns.xruns.load() : 0;
+}
+
+void AudioEngine::resetXrunCounters()
+{
+    if (priv != nullptr)
+        priv->graphs.xruns.reset();
+}
+
 } // namespace element
@@ -100,6 +100,13 @@ public:
     Context& getWorld() const;
     MidiIOMonitorPtr getMidiIOMonitor() const;
 
+    /** Returns the number of audio callbacks that took longer than the audio
+        they rendered. */
+    int getNumXruns() const;
+
+    /** Resets the xrun counter to zero. */
+    void resetXrunCounters();
+
 private:
     class Private;
     std::unique_ptr<Private> priv;
@@ -0,0 +1,100 @@
+/*
+    This file is part of Element
+    Copyright (C) 2021  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+
+
+#pragma once
+
+#include "JuceHeader.h"
+
+namespace element {
+
+/** A fixed delay for a single channel of audio.
+
+    Samples are moved a block at a time: each block is written to a ring
+    buffer and read back from a fixed distance behind, each taking at most
+    two vectorized copies.  The ring holds the delay plus one block, bigger
+    blocks are processed in pieces.
+ */
+template <typename SampleType>
+class DelayLine
+{
+public:
+    DelayLine() = default;
+
+    /** Sets the delay and the largest block expected, then clears the
+        line.  Not realtime safe. */
+    void setDelay (const int numSamplesDelay, const int maxBlockSize)
+    {
+        jassert (numSamplesDelay >= 0);
+        delay = jmax (0, numSamplesDelay);
+        size = delay + jmax (1, maxBlockSize);
+        ring.calloc ((size_t) size);
+        writeIndex = 0;
+    }
+
+    /** Returns the delay in samples */
+    int getDelay() const noexcept { return delay; }
+
+    /** Returns the number of samples the line holds */
+    int getSize() const noexcept { return size; }
+
+    /** Delays a block of samples.  input and output may be the same. */
+    void process (const SampleType* input, SampleType* output, int numSamples) noexcept
+    {
+        jassert (size > delay); // call setDelay() first
+        const int maxChunk = size - delay;
+
+        while (numSamples > 0)
+        {
+            const int chunk = jmin (numSamples, maxChunk);
+            const int readIndex = (writeIndex + size - delay) % size;
+            write (input, chunk);
+            read (readIndex, output, chunk);
+            input += chunk;
+            output += chunk;
+            numSamples -= chunk;
+        }
+    }
+
+private:
+    HeapBlock<SampleType> ring;
+    int delay = 0;
+    int size = 0;
+    int writeIndex = 0;
+
+    void write (const SampleType* input, const int numSamples) noexcept
+    {
+        const int first = jmin (numSamples, size - writeIndex);
+        FloatVectorOperations::copy (ring + writeIndex, input, first);
+        FloatVectorOperations::copy (ring.get(), input + first, numSamples - first);
+        writeIndex = (writeIndex + numSamples) % size;
+    }
+
+    void read (const int readIndex, SampleType* output, const int numSamples) const noexcept
+    {
+        const int first = jmin (numSamples, size - readIndex);
+        FloatVectorOperations::copy (output, ring + readIndex, first);
+        FloatVectorOperations::copy (output + first, ring.get(), numSamples - first);
+    }
+
+    JUCE_DECLARE_NON_COPYABLE (DelayLine)
+};
+
+} // namespace element
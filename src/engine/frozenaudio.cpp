@@ -0,0 +1,262 @@
+/*
+    This file is part of Element
+    Copyright (C) 2021  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+
+
+#include "engine/frozenaudio.hpp"
+#include "engine/graphcompiler.hpp"
+#include "engine/lookahead.hpp"
+
+namespace element {
+
+/** Reads frozen audio ahead of the transport for every graph */
+struct FrozenAudio::BufferingThread : public TimeSliceThread
+{
+    BufferingThread() : TimeSliceThread ("element: frozen audio") { startThread (5); }
+    ~BufferingThread() override { stopThread (1000); }
+};
+
+namespace {
+// samples read from the file per time slice
+constexpr int chunkSize = 4096;
+} // namespace
+
+FrozenAudio::FrozenAudio (const uint32 node, const File& f, AudioFormatReader* const reader)
+    : nodeId (node),
+      file (f),
+      source (reader)
+{
+    numChannels = (int) source->numChannels;
+    length = source->lengthInSamples;
+    sampleRate = source->sampleRate;
+
+    // a few seconds are buffered so a jump of the transport is heard soon
+    capacity = (int) jmax ((int64) 1, jmin (length, (int64) roundToInt (sampleRate * 4.0)));
+    ring.setSize (jmax (1, numChannels), capacity);
+    ring.clear();
+    thread->addTimeSliceClient (this);
+}
+
+FrozenAudio::~FrozenAudio()
+{
+    thread->removeTimeSliceClient (this);
+    source.reset();
+    file.deleteFile();
+}
+
+bool FrozenAudio::read (float* const* channels, const int numDestChannels, const int64 position, const int numSamples) noexcept
+{
+    if (position + numSamples <= 0 || position >= length)
+        return false;
+
+    for (int ch = 0; ch < numDestChannels; ++ch)
+        FloatVectorOperations::clear (channels[ch], numSamples);
+
+    const int64 from = jmax ((int64) 0, position);
+    const int64 to = jmin (length, position + numSamples);
+    wanted.store (from);
+
+    const uint32 readEpoch = epoch.load();
+    if (from < bufferedStart.load() || to > bufferedEnd.load())
+        return true;
+
+    const int numToRead = jmin (numDestChannels, numChannels);
+    for (int64 pos = from; pos < to;)
+    {
+        const int offset = (int) (pos % capacity);
+        const int num = (int) jmin (to - pos, (int64) (capacity - offset));
+        for (int ch = 0; ch < numToRead; ++ch)
+            FloatVectorOperations::copy (channels[ch] + (pos - position), ring.getReadPointer (ch, offset), num);
+        pos += num;
+    }
+
+    // anything overwritten while it was copied moved the start past it
+    std::atomic_thread_fence (std::memory_order_acquire);
+    if (epoch.load() != readEpoch || from < bufferedStart.load())
+        for (int ch = 0; ch < numToRead; ++ch)
+            FloatVectorOperations::clear (channels[ch], numSamples);
+
+    return true;
+}
+
+void FrozenAudio::waitForBuffering (const int64 position, const int numSamples, const int timeoutMs)
+{
+    if (numSamples <= 0 || position < 0 || position >= length)
+        return;
+
+    const int64 to = jmin (length, position + numSamples);
+    wanted.store (position);
+    thread->notify();
+
+    const auto timeout = Time::getMillisecondCounter() + (uint32) jmax (0, timeoutMs);
+    while ((position < bufferedStart.load() || to > bufferedEnd.load())
+           && Time::getMillisecondCounter() < timeout)
+    {
+        Thread::sleep (1);
+    }
+}
+
+int FrozenAudio::useTimeSlice()
+{
+    const int64 want = jlimit ((int64) 0, length, wanted.load());
+    int64 end = bufferedEnd.load();
+
+    if (want < bufferedStart.load() || want > end)
+    {
+        // the transport jumped, start over from where it is.  reads see
+        // nothing buffered until the new epoch's range is published
+        bufferedStart.store (std::numeric_limits<int64>::max());
+        epoch.fetch_add (1);
+        bufferedEnd.store (want);
+        bufferedStart.store (want);
+        end = want;
+    }
+
+    const int num = (int) jmin ((int64) chunkSize, length - end, want + capacity - end);
+    if (num <= 0)
+        return 10;
+
+    // drop what's about to be overwritten before writing over it
+    if (end + num - capacity > bufferedStart.load())
+        bufferedStart.store (end + num - capacity);
+    std::atomic_thread_fence (std::memory_order_release);
+
+    const int offset = (int) (end % capacity);
+    const int first = jmin (num, capacity - offset);
+    source->read (&ring, offset, first, end, true, true);
+    if (first < num)
+        source->read (&ring, 0, num - first, end + first, true, true);
+
+    bufferedEnd.store (end + num);
+    return 0;
+}
+
+//==============================================================================
+FrozenAudio::Ptr FrozenAudio::render (const GraphSnapshot& snapshot,
+                                      const uint32 nodeId,
+                                      const Optional<AudioPlayHead::PositionInfo>& start,
+                                      const double sampleRate,
+                                      const int64 numSamples,
+                                      String& error)
+{
+    jassert (! snapshot.doublePrecision); // outputs are captured as floats
+
+    const NodeState* state = nullptr;
+    for (int i = 0; i < snapshot.nodes.size(); ++i)
+        if (snapshot.getNodeId (i) == nodeId)
+            state = snapshot.states.getUnchecked (i);
+
+    const int numOutputs = state != nullptr ? state->getNumPorts (PortType::Audio, false) : 0;
+    if (numOutputs <= 0 || sampleRate <= 0.0)
+    {
+        error = "There's no audio to freeze";
+        return nullptr;
+    }
+
+    // the outputs are passed out through a look-ahead, which also moves the
+    // playhead the nodes see along with the blocks rendered
+    LookAhead capture (1);
+    for (int i = 0; i < snapshot.nodes.size(); ++i)
+        capture.addNode (snapshot.getNodeId (i));
+    for (int ch = 0; ch < numOutputs; ++ch)
+        capture.addPort (nodeId, state->getNthPort (PortType::Audio, ch, false), PortType::Audio);
+    GraphCompiler::buildAhead (snapshot, capture);
+
+    const auto file = File::getSpecialLocation (File::tempDirectory)
+                          .getNonexistentChildFile ("element-frozen-" + String (nodeId), ".wav");
+    std::unique_ptr<AudioFormatWriter> writer;
+    {
+        std::unique_ptr<OutputStream> stream (file.createOutputStream());
+        if (stream != nullptr)
+            writer.reset (WavAudioFormat().createWriterFor (stream.get(), sampleRate, (unsigned int) numOutputs, 32, {}, 0));
+        if (writer != nullptr)
+            stream.release(); // owned by the writer
+    }
+
+    if (writer == nullptr)
+    {
+        error = "Couldn't create " + file.getFullPathName();
+        file.deleteFile();
+        return nullptr;
+    }
+
+    // the transport plays from the start at the tempo it has now
+    auto position = start.hasValue() ? *start : AudioPlayHead::PositionInfo();
+    position.setIsPlaying (true);
+    position.setIsRecording (false);
+    position.setTimeInSamples (0);
+    position.setTimeInSeconds (0.0);
+    position.setPpqPosition (0.0);
+    position.setPpqPositionOfLastBarStart (0.0);
+    if (! position.getBpm().hasValue())
+        position.setBpm (120.0);
+    capture.restart (position, sampleRate);
+
+    // output delayed by the node and whatever feeds it is dropped, so the
+    // file lines up with the transport
+    int64 toSkip = capture.getPorts().getReference (0).delay;
+    const int blockSize = capture.getProgram()->getBlockSize();
+    AudioSampleBuffer block (numOutputs, blockSize);
+    ScopedNoDenormals denormals;
+
+    for (int64 written = 0; written < numSamples;)
+    {
+        if (Thread::currentThreadShouldExit())
+        {
+            error = "Freezing was cancelled";
+            writer.reset();
+            file.deleteFile();
+            return nullptr;
+        }
+
+        capture.renderNextBlock();
+        for (int ch = 0; ch < numOutputs; ++ch)
+            if (capture.read (ch, block.getWritePointer (ch), blockSize))
+                block.clear (ch, 0, blockSize);
+        capture.advance (blockSize);
+
+        const int skip = (int) jmin ((int64) blockSize, toSkip);
+        const int num = (int) jmin ((int64) (blockSize - skip), numSamples - written);
+        toSkip -= skip;
+
+        if (num > 0 && ! writer->writeFromAudioSampleBuffer (block, skip, num))
+        {
+            error = "Couldn't write " + file.getFullPathName();
+            writer.reset();
+            file.deleteFile();
+            return nullptr;
+        }
+
+        written += num;
+    }
+
+    writer.reset();
+
+    auto* const source = WavAudioFormat().createReaderFor (file.createInputStream().release(), true);
+    if (source == nullptr)
+    {
+        error = "Couldn't read " + file.getFullPathName();
+        file.deleteFile();
+        return nullptr;
+    }
+
+    return new FrozenAudio (nodeId, file, source);
+}
+
+} // namespace element
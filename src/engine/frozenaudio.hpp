@@ -0,0 +1,108 @@
+/*
+    This file is part of Element
+    Copyright (C) 2021  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+
+
+#pragma once
+
+#include "ElementApp.h"
+
+namespace element {
+
+struct GraphSnapshot;
+
+/** The output of a frozen node rendered to a file.  The graph streams it
+    back at the transport position in place of the node, which no longer
+    runs until it's unfrozen.  The file is deleted with this.
+ */
+class FrozenAudio : public ReferenceCountedObject,
+                    private TimeSliceClient
+{
+public:
+    using Ptr = ReferenceCountedObjectPtr<FrozenAudio>;
+
+    /** Renders the audio outputs of a node from the start of the transport
+        in to a temporary file.  The snapshot holds the node and the nodes
+        feeding it, which are rendered on the calling thread and must be out
+        of any program rendering them.  Rendering stops with an error if the
+        calling thread is asked to exit.
+
+        The transport plays from the start position's tempo and meter.
+        Returns nullptr and sets the error if it couldn't be rendered.
+     */
+    static Ptr render (const GraphSnapshot& snapshot,
+                       uint32 nodeId,
+                       const Optional<AudioPlayHead::PositionInfo>& start,
+                       double sampleRate,
+                       int64 numSamples,
+                       String& error);
+
+    ~FrozenAudio();
+
+    /** Returns the ID of the node this was rendered from */
+    uint32 getNodeId() const noexcept { return nodeId; }
+
+    /** Returns the rendered file */
+    const File& getFile() const noexcept { return file; }
+
+    int getNumChannels() const noexcept { return numChannels; }
+    int64 getLength() const noexcept { return length; }
+    double getSampleRate() const noexcept { return sampleRate; }
+
+    /** Reads the audio at a transport position.  Only what's been buffered
+        is read, and the buffering thread is never waited for, so this is
+        realtime safe.  Audio that isn't buffered yet, and channels past the
+        rendered ones, are cleared.  Returns false, leaving the channels
+        alone, if the position is outside the rendered audio.
+     */
+    bool read (float* const* channels, int numDestChannels, int64 position, int numSamples) noexcept;
+
+    /** Waits up to timeoutMs for the audio at a position to be buffered.
+        Call before it's played, this isn't realtime safe.
+     */
+    void waitForBuffering (int64 position, int numSamples, int timeoutMs);
+
+private:
+    FrozenAudio (uint32 nodeId, const File& file, AudioFormatReader* reader);
+
+    struct BufferingThread;
+    SharedResourcePointer<BufferingThread> thread;
+
+    const uint32 nodeId;
+    const File file;
+    std::unique_ptr<AudioFormatReader> source;
+    int numChannels = 0;
+    int64 length = 0;
+    double sampleRate = 0.0;
+
+    // positions [bufferedStart, bufferedEnd) of the file are in the ring at
+    // position % capacity.  The buffering thread moves the start past what
+    // it's about to overwrite, and bumps the epoch when it starts over
+    // somewhere else, so a read which raced it can tell and go silent.
+    AudioSampleBuffer ring;
+    int capacity = 0;
+    std::atomic<int64> bufferedStart { 0 }, bufferedEnd { 0 }, wanted { 0 };
+    std::atomic<uint32> epoch { 0 };
+
+    int useTimeSlice() override;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (FrozenAudio)
+};
+
+} // namespace element
@@ -1,13 +1,44 @@
 
+#include "engine/delayline.hpp"
+#include "engine/frozenaudio.hpp"
 #include "engine/nodeobject.hpp"
 #include "engine/miditranspose.hpp"
 #include "engine/graphnode.hpp"
 #include "engine/graphbuilder.hpp"
 #include "engine/ionode.hpp"
+#include "engine/lookahead.hpp"
+#include "engine/midieventbuffer.hpp"
+#include "engine/renderguard.hpp"
 
 namespace element {
 
-class ClearChannelOp : public GraphOp
+/** Implements both precisions of GraphOp::perform() with a single member
+    template, OpType::process(). */
+template <class OpType>
+class SampleTypeOp : public GraphOp
+{
+public:
+    void perform (AudioSampleBuffer& sharedBufferChans, const OwnedArray<MidiBuffer>& sharedMidiBuffers, bool* silentChannels, const int numSamples) override
+    {
+        static_cast<OpType*> (this)->process (sharedBufferChans, sharedMidiBuffers, silentChannels, numSamples);
+    }
+
+    void perform (AudioBuffer<double>& sharedBufferChans, const OwnedArray<MidiBuffer>& sharedMidiBuffers, bool* silentChannels, const int numSamples) override
+    {
+        static_cast<OpType*> (this)->process (sharedBufferChans, sharedMidiBuffers, silentChannels, numSamples);
+    }
+};
+
+/** An op which only stands for an instruction.  It's deleted once the
+    program is assembled, the program runs the instruction itself. */
+class InstructionOp : public GraphOp
+{
+public:
+    void perform (AudioSampleBuffer&, const OwnedArray<MidiBuffer>&, bool*, const int) override { jassertfalse; }
+    void perform (AudioBuffer<double>&, const OwnedArray<MidiBuffer>&, bool*, const int) override { jassertfalse; }
+};
+
+class ClearChannelOp : public InstructionOp
 {
 public:
     ClearChannelOp (const int channelNum_)
@@ -15,9 +46,17 @@ public:
     {
     }
 
-    void perform (AudioSampleBuffer& sharedBufferChans, const OwnedArray<MidiBuffer>&, const int numSamples)
+    RenderOp getRenderOp()
     {
-        sharedBufferChans.clear (channelNum, 0, numSamples);
+        RenderOp r;
+        r.type = RenderOp::clearChannel;
+        r.dst = channelNum;
+        return r;
+    }
+
+    void getBufferAccess (GraphOpAccess& access) const
+    {
+        access.audioWrites.add (channelNum);
     }
 
 private:
@@ -26,7 +65,7 @@ private:
     JUCE_DECLARE_NON_COPYABLE (ClearChannelOp)
 };
 
-class CopyChannelOp : public GraphOp
+class CopyChannelOp : public InstructionOp
 {
 public:
     CopyChannelOp (const int srcChannelNum_, const int dstChannelNum_)
@@ -35,9 +74,19 @@ public:
     {
     }
 
-    void perform (AudioSampleBuffer& sharedBufferChans, const OwnedArray<MidiBuffer>&, const int numSamples)
+    RenderOp getRenderOp()
     {
-        sharedBufferChans.copyFrom (dstChannelNum, 0, sharedBufferChans, srcChannelNum, 0, numSamples);
+        RenderOp r;
+        r.type = RenderOp::copyChannel;
+        r.src = srcChannelNum;
+        r.dst = dstChannelNum;
+        return r;
+    }
+
+    void getBufferAccess (GraphOpAccess& access) const
+    {
+        access.audioReads.add (srcChannelNum);
+        access.audioWrites.add (dstChannelNum);
     }
 
 private:
@@ -46,7 +95,7 @@ private:
     JUCE_DECLARE_NON_COPYABLE (CopyChannelOp)
 };
 
-class AddChannelOp : public GraphOp
+class AddChannelOp : public InstructionOp
 {
 public:
     AddChannelOp (const int srcChannelNum_, const int dstChannelNum_)
@@ -55,9 +104,19 @@ public:
     {
     }
 
-    void perform (AudioSampleBuffer& sharedBufferChans, const OwnedArray<MidiBuffer>&, const int numSamples)
+    RenderOp getRenderOp()
+    {
+        RenderOp r;
+        r.type = RenderOp::addChannel;
+        r.src = srcChannelNum;
+        r.dst = dstChannelNum;
+        return r;
+    }
+
+    void getBufferAccess (GraphOpAccess& access) const
     {
-        sharedBufferChans.addFrom (dstChannelNum, 0, sharedBufferChans, srcChannelNum, 0, numSamples);
+        access.audioReads.add (srcChannelNum);
+        access.audioWrites.add (dstChannelNum);
     }
 
 private:
@@ -66,7 +125,7 @@ private:
     JUCE_DECLARE_NON_COPYABLE (AddChannelOp)
 };
 
-class ClearMidiBufferOp : public GraphOp
+class ClearMidiBufferOp : public InstructionOp
 {
 public:
     ClearMidiBufferOp (const int bufferNum_)
@@ -74,9 +133,17 @@ public:
     {
     }
 
-    void perform (AudioSampleBuffer&, const OwnedArray<MidiBuffer>& sharedMidiBuffers, const int)
+    RenderOp getRenderOp()
+    {
+        RenderOp r;
+        r.type = RenderOp::clearMidi;
+        r.dst = bufferNum;
+        return r;
+    }
+
+    void getBufferAccess (GraphOpAccess& access) const
     {
-        sharedMidiBuffers.getUnchecked (bufferNum)->clear();
+        access.midiWrites.add (bufferNum);
     }
 
 private:
@@ -85,7 +152,7 @@ private:
     JUCE_DECLARE_NON_COPYABLE (ClearMidiBufferOp)
 };
 
-class CopyMidiBufferOp : public GraphOp
+class CopyMidiBufferOp : public InstructionOp
 {
 public:
     CopyMidiBufferOp (const int srcBufferNum_, const int dstBufferNum_)
@@ -94,9 +161,19 @@ public:
     {
     }
 
-    void perform (AudioSampleBuffer&, const OwnedArray<MidiBuffer>& sharedMidiBuffers, const int)
+    RenderOp getRenderOp()
     {
-        *sharedMidiBuffers.getUnchecked (dstBufferNum) = *sharedMidiBuffers.getUnchecked (srcBufferNum);
+        RenderOp r;
+        r.type = RenderOp::copyMidi;
+        r.src = srcBufferNum;
+        r.dst = dstBufferNum;
+        return r;
+    }
+
+    void getBufferAccess (GraphOpAccess& access) const
+    {
+        access.midiReads.add (srcBufferNum);
+        access.midiWrites.add (dstBufferNum);
     }
 
 private:
@@ -105,7 +182,7 @@ private:
     JUCE_DECLARE_NON_COPYABLE (CopyMidiBufferOp)
 };
 
-class AddMidiBufferOp : public GraphOp
+class AddMidiBufferOp : public InstructionOp
 {
 public:
     AddMidiBufferOp (const int srcBufferNum_, const int dstBufferNum_)
@@ -114,10 +191,19 @@ public:
     {
     }
 
-    void perform (AudioSampleBuffer&, const OwnedArray<MidiBuffer>& sharedMidiBuffers, const int numSamples)
+    RenderOp getRenderOp()
+    {
+        RenderOp r;
+        r.type = RenderOp::addMidi;
+        r.src = srcBufferNum;
+        r.dst = dstBufferNum;
+        return r;
+    }
+
+    void getBufferAccess (GraphOpAccess& access) const
     {
-        sharedMidiBuffers.getUnchecked (dstBufferNum)
-            ->addEvents (*sharedMidiBuffers.getUnchecked (srcBufferNum), 0, numSamples, 0);
+        access.midiReads.add (srcBufferNum);
+        access.midiWrites.add (dstBufferNum);
     }
 
 private:
@@ -126,46 +212,268 @@ private:
     JUCE_DECLARE_NON_COPYABLE (AddMidiBufferOp)
 };
 
-class DelayChannelOp : public GraphOp
+/** Delays a channel for latency compensation.  The source and destination
+    can be the same buffer, a separate destination lets the delayed signal be
+    shared by every node which needs the same source with the same delay.
+ */
+class DelayChannelOp : public SampleTypeOp<DelayChannelOp>
 {
 public:
-    DelayChannelOp (const int channel_, const int numSamplesDelay_)
-        : channel (channel_),
-          bufferSize (numSamplesDelay_ + 1),
-          readIndex (0),
-          writeIndex (numSamplesDelay_)
+    DelayChannelOp (const int srcChannel_, const int dstChannel_, const int numSamplesDelay, const int blockSize)
+        : srcChannel (srcChannel_),
+          dstChannel (dstChannel_)
     {
-        buffer.calloc ((size_t) bufferSize);
+        // the op is shared by programs of either precision, a line each is
+        // cheaper than allocating when the precision changes
+        line.setDelay (numSamplesDelay, blockSize);
+        doubleLine.setDelay (numSamplesDelay, blockSize);
+        silentSamples = line.getSize();
     }
 
-    void perform (AudioSampleBuffer& sharedBufferChans, const OwnedArray<MidiBuffer>&, const int numSamples)
+    template <typename SampleType>
+    void process (AudioBuffer<SampleType>& sharedBufferChans, const OwnedArray<MidiBuffer>&, bool* silentChannels, const int numSamples)
     {
-        float* data = sharedBufferChans.getWritePointer (channel, 0);
+        const bool inputSilent = silentChannels[srcChannel];
 
-        for (int i = numSamples; --i >= 0;)
+        // once the line has filled with silence it only ever outputs silence
+        if (inputSilent && silentSamples >= line.getSize())
         {
-            buffer[writeIndex] = *data;
-            *data++ = buffer[readIndex];
-
-            if (++readIndex >= bufferSize)
-                readIndex = 0;
-            if (++writeIndex >= bufferSize)
-                writeIndex = 0;
+            if (! silentChannels[dstChannel])
+                sharedBufferChans.clear (dstChannel, 0, numSamples);
+            silentChannels[dstChannel] = true;
+            return;
         }
+
+        if constexpr (std::is_same<SampleType, double>::value)
+            doubleLine.process (sharedBufferChans.getReadPointer (srcChannel), sharedBufferChans.getWritePointer (dstChannel), numSamples);
+        else
+            line.process (sharedBufferChans.getReadPointer (srcChannel), sharedBufferChans.getWritePointer (dstChannel), numSamples);
+
+        silentSamples = inputSilent ? jmin (silentSamples + numSamples, line.getSize()) : 0;
+        silentChannels[dstChannel] = silentSamples >= line.getDelay() + numSamples;
+    }
+
+    void getBufferAccess (GraphOpAccess& access) const
+    {
+        if (srcChannel != dstChannel)
+            access.audioReads.add (srcChannel);
+        access.audioWrites.add (dstChannel);
     }
 
 private:
-    HeapBlock<float> buffer;
-    const int channel, bufferSize;
-    int readIndex, writeIndex;
+    const int srcChannel, dstChannel;
+    DelayLine<float> line;
+    DelayLine<double> doubleLine;
+    int silentSamples = 0;
 
     JUCE_DECLARE_NON_COPYABLE (DelayChannelOp)
 };
 
-class ProcessBufferOp : public GraphOp
+/** Copies a node's output in to the block a LookAhead is rendering */
+class WriteAheadOp : public SampleTypeOp<WriteAheadOp>
+{
+public:
+    WriteAheadOp (LookAhead& lookAhead_, const LookAhead::Port& port_, const int srcBuffer_)
+        : lookAhead (lookAhead_),
+          port (port_),
+          srcBuffer (srcBuffer_)
+    {
+    }
+
+    template <typename SampleType>
+    void process (AudioBuffer<SampleType>& sharedBufferChans, const OwnedArray<MidiBuffer>& sharedMidiBuffers, bool* silentChannels, const int)
+    {
+        if (port.type == PortType::Audio)
+            lookAhead.write (port.index, sharedBufferChans.getReadPointer (srcBuffer), silentChannels[srcBuffer]);
+        else
+            lookAhead.writeMidi (port.index, *sharedMidiBuffers.getUnchecked (srcBuffer));
+    }
+
+    void getBufferAccess (GraphOpAccess& access) const
+    {
+        if (port.type == PortType::Audio)
+            access.audioReads.add (srcBuffer);
+        else
+            access.midiReads.add (srcBuffer);
+    }
+
+private:
+    LookAhead& lookAhead;
+    const LookAhead::Port port;
+    const int srcBuffer;
+
+    JUCE_DECLARE_NON_COPYABLE (WriteAheadOp)
+};
+
+/** Reads the output of a node rendered ahead back in to a shared buffer */
+class ReadAheadOp : public SampleTypeOp<ReadAheadOp>
+{
+public:
+    ReadAheadOp (LookAhead& lookAhead_, const LookAhead::Port& port_, const int dstBuffer_)
+        : lookAhead (lookAhead_),
+          port (port_),
+          dstBuffer (dstBuffer_)
+    {
+    }
+
+    template <typename SampleType>
+    void process (AudioBuffer<SampleType>& sharedBufferChans, const OwnedArray<MidiBuffer>& sharedMidiBuffers, bool* silentChannels, const int numSamples)
+    {
+        if (port.type == PortType::Midi)
+        {
+            auto& midi = *sharedMidiBuffers.getUnchecked (dstBuffer);
+            midi.clear();
+            lookAhead.readMidi (port.index, midi, numSamples);
+            return;
+        }
+
+        const bool silent = lookAhead.read (port.index, sharedBufferChans.getWritePointer (dstBuffer), numSamples);
+        if (silent && ! silentChannels[dstBuffer])
+            sharedBufferChans.clear (dstBuffer, 0, numSamples);
+        silentChannels[dstBuffer] = silent;
+    }
+
+    void getBufferAccess (GraphOpAccess& access) const
+    {
+        if (port.type == PortType::Audio)
+            access.audioWrites.add (dstBuffer);
+        else
+            access.midiWrites.add (dstBuffer);
+    }
+
+private:
+    LookAhead& lookAhead;
+    const LookAhead::Port port;
+    const int dstBuffer;
+
+    JUCE_DECLARE_NON_COPYABLE (ReadAheadOp)
+};
+
+/** Streams the audio a node was frozen to at the transport position, in
+    place of the node */
+class PlayFrozenOp : public SampleTypeOp<PlayFrozenOp>
+{
+public:
+    PlayFrozenOp (FrozenAudio* audio_, AudioPlayHead& playhead_, const Array<int>& channels_, const int blockSize)
+        : audio (audio_),
+          playhead (playhead_),
+          channels (channels_)
+    {
+        pointers.calloc ((size_t) jmax (1, channels.size()));
+        floatBuffer.setSize (jmax (1, channels.size()), jmax (1, blockSize));
+    }
+
+    template <typename SampleType>
+    void process (AudioBuffer<SampleType>& sharedBufferChans, const OwnedArray<MidiBuffer>&, bool* silentChannels, const int numSamples)
+    {
+        bool silent = true;
+        const auto position = audio != nullptr ? playhead.getPosition() : Optional<AudioPlayHead::PositionInfo>();
+        const auto time = position.hasValue() && position->getIsPlaying() ? position->getTimeInSamples() : Optional<int64>();
+
+        if (time.hasValue())
+        {
+            if constexpr (std::is_same<SampleType, double>::value)
+            {
+                silent = ! audio->read (floatBuffer.getArrayOfWritePointers(), channels.size(), *time, numSamples);
+                for (int i = 0; ! silent && i < channels.size(); ++i)
+                {
+                    const auto* const src = floatBuffer.getReadPointer (i);
+                    std::copy (src, src + numSamples, sharedBufferChans.getWritePointer (channels.getUnchecked (i)));
+                }
+            }
+            else
+            {
+                for (int i = 0; i < channels.size(); ++i)
+                    pointers[i] = sharedBufferChans.getWritePointer (channels.getUnchecked (i));
+                silent = ! audio->read (pointers.get(), channels.size(), *time, numSamples);
+            }
+        }
+
+        for (const auto channel : channels)
+        {
+            if (silent && ! silentChannels[channel])
+                sharedBufferChans.clear (channel, 0, numSamples);
+            silentChannels[channel] = silent;
+        }
+    }
+
+    void getBufferAccess (GraphOpAccess& access) const
+    {
+        access.audioWrites.addArray (channels);
+    }
+
+private:
+    const FrozenAudio::Ptr audio;
+    AudioPlayHead& playhead;
+    const Array<int> channels;
+    HeapBlock<float*> pointers;
+    AudioSampleBuffer floatBuffer;
+
+    JUCE_DECLARE_NON_COPYABLE (PlayFrozenOp)
+};
+
+/** Routes a bypassed node's inputs straight to its outputs in place of the
+    node.  Each input shares its buffer with the output of the same index, so
+    only outputs without a matching input need clearing.
+ */
+class BypassOp : public SampleTypeOp<BypassOp>
+{
+public:
+    BypassOp (const NodeObjectPtr& node_, const NodeState& state, const Array<int>& audioChannels_, const Array<int>& midiChannels_)
+        : node (node_),
+          audioChannels (audioChannels_),
+          midiChannels (midiChannels_),
+          numAudioIns (state.getNumPorts (PortType::Audio, true)),
+          numAudioOuts (state.getNumPorts (PortType::Audio, false)),
+          numMidiIns (state.getNumPorts (PortType::Midi, true)),
+          numMidiOuts (state.getNumPorts (PortType::Midi, false))
+    {
+    }
+
+    template <typename SampleType>
+    void process (AudioBuffer<SampleType>& sharedBufferChans, const OwnedArray<MidiBuffer>& sharedMidiBuffers, bool* silentChannels, const int numSamples)
+    {
+        for (int i = numAudioIns; i < numAudioOuts; ++i)
+        {
+            const int channel = audioChannels.getUnchecked (i);
+            if (! silentChannels[channel])
+                sharedBufferChans.clear (channel, 0, numSamples);
+            silentChannels[channel] = true;
+        }
+
+        for (int i = numMidiIns; i < numMidiOuts; ++i)
+            sharedMidiBuffers.getUnchecked (midiChannels.getUnchecked (i))->clear();
+
+        node->renderedBypassed = true;
+    }
+
+    void getBufferAccess (GraphOpAccess& access) const
+    {
+        for (int i = 0; i < audioChannels.size(); ++i)
+        {
+            if (i < numAudioOuts)
+                access.audioWrites.add (audioChannels.getUnchecked (i));
+            else
+                access.audioReads.add (audioChannels.getUnchecked (i));
+        }
+
+        access.midiWrites.addArray (midiChannels);
+    }
+
+private:
+    const NodeObjectPtr node;
+    const Array<int> audioChannels;
+    const Array<int> midiChannels;
+    const int numAudioIns, numAudioOuts, numMidiIns, numMidiOuts;
+
+    JUCE_DECLARE_NON_COPYABLE (BypassOp)
+};
+
+class ProcessBufferOp : public SampleTypeOp<ProcessBufferOp>
 {
 public:
     ProcessBufferOp (const NodeObjectPtr& node_,
+                     const NodeState& state,
                      const Array<int>& audioChannelsToUse_,
                      const int totalChans_,
                      const int midiBufferToUse_,
@@ -175,11 +483,13 @@ public:
           audioChannelsToUse (audioChannelsToUse_),
           midiChannelsToUse (chans[PortType::Midi]),
           totalChans (jmax (1, totalChans_)),
-          numAudioIns (node_->getNumPorts (PortType::Audio, true)),
-          numAudioOuts (node_->getNumPorts (PortType::Audio, false)),
-          midiBufferToUse (midiBufferToUse_)
+          numAudioIns (state.getNumPorts (PortType::Audio, true)),
+          numAudioOuts (state.getNumPorts (PortType::Audio, false)),
+          midiBufferToUse (midiBufferToUse_),
+          bypass (node_, state, audioChannelsToUse_, chans[PortType::Midi])
     {
         channels.calloc ((size_t) totalChans);
+        doubleChannels.calloc ((size_t) totalChans);
 
         while (audioChannelsToUse.size() < totalChans)
             audioChannelsToUse.add (0);
@@ -189,101 +499,168 @@ public:
         else
             midiChannelsToUse.add (midiBufferToUse);
 
+        // mute is switched while rendering, the op reads it like each block does
         lastMute = node->isMuted();
+        isIONode = node->isA<IONode>();
+        numDryChans = isIONode ? 0 : jmin (numAudioIns, numAudioOuts);
+
+        // only audio effects which report a tail can idle.  Anything taking
+        // or making MIDI may play from notes or the transport, and a tail of
+        // zero is what most plugins report when they don't know theirs.
+        const double tailSeconds = state.tailSeconds;
+        canIdle = processor != nullptr && ! isIONode && ! node->wantsMidiPipe()
+                  && numAudioIns > 0 && ! processor->acceptsMidi()
+                  && ! processor->producesMidi() && ! processor->isMidiEffect()
+                  && tailSeconds > 0.0 && std::isfinite (tailSeconds);
+
+        auto* const graph = node->getParentGraph();
+        if (canIdle)
+        {
+            tailSamples = roundToInt (tailSeconds * state.sampleRate) + state.latencySamples;
+            if (graph != nullptr)
+                playhead = &graph->getPlayHeadForNodes();
+            lastChangeCount = node->getProcessorChangeCount();
+        }
 
         osChanSize = totalChans;
         osChans.reset (new float*[osChanSize]);
         tempMidi.ensureSize (128);
+
+        // size the buffers used to convert between precisions up front, they
+        // only grow on the audio thread if the oversampling factor does
+        if (graph != nullptr && graph->isUsingDoublePrecision())
+        {
+            const int blockSize = jmax (1, state.blockSize);
+            floatBuffer.setSize (totalChans, blockSize);
+            doubleBuffer.setSize (totalChans, blockSize * jmax (1, state.oversamplingFactor));
+            dryDouble.setSize (numDryChans, blockSize);
+        }
+        else
+        {
+            dryFloat.setSize (numDryChans, jmax (1, state.blockSize));
+        }
     }
 
-    void perform (AudioSampleBuffer& sharedBufferChans, const OwnedArray<MidiBuffer>& sharedMidiBuffers, const int numSamples)
+    template <typename SampleType>
+    void process (AudioBuffer<SampleType>& sharedBufferChans, const OwnedArray<MidiBuffer>& sharedMidiBuffers, bool* silentChannels, const int numSamples)
     {
+        SampleType** chans;
+        if constexpr (std::is_same<SampleType, double>::value)
+            chans = doubleChannels.get();
+        else
+            chans = channels.get();
+
         for (int i = totalChans; --i >= 0;)
         {
-            channels[i] = sharedBufferChans.getWritePointer (audioChannelsToUse.getUnchecked (i), 0);
+            chans[i] = sharedBufferChans.getWritePointer (audioChannelsToUse.getUnchecked (i), 0);
         }
 
-        AudioSampleBuffer buffer (channels, totalChans, numSamples);
+        AudioBuffer<SampleType> buffer (chans, totalChans, numSamples);
         MidiPipe midiPipe (sharedMidiBuffers, midiChannelsToUse);
 
+        // disabled nodes are compiled out and the nodes they feed read
+        // silence, until the program is swapped this does the same thing
         if (! node->isEnabled())
         {
-            for (int ch = numAudioIns; ch < numAudioOuts; ++ch)
+            for (int ch = 0; ch < numAudioOuts; ++ch)
+            {
                 buffer.clear (ch, 0, buffer.getNumSamples());
+                silentChannels[audioChannelsToUse.getUnchecked (ch)] = true;
+            }
+            midiPipe.clear();
             return;
         }
 
-        const bool muted = node->isMuted();
-        const bool muteInput = node->isMutingInputs();
+        // IO nodes can't be routed around, they render their own bypass
+        const bool bypassed = node->isSuspended();
+        bypassing = isIONode && bypassed;
 
-        if (muted && muteInput)
+        // bypassed nodes are compiled as a BypassOp, until the program
+        // is swapped this does the same thing
+        if (! isIONode && bypassed && node->renderedBypassed)
         {
-            if (lastMute != muted)
-            {
-                // just became muted
-                buffer.applyGainRamp (0, numSamples, node->getLastInputGain(), 0.0);
-            }
-            else
-            {
-                // normal mute processing
-                buffer.applyGain (0, numSamples, 0.0);
-            }
+            bypass.process (sharedBufferChans, sharedMidiBuffers, silentChannels, numSamples);
+            return;
         }
-        else if (! muted && muteInput && muted != lastMute)
+
+        // crossfade between the dry inputs and the node for one block when
+        // it has just been bypassed or brought back
+        const bool crossfading = ! isIONode && bypassed != node->renderedBypassed;
+        auto& dry = getDryBuffer<SampleType>();
+        if (crossfading)
         {
-            // just became unmuted
-            buffer.applyGainRamp (0, numSamples, 0.0, node->getInputGain());
+            dry.setSize (numDryChans, numSamples, false, false, true);
+            for (int i = 0; i < numDryChans; ++i)
+                dry.copyFrom (i, 0, buffer, i, 0, numSamples);
         }
-        else if (node->getInputGain() != node->getLastInputGain())
+        else if (canIdle && isIdle (sharedMidiBuffers, silentChannels, numSamples))
         {
-            buffer.applyGainRamp (0, numSamples, node->getLastInputGain(), node->getInputGain());
+            performIdle (buffer, silentChannels);
+            return;
         }
-        else
+
+        const bool muted = node->isMuted();
+        const bool muteInput = node->isMutingInputs();
+
+        // input gain and metering in one pass over the inputs
+        const bool metering = node->isMetering();
+        const auto inputRamp = getGainRamp (muted, muteInput, node->getInputGain(), node->getLastInputGain());
+        if (metering || ! inputRamp.isUnity())
         {
-            buffer.applyGain (0, numSamples, node->getInputGain());
+            for (int i = 0; i < numAudioIns; ++i)
+            {
+                if (metering)
+                    node->meters.setInput (i, applyGainAndMeasure (buffer.getWritePointer (i), numSamples, inputRamp.start, inputRamp.end));
+                else
+                    buffer.applyGainRamp (i, 0, numSamples, inputRamp.start, inputRamp.end);
+            }
         }
 
-        for (int i = numAudioIns; --i >= 0;)
-            node->setInputRMS (i, buffer.getRMSLevel (i, 0, numSamples));
-
         // Begin MIDI filters
         {
             jassert (tempMidi.getNumEvents() == 0);
-            ScopedLock spl (node->getPropertyLock());
-            transpose.setNoteOffset (node->getTransposeOffset());
-            const auto keyRange (node->getKeyRange());
-            const auto midiChans (node->getMidiChannels());
-            const auto useMidiProgram (node->areMidiProgramsEnabled());
+            const auto& props = node->getRenderProperties();
+            transpose.setNoteOffset (props.transposeOffset);
+            const auto keyRange (props.keyRange);
+            const auto& midiChans (props.midiChannels);
+            const auto useMidiProgram (props.midiProgramsEnabled);
 
             if (keyRange.getLength() > 0 || ! midiChans.isOmni() || useMidiProgram)
             {
                 for (int i = 0; i < midiPipe.getNumBuffers(); ++i)
                 {
                     auto& midi = *midiPipe.getWriteBuffer (i);
-                    MidiBuffer::Iterator iter (midi);
-                    int frame = 0;
-                    MidiMessage msg;
-                    while (iter.getNextEvent (msg, frame))
+                    for (const auto metadata : midi)
                     {
-                        if (msg.isNoteOnOrOff())
-                        {
-                            // out of range
-                            if (keyRange.getLength() > 0 && (msg.getNoteNumber() < keyRange.getStart() || msg.getNoteNumber() > keyRange.getEnd()))
-                                continue;
-                        }
+                        const auto* data = metadata.data;
+                        const int size = metadata.numBytes;
+                        const int status = size > 0 ? (data[0] & 0xf0) : 0xf0;
+                        const bool isNote = size >= 2 && (status == 0x80 || status == 0x90);
 
-                        if (msg.getChannel() > 0 && midiChans.isOff (msg.getChannel()))
+                        // out of range
+                        if (isNote && keyRange.getLength() > 0 && (data[1] < keyRange.getStart() || data[1] > keyRange.getEnd()))
                             continue;
 
-                        if (useMidiProgram && msg.isProgramChange())
+                        if (status != 0xf0 && midiChans.isOff ((data[0] & 0x0f) + 1))
+                            continue;
+
+                        if (useMidiProgram && status == 0xc0 && size >= 2)
                         {
-                            node->setMidiProgram (msg.getProgramChangeNumber());
+                            node->setMidiProgram (data[1]);
                             node->reloadMidiProgram();
                             continue;
                         }
 
-                        transpose.process (msg);
-                        tempMidi.addEvent (msg, frame);
+                        if (isNote && size <= 3)
+                        {
+                            uint8 bytes[3];
+                            std::memcpy (bytes, data, (size_t) size);
+                            MidiTranspose::process (bytes, size, transpose.getNoteOffset());
+                            appendMidiEvent (tempMidi, bytes, size, metadata.samplePosition);
+                            continue;
+                        }
+
+                        appendMidiEvent (tempMidi, data, size, metadata.samplePosition);
                     }
 
                     midi.swapWith (tempMidi);
@@ -300,30 +677,233 @@ public:
         tempMidi.clear();
         // End MIDI filters
 
-        auto pluginProcessBlock = [=] (AudioSampleBuffer& buffer, MidiPipe& midiPipe, bool isSuspended) {
-            if (node->wantsMidiPipe())
+        renderNode (buffer, midiPipe);
+
+        // output gain, metering and silence in one pass over the outputs
+        const auto outputRamp = getGainRamp (muted, ! muteInput, node->getGain(), node->getLastGain());
+        node->updateGain();
+        lastMute = muted;
+
+        bool silent = ! muted && node->getGain() > 0.f;
+        for (int i = 0; i < numAudioOuts; ++i)
+        {
+            bool silentChannel;
+            if (metering || ! outputRamp.isUnity())
             {
-                if (! node->isSuspended())
-                    node->render (buffer, midiPipe);
-                else
-                    node->renderBypassed (buffer, midiPipe);
+                const auto levels = applyGainAndMeasure (buffer.getWritePointer (i), numSamples, outputRamp.start, outputRamp.end);
+                if (metering)
+                    node->meters.setOutput (i, levels);
+                silentChannel = levels.peak == 0.f;
             }
             else
             {
-                jassert (processor != nullptr);
-                if (! isSuspended)
-                {
-                    processor->processBlock (buffer, *midiPipe.getWriteBuffer (0));
-                    // processor->processBlock (buffer, *sharedMidiBuffers.getUnchecked (midiBufferToUse));
-                }
-                else
+                silentChannel = isSilent (buffer.getReadPointer (i), numSamples);
+            }
+
+            silentChannels[audioChannelsToUse.getUnchecked (i)] = silentChannel;
+            silent &= silentChannel;
+        }
+
+        if (crossfading)
+        {
+            const float nodeGain = bypassed ? 0.f : 1.f;
+            for (int i = 0; i < numAudioOuts; ++i)
+            {
+                buffer.applyGainRamp (i, 0, numSamples, 1.f - nodeGain, nodeGain);
+                if (i < numDryChans)
                 {
-                    processor->processBlockBypassed (buffer, *midiPipe.getWriteBuffer (0));
-                    // processor->processBlockBypassed (buffer, *sharedMidiBuffers.getUnchecked (midiBufferToUse));
+                    buffer.addFromWithRamp (i, 0, dry.getReadPointer (i), numSamples, nodeGain, 1.f - nodeGain);
+                    silentChannels[audioChannelsToUse.getUnchecked (i)] = false;
+                    silent = false;
                 }
             }
-        };
 
+            node->renderedBypassed = bypassed;
+        }
+
+        for (const auto midiBuffer : midiChannelsToUse)
+            silent &= sharedMidiBuffers.getUnchecked (midiBuffer)->isEmpty();
+        outputWasSilent = silent;
+    }
+
+    void getBufferAccess (GraphOpAccess& access) const
+    {
+        // channels past the outputs are inputs only and aren't written to
+        for (int i = 0; i < totalChans; ++i)
+        {
+            if (i < numAudioOuts)
+                access.audioWrites.add (audioChannelsToUse.getUnchecked (i));
+            else
+                access.audioReads.add (audioChannelsToUse.getUnchecked (i));
+        }
+
+        access.midiWrites.addArray (midiChannelsToUse);
+
+        // IO nodes read and write buffers owned by the parent graph
+        if (isIONode)
+            access.usesGraphIO = true;
+    }
+
+    NodeObject* getRenderedNode() const override { return node.get(); }
+
+    const NodeObjectPtr node;
+    AudioProcessor* const processor;
+
+private:
+    Array<int> audioChannelsToUse;
+    Array<int> midiChannelsToUse;
+    HeapBlock<float*> channels;
+    HeapBlock<double*> doubleChannels;
+    int totalChans, numAudioIns, numAudioOuts;
+    int midiBufferToUse;
+    bool lastMute = false;
+    bool isIONode = false;
+    bool bypassing = false;
+    MidiTranspose transpose;
+    MidiBuffer tempMidi;
+
+    std::unique_ptr<float*> osChans;
+    int osChanSize = 0;
+
+    // a block converted to the other precision
+    AudioSampleBuffer floatBuffer;
+    AudioBuffer<double> doubleBuffer;
+
+    // the inputs to crossfade with when the node is bypassed or brought back
+    BypassOp bypass;
+    int numDryChans = 0;
+    AudioSampleBuffer dryFloat;
+    AudioBuffer<double> dryDouble;
+
+    template <typename SampleType>
+    AudioBuffer<SampleType>& getDryBuffer() noexcept
+    {
+        if constexpr (std::is_same<SampleType, double>::value)
+            return dryDouble;
+        else
+            return dryFloat;
+    }
+
+    /** A gain applied across one block, from start to end */
+    struct GainRamp
+    {
+        float start, end;
+        bool isUnity() const noexcept { return start == 1.f && end == 1.f; }
+    };
+
+    /** Returns the gain for the input or output stage, fading in or out
+        when the stage has just been muted or unmuted. */
+    GainRamp getGainRamp (const bool muted, const bool stageMutes, const float gain, const float lastGain) const noexcept
+    {
+        if (muted && stageMutes)
+        {
+            if (lastMute != muted)
+                return { lastGain, 0.f }; // just became muted
+            return { 0.f, 0.f };
+        }
+
+        if (! muted && stageMutes && muted != lastMute)
+            return { 0.f, gain }; // just became unmuted
+
+        return { lastGain, gain };
+    }
+
+    // idle when the inputs have been silent for longer than the tail
+    bool canIdle = false;
+    int tailSamples = 0;
+    int silentInputSamples = 0;
+    bool outputWasSilent = false;
+
+    // the node's processor change count seen last block, a parameter or
+    // state change wakes the node
+    uint32 lastChangeCount = 0;
+
+    // the transport seen last block, a node wakes when it starts, stops or jumps
+    AudioPlayHead* playhead = nullptr;
+    bool wasPlaying = false;
+    int64 nextTimeInSamples = 0;
+
+    /** Returns true if the transport started, stopped or moved somewhere
+        other than where the last block left it */
+    bool transportChanged (const int numSamples) noexcept
+    {
+        if (playhead == nullptr)
+            return false;
+
+        const auto position = playhead->getPosition();
+        const bool playing = position.hasValue() && position->getIsPlaying();
+        const int64 time = position.hasValue() ? position->getTimeInSamples().orFallback (0) : 0;
+        const bool result = playing != wasPlaying || (playing && time != nextTimeInSamples);
+        wasPlaying = playing;
+        nextTimeInSamples = time + numSamples;
+        return result;
+    }
+
+    /** Returns true if the node can be skipped this block: its inputs have
+        been silent for longer than its tail and latency, and the last block
+        it rendered came out silent.  Muted nodes never count as silent, it
+        would hide a tail that's still running.  A parameter, state or
+        transport change wakes the node for at least one block.
+     */
+    bool isIdle (const OwnedArray<MidiBuffer>& sharedMidiBuffers, const bool* silentChannels, const int numSamples) noexcept
+    {
+        const auto changeCount = node->getProcessorChangeCount();
+        const bool wake = changeCount != lastChangeCount;
+        lastChangeCount = changeCount;
+        if (transportChanged (numSamples) || wake)
+        {
+            silentInputSamples = 0;
+            return false;
+        }
+
+        for (int i = 0; i < numAudioIns; ++i)
+        {
+            if (! silentChannels[audioChannelsToUse.getUnchecked (i)])
+            {
+                silentInputSamples = 0;
+                return false;
+            }
+        }
+
+        for (const auto midiBuffer : midiChannelsToUse)
+        {
+            if (! sharedMidiBuffers.getUnchecked (midiBuffer)->isEmpty())
+            {
+                silentInputSamples = 0;
+                return false;
+            }
+        }
+
+        const bool idle = outputWasSilent && silentInputSamples > tailSamples;
+        silentInputSamples = jmin (silentInputSamples + numSamples, tailSamples + 1);
+        return idle;
+    }
+
+    /** Outputs silence without running the node */
+    template <typename SampleType>
+    void performIdle (AudioBuffer<SampleType>& buffer, bool* silentChannels) noexcept
+    {
+        for (int i = 0; i < numAudioOuts; ++i)
+        {
+            const int channel = audioChannelsToUse.getUnchecked (i);
+            if (! silentChannels[channel])
+                buffer.clear (i, 0, buffer.getNumSamples());
+            silentChannels[channel] = true;
+        }
+
+        if (node->isMetering())
+        {
+            node->meters.clearInputs();
+            node->meters.clearOutputs();
+        }
+
+        node->updateGain();
+        lastMute = node->isMuted();
+    }
+
+    /** Runs the node at the graph's sample rate and precision */
+    void renderNode (AudioSampleBuffer& buffer, MidiPipe& midiPipe)
+    {
         const auto osFactor = node->getOversamplingFactor();
         if (osFactor > 1)
         {
@@ -351,17 +931,12 @@ public:
             {
                 auto& mb = *midiPipe.getWriteBuffer (i);
                 for (const MidiMessageMetadata msg : mb)
-                {
-                    tempMidi.addEvent (
-                        msg.data,
-                        msg.numBytes,
-                        msg.samplePosition * osFactor);
-                }
+                    appendMidiEvent (tempMidi, msg.data, msg.numBytes, msg.samplePosition * osFactor);
                 mb.swapWith (tempMidi);
                 tempMidi.clear();
             }
 
-            pluginProcessBlock (osBuffer, midiPipe, node->isSuspended());
+            renderFloat (osBuffer, midiPipe);
             osProcessor->processSamplesDown (block);
 
             tempMidi.clear();
@@ -369,188 +944,642 @@ public:
             {
                 auto& mb = *midiPipe.getWriteBuffer (i);
                 for (const MidiMessageMetadata msg : mb)
-                {
-                    tempMidi.addEvent (
-                        msg.data,
-                        msg.numBytes,
-                        msg.samplePosition / osFactor);
-                }
+                    appendMidiEvent (tempMidi, msg.data, msg.numBytes, msg.samplePosition / osFactor);
                 mb.swapWith (tempMidi);
                 tempMidi.clear();
             }
         }
         else
         {
-            pluginProcessBlock (buffer, midiPipe, node->isSuspended());
+            renderFloat (buffer, midiPipe);
         }
+    }
 
-        if (muted && ! muteInput)
+    void renderNode (AudioBuffer<double>& buffer, MidiPipe& midiPipe)
+    {
+        if (node->getOversamplingFactor() <= 1 && rendersDoublePrecision())
         {
-            if (lastMute != muted)
+            callNode (buffer, midiPipe);
+            return;
+        }
+
+        // a float only node, or the oversampler, converts at its edges
+        floatBuffer.makeCopyOf (buffer, true);
+        renderNode (floatBuffer, midiPipe);
+        buffer.makeCopyOf (floatBuffer, true);
+    }
+
+    /** Calls the node with float buffers. A double precision plugin behind
+        an oversampler still gets doubles, it can't be called with floats.
+     */
+    void renderFloat (AudioSampleBuffer& buffer, MidiPipe& midiPipe)
+    {
+        if (! node->wantsMidiPipe() && processor != nullptr && processor->isUsingDoublePrecision())
+        {
+            doubleBuffer.makeCopyOf (buffer, true);
+            callNode (doubleBuffer, midiPipe);
+            buffer.makeCopyOf (doubleBuffer, true);
+            return;
+        }
+
+        callNode (buffer, midiPipe);
+    }
+
+    template <typename SampleType>
+    void callNode (AudioBuffer<SampleType>& buffer, MidiPipe& midiPipe)
+    {
+        if (node->wantsMidiPipe())
+        {
+            if (! bypassing)
+                node->render (buffer, midiPipe);
+            else
+                node->renderBypassed (buffer, midiPipe);
+        }
+        else
+        {
+            jassert (processor != nullptr);
+            if (! bypassing)
             {
-                // just became muted
-                buffer.applyGainRamp (0, numSamples, node->getLastGain(), 0.0);
+                processor->processBlock (buffer, *midiPipe.getWriteBuffer (0));
+                // processor->processBlock (buffer, *sharedMidiBuffers.getUnchecked (midiBufferToUse));
             }
             else
             {
-                // normal mute processing
-                buffer.applyGain (0, numSamples, 0.0);
+                processor->processBlockBypassed (buffer, *midiPipe.getWriteBuffer (0));
+                // processor->processBlockBypassed (buffer, *sharedMidiBuffers.getUnchecked (midiBufferToUse));
             }
         }
-        else if (! muted && ! muteInput && muted != lastMute)
+    }
+
+    /** True if the node can be called with double buffers directly */
+    bool rendersDoublePrecision() const noexcept
+    {
+        if (node->wantsMidiPipe())
+            return node->supportsDoublePrecisionRender();
+        return processor != nullptr && processor->isUsingDoublePrecision();
+    }
+
+    JUCE_DECLARE_NON_COPYABLE (ProcessBufferOp)
+};
+
+/** Combines an instruction with the one before it if they write the same
+    buffer, returns false if they can't be combined. */
+static bool fuseRenderOps (RenderOp& prev, const RenderOp& next) noexcept
+{
+    if (prev.dst != next.dst || next.type == RenderOp::performOp)
+        return false;
+
+    switch (prev.type)
+    {
+        case RenderOp::clearChannel:
+            if (next.type == RenderOp::copyChannel)
+            {
+                prev = next;
+                return true;
+            }
+            if (next.type == RenderOp::addChannel && next.src != next.dst)
+            {
+                prev.type = RenderOp::copyChannel;
+                prev.src = next.src;
+                return true;
+            }
+            break;
+
+        case RenderOp::copyChannel:
+            if (next.type == RenderOp::addChannel && next.src != next.dst && prev.src != prev.dst)
+            {
+                prev.type = RenderOp::sumChannels;
+                prev.src2 = next.src;
+                return true;
+            }
+            break;
+
+        case RenderOp::clearMidi:
+            if (next.type == RenderOp::copyMidi)
+            {
+                prev = next;
+                return true;
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    return false;
+}
+
+RenderProgram::~RenderProgram() {}
+
+void RenderProgram::assemble (const Array<void*>& builderOps, const Array<GraphTask>& builderTasks)
+{
+    code.ensureStorageAllocated (code.size() + builderOps.size());
+    tasks.ensureStorageAllocated (tasks.size() + builderTasks.size());
+
+    for (const auto& builderTask : builderTasks)
+    {
+        const int firstOp = code.size();
+
+        for (int i = builderTask.firstOp; i < builderTask.firstOp + builderTask.numOps; ++i)
         {
-            // just became unmuted
-            buffer.applyGainRamp (0, numSamples, 0.0, node->getGain());
+            auto* const op = static_cast<GraphOp*> (builderOps.getUnchecked (i));
+            const auto r = op->getRenderOp();
+
+            if (r.type == RenderOp::performOp)
+                ops.add (op);
+            else
+                delete op;
+
+            // ops are only fused within a task, other tasks depend on them
+            if (code.size() > firstOp && fuseRenderOps (code.getReference (code.size() - 1), r))
+                continue;
+
+            code.add (r);
         }
-        else if (node->getGain() != node->getLastGain())
+
+        GraphTask task;
+        task.firstOp = firstOp;
+        task.numOps = code.size() - firstOp;
+        tasks.add (task);
+    }
+}
+
+/** Adds the shared buffers an instruction reads and writes */
+static void getRenderOpAccess (const RenderOp& r, GraphOpAccess& access)
+{
+    switch (r.type)
+    {
+        case RenderOp::clearChannel:
+            access.audioWrites.add (r.dst);
+            break;
+        case RenderOp::copyChannel:
+        case RenderOp::addChannel:
+            access.audioReads.add (r.src);
+            access.audioWrites.add (r.dst);
+            break;
+        case RenderOp::sumChannels:
+            access.audioReads.add (r.src);
+            access.audioReads.add (r.src2);
+            access.audioWrites.add (r.dst);
+            break;
+        case RenderOp::clearMidi:
+            access.midiWrites.add (r.dst);
+            break;
+        case RenderOp::copyMidi:
+        case RenderOp::addMidi:
+            access.midiReads.add (r.src);
+            access.midiWrites.add (r.dst);
+            break;
+        case RenderOp::performOp:
+            r.op->getBufferAccess (access);
+            break;
+    }
+}
+
+void RenderProgram::linkTasks (const int numAudioBuffers, const int numMidiBuffers)
+{
+    // one slot per audio buffer, then the MIDI buffers, then the graph's IO
+    const int numAudioSlots = numAudioBuffers;
+    const int graphIOSlot = numAudioSlots + numMidiBuffers;
+
+    Array<int> lastWriters;
+    lastWriters.insertMultiple (0, -1, graphIOSlot + 1);
+    Array<Array<int>> readers;
+    readers.resize (graphIOSlot + 1);
+    Array<SortedSet<int>> dependencies;
+    dependencies.resize (tasks.size());
+
+    for (int taskIndex = 0; taskIndex < tasks.size(); ++taskIndex)
+    {
+        auto& task = tasks.getReference (taskIndex);
+        task.numDependencies = 0;
+        task.dependents.clearQuick();
+
+        GraphOpAccess access;
+        for (int i = task.firstOp; i < task.firstOp + task.numOps; ++i)
+            getRenderOpAccess (code.getReference (i), access);
+
+        SortedSet<int> reads, writes;
+        for (const auto buffer : access.audioReads)
+            reads.add (buffer);
+        for (const auto buffer : access.midiReads)
+            reads.add (numAudioSlots + buffer);
+        for (const auto buffer : access.audioWrites)
+            writes.add (buffer);
+        for (const auto buffer : access.midiWrites)
+            writes.add (numAudioSlots + buffer);
+        if (access.usesGraphIO)
+            writes.add (graphIOSlot);
+
+        auto& deps = dependencies.getReference (taskIndex);
+
+        for (const auto slot : reads)
         {
-            buffer.applyGainRamp (0, numSamples, node->getLastGain(), node->getGain());
+            if (writes.contains (slot))
+                continue;
+            if (lastWriters.getUnchecked (slot) >= 0)
+                deps.add (lastWriters.getUnchecked (slot));
+            readers.getReference (slot).add (taskIndex);
         }
-        else
+
+        for (const auto slot : writes)
         {
-            buffer.applyGain (0, numSamples, node->getGain());
+            if (lastWriters.getUnchecked (slot) >= 0)
+                deps.add (lastWriters.getUnchecked (slot));
+            for (const auto reader : readers.getReference (slot))
+                deps.add (reader);
+            readers.getReference (slot).clearQuick();
+            lastWriters.set (slot, taskIndex);
         }
 
-        node->updateGain();
-        lastMute = muted;
+        deps.removeValue (taskIndex);
+    }
 
-        for (int i = 0; i < numAudioOuts; ++i)
-            node->setOutputRMS (i, buffer.getRMSLevel (i, 0, numSamples));
+    for (int taskIndex = 0; taskIndex < tasks.size(); ++taskIndex)
+    {
+        const auto& deps = dependencies.getReference (taskIndex);
+        tasks.getReference (taskIndex).numDependencies = deps.size();
+        for (const auto dep : deps)
+            tasks.getReference (dep).dependents.add (taskIndex);
     }
+}
 
-    const NodeObjectPtr node;
-    AudioProcessor* const processor;
+void RenderProgram::allocateBuffers (const int numAudioBuffers, const int numMidiBuffers, const int numSamples)
+{
+    // only the buffers of the program's precision are used
+    buffers.setSize (doublePrecision ? 1 : numAudioBuffers, doublePrecision ? 1 : numSamples);
+    doubleBuffers.setSize (doublePrecision ? numAudioBuffers : 1, doublePrecision ? numSamples : 1);
+    buffers.clear();
+    doubleBuffers.clear();
+
+    // everything starts out cleared
+    numSilentChannels = jmax (1, numAudioBuffers);
+    silentChannels.malloc ((size_t) numSilentChannels);
+    std::fill_n (silentChannels.get(), numSilentChannels, true);
+    silentBlockSize = numSamples;
+
+    midiBuffers.clear();
+    for (int i = numMidiBuffers; --i >= 0;)
+        midiBuffers.add (new MidiBuffer())->ensureSize (midiBufferBytes);
+
+    // every merge builds in its own buffer, instructions run on different
+    // threads never share one
+    midiScratch.clear();
+    for (auto& r : code)
+    {
+        if (r.type != RenderOp::addMidi)
+            continue;
+        r.src2 = midiScratch.size();
+        midiScratch.add (new MidiBuffer())->ensureSize (midiBufferBytes);
+    }
+}
 
-private:
-    Array<int> audioChannelsToUse;
-    Array<int> midiChannelsToUse;
-    HeapBlock<float*> channels;
-    int totalChans, numAudioIns, numAudioOuts;
-    int midiBufferToUse;
-    bool lastMute = false;
-    MidiTranspose transpose;
-    MidiBuffer tempMidi;
+void RenderProgram::beginBlock (const int numSamples) noexcept
+{
+    if (numSamples > silentBlockSize)
+    {
+        // the samples past the last block weren't covered, only the zero
+        // buffer is still known to be silent
+        std::fill_n (silentChannels.get() + 1, numSilentChannels - 1, false);
+    }
 
-    std::unique_ptr<float*> osChans;
-    int osChanSize = 0;
-    JUCE_DECLARE_NON_COPYABLE (ProcessBufferOp)
-};
+    silentBlockSize = numSamples;
+}
+
+void RenderProgram::perform (const int firstOp, const int numOps, const int numSamples) noexcept
+{
+    const ScopedRenderGuard guard;
+    if (doublePrecision)
+        performCode (doubleBuffers, firstOp, numOps, numSamples);
+    else
+        performCode (buffers, firstOp, numOps, numSamples);
+}
+
+template <typename SampleType>
+void RenderProgram::performCode (AudioBuffer<SampleType>& audio, const int firstOp, const int numOps, const int numSamples) noexcept
+{
+    auto* const* const chans = audio.getArrayOfWritePointers();
+    auto* const silent = silentChannels.get();
+
+    for (const auto *r = code.begin() + firstOp, *end = r + numOps; r != end; ++r)
+    {
+        switch (r->type)
+        {
+            // buffers known to be silent aren't read, silence is only written
+            // to buffers which aren't already
+            case RenderOp::clearChannel:
+                if (! silent[r->dst])
+                    FloatVectorOperations::clear (chans[r->dst], numSamples);
+                silent[r->dst] = true;
+                break;
+            case RenderOp::copyChannel:
+                if (! silent[r->src])
+                    FloatVectorOperations::copy (chans[r->dst], chans[r->src], numSamples);
+                else if (! silent[r->dst])
+                    FloatVectorOperations::clear (chans[r->dst], numSamples);
+                silent[r->dst] = silent[r->src];
+                break;
+            case RenderOp::addChannel:
+                if (silent[r->src])
+                    break;
+                FloatVectorOperations::add (chans[r->dst], chans[r->src], numSamples);
+                silent[r->dst] = false;
+                break;
+            case RenderOp::sumChannels:
+                if (! silent[r->src] && ! silent[r->src2])
+                    FloatVectorOperations::add (chans[r->dst], chans[r->src], chans[r->src2], numSamples);
+                else if (! silent[r->src])
+                    FloatVectorOperations::copy (chans[r->dst], chans[r->src], numSamples);
+                else if (! silent[r->src2])
+                    FloatVectorOperations::copy (chans[r->dst], chans[r->src2], numSamples);
+                else if (! silent[r->dst])
+                    FloatVectorOperations::clear (chans[r->dst], numSamples);
+                silent[r->dst] = silent[r->src] && silent[r->src2];
+                break;
+            case RenderOp::clearMidi:
+                midiBuffers.getUnchecked (r->dst)->clear();
+                break;
+            case RenderOp::copyMidi:
+                copyMidiEvents (*midiBuffers.getUnchecked (r->src), *midiBuffers.getUnchecked (r->dst));
+                break;
+            case RenderOp::addMidi:
+                mergeMidiEvents (*midiBuffers.getUnchecked (r->dst), *midiBuffers.getUnchecked (r->src),
+                                 *midiScratch.getUnchecked (r->src2), numSamples);
+                break;
+            case RenderOp::performOp:
+                r->op->perform (audio, midiBuffers, silent, numSamples);
+                break;
+        }
+    }
+}
+
+//==============================================================================
+NodeState::NodeState (NodeObject& node)
+    : ports (node.ports),
+      latencySamples (node.getLatencySamples()),
+      enabled (node.isEnabled()),
+      bypassed (node.isSuspended()),
+      sampleRate (node.getSampleRate()),
+      blockSize (node.getBlockSize()),
+      oversamplingFactor (node.getOversamplingFactor())
+{
+    if (auto* const processor = node.getAudioProcessor())
+        tailSeconds = processor->getTailLengthSeconds();
+}
+
+uint32 NodeState::getNthPort (const PortType type, const int channel, const bool isInput) const
+{
+    int count = -1;
+    for (const auto* const port : ports)
+        if (port->type == type.id() && port->input == isInput && ++count == channel)
+            return (uint32) port->index;
+
+    jassertfalse;
+    return EL_INVALID_PORT;
+}
+
+//==============================================================================
+GraphBuilder::GraphBuilder (const OwnedArray<Arc>& connections_,
+                            const Array<void*>& orderedNodes_,
+                            const Array<const NodeState*>& orderedStates_,
+                            Array<void*>& renderingOps,
+                            Array<GraphTask>& renderingTasks)
+    : GraphBuilder (connections_, orderedNodes_, orderedStates_)
+{
+    while (currentStep < orderedNodes.size())
+    {
+        const int firstOp = renderingOps.size();
+        addNextNode (renderingOps);
+
+        if (renderingOps.size() > firstOp)
+        {
+            GraphTask task;
+            task.firstOp = firstOp;
+            task.numOps = renderingOps.size() - firstOp;
+            renderingTasks.add (task);
+        }
+    }
+}
+
+GraphBuilder::GraphBuilder (const OwnedArray<Arc>& connections_,
+                            const Array<void*>& orderedNodes_,
+                            const Array<const NodeState*>& orderedStates_)
+    : GraphBuilder (connections_, orderedNodes_, orderedStates_, getNodeIds (orderedNodes_))
+{
+}
 
-GraphBuilder::GraphBuilder (GraphNode& graph_,
+GraphBuilder::GraphBuilder (const OwnedArray<Arc>& connections_,
                             const Array<void*>& orderedNodes_,
-                            Array<void*>& renderingOps)
-    : graph (graph_),
+                            const Array<const NodeState*>& orderedStates_,
+                            const Array<uint32>& orderedIds)
+    : connections (connections_),
       orderedNodes (orderedNodes_),
+      orderedStates (orderedStates_),
+      nodeIds (orderedIds),
       totalLatency (0)
 {
+    jassert (nodeIds.size() == orderedNodes.size() && orderedStates.size() == orderedNodes.size());
+    nodeInputs.resize (orderedNodes.size());
+    nodeOutputs.resize (orderedNodes.size());
+    for (int i = 0; i < orderedNodes.size(); ++i)
+        renderingIndexes.set (nodeIds.getUnchecked (i), i);
+
+    for (int i = connections.size(); --i >= 0;)
+    {
+        const auto* const c = connections.getUnchecked (i);
+        if (! renderingIndexes.contains (c->sourceNode) || ! renderingIndexes.contains (c->destNode))
+            continue;
+        nodeOutputs.getReference (renderingIndexes[c->sourceNode]).add (c);
+        nodeInputs.getReference (renderingIndexes[c->destNode]).add (c);
+    }
+
     for (int i = 0; i < PortType::Unknown; ++i)
     {
         allNodes[i].add ((uint32) zeroNodeID); // first buffer is read-only zeros
         allPorts[i].add (EL_INVALID_PORT);
+        freedAt[i].add (-1);
+        bufferDelays[i].add (0);
     }
+}
 
-    for (int i = 0; i < orderedNodes.size(); ++i)
+void GraphBuilder::addNextNode (Array<void*>& renderingOps)
+{
+    jassert (currentStep < orderedNodes.size());
+    auto* const node = (NodeObject*) orderedNodes.getUnchecked (currentStep);
+    const auto& state = *orderedStates.getUnchecked (currentStep);
+    const uint32 nodeId = nodeIds.getUnchecked (currentStep);
+
+    if (! state.enabled && ! node->isA<IONode>())
+        setNodeDelay (nodeId, 0); // no ops, the nodes it feeds read silence
+    else if (lookAhead != nullptr && ! writesLookAhead && lookAhead->rendersAhead (nodeId))
+        createLookAheadReads (nodeId, renderingOps);
+    else if (freezingNodes != nullptr && freezingNodes->contains (nodeId))
+        createFrozenOps (node, state, nodeId, nullptr, renderingOps);
+    else if (auto* const audio = findFrozenAudio (nodeId))
+        createFrozenOps (node, state, nodeId, audio, renderingOps);
+    else
+        createRenderingOpsForNode (node, state, renderingOps, currentStep);
+
+    if (lookAhead != nullptr && writesLookAhead)
+        createLookAheadWrites (nodeId, renderingOps);
+
+    markUnusedBuffersFree (currentStep);
+    ++currentStep;
+}
+
+void GraphBuilder::saveCheckpoint (Checkpoint& checkpoint) const
+{
+    checkpoint.step = currentStep;
+    checkpoint.totalLatency = totalLatency;
+    for (int i = 0; i < PortType::Unknown; ++i)
     {
-        createRenderingOpsForNode ((NodeObject*) orderedNodes.getUnchecked (i),
-                                   renderingOps,
-                                   i);
-        markUnusedBuffersFree (i);
+        checkpoint.nodes[i] = allNodes[i];
+        checkpoint.ports[i] = allPorts[i];
+        checkpoint.freedAt[i] = freedAt[i];
+        checkpoint.bufferDelays[i] = bufferDelays[i];
     }
 }
 
-int GraphBuilder::buffersNeeded (PortType type) { return allNodes[type.id()].size(); }
-int GraphBuilder::getNodeDelay (const uint32 nodeID) const { return nodeDelays[nodeDelayIDs.indexOf (nodeID)]; }
-
-void GraphBuilder::setNodeDelay (const uint32 nodeID, const int latency)
+void GraphBuilder::restoreCheckpoint (const Checkpoint& checkpoint, const Array<int>& delays)
 {
-    const int index = nodeDelayIDs.indexOf (nodeID);
-
-    if (index >= 0)
+    jassert (checkpoint.step <= orderedNodes.size() && delays.size() >= checkpoint.step);
+    currentStep = checkpoint.step;
+    totalLatency = checkpoint.totalLatency;
+    for (int i = 0; i < PortType::Unknown; ++i)
     {
-        nodeDelays.set (index, latency);
+        allNodes[i] = checkpoint.nodes[i];
+        allPorts[i] = checkpoint.ports[i];
+        freedAt[i] = checkpoint.freedAt[i];
+        bufferDelays[i] = checkpoint.bufferDelays[i];
     }
-    else
+
+    nodeDelays.clear();
+    for (int i = 0; i < currentStep; ++i)
+        setNodeDelay (nodeIds.getUnchecked (i), delays.getUnchecked (i));
+}
+
+SortedSet<uint32> GraphBuilder::findLiveNodes (const OwnedArray<Arc>& connections, const Array<void*>& nodes)
+{
+    return findLiveNodes (connections, nodes, getNodeIds (nodes));
+}
+
+SortedSet<uint32> GraphBuilder::findLiveNodes (const OwnedArray<Arc>& connections, const Array<void*>& nodes, const Array<uint32>& nodeIds)
+{
+    SortedSet<uint32> live;
+    for (int i = 0; i < nodes.size(); ++i)
+        if (static_cast<NodeObject*> (nodes.getUnchecked (i))->rendersLive())
+            live.add (nodeIds.getUnchecked (i));
+
+    // feedback loops can feed a node seen earlier, go again until nothing changes
+    for (bool changed = ! live.isEmpty(); changed;)
     {
-        nodeDelayIDs.add (nodeID);
-        nodeDelays.add (latency);
+        changed = false;
+        for (const auto* const c : connections)
+        {
+            if (live.contains (c->sourceNode) && ! live.contains (c->destNode))
+            {
+                live.add (c->destNode);
+                changed = true;
+            }
+        }
     }
+
+    return live;
+}
+
+Array<uint32> GraphBuilder::getNodeIds (const Array<void*>& nodes)
+{
+    Array<uint32> ids;
+    ids.ensureStorageAllocated (nodes.size());
+    for (auto* const node : nodes)
+        ids.add (static_cast<NodeObject*> (node)->nodeId);
+    return ids;
+}
+
+int GraphBuilder::buffersNeeded (PortType type) { return allNodes[type.id()].size(); }
+int GraphBuilder::getNodeDelay (const uint32 nodeID) const { return nodeDelays[nodeID]; }
+
+void GraphBuilder::setNodeDelay (const uint32 nodeID, const int latency)
+{
+    nodeDelays.set (nodeID, latency);
 }
 
 int GraphBuilder::getInputLatency (const uint32 nodeID) const
 {
     int maxLatency = 0;
 
-    for (int i = graph.getNumConnections(); --i >= 0;)
-    {
-        const auto* const c = graph.getConnection (i);
-        if (c->destNode == nodeID)
-            maxLatency = jmax (maxLatency, getNodeDelay (c->sourceNode));
-    }
+    if (! renderingIndexes.contains (nodeID))
+        return maxLatency;
+
+    for (const auto* const c : nodeInputs.getReference (renderingIndexes[nodeID]))
+        maxLatency = jmax (maxLatency, getNodeDelay (c->sourceNode));
 
     return maxLatency;
 }
 
 void GraphBuilder::createRenderingOpsForNode (NodeObject* const node,
+                                              const NodeState& state,
                                               Array<void*>& renderingOps,
                                               const int ourRenderingIndex)
 {
     AudioProcessor* const proc (node->getAudioProcessor());
+    const uint32 nodeId = nodeIds.getUnchecked (ourRenderingIndex);
 
     // don't add IONodes that cannot process
     if (IONode* ioproc = dynamic_cast<IONode*> (proc))
     {
-        const uint32 numOuts = node->getNumPorts (PortType::Audio, false);
+        const uint32 numOuts = state.getNumPorts (PortType::Audio, false);
         if (IONode::audioInputNode == ioproc->getType() && numOuts <= 0)
             return;
-        const uint32 numIns = node->getNumPorts (PortType::Audio, true);
+        const uint32 numIns = state.getNumPorts (PortType::Audio, true);
         if (IONode::audioOutputNode == ioproc->getType() && numIns <= 0)
             return;
     }
 
     Array<int> channelsToUse[PortType::Unknown];
-    int maxLatency = getInputLatency (node->nodeId);
+    int maxLatency = getInputLatency (nodeId);
+    const int blockSize = jmax (1, state.blockSize);
 
-    const uint32 numPorts (node->getNumPorts());
+    const uint32 numPorts (state.getNumPorts());
     for (uint32 port = 0; port < numPorts; ++port)
     {
-        const PortType portType (node->getPortType (port));
+        const PortType portType (state.getPortType (port));
         if (portType != PortType::Audio && portType != PortType::Midi)
             continue;
 
-        const uint32 numIns = node->getNumPorts (portType, true);
-        const uint32 numOuts = node->getNumPorts (portType, false);
+        const uint32 numIns = state.getNumPorts (portType, true);
+        const uint32 numOuts = state.getNumPorts (portType, false);
 
         // Outputs only need a buffer if the channel index is greater
         // than or equal to the total inputs of the same port type
-        if (node->isPortOutput (port))
+        if (state.isPortOutput (port))
         {
-            const int outputChan = node->getChannelPort (port);
+            const int outputChan = state.getChannelPort (port);
             if (outputChan >= (int) numIns && outputChan < (int) numOuts)
             {
                 const int bufIndex = getFreeBuffer (portType);
                 channelsToUse[portType.id()].add (bufIndex);
-                const uint32 outPort = node->getNthPort (portType, outputChan, false, false);
+                const uint32 outPort = state.getNthPort (portType, outputChan, false);
 
                 jassert (bufIndex != 0);
                 jassert (outPort == port);
-                jassert (outPort < node->getNumPorts());
+                jassert (outPort < state.getNumPorts());
 
-                markBufferAsContaining (bufIndex, portType, node->nodeId, outPort);
+                markBufferAsContaining (bufIndex, portType, nodeId, outPort);
             }
             continue;
         }
 
-        jassert (node->isPortInput (port));
+        jassert (state.isPortInput (port));
 
-        const int inputChan = node->getChannelPort (port);
+        const int inputChan = state.getChannelPort (port);
 
         // get a list of all the inputs to this node
         Array<uint32> sourceNodes;
         Array<uint32> sourcePorts;
-        for (int i = graph.getNumConnections(); --i >= 0;)
+        for (const auto* const c : nodeInputs.getReference (ourRenderingIndex))
         {
-            const auto* const c = graph.getConnection (i);
-            if (c->destNode == node->nodeId && c->destPort == port)
+            if (c->destPort == port)
             {
                 sourceNodes.add (c->sourceNode);
                 sourcePorts.add (c->sourcePort);
@@ -598,6 +1627,17 @@ void GraphBuilder::createRenderingOpsForNode (NodeObject* const node,
             }
 
             const bool bufNeededLater = isBufferNeededLater (ourRenderingIndex, port, srcNode, srcPort);
+            const int nodeDelay = getNodeDelay (srcNode);
+
+            if (portType == PortType::Audio && nodeDelay < maxLatency && bufIndex != getReadOnlyEmptyBuffer())
+            {
+                // delay in place unless other nodes read the output later on
+                if (bufNeededLater)
+                    bufIndex = getDelayedBuffer (renderingOps, bufIndex, srcNode, srcPort, maxLatency - nodeDelay, blockSize);
+                else
+                    renderingOps.add (new DelayChannelOp (bufIndex, bufIndex, maxLatency - nodeDelay, blockSize));
+            }
+
             if (bufNeededLater && (inputChan < (int) numOuts || portType == PortType::Midi))
             {
                 // can't mess up this channel because it's needed later by another node, so we
@@ -618,11 +1658,6 @@ void GraphBuilder::createRenderingOpsForNode (NodeObject* const node,
 
                 bufIndex = newFreeBuffer;
             }
-
-            const int nodeDelay = getNodeDelay (srcNode);
-
-            if (nodeDelay < maxLatency)
-                renderingOps.add (new DelayChannelOp (bufIndex, maxLatency - nodeDelay));
         }
         else
         {
@@ -648,7 +1683,7 @@ void GraphBuilder::createRenderingOpsForNode (NodeObject* const node,
                     {
                         const int nodeDelay = getNodeDelay (sourceNodes.getUnchecked (i));
                         if (nodeDelay < maxLatency)
-                            renderingOps.add (new DelayChannelOp (sourceBufIndex, maxLatency - nodeDelay));
+                            renderingOps.add (new DelayChannelOp (sourceBufIndex, sourceBufIndex, maxLatency - nodeDelay, blockSize));
                     }
 
                     break;
@@ -663,7 +1698,11 @@ void GraphBuilder::createRenderingOpsForNode (NodeObject* const node,
 
                 markBufferAsContaining (bufIndex, portType, anonymousNodeID, 0);
 
-                const int srcIndex = getBufferContaining (portType, sourceNodes.getUnchecked (0), sourcePorts.getUnchecked (0));
+                int srcIndex = getBufferContaining (portType, sourceNodes.getUnchecked (0), sourcePorts.getUnchecked (0));
+                const int firstDelay = portType == PortType::Audio ? maxLatency - getNodeDelay (sourceNodes.getFirst()) : 0;
+                if (srcIndex >= 0 && firstDelay > 0)
+                    srcIndex = getDelayedBuffer (renderingOps, srcIndex, sourceNodes.getFirst(), sourcePorts.getFirst(), firstDelay, blockSize);
+
                 if (srcIndex < 0)
                 {
                     // if not found, this is probably a feedback loop
@@ -681,13 +1720,6 @@ void GraphBuilder::createRenderingOpsForNode (NodeObject* const node,
                 }
 
                 reusableInputIndex = 0;
-
-                if (portType == PortType::Audio)
-                {
-                    const int nodeDelay = getNodeDelay (sourceNodes.getFirst());
-                    if (nodeDelay < maxLatency)
-                        renderingOps.add (new DelayChannelOp (bufIndex, maxLatency - nodeDelay));
-                }
             }
 
             for (int j = 0; j < sourceNodes.size(); ++j)
@@ -705,14 +1737,11 @@ void GraphBuilder::createRenderingOpsForNode (NodeObject* const node,
                             {
                                 if (! isBufferNeededLater (ourRenderingIndex, port, sourceNodes.getUnchecked (j), sourcePorts.getUnchecked (j)))
                                 {
-                                    renderingOps.add (new DelayChannelOp (srcIndex, maxLatency - nodeDelay));
+                                    renderingOps.add (new DelayChannelOp (srcIndex, srcIndex, maxLatency - nodeDelay, blockSize));
                                 }
-                                else // buffer is reused elsewhere, can't be delayed
+                                else // buffer is reused elsewhere, read a shared delayed copy
                                 {
-                                    const int bufferToDelay = getFreeBuffer (PortType::Audio);
-                                    renderingOps.add (new CopyChannelOp (srcIndex, bufferToDelay));
-                                    renderingOps.add (new DelayChannelOp (bufferToDelay, maxLatency - nodeDelay));
-                                    srcIndex = bufferToDelay;
+                                    srcIndex = getDelayedBuffer (renderingOps, srcIndex, sourceNodes.getUnchecked (j), sourcePorts.getUnchecked (j), maxLatency - nodeDelay, blockSize);
                                 }
                             }
 
@@ -732,19 +1761,98 @@ void GraphBuilder::createRenderingOpsForNode (NodeObject* const node,
 
         if (inputChan < (int) numOuts)
         {
-            const int outputPort = node->getNthPort (portType, inputChan, false, false);
-            markBufferAsContaining (bufIndex, portType, node->nodeId, outputPort);
+            const int outputPort = state.getNthPort (portType, inputChan, false);
+            markBufferAsContaining (bufIndex, portType, nodeId, outputPort);
         }
     } /* foreach port */
 
-    setNodeDelay (node->nodeId, maxLatency + node->getLatencySamples());
+    if (state.bypassed && ! node->isA<IONode>())
+    {
+        // the inputs are already in place as the outputs
+        setNodeDelay (nodeId, maxLatency);
+        renderingOps.add (new BypassOp (node, state, channelsToUse[PortType::Audio], channelsToUse[PortType::Midi]));
+        return;
+    }
+
+    setNodeDelay (nodeId, maxLatency + state.latencySamples);
 
-    if (node->isAudioIONode() && node->getNumPorts (PortType::Audio, false) == 0)
+    if (node->isAudioIONode() && state.getNumPorts (PortType::Audio, false) == 0)
         totalLatency = maxLatency;
 
-    int totalChans = jmax (node->getNumPorts (PortType::Audio, true),
-                           node->getNumPorts (PortType::Audio, false));
-    renderingOps.add (new ProcessBufferOp (node, channelsToUse[PortType::Audio], totalChans, 0, channelsToUse));
+    int totalChans = jmax (state.getNumPorts (PortType::Audio, true),
+                           state.getNumPorts (PortType::Audio, false));
+    renderingOps.add (new ProcessBufferOp (node, state, channelsToUse[PortType::Audio], totalChans, 0, channelsToUse));
+}
+
+void GraphBuilder::createLookAheadWrites (const uint32 nodeID, Array<void*>& renderingOps)
+{
+    for (auto& port : lookAhead->getPorts())
+    {
+        if (port.node != nodeID)
+            continue;
+
+        // live nodes compensate for the latency the output was rendered with
+        port.delay = getNodeDelay (nodeID);
+
+        const int bufIndex = getBufferContaining (port.type, port.node, port.port);
+        if (bufIndex >= 0)
+            renderingOps.add (new WriteAheadOp (*lookAhead, port, bufIndex));
+    }
+}
+
+void GraphBuilder::createLookAheadReads (const uint32 nodeID, Array<void*>& renderingOps)
+{
+    for (const auto& port : lookAhead->getPorts())
+    {
+        if (port.node != nodeID)
+            continue;
+
+        const int bufIndex = getFreeBuffer (port.type);
+        renderingOps.add (new ReadAheadOp (*lookAhead, port, bufIndex));
+        markBufferAsContaining (bufIndex, port.type, port.node, port.port);
+        setNodeDelay (nodeID, port.delay);
+    }
+}
+
+FrozenAudio* GraphBuilder::findFrozenAudio (const uint32 nodeID) const noexcept
+{
+    if (frozenAudio != nullptr)
+        for (auto* const audio : *frozenAudio)
+            if (audio->getNodeId() == nodeID)
+                return audio;
+    return nullptr;
+}
+
+void GraphBuilder::createFrozenOps (NodeObject* const node, const NodeState& state, const uint32 nodeID, FrozenAudio* audio, Array<void*>& renderingOps)
+{
+    auto* const graph = node->getParentGraph();
+    if (graph == nullptr)
+        return;
+
+    // audio rendered at another rate would play at the wrong speed
+    if (audio != nullptr && audio->getSampleRate() != frozenSampleRate)
+        audio = nullptr;
+
+    Array<int> channels;
+    for (int ch = 0; ch < state.getNumPorts (PortType::Audio, false); ++ch)
+    {
+        const int bufIndex = getFreeBuffer (PortType::Audio);
+        channels.add (bufIndex);
+        markBufferAsContaining (bufIndex, PortType::Audio, nodeID, state.getNthPort (PortType::Audio, ch, false));
+    }
+
+    for (int ch = 0; ch < state.getNumPorts (PortType::Midi, false); ++ch)
+    {
+        const int bufIndex = getFreeBuffer (PortType::Midi);
+        renderingOps.add (new ClearMidiBufferOp (bufIndex));
+        markBufferAsContaining (bufIndex, PortType::Midi, nodeID, state.getNthPort (PortType::Midi, ch, false));
+    }
+
+    if (! channels.isEmpty())
+        renderingOps.add (new PlayFrozenOp (audio, graph->getPlayHeadForNodes(), channels, frozenBlockSize));
+
+    // the audio lines up with the transport, it has no latency
+    setNodeDelay (nodeID, 0);
 }
 
 int GraphBuilder::getFreeBuffer (PortType type)
@@ -752,12 +1860,29 @@ int GraphBuilder::getFreeBuffer (PortType type)
     jassert (type.id() < PortType::Unknown);
 
     Array<uint32>& nodes = allNodes[type.id()];
+    Array<uint32>& ports = allPorts[type.id()];
+    Array<int>& freed = freedAt[type.id()];
+
+    // the most recently freed buffer is the most likely to still be in cache
+    int bufIndex = -1;
     for (int i = 1; i < nodes.size(); ++i)
-        if (nodes.getUnchecked (i) == freeNodeID)
-            return i;
+        if (nodes.getUnchecked (i) == freeNodeID && (bufIndex < 0 || freed.getUnchecked (i) > freed.getUnchecked (bufIndex)))
+            bufIndex = i;
+
+    if (bufIndex < 0)
+    {
+        nodes.add ((uint32) freeNodeID);
+        ports.add (EL_INVALID_PORT);
+        freed.add (-1);
+        bufferDelays[type.id()].add (0);
+        bufIndex = nodes.size() - 1;
+    }
 
-    nodes.add ((uint32) freeNodeID);
-    return nodes.size() - 1;
+    // busy until it's marked as holding an output, or the step is done
+    nodes.set (bufIndex, (uint32) anonymousNodeID);
+    ports.set (bufIndex, EL_INVALID_PORT);
+    bufferDelays[type.id()].set (bufIndex, 0);
+    return bufIndex;
 }
 
 int GraphBuilder::getReadOnlyEmptyBuffer() const noexcept
@@ -769,15 +1894,36 @@ int GraphBuilder::getBufferContaining (const PortType type, const uint32 nodeId,
 {
     Array<uint32>& nodes = allNodes[type.id()];
     Array<uint32>& ports = allPorts[type.id()];
+    const Array<int>& delays = bufferDelays[type.id()];
 
     for (int i = nodes.size(); --i >= 0;)
         if (nodes.getUnchecked (i) == nodeId
-            && ports.getUnchecked (i) == outputPort)
+            && ports.getUnchecked (i) == outputPort
+            && delays.getUnchecked (i) == 0)
             return i;
 
     return -1;
 }
 
+int GraphBuilder::getDelayedBuffer (Array<void*>& renderingOps, const int srcBuffer, const uint32 nodeId, const uint32 outputPort, const int delay, const int blockSize)
+{
+    const Array<uint32>& nodes = allNodes[PortType::Audio];
+    const Array<uint32>& ports = allPorts[PortType::Audio];
+    const Array<int>& delays = bufferDelays[PortType::Audio];
+
+    for (int i = nodes.size(); --i >= 0;)
+        if (nodes.getUnchecked (i) == nodeId
+            && ports.getUnchecked (i) == outputPort
+            && delays.getUnchecked (i) == delay)
+            return i;
+
+    // lives as long as the output does, so later readers can share it
+    const int bufIndex = getFreeBuffer (PortType::Audio);
+    renderingOps.add (new DelayChannelOp (srcBuffer, bufIndex, delay, blockSize));
+    markBufferAsContaining (bufIndex, PortType::Audio, nodeId, outputPort, delay);
+    return bufIndex;
+}
+
 void GraphBuilder::markUnusedBuffersFree (const int stepIndex)
 {
     for (uint32 type = 0; type < PortType::Unknown; ++type)
@@ -787,10 +1933,12 @@ void GraphBuilder::markUnusedBuffersFree (const int stepIndex)
 
         for (int i = 0; i < nodes.size(); ++i)
         {
+            // live until the last node reading it, which may be this one
             if (isNodeBusy (nodes.getUnchecked (i))
-                && ! isBufferNeededLater (stepIndex, EL_INVALID_PORT, nodes.getUnchecked (i), ports.getUnchecked (i)))
+                && ! isBufferNeededLater (stepIndex + 1, EL_INVALID_PORT, nodes.getUnchecked (i), ports.getUnchecked (i)))
             {
                 nodes.set (i, (uint32) freeNodeID);
+                freedAt[type].set (i, stepIndex);
             }
         }
     }
@@ -798,28 +1946,26 @@ void GraphBuilder::markUnusedBuffersFree (const int stepIndex)
 
 bool GraphBuilder::isBufferNeededLater (int stepIndexToSearchFrom, uint32 inputChannelOfIndexToIgnore, const uint32 sourceNode, const uint32 outputPortIndex) const
 {
-    while (stepIndexToSearchFrom < orderedNodes.size())
+    if (! renderingIndexes.contains (sourceNode))
+        return false;
+
+    for (const auto* const c : nodeOutputs.getReference (renderingIndexes[sourceNode]))
     {
-        const NodeObject* const node = (const NodeObject*) orderedNodes.getUnchecked (stepIndexToSearchFrom);
+        if (c->sourcePort != outputPortIndex)
+            continue;
 
+        const int destIndex = renderingIndexes[c->destNode];
+        if (destIndex > stepIndexToSearchFrom
+            || (destIndex == stepIndexToSearchFrom && c->destPort != inputChannelOfIndexToIgnore))
         {
-            for (uint32 port = 0; port < node->getNumPorts(); ++port)
-            {
-                if (port != inputChannelOfIndexToIgnore && graph.getConnectionBetween (sourceNode, outputPortIndex, node->nodeId, port) != nullptr)
-                {
-                    return true;
-                }
-            }
+            return true;
         }
-
-        inputChannelOfIndexToIgnore = EL_INVALID_PORT;
-        ++stepIndexToSearchFrom;
     }
 
     return false;
 }
 
-void GraphBuilder::markBufferAsContaining (int bufferNum, PortType type, uint32 nodeId, uint32 portIndex)
+void GraphBuilder::markBufferAsContaining (int bufferNum, PortType type, uint32 nodeId, uint32 portIndex, int delay)
 {
     Array<uint32>& nodes = allNodes[type.id()];
     Array<uint32>& ports = allPorts[type.id()];
@@ -827,6 +1973,7 @@ void GraphBuilder::markBufferAsContaining (int bufferNum, PortType type, uint32
     jassert (bufferNum >= 0 && bufferNum < nodes.size());
     nodes.set (bufferNum, nodeId);
     ports.set (bufferNum, portIndex);
+    bufferDelays[type.id()].set (bufferNum, delay);
 }
 
 } // namespace element
@@ -2,43 +2,338 @@
 #pragma once
 
 #include "ElementApp.h"
+#include "arc.hpp"
 
 namespace element {
 
-class GraphNode;
 class NodeObject;
 
-class GraphOp
+/** Lists the shared buffers touched by one or more GraphOps */
+struct GraphOpAccess
+{
+    Array<int> audioReads, audioWrites;
+    Array<int> midiReads, midiWrites;
+
+    /** True if the parent graph's IO buffers are used */
+    bool usesGraphIO = false;
+};
+
+class FrozenAudio;
+class GraphOp;
+class LookAhead;
+
+/** A single instruction of a RenderProgram.  Buffer operations are run in
+    place by the program, anything else calls a GraphOp.
+ */
+struct RenderOp
+{
+    enum Type : int32
+    {
+        clearChannel = 0, ///< clear dst
+        copyChannel, ///< copy src to dst
+        addChannel, ///< add src to dst
+        sumChannels, ///< write src + src2 to dst
+        clearMidi, ///< clear MIDI dst
+        copyMidi, ///< copy MIDI src to dst
+        addMidi, ///< merge MIDI src in to dst, built in merge buffer src2
+        performOp ///< call op
+    };
+
+    Type type = performOp;
+    int32 src = 0, src2 = 0, dst = 0;
+    GraphOp* op = nullptr;
+};
+
+/** Ops are reference counted so a program built after a small edit can
+    share the unchanged ones with the program before it.
+ */
+class GraphOp : public ReferenceCountedObject
 {
 public:
     GraphOp() {}
     virtual ~GraphOp() {}
 
+    /** Returns the instruction used to run this op in a RenderProgram.  Ops
+        which only move buffers around return an equivalent instruction and
+        are deleted once the program is assembled.
+     */
+    virtual RenderOp getRenderOp()
+    {
+        RenderOp r;
+        r.op = this;
+        return r;
+    }
+
+    /** Runs the op.  silentChannels has a flag for each shared audio buffer
+        which is set when the buffer is known to hold nothing but silence, ops
+        must keep the flags of the buffers they write up to date.
+     */
     virtual void perform (AudioSampleBuffer& sharedBufferChans,
                           const OwnedArray<MidiBuffer>& sharedMidiBuffers,
+                          bool* silentChannels,
+                          const int numSamples) = 0;
+
+    /** Runs the op in a double precision program */
+    virtual void perform (AudioBuffer<double>& sharedBufferChans,
+                          const OwnedArray<MidiBuffer>& sharedMidiBuffers,
+                          bool* silentChannels,
                           const int numSamples) = 0;
 
+    /** Adds the shared buffers this op reads and writes.  This is used to
+        find ops which can be performed concurrently. */
+    virtual void getBufferAccess (GraphOpAccess& access) const = 0;
+
+    /** Returns the node this op calls to render, or nullptr if it doesn't
+        call one */
+    virtual NodeObject* getRenderedNode() const { return nullptr; }
+
     JUCE_LEAK_DETECTOR (GraphOp);
 };
 
+/** A run of rendering ops belonging to a single node.
+
+    A task only depends on tasks which come before it in the sequence, so
+    performing the ops in their flat order is always a valid schedule.
+ */
+struct GraphTask
+{
+    /** Index of the first op of this task */
+    int firstOp = 0;
+
+    /** Number of ops in this task */
+    int numOps = 0;
+
+    /** Number of tasks which must finish before this one can start */
+    int numDependencies = 0;
+
+    /** Tasks waiting on this one */
+    Array<int> dependents;
+};
+
+/** A compiled graph: everything needed to render it.  Programs are built
+    off the audio thread and never changed once handed to it, the buffers
+    are scratch space for the ops.
+ */
+struct RenderProgram
+{
+    RenderProgram() = default;
+    ~RenderProgram();
+
+    /** Turns the ops of a GraphBuilder in to instructions, fusing adjacent
+        buffer operations, and takes ownership of the ops.  The instructions
+        and tasks are appended, task ranges are changed to index the
+        instructions.
+     */
+    void assemble (const Array<void*>& builderOps, const Array<GraphTask>& builderTasks);
+
+    /** Works out which tasks depend on each other from the buffers their
+        instructions use.  Call this once all tasks are assembled.
+     */
+    void linkTasks (int numAudioBuffers, int numMidiBuffers);
+
+    /** Sizes and clears the shared buffers */
+    void allocateBuffers (int numAudioBuffers, int numMidiBuffers, int numSamples);
+
+    /** Call before performing the instructions of a block.  Silence flags
+        only cover as many samples as the last block, they're dropped when
+        the block grows. */
+    void beginBlock (int numSamples) noexcept;
+
+    /** Runs a range of instructions */
+    void perform (int firstOp, int numOps, int numSamples) noexcept;
+
+    /** Returns the most samples a block can have */
+    int getBlockSize() const noexcept { return doublePrecision ? doubleBuffers.getNumSamples() : buffers.getNumSamples(); }
+
+    /** Instructions, in order */
+    Array<RenderOp> code;
+
+    /** Ops called by the instructions */
+    ReferenceCountedArray<GraphOp> ops;
+
+    /** Runs of instructions which can be scheduled on different threads */
+    Array<GraphTask> tasks;
+
+    /** True if the ops render in to doubleBuffers instead of buffers, set
+        before allocating */
+    bool doublePrecision = false;
+
+    /** Shared audio buffers used by the ops */
+    AudioSampleBuffer buffers;
+
+    /** Shared audio buffers of a double precision program */
+    AudioBuffer<double> doubleBuffers;
+
+    /** Shared MIDI buffers used by the ops */
+    OwnedArray<MidiBuffer> midiBuffers;
+
+    /** A buffer per addMidi instruction to merge in to, swapped with the
+        destination after each merge */
+    OwnedArray<MidiBuffer> midiScratch;
+
+    /** Bytes reserved for each MIDI buffer so rendering doesn't allocate */
+    static constexpr int midiBufferBytes = 2048;
+
+    /** Set for shared audio buffers known to be silent */
+    HeapBlock<bool> silentChannels;
+    int numSilentChannels = 0;
+    int silentBlockSize = 0;
+
+    /** Total latency of the graph */
+    int latencySamples = 0;
+
+    /** The serial of the snapshot this was built from */
+    uint32 serial = 0;
+
+    /** Renders the nodes which don't depend on live input ahead of the
+        device, or nullptr if everything renders live */
+    std::unique_ptr<LookAhead> lookAhead;
+
+    /** Links programs waiting to be deleted */
+    RenderProgram* nextRetired = nullptr;
+
+private:
+    template <typename SampleType>
+    void performCode (AudioBuffer<SampleType>& audio, int firstOp, int numOps, int numSamples) noexcept;
+
+    JUCE_DECLARE_NON_COPYABLE (RenderProgram)
+};
+
+/** What building a node's ops reads of it.  This is copied on the message
+    thread along with the rest of a GraphSnapshot, so the compiler never reads
+    a node while it's being changed.
+ */
+struct NodeState
+{
+    NodeState() = default;
+    explicit NodeState (NodeObject& node);
+
+    PortList ports;
+    int latencySamples = 0;
+    bool enabled = true;
+    bool bypassed = false;
+    double tailSeconds = 0.0;
+    double sampleRate = 0.0;
+    int blockSize = 0;
+    int oversamplingFactor = 1;
+
+    PortType getPortType (uint32 port) const { return PortType (ports.getType ((int) port)); }
+    uint32 getNumPorts() const { return (uint32) ports.size(); }
+    int getNumPorts (PortType type, bool isInput) const { return ports.size (type.id(), isInput); }
+    int getChannelPort (uint32 port) const { return ports.getChannelForPort ((int) port); }
+    bool isPortInput (uint32 port) const { return ports.isInput ((int) port, false); }
+    bool isPortOutput (uint32 port) const { return ports.isOutput ((int) port, true); }
+
+    /** Returns the port of a type's nth input or output */
+    uint32 getNthPort (PortType type, int channel, bool isInput) const;
+};
+
 /** Used to calculate the correct sequence of rendering ops needed, based on
     the best re-use of shared buffers at each stage. */
 class GraphBuilder
 {
 public:
-    GraphBuilder (GraphNode& graph_,
+    /** The state of a builder before a step, used to resume building part
+        way through after an edit which doesn't change the steps before it.
+     */
+    struct Checkpoint
+    {
+        int step = 0;
+        int totalLatency = 0;
+        Array<uint32> nodes[PortType::Unknown];
+        Array<uint32> ports[PortType::Unknown];
+        Array<int> freedAt[PortType::Unknown];
+        Array<int> bufferDelays[PortType::Unknown];
+    };
+
+    /** Builds the ops of every node, one task per node which has any.  The
+        nodes are built from their states, one for each node in the same order.
+     */
+    GraphBuilder (const OwnedArray<Arc>& connections_,
                   const Array<void*>& orderedNodes_,
-                  Array<void*>& renderingOps);
+                  const Array<const NodeState*>& orderedStates_,
+                  Array<void*>& renderingOps,
+                  Array<GraphTask>& renderingTasks);
+
+    /** Prepares to build one step at a time with addNextNode() */
+    GraphBuilder (const OwnedArray<Arc>& connections_,
+                  const Array<void*>& orderedNodes_,
+                  const Array<const NodeState*>& orderedStates_);
+
+    /** Prepares to build one step at a time, with the IDs the connections
+        know each node by when they aren't the nodes' own.
+     */
+    GraphBuilder (const OwnedArray<Arc>& connections_,
+                  const Array<void*>& orderedNodes_,
+                  const Array<const NodeState*>& orderedStates_,
+                  const Array<uint32>& orderedIds);
+
+    /** Adds the ops of the node at the current step and moves to the next */
+    void addNextNode (Array<void*>& renderingOps);
+
+    /** Returns the step addNextNode() will build */
+    int getCurrentStep() const noexcept { return currentStep; }
+
+    /** Saves the state before the current step */
+    void saveCheckpoint (Checkpoint& checkpoint) const;
+
+    /** Continues from a checkpoint.  The nodes and connections before the
+        checkpoint's step must be the same as when it was saved, delays are
+        the node delays of those steps in order.
+     */
+    void restoreCheckpoint (const Checkpoint& checkpoint, const Array<int>& delays);
+
+    /** Builds the ops which move outputs through a LookAhead.  A builder
+        writing it copies the outputs live nodes read in to the block being
+        rendered ahead.  A builder reading it replaces the nodes rendered
+        ahead with reads of those outputs.  Call before adding nodes.
+     */
+    void setLookAhead (LookAhead* newLookAhead, bool writing) noexcept
+    {
+        lookAhead = newLookAhead;
+        writesLookAhead = writing;
+    }
+
+    /** Renders frozen nodes from their audio instead of running them, and
+        silences the nodes being frozen.  Audio frozen at a rate other than
+        the graph's is silent too.  Call before adding nodes.
+     */
+    void setFrozenNodes (const ReferenceCountedArray<FrozenAudio>& frozen, const SortedSet<uint32>& freezing,
+                         double sampleRate, int blockSize) noexcept
+    {
+        frozenAudio = &frozen;
+        freezingNodes = &freezing;
+        frozenSampleRate = sampleRate;
+        frozenBlockSize = blockSize;
+    }
+
+    /** Returns the IDs of the nodes which depend on live input: the ones
+        which render live themselves and every node they feed.
+     */
+    static SortedSet<uint32> findLiveNodes (const OwnedArray<Arc>& connections, const Array<void*>& nodes);
+    static SortedSet<uint32> findLiveNodes (const OwnedArray<Arc>& connections, const Array<void*>& nodes, const Array<uint32>& nodeIds);
+
+    /** Returns the IDs of nodes */
+    static Array<uint32> getNodeIds (const Array<void*>& nodes);
 
     int buffersNeeded (PortType type);
     int getTotalLatencySamples() const { return totalLatency; }
+    int getNodeDelay (const uint32 nodeID) const;
 
 private:
     //==============================================================================
-    GraphNode& graph;
+    const OwnedArray<Arc>& connections;
     const Array<void*>& orderedNodes;
+    const Array<const NodeState*>& orderedStates;
+    // the ID of each node in the connections, by rendering order
+    const Array<uint32> nodeIds;
     Array<uint32> allNodes[PortType::Unknown];
     Array<uint32> allPorts[PortType::Unknown];
+    // step each buffer was last freed at, used to prefer recently used buffers
+    Array<int> freedAt[PortType::Unknown];
+    // samples each buffer's output is delayed by, delayed copies are shared
+    Array<int> bufferDelays[PortType::Unknown];
+    int currentStep = 0;
 
     enum
     {
@@ -49,23 +344,39 @@ private:
 
     static bool isNodeBusy (uint32 nodeID) noexcept { return nodeID != freeNodeID && nodeID != zeroNodeID; }
 
-    Array<uint32> nodeDelayIDs;
-    Array<int> nodeDelays;
+    HashMap<uint32, int> nodeDelays;
     int totalLatency;
 
-    int getNodeDelay (const uint32 nodeID) const;
+    LookAhead* lookAhead = nullptr;
+    bool writesLookAhead = false;
+
+    const ReferenceCountedArray<FrozenAudio>* frozenAudio = nullptr;
+    const SortedSet<uint32>* freezingNodes = nullptr;
+    double frozenSampleRate = 0.0;
+    int frozenBlockSize = 0;
+
+    // connections of each node, indexed by rendering order
+    HashMap<uint32, int> renderingIndexes;
+    Array<Array<const Arc*>> nodeInputs;
+    Array<Array<const Arc*>> nodeOutputs;
+
     void setNodeDelay (const uint32 nodeID, const int latency);
 
     int getInputLatency (const uint32 nodeID) const;
 
-    void createRenderingOpsForNode (NodeObject* const node, Array<void*>& renderingOps, const int ourRenderingIndex);
+    void createRenderingOpsForNode (NodeObject* const node, const NodeState& state, Array<void*>& renderingOps, const int ourRenderingIndex);
+    void createLookAheadWrites (const uint32 nodeID, Array<void*>& renderingOps);
+    void createLookAheadReads (const uint32 nodeID, Array<void*>& renderingOps);
+    FrozenAudio* findFrozenAudio (const uint32 nodeID) const noexcept;
+    void createFrozenOps (NodeObject* const node, const NodeState& state, const uint32 nodeID, FrozenAudio* audio, Array<void*>& renderingOps);
 
     int getFreeBuffer (PortType type);
     int getReadOnlyEmptyBuffer() const noexcept;
     int getBufferContaining (const PortType type, const uint32 nodeId, const uint32 outputPort) noexcept;
+    int getDelayedBuffer (Array<void*>& renderingOps, int srcBuffer, uint32 nodeId, uint32 outputPort, int delay, int blockSize);
     void markUnusedBuffersFree (const int stepIndex);
     bool isBufferNeededLater (int stepIndexToSearchFrom, uint32 inputChannelOfIndexToIgnore, const uint32 sourceNode, const uint32 outputPortIndex) const;
-    void markBufferAsContaining (int bufferNum, PortType type, uint32 nodeId, uint32 portIndex);
+    void markBufferAsContaining (int bufferNum, PortType type, uint32 nodeId, uint32 portIndex, int delay = 0);
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (GraphBuilder)
 };
@@ -0,0 +1,660 @@
+/*
+    This file is part of Element
+    Copyright (C) 2021  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+
+#include "engine/graphcompiler.hpp"
+#include "engine/graphnode.hpp"
+#include "engine/ionode.hpp"
+#include "engine/lookahead.hpp"
+
+namespace element {
+
+GraphCompiler::GraphCompiler()
+    : Thread ("element: graph compiler")
+{
+    startThread (3);
+}
+
+GraphCompiler::~GraphCompiler()
+{
+    signalThreadShouldExit();
+    notify();
+    stopThread (5000);
+    jobs.clear();
+    reclaim();
+}
+
+//==============================================================================
+void CompileCache::clear()
+{
+    nodes.clear();
+    nodeIds.clearQuick();
+    signatures.clearQuick();
+    delays.clearQuick();
+    connections.clear();
+    stepTasks.clearQuick();
+    checkpoints.clear();
+    code.clearQuick();
+    tasks.clearQuick();
+    ops.clear();
+    blockSize = 0;
+    doublePrecision = false;
+}
+
+namespace {
+/** Changes to a node's ports, latency, enablement or bypass change the ops
+    built for it */
+int64 getNodeSignature (const NodeState& state)
+{
+    auto signature = ((int64) state.getNumPorts() << 32) | (int64) (uint32) state.latencySamples;
+    if (! state.enabled)
+        signature ^= (int64) 1 << 62;
+    if (state.bypassed)
+        signature ^= (int64) 1 << 61;
+    return signature;
+}
+
+/** Looks up the snapshot's state of each ordered node */
+Array<const NodeState*> getOrderedStates (const GraphSnapshot& snapshot, const Array<uint32>& orderedIds)
+{
+    HashMap<uint32, int> indexes;
+    for (int i = 0; i < snapshot.nodes.size(); ++i)
+        indexes.set (snapshot.getNodeId (i), i);
+
+    Array<const NodeState*> states;
+    states.ensureStorageAllocated (orderedIds.size());
+    for (const auto nodeId : orderedIds)
+        states.add (snapshot.states.getUnchecked (indexes[nodeId]));
+    return states;
+}
+
+/** Orders every node of a snapshot, along with the IDs they go by */
+void sortNodes (const GraphSnapshot& snapshot, Array<void*>& orderedNodes, Array<uint32>& orderedIds)
+{
+    Array<uint32> nodeIds;
+    nodeIds.ensureStorageAllocated (snapshot.nodes.size());
+    for (int i = 0; i < snapshot.nodes.size(); ++i)
+        nodeIds.add (snapshot.getNodeId (i));
+
+    orderedNodes.ensureStorageAllocated (nodeIds.size());
+    orderedIds.ensureStorageAllocated (nodeIds.size());
+    for (const auto index : sortTopologically (nodeIds, snapshot.connections))
+    {
+        orderedNodes.add (snapshot.nodes.getUnchecked (index));
+        orderedIds.add (nodeIds.getUnchecked (index));
+    }
+}
+
+/** Orders the nodes of a snapshot keeping as much of the last build's order
+    as possible.  Returns the first step which renders something different.
+ */
+int updateNodeOrder (const GraphSnapshot& snapshot, const CompileCache& cache, Array<void*>& orderedNodes, Array<uint32>& orderedIds)
+{
+    HashMap<uint32, NodeObject*> current;
+    for (int i = 0; i < snapshot.nodes.size(); ++i)
+        current.set (snapshot.getNodeId (i), snapshot.nodes.getUnchecked (i));
+
+    // nodes still in the graph keep their place, new ones go last
+    HashMap<uint32, int> positions;
+    orderedNodes.ensureStorageAllocated (snapshot.nodes.size());
+    orderedIds.ensureStorageAllocated (snapshot.nodes.size());
+    for (int i = 0; i < cache.nodes.size(); ++i)
+    {
+        const auto nodeId = cache.nodeIds.getUnchecked (i);
+        if (current[nodeId] == cache.nodes.getUnchecked (i))
+        {
+            positions.set (nodeId, orderedNodes.size());
+            orderedNodes.add (cache.nodes.getUnchecked (i));
+            orderedIds.add (nodeId);
+        }
+    }
+
+    for (int i = 0; i < snapshot.nodes.size(); ++i)
+    {
+        const auto nodeId = snapshot.getNodeId (i);
+        if (! positions.contains (nodeId))
+        {
+            positions.set (nodeId, orderedNodes.size());
+            orderedNodes.add (snapshot.nodes.getUnchecked (i));
+            orderedIds.add (nodeId);
+        }
+    }
+
+    // sort again from the first node rendered before one of its inputs
+    int firstUnsorted = orderedNodes.size();
+    for (const auto* const c : snapshot.connections)
+    {
+        if (c->sourceNode == c->destNode || ! positions.contains (c->sourceNode) || ! positions.contains (c->destNode))
+            continue;
+        const int destIndex = positions[c->destNode];
+        if (positions[c->sourceNode] > destIndex)
+            firstUnsorted = jmin (firstUnsorted, destIndex);
+    }
+
+    if (firstUnsorted < orderedNodes.size())
+    {
+        Array<uint32> nodeIds;
+        Array<void*> unsorted;
+        for (int i = firstUnsorted; i < orderedNodes.size(); ++i)
+        {
+            unsorted.add (orderedNodes.getUnchecked (i));
+            nodeIds.add (orderedIds.getUnchecked (i));
+        }
+
+        orderedNodes.removeRange (firstUnsorted, orderedNodes.size() - firstUnsorted);
+        orderedIds.removeRange (firstUnsorted, orderedIds.size() - firstUnsorted);
+        for (const auto index : sortTopologically (nodeIds, snapshot.connections))
+        {
+            positions.set (nodeIds.getUnchecked (index), orderedNodes.size());
+            orderedNodes.add (unsorted.getUnchecked (index));
+            orderedIds.add (nodeIds.getUnchecked (index));
+        }
+    }
+
+    const auto orderedStates = getOrderedStates (snapshot, orderedIds);
+    int firstStep = jmin (orderedNodes.size(), cache.nodes.size());
+    for (int i = 0; i < firstStep; ++i)
+    {
+        auto* const node = (NodeObject*) orderedNodes.getUnchecked (i);
+        if (node != cache.nodes.getUnchecked (i) || orderedIds.getUnchecked (i) != cache.nodeIds.getUnchecked (i)
+            || getNodeSignature (*orderedStates.getUnchecked (i)) != cache.signatures.getUnchecked (i))
+        {
+            firstStep = i;
+            break;
+        }
+    }
+
+    // a connection changes the steps from the first node it joins
+    const auto& last = cache.connections;
+    const auto& next = snapshot.connections;
+    int i = 0, j = 0;
+    while (i < last.size() || j < next.size())
+    {
+        const int order = i == last.size()   ? 1
+                          : j == next.size() ? -1
+                                             : ArcSorter::compareElements (last.getUnchecked (i), next.getUnchecked (j));
+        if (order == 0)
+        {
+            ++i;
+            ++j;
+            continue;
+        }
+
+        const auto* const c = order < 0 ? last.getUnchecked (i++) : next.getUnchecked (j++);
+        if (positions.contains (c->sourceNode))
+            firstStep = jmin (firstStep, positions[c->sourceNode]);
+        if (positions.contains (c->destNode))
+            firstStep = jmin (firstStep, positions[c->destNode]);
+    }
+
+    return firstStep;
+}
+
+/** Builds every step of a program in one go */
+std::unique_ptr<RenderProgram> buildProgram (GraphBuilder& builder, const Array<void*>& orderedNodes, const GraphSnapshot& snapshot)
+{
+    std::unique_ptr<RenderProgram> program (new RenderProgram());
+    builder.setFrozenNodes (snapshot.frozen, snapshot.freezing, snapshot.sampleRate, snapshot.blockSize);
+    Array<void*> ops;
+    Array<GraphTask> tasks;
+    while (builder.getCurrentStep() < orderedNodes.size())
+    {
+        const int firstOp = ops.size();
+        builder.addNextNode (ops);
+        if (ops.size() > firstOp)
+        {
+            GraphTask task;
+            task.firstOp = firstOp;
+            task.numOps = ops.size() - firstOp;
+            tasks.add (task);
+        }
+    }
+
+    program->assemble (ops, tasks);
+    program->linkTasks (builder.buffersNeeded (PortType::Audio),
+                        builder.buffersNeeded (PortType::Midi));
+    program->doublePrecision = snapshot.doublePrecision;
+    program->allocateBuffers (builder.buffersNeeded (PortType::Audio),
+                              builder.buffersNeeded (PortType::Midi),
+                              jmax (1, snapshot.blockSize));
+    program->latencySamples = builder.getTotalLatencySamples();
+    return program;
+}
+
+/** Builds a program which renders the nodes not depending on live input
+    ahead of the rest.  Returns nullptr if every node depends on it.
+ */
+std::unique_ptr<RenderProgram> buildWithLookAhead (const GraphSnapshot& snapshot)
+{
+    Array<void*> orderedNodes;
+    Array<uint32> orderedIds;
+    sortNodes (snapshot, orderedNodes, orderedIds);
+    const auto live = GraphBuilder::findLiveNodes (snapshot.connections, orderedNodes, orderedIds);
+
+    const auto orderedStates = getOrderedStates (snapshot, orderedIds);
+
+    std::unique_ptr<LookAhead> lookAhead (new LookAhead (snapshot.lookAheadBlocks));
+    HashMap<uint32, const NodeState*> aheadNodes;
+    Array<void*> aheadOrder;
+    Array<const NodeState*> aheadStates;
+    Array<uint32> aheadIds;
+    for (int i = 0; i < orderedNodes.size(); ++i)
+    {
+        const auto nodeId = orderedIds.getUnchecked (i);
+        if (live.contains (nodeId))
+            continue;
+        lookAhead->addNode (nodeId);
+        aheadNodes.set (nodeId, orderedStates.getUnchecked (i));
+        aheadOrder.add (orderedNodes.getUnchecked (i));
+        aheadStates.add (orderedStates.getUnchecked (i));
+        aheadIds.add (nodeId);
+    }
+
+    if (aheadOrder.isEmpty())
+        return nullptr;
+
+    // outputs read by live nodes are passed through the look-ahead
+    SortedSet<uint32> readNodes;
+    for (const auto* const c : snapshot.connections)
+    {
+        if (! aheadNodes.contains (c->sourceNode) || ! live.contains (c->destNode))
+            continue;
+
+        const PortType type (aheadNodes[c->sourceNode]->getPortType (c->sourcePort));
+        if (type == PortType::Audio || type == PortType::Midi)
+        {
+            lookAhead->addPort (c->sourceNode, c->sourcePort, type);
+            readNodes.add (c->sourceNode);
+        }
+    }
+
+    GraphBuilder aheadBuilder (snapshot.connections, aheadOrder, aheadStates, aheadIds);
+    aheadBuilder.setLookAhead (lookAhead.get(), true);
+    lookAhead->setProgram (buildProgram (aheadBuilder, aheadOrder, snapshot));
+
+    // nodes rendered ahead are read back where they'd have been rendered
+    Array<void*> liveOrder;
+    Array<const NodeState*> liveStates;
+    Array<uint32> liveIds;
+    for (int i = 0; i < orderedNodes.size(); ++i)
+    {
+        const auto nodeId = orderedIds.getUnchecked (i);
+        if (live.contains (nodeId) || readNodes.contains (nodeId))
+        {
+            liveOrder.add (orderedNodes.getUnchecked (i));
+            liveStates.add (orderedStates.getUnchecked (i));
+            liveIds.add (nodeId);
+        }
+    }
+
+    GraphBuilder liveBuilder (snapshot.connections, liveOrder, liveStates, liveIds);
+    liveBuilder.setLookAhead (lookAhead.get(), false);
+    auto program = buildProgram (liveBuilder, liveOrder, snapshot);
+    program->lookAhead = std::move (lookAhead);
+    return program;
+}
+} // namespace
+
+std::unique_ptr<RenderProgram> GraphCompiler::build (const GraphSnapshot& snapshot, CompileCache* cache)
+{
+    if (snapshot.lookAheadBlocks > 0)
+    {
+        if (auto program = buildWithLookAhead (snapshot))
+        {
+            // the split changes with any edit, these are built from scratch
+            if (cache != nullptr)
+                cache->clear();
+            return program;
+        }
+    }
+
+    CompileCache temporary;
+    if (cache == nullptr)
+        cache = &temporary;
+
+    std::unique_ptr<RenderProgram> program (new RenderProgram());
+    Array<void*> orderedNodes;
+    Array<uint32> orderedIds;
+    int checkpoint = 0;
+
+    if (snapshot.incremental && snapshot.blockSize == cache->blockSize
+        && snapshot.doublePrecision == cache->doublePrecision && ! cache->checkpoints.isEmpty())
+    {
+        const int firstStep = updateNodeOrder (snapshot, *cache, orderedNodes, orderedIds);
+        checkpoint = jmin (firstStep / CompileCache::checkpointInterval, cache->checkpoints.size() - 1);
+    }
+    else
+    {
+        sortNodes (snapshot, orderedNodes, orderedIds);
+    }
+
+    const auto orderedStates = getOrderedStates (snapshot, orderedIds);
+    GraphBuilder builder (snapshot.connections, orderedNodes, orderedStates, orderedIds);
+    builder.setFrozenNodes (snapshot.frozen, snapshot.freezing, snapshot.sampleRate, snapshot.blockSize);
+
+    if (checkpoint > 0)
+    {
+        // everything before the checkpoint is the same as the last build
+        const auto& state = *cache->checkpoints.getUnchecked (checkpoint);
+        builder.restoreCheckpoint (state, cache->delays);
+
+        const int numTasks = cache->stepTasks.getUnchecked (state.step);
+        const int numOps = numTasks < cache->tasks.size() ? cache->tasks.getReference (numTasks).firstOp
+                                                          : cache->code.size();
+
+        program->code.addArray (cache->code, 0, numOps);
+        for (int i = 0; i < numTasks; ++i)
+        {
+            GraphTask task;
+            task.firstOp = cache->tasks.getReference (i).firstOp;
+            task.numOps = cache->tasks.getReference (i).numOps;
+            program->tasks.add (task);
+        }
+
+        for (const auto& r : program->code)
+            if (r.type == RenderOp::performOp)
+                program->ops.add (r.op);
+    }
+    else
+    {
+        cache->clear();
+    }
+
+    const int firstStep = builder.getCurrentStep();
+    cache->checkpoints.removeRange (checkpoint, cache->checkpoints.size() - checkpoint);
+    cache->stepTasks.removeRange (firstStep, cache->stepTasks.size() - firstStep);
+    cache->delays.removeRange (firstStep, cache->delays.size() - firstStep);
+
+    Array<void*> ops;
+    Array<GraphTask> tasks;
+    while (builder.getCurrentStep() < orderedNodes.size())
+    {
+        const int step = builder.getCurrentStep();
+        if (step % CompileCache::checkpointInterval == 0)
+            builder.saveCheckpoint (*cache->checkpoints.add (new GraphBuilder::Checkpoint()));
+        cache->stepTasks.add (program->tasks.size() + tasks.size());
+
+        const int firstOp = ops.size();
+        builder.addNextNode (ops);
+        if (ops.size() > firstOp)
+        {
+            GraphTask task;
+            task.firstOp = firstOp;
+            task.numOps = ops.size() - firstOp;
+            tasks.add (task);
+        }
+
+        cache->delays.add (builder.getNodeDelay (orderedIds.getUnchecked (step)));
+    }
+
+    if (cache->checkpoints.isEmpty())
+        builder.saveCheckpoint (*cache->checkpoints.add (new GraphBuilder::Checkpoint()));
+    cache->stepTasks.add (program->tasks.size() + tasks.size());
+
+    program->assemble (ops, tasks);
+    program->linkTasks (builder.buffersNeeded (PortType::Audio),
+                        builder.buffersNeeded (PortType::Midi));
+    program->doublePrecision = snapshot.doublePrecision;
+    program->allocateBuffers (builder.buffersNeeded (PortType::Audio),
+                              builder.buffersNeeded (PortType::Midi),
+                              jmax (1, snapshot.blockSize));
+    program->latencySamples = builder.getTotalLatencySamples();
+
+    // remember this build for the next one
+    cache->nodes.clearQuick();
+    cache->signatures.clearQuick();
+    for (int i = 0; i < orderedNodes.size(); ++i)
+    {
+        cache->nodes.add ((NodeObject*) orderedNodes.getUnchecked (i));
+        cache->signatures.add (getNodeSignature (*orderedStates.getUnchecked (i)));
+    }
+    cache->nodeIds = orderedIds;
+
+    cache->connections.clearQuick (true);
+    for (const auto* const c : snapshot.connections)
+        cache->connections.add (new Arc (c->sourceNode, c->sourcePort, c->destNode, c->destPort));
+
+    cache->code = program->code;
+    cache->tasks = program->tasks;
+    cache->ops = program->ops;
+    cache->blockSize = snapshot.blockSize;
+    cache->doublePrecision = snapshot.doublePrecision;
+
+    return program;
+}
+
+uint32 GraphCompiler::inlineSubgraph (GraphSnapshot& snapshot,
+                                      const uint32 subgraphId,
+                                      const NodeObject& subgraph,
+                                      const GraphSnapshot& inner,
+                                      const uint32 firstId)
+{
+    for (int i = 0; i < snapshot.nodes.size(); ++i)
+    {
+        if (snapshot.getNodeId (i) != subgraphId)
+            continue;
+
+        // the rest of the nodes go by their own IDs until now
+        if (snapshot.nodeIds.isEmpty())
+            for (auto* const node : snapshot.nodes)
+                snapshot.nodeIds.add (node->nodeId);
+
+        snapshot.nodes.remove (i);
+        snapshot.states.remove (i);
+        snapshot.nodeIds.remove (i);
+        break;
+    }
+
+    uint32 nextId = firstId;
+    HashMap<uint32, IONode*> ioNodes;
+    for (int i = 0; i < inner.nodes.size(); ++i)
+    {
+        auto* const node = inner.nodes.getUnchecked (i);
+        const auto nodeId = inner.getNodeId (i);
+        nextId = jmax (nextId, firstId + nodeId + 1);
+
+        if (auto* const io = dynamic_cast<IONode*> (node))
+        {
+            ioNodes.set (nodeId, io);
+            continue;
+        }
+
+        snapshot.nodes.add (node);
+        snapshot.states.add (new NodeState (*inner.states.getUnchecked (i)));
+        snapshot.nodeIds.add (firstId + nodeId);
+    }
+
+    // connections to the subgraph's ports are replaced, the rest stay
+    OwnedArray<Arc> into, outOf, connections;
+    for (const auto* const c : snapshot.connections)
+    {
+        auto* const arc = new Arc (c->sourceNode, c->sourcePort, c->destNode, c->destPort);
+        if (c->destNode == subgraphId && c->sourceNode != subgraphId)
+            into.add (arc);
+        else if (c->sourceNode == subgraphId && c->destNode != subgraphId)
+            outOf.add (arc);
+        else if (c->sourceNode != subgraphId)
+            connections.add (arc);
+        else
+        {
+            jassertfalse; // a subgraph feeding itself can't be inlined
+            delete arc;
+        }
+    }
+
+    ArcSorter sorter;
+    connections.sort (sorter, true);
+    const auto connect = [&] (uint32 sourceNode, uint32 sourcePort, uint32 destNode, uint32 destPort) {
+        Arc arc (sourceNode, sourcePort, destNode, destPort);
+        if (connections.indexOfSorted (sorter, &arc) < 0)
+            connections.addSorted (sorter, new Arc (arc));
+    };
+
+    // the connections of the subgraph's port a channel of an IO node stands for
+    const auto portConnections = [&] (const OwnedArray<Arc>& arcs, bool input, const IONode& io, uint32 ioPort) {
+        const auto type = io.getPortType();
+        const int channel = io.getChannelPort (ioPort);
+        Array<const Arc*> found;
+        for (const auto* const c : arcs)
+        {
+            const auto port = input ? c->destPort : c->sourcePort;
+            if (subgraph.getPortType (port) == type && subgraph.getChannelPort (port) == channel)
+                found.add (c);
+        }
+        return found;
+    };
+
+    for (const auto* const c : inner.connections)
+    {
+        auto* const source = ioNodes[c->sourceNode];
+        auto* const dest = ioNodes[c->destNode];
+
+        if (source == nullptr && dest == nullptr)
+        {
+            connect (firstId + c->sourceNode, c->sourcePort, firstId + c->destNode, c->destPort);
+        }
+        else if (dest == nullptr)
+        {
+            if (source->isInput())
+                for (const auto* const in : portConnections (into, true, *source, c->sourcePort))
+                    connect (in->sourceNode, in->sourcePort, firstId + c->destNode, c->destPort);
+        }
+        else if (source == nullptr)
+        {
+            if (dest->isOutput())
+                for (const auto* const out : portConnections (outOf, false, *dest, c->destPort))
+                    connect (firstId + c->sourceNode, c->sourcePort, out->destNode, out->destPort);
+        }
+        else if (source->isInput() && dest->isOutput())
+        {
+            // straight through the subgraph
+            for (const auto* const in : portConnections (into, true, *source, c->sourcePort))
+                for (const auto* const out : portConnections (outOf, false, *dest, c->destPort))
+                    connect (in->sourceNode, in->sourcePort, out->destNode, out->destPort);
+        }
+    }
+
+    snapshot.connections.swapWith (connections);
+    return nextId;
+}
+
+void GraphCompiler::buildAhead (const GraphSnapshot& snapshot, LookAhead& lookAhead)
+{
+    Array<void*> orderedNodes;
+    Array<uint32> orderedIds;
+    sortNodes (snapshot, orderedNodes, orderedIds);
+    const auto orderedStates = getOrderedStates (snapshot, orderedIds);
+    GraphBuilder builder (snapshot.connections, orderedNodes, orderedStates, orderedIds);
+    builder.setLookAhead (&lookAhead, true);
+    lookAhead.setProgram (buildProgram (builder, orderedNodes, snapshot));
+}
+
+void GraphCompiler::compile (GraphNode& graph, std::unique_ptr<GraphSnapshot> snapshot)
+{
+    EL_ASSERT_NOT_RENDERING();
+    {
+        const ScopedLock sl (queueLock);
+        Job* job = nullptr;
+        for (auto* const j : jobs)
+            if (j->graph == &graph)
+                job = j;
+
+        if (job == nullptr)
+        {
+            job = jobs.add (new Job());
+            job->graph = &graph;
+        }
+
+        job->snapshot = std::move (snapshot);
+    }
+
+    notify();
+}
+
+void GraphCompiler::cancel (GraphNode& graph)
+{
+    EL_ASSERT_NOT_RENDERING();
+    {
+        const ScopedLock sl (queueLock);
+        for (int i = jobs.size(); --i >= 0;)
+            if (jobs.getUnchecked (i)->graph == &graph)
+                jobs.remove (i);
+    }
+
+    // wait for one in progress
+    const ScopedLock sl (compileLock);
+}
+
+void GraphCompiler::retire (RenderProgram* program) noexcept
+{
+    if (program == nullptr)
+        return;
+
+    auto* head = retired.load();
+    do
+    {
+        program->nextRetired = head;
+    } while (! retired.compare_exchange_weak (head, program));
+}
+
+void GraphCompiler::reclaim()
+{
+    auto* program = retired.exchange (nullptr);
+    while (program != nullptr)
+    {
+        auto* const next = program->nextRetired;
+        delete program;
+        program = next;
+    }
+}
+
+void GraphCompiler::run()
+{
+    while (! threadShouldExit())
+    {
+        bool compiled = false;
+
+        {
+            EL_ASSERT_NOT_RENDERING();
+            const ScopedLock csl (compileLock);
+            std::unique_ptr<Job> job;
+
+            {
+                const ScopedLock sl (queueLock);
+                if (! jobs.isEmpty())
+                    job.reset (jobs.removeAndReturn (0));
+            }
+
+            if (job != nullptr)
+            {
+                auto program = build (*job->snapshot, &job->graph->compileCache);
+                program->serial = job->snapshot->serial;
+                job->graph->setCompiledProgram (std::move (program));
+                compiled = true;
+            }
+        }
+
+        reclaim();
+
+        if (! compiled)
+            wait (100);
+    }
+}
+
+} // namespace element
@@ -0,0 +1,201 @@
+/*
+    This file is part of Element
+    Copyright (C) 2021  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+
+#pragma once
+
+#include "ElementApp.h"
+#include "engine/frozenaudio.hpp"
+#include "engine/graphbuilder.hpp"
+#include "engine/nodeobject.hpp"
+
+namespace element {
+
+class GraphNode;
+
+/** The parts of a graph needed to compile it.  This is copied on the
+    message thread so the compiler never reads a graph while it's edited.
+ */
+struct GraphSnapshot
+{
+    /** Nodes of the graph */
+    ReferenceCountedArray<NodeObject> nodes;
+
+    /** The state of each node when the snapshot was taken, the compiler
+        reads these instead of the nodes */
+    OwnedArray<NodeState> states;
+
+    /** Adds a node and a copy of its state */
+    void addNode (NodeObject* node)
+    {
+        jassert (nodeIds.isEmpty());
+        nodes.add (node);
+        states.add (new NodeState (*node));
+    }
+
+    /** The ID the connections know each node by, empty if every node goes
+        by its own.  Nodes of subgraphs rendered inline are numbered after
+        the graph's own, their IDs are only unique within their subgraph.
+     */
+    Array<uint32> nodeIds;
+
+    /** Returns the ID of the node at an index of nodes */
+    uint32 getNodeId (int index) const noexcept
+    {
+        return nodeIds.isEmpty() ? nodes.getUnchecked (index)->nodeId : nodeIds.getUnchecked (index);
+    }
+
+    /** Connections of the graph, sorted with an ArcSorter */
+    OwnedArray<Arc> connections;
+
+    /** The sample rate and block size the graph was prepared with */
+    double sampleRate = 0.0;
+    int blockSize = 0;
+
+    /** True if the program renders in double precision */
+    bool doublePrecision = false;
+
+    /** Blocks to render the nodes which don't depend on live input ahead
+        of the device, zero renders everything live */
+    int lookAheadBlocks = 0;
+
+    /** Audio frozen nodes are rendered from instead of running them */
+    ReferenceCountedArray<FrozenAudio> frozen;
+
+    /** Nodes being frozen, they're silent until they've been rendered */
+    SortedSet<uint32> freezing;
+
+    /** False if nodes changed in ways the compiler can't see, like their
+        processing, so every step has to be built again.
+     */
+    bool incremental = true;
+
+    /** Numbers the snapshots of a graph in the order they were taken */
+    uint32 serial = 0;
+};
+
+/** What the compiler remembers about the last program built for a graph.
+    After an edit only the steps from the first one it changes are built
+    again, the instructions before that are shared with the last program.
+ */
+struct CompileCache
+{
+    /** Forgets the last build, the next one starts from scratch */
+    void clear();
+
+    /** Nodes of the last build in rendering order */
+    ReferenceCountedArray<NodeObject> nodes;
+
+    /** The ID of each node in the last build's connections */
+    Array<uint32> nodeIds;
+
+    /** Ports and latency of each node when it was built */
+    Array<int64> signatures;
+
+    /** Delay of each node, in rendering order */
+    Array<int> delays;
+
+    /** Connections of the last build, sorted with an ArcSorter */
+    OwnedArray<Arc> connections;
+
+    /** Number of tasks before each step, plus one for the end */
+    Array<int> stepTasks;
+
+    /** Builder state every checkpointInterval steps */
+    OwnedArray<GraphBuilder::Checkpoint> checkpoints;
+
+    /** Instructions, tasks and ops of the last program */
+    Array<RenderOp> code;
+    Array<GraphTask> tasks;
+    ReferenceCountedArray<GraphOp> ops;
+
+    int blockSize = 0;
+    bool doublePrecision = false;
+
+    static constexpr int checkpointInterval = 32;
+};
+
+/** Compiles graphs in to render programs on a background thread and deletes
+    the programs the audio thread has finished with.  One compiler is shared
+    by every graph, use it with a SharedResourcePointer.
+ */
+class GraphCompiler : private Thread
+{
+public:
+    GraphCompiler();
+    ~GraphCompiler();
+
+    /** Builds a render program from a snapshot on the calling thread.  With
+        a cache only the part of the program after the first change since
+        the last build is built again.
+     */
+    static std::unique_ptr<RenderProgram> build (const GraphSnapshot& snapshot,
+                                                 CompileCache* cache = nullptr);
+
+    /** Puts the nodes of a subgraph in a snapshot of the graph around it, in
+        place of the subgraph.  The subgraph's IO nodes are left out and the
+        connections which went through them join its nodes to the graph's
+        directly.  Its nodes are numbered from firstId on, returns the first
+        ID after them.
+     */
+    static uint32 inlineSubgraph (GraphSnapshot& snapshot,
+                                  uint32 subgraphId,
+                                  const NodeObject& subgraph,
+                                  const GraphSnapshot& inner,
+                                  uint32 firstId);
+
+    /** Builds a program rendering every node of a snapshot in to a
+        look-ahead, which takes the program.  Add the look-ahead's ports
+        first.
+     */
+    static void buildAhead (const GraphSnapshot& snapshot, LookAhead& lookAhead);
+
+    /** Queues a graph to be compiled.  This replaces a snapshot of the same
+        graph which is still waiting.
+     */
+    void compile (GraphNode& graph, std::unique_ptr<GraphSnapshot> snapshot);
+
+    /** Removes a graph from the queue.  If the graph is being compiled this
+        waits until it's done, after which it's safe to delete the graph.
+     */
+    void cancel (GraphNode& graph);
+
+    /** Hands over a program the audio thread is done with.  Realtime safe. */
+    void retire (RenderProgram* program) noexcept;
+
+    /** Deletes retired programs now. */
+    void reclaim();
+
+private:
+    struct Job
+    {
+        GraphNode* graph = nullptr;
+        std::unique_ptr<GraphSnapshot> snapshot;
+    };
+
+    CriticalSection queueLock, compileLock;
+    OwnedArray<Job> jobs;
+    std::atomic<RenderProgram*> retired { nullptr };
+
+    void run() override;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (GraphCompiler)
+};
+
+} // namespace element
@@ -272,10 +272,13 @@ private:
 GraphManager::GraphManager (GraphNode& pg, PluginManager& pm)
     : pluginManager (pm), processor (pg), lastUID (0)
 {
+    nodeFrozenConnection = processor.nodeFrozen.connect (
+        std::bind (&GraphManager::onNodeFrozen, this, std::placeholders::_1, std::placeholders::_2));
 }
 
 GraphManager::~GraphManager()
 {
+    nodeFrozenConnection.disconnect();
     // Make sure to dereference NodeObject's so we don't leak memory
     // If you get warnings by juce's leak detector about graph related
     // objects, then there's probably "object" properties lingering that
@@ -284,6 +287,18 @@ GraphManager::~GraphManager()
     graph = arcs = nodes = ValueTree();
 }
 
+void GraphManager::onNodeFrozen (const uint32 nodeId, const Result& result)
+{
+    // the model only stays frozen if the node could be
+    if (result.failed())
+    {
+        DBG ("[EL] couldn't freeze node: " << result.getErrorMessage());
+        Node model (getNodeModelForId (nodeId));
+        if (model.isValid())
+            model.setProperty (Tags::frozen, false);
+    }
+}
+
 uint32 GraphManager::getNextUID() noexcept
 {
     return ++lastUID;
@@ -481,12 +496,12 @@ void GraphManager::removeNode (const uint32 uid)
         if (node.getNodeId() == uid)
         {
             // the model was probably referencing the node ptr
+            // the graph releases it once it's out of the program
             NodeObjectPtr obj = node.getObject();
-            if (obj)
-            {
+            if (obj && batchDepth > 0)
+                removedInBatch.add (obj);
+            else if (obj)
                 obj->willBeRemoved();
-                obj->releaseResources();
-            }
 
             for (int i = bindings.size(); --i >= 0;)
             {
@@ -542,7 +557,8 @@ void GraphManager::removeIllegalConnections()
 
 int GraphManager::getNumConnections() const noexcept
 {
-    jassert (arcs.getNumChildren() == processor.getNumConnections());
+    // the model is only updated at the end of a batch
+    jassert (batchDepth > 0 || arcs.getNumChildren() == processor.getNumConnections());
     return processor.getNumConnections();
 }
 
@@ -591,6 +607,9 @@ void GraphManager::setNodeModel (const Node& node)
     arcs = node.getArcsValueTree();
     nodes = node.getNodesValueTree();
 
+    // restore everything, then compile once
+    beginBatch();
+
     Array<ValueTree> failed;
     for (int i = 0; i < nodes.getNumChildren(); ++i)
     {
@@ -626,8 +645,7 @@ void GraphManager::setNodeModel (const Node& node)
     jassert (nodes.getNumChildren() == processor.getNumNodes());
 
     // Cheap way to refresh engine-side nodes
-    processor.triggerAsyncUpdate();
-    processor.handleUpdateNowIfNeeded();
+    processor.triggerRebuild();
 
     for (int i = 0; i < arcs.getNumChildren(); ++i)
     {
@@ -669,6 +687,7 @@ void GraphManager::setNodeModel (const Node& node)
 
     IONodeEnforcer enforceIONodes (*this);
     processorArcsChanged();
+    commit();
 }
 
 void GraphManager::savePluginStates()
@@ -699,8 +718,42 @@ void GraphManager::clear()
     changed();
 }
 
+void GraphManager::beginBatch()
+{
+    if (batchDepth++ == 0)
+        changedInBatch = arcsChangedInBatch = false;
+    processor.beginBatch();
+}
+
+void GraphManager::commit()
+{
+    jassert (batchDepth > 0); // commit() without beginBatch()
+    if (batchDepth <= 0)
+        return;
+
+    const int numConnections = processor.getNumConnections();
+    processor.commit();
+    if (--batchDepth > 0)
+        return;
+
+    for (auto* const obj : removedInBatch)
+        obj->willBeRemoved();
+    removedInBatch.clear();
+
+    if (arcsChangedInBatch || numConnections != processor.getNumConnections())
+        processorArcsChanged();
+    else if (changedInBatch)
+        changed();
+}
+
 void GraphManager::processorArcsChanged()
 {
+    if (batchDepth > 0)
+    {
+        arcsChangedInBatch = true;
+        return;
+    }
+
     ValueTree newArcs = ValueTree (Tags::arcs);
     for (int i = 0; i < processor.getNumConnections(); ++i)
         newArcs.addChild (Node::makeArc (*processor.getConnection (i)), -1, nullptr);
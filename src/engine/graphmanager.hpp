@@ -92,6 +92,14 @@ public:
 
     void removeIllegalConnections();
 
+    /** Starts a batch of edits.  The graph is compiled and the model updated
+        once, when the matching commit() is called.  Batches can be nested.
+     */
+    void beginBatch();
+
+    /** Ends a batch of edits started with beginBatch() */
+    void commit();
+
     void clear();
 
     void setNodeModel (const Node& node);
@@ -114,20 +122,34 @@ private:
     ValueTree graph, arcs, nodes;
     bool loaded = false;
 
+    int batchDepth = 0;
+    bool changedInBatch = false;
+    bool arcsChangedInBatch = false;
+    // told they're removed once the batch is committed
+    ReferenceCountedArray<NodeObject> removedInBatch;
+
     uint32 lastUID;
+    SignalConnection nodeFrozenConnection;
 
     class Binding;
     friend class Binding;
     OwnedArray<Binding> bindings;
 
     uint32 getNextUID() noexcept;
-    inline void changed() { sendChangeMessage(); }
+    inline void changed()
+    {
+        if (batchDepth > 0)
+            changedInBatch = true;
+        else
+            sendChangeMessage();
+    }
     NodeObject* createFilter (const PluginDescription* desc, double x = 0.0f, double y = 0.0f, uint32 nodeId = 0);
     NodeObject* createPlaceholder (const Node& node);
 
     void setupNode (const ValueTree& data, NodeObjectPtr object);
 
     void processorArcsChanged();
+    void onNodeFrozen (uint32 nodeId, const Result& result);
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (GraphManager)
 };
@@ -34,13 +34,62 @@ namespace element {
 GraphNode::Connection::Connection (const uint32 sourceNode_, const uint32 sourcePort_, const uint32 destNode_, const uint32 destPort_) noexcept
     : Arc (sourceNode_, sourcePort_, destNode_, destPort_) {}
 
+/** Renders a node being frozen on its own thread */
+class GraphNode::FreezeRender : public Thread
+{
+public:
+    FreezeRender (GraphNode& g, const FreezeRequest& r, std::unique_ptr<GraphSnapshot> s)
+        : Thread ("element: freeze"),
+          request (r),
+          id (++g.numFreezes),
+          graph (g),
+          snapshot (std::move (s)),
+          start (g.getPlayHeadForNodes().getPosition()),
+          sampleRate (g.getSampleRate()),
+          blockSize (g.getBlockSize())
+    {
+    }
+
+    ~FreezeRender() override { stopThread (-1); }
+
+    void run() override
+    {
+        const auto numSamples = (int64) (request.seconds * sampleRate + 0.5);
+        audio = FrozenAudio::render (*snapshot, request.nodeId, start, sampleRate, numSamples, error);
+
+        // buffered where the transport is before it's swapped in, so it isn't
+        // silent for the first blocks
+        if (audio != nullptr && ! threadShouldExit())
+        {
+            const auto position = graph.getPlayHeadForNodes().getPosition();
+            const auto time = position.hasValue() ? position->getTimeInSamples().orFallback (0) : (int64) 0;
+            audio->waitForBuffering (time, blockSize, 500);
+        }
+
+        finished = true;
+        graph.freezer.triggerAsyncUpdate();
+    }
+
+    const FreezeRequest request;
+    const uint32 id;
+    FrozenAudio::Ptr audio;
+    String error;
+    std::atomic<bool> finished { false };
+
+private:
+    GraphNode& graph;
+    const std::unique_ptr<GraphSnapshot> snapshot;
+    const Optional<AudioPlayHead::PositionInfo> start;
+    const double sampleRate;
+    const int blockSize;
+};
+
 GraphNode::GraphNode()
     : NodeObject (PortCount()
                       .with (PortType::Audio, 2, 2)
                       .with (PortType::Midi, 1, 1)
                       .toPortList()),
       lastNodeId (0),
-      renderingBuffers (1, 1),
       currentAudioInputBuffer (nullptr),
       currentAudioOutputBuffer (1, 1),
       currentMidiInputBuffer (nullptr)
@@ -53,24 +102,49 @@ GraphNode::GraphNode()
 GraphNode::~GraphNode()
 {
     renderingSequenceChanged.disconnect_all_slots();
+    nodeFrozen.disconnect_all_slots();
+    compiled.cancelPendingUpdate();
+    swapWatcher.stopTimer();
+    cancelFreeze (false);
+    freezer.cancelPendingUpdate();
     clearRenderingSequence();
+    renderedInline = false; // the parent has already let go of it
     clear();
 }
 
 void GraphNode::clear()
 {
-    nodes.clear();
-    connections.clear();
+    compiler->cancel (*this);
+    cancelFreeze (false);
+    freezeQueue.clearQuick();
+    // before the nodes go, subgraphs rendered inline by the program go with them
     clearRenderingSequence();
+
+    ReferenceCountedArray<NodeObject> removed;
+    removed.swapWith (nodes);
+    removed.addArray (batchRemoved);
+    batchRemoved.clear();
+    nodeMap.clear();
+    connections.clear();
+    frozenNodes.clear();
+    freezingNodes.clear();
+
+    // only the parent's program can still be rendering them
+    if (renderedInline)
+    {
+        triggerRebuild();
+        releaseNodes (removed);
+        return;
+    }
+
+    flushPendingSwaps();
+    for (auto* const node : removed)
+        detachNode (*node);
 }
 
 NodeObject* GraphNode::getNodeForId (const uint32 nodeId) const
 {
-    for (int i = nodes.size(); --i >= 0;)
-        if (nodes.getUnchecked (i)->nodeId == nodeId)
-            return nodes.getUnchecked (i);
-
-    return nullptr;
+    return nodeMap[nodeId];
 }
 
 NodeObject* GraphNode::addNode (NodeObject* newNode, uint32 nodeId)
@@ -110,33 +184,44 @@ NodeObject* GraphNode::addNode (NodeObject* newNode, uint32 nodeId)
             lastNodeId = nodeId;
     }
 
-    newNode->setPlayHead (playhead);
+    newNode->setPlayHead (getNodePlayHead());
     newNode->setParentGraph (this);
     newNode->refreshPorts();
     newNode->prepare (getSampleRate(), getBlockSize(), this);
-    triggerAsyncUpdate();
+    graphChanged();
+    nodeMap.set (newNode->nodeId, newNode);
     return nodes.add (newNode);
 }
 
 bool GraphNode::removeNode (const uint32 nodeId)
 {
+    // a freeze rendering the node starts again without it
+    if (freezingNodes.contains (nodeId))
+        cancelFreeze (freezeRender->request.nodeId != nodeId);
+    for (int i = freezeQueue.size(); --i >= 0;)
+        if (freezeQueue.getReference (i).nodeId == nodeId)
+            freezeQueue.remove (i);
+
     disconnectNode (nodeId);
+    for (int i = frozenNodes.size(); --i >= 0;)
+        if (frozenNodes.getUnchecked (i)->getNodeId() == nodeId)
+            frozenNodes.remove (i);
+
     for (int i = nodes.size(); --i >= 0;)
     {
         NodeObjectPtr n = nodes.getUnchecked (i);
         if (n->nodeId == nodeId)
         {
             nodes.remove (i);
+            nodeMap.remove (nodeId);
 
-            handleAsyncUpdate();
-            n->setParentGraph (nullptr);
-            n->setPlayHead (nullptr);
-
-            if (n->isSubGraph())
+            graphChanged();
+            batchRemoved.add (n);
+            if (! isInBatch())
             {
-                DBG ("[EL] sub graph removed");
+                releaseNodes (batchRemoved);
+                batchRemoved.clear();
             }
-
             return true;
         }
     }
@@ -144,6 +229,33 @@ bool GraphNode::removeNode (const uint32 nodeId)
     return false;
 }
 
+void GraphNode::detachNode (NodeObject& node)
+{
+    // it may have been added back since it was removed
+    if (node.getParentGraph() != this || nodes.contains (&node))
+        return;
+
+    node.setParentGraph (nullptr);
+    node.setPlayHead (nullptr);
+    node.unprepare();
+
+    if (auto* const graph = dynamic_cast<GraphNode*> (&node))
+    {
+        // nothing renders what's left in it anymore
+        graph->flushPendingSwaps();
+        DBG ("[EL] sub graph removed");
+    }
+}
+
+void GraphNode::releaseNodes (const ReferenceCountedArray<NodeObject>& removed)
+{
+    // the program still renders them until one built without them is swapped in
+    afterProgramSwap ([this, removed]() {
+        for (auto* const node : removed)
+            detachNode (*node);
+    });
+}
+
 const GraphNode::Connection*
     GraphNode::getConnectionBetween (const uint32 sourceNode,
                                      const uint32 sourcePort,
@@ -227,7 +339,7 @@ bool GraphNode::addConnection (const uint32 sourceNode, const uint32 sourcePort,
     ArcSorter sorter;
     Connection* c = new Connection (sourceNode, sourcePort, destNode, destPort);
     connections.addSorted (sorter, c);
-    triggerAsyncUpdate();
+    graphChanged();
     return true;
 }
 
@@ -243,7 +355,7 @@ bool GraphNode::connectChannels (PortType type, uint32 sourceNode, int32 sourceC
 void GraphNode::removeConnection (const int index)
 {
     connections.remove (index);
-    triggerAsyncUpdate();
+    graphChanged();
 }
 
 bool GraphNode::removeConnection (const uint32 sourceNode, const uint32 sourcePort, const uint32 destNode, const uint32 destPort)
@@ -299,6 +411,31 @@ bool GraphNode::isConnectionLegal (const Connection* const c) const
            && c->destPort < dest->getNumPorts();
 }
 
+void GraphNode::beginBatch()
+{
+    ++batchDepth;
+}
+
+void GraphNode::commit()
+{
+    jassert (batchDepth > 0); // commit() without beginBatch()
+    if (batchDepth <= 0 || --batchDepth > 0)
+        return;
+
+    removeIllegalConnections();
+
+    if (! batchChanged)
+        return;
+    batchChanged = false;
+
+    graphChanged();
+    if (batchRemoved.isEmpty())
+        return;
+
+    releaseNodes (batchRemoved);
+    batchRemoved.clear();
+}
+
 bool GraphNode::removeIllegalConnections()
 {
     bool doneAnything = false;
@@ -318,53 +455,83 @@ bool GraphNode::removeIllegalConnections()
 void GraphNode::setMidiChannel (const int channel) noexcept
 {
     jassert (isPositiveAndBelow (channel, 17));
+    ScopedLock sl (getPropertyLock());
     if (channel <= 0)
         midiChannels.setOmni (true);
     else
         midiChannels.setChannel (channel);
+    publishInputFilter();
 }
 
 void GraphNode::setMidiChannels (const BigInteger channels) noexcept
 {
     ScopedLock sl (getPropertyLock());
     midiChannels.setChannels (channels);
+    publishInputFilter();
 }
 
 void GraphNode::setMidiChannels (const MidiChannels channels) noexcept
 {
     ScopedLock sl (getPropertyLock());
     midiChannels = channels;
+    publishInputFilter();
 }
 
 bool GraphNode::acceptsMidiChannel (const int channel) const noexcept
 {
-    ScopedLock sl (getPropertyLock());
-    return midiChannels.isOn (channel);
+    // only called while rendering
+    return inputFilter.read().midiChannels.isOn (channel);
 }
 
 void GraphNode::setVelocityCurveMode (const VelocityCurve::Mode mode) noexcept
 {
     ScopedLock sl (getPropertyLock());
     velocityCurve.setMode (mode);
+    publishInputFilter();
 }
 
-static void deleteRenderOpArray (Array<void*>& ops)
+void GraphNode::publishInputFilter()
 {
-    for (int i = ops.size(); --i >= 0;)
-        delete static_cast<GraphOp*> (ops.getUnchecked (i));
-    ops.clearQuick();
+    // writers hold the property lock, the render thread never takes it
+    auto& filter = inputFilter.write();
+    filter.midiChannels = midiChannels;
+    filter.velocityCurve = velocityCurve;
+    inputFilter.publish();
+    checkInlineRendering();
+}
+
+void GraphNode::setNumRenderThreads (const int numThreads)
+{
+    if (numThreads == getNumRenderThreads())
+        return;
+    EL_ASSERT_NOT_RENDERING();
+    ScopedLock sl (schedulerLock);
+    scheduler.setNumThreads (numThreads);
 }
 
 void GraphNode::clearRenderingSequence()
 {
-    Array<void*> oldOps;
+    EL_ASSERT_NOT_RENDERING();
+    compiler->cancel (*this);
+    compileCache.clear();
+
+    std::unique_ptr<RenderProgram> oldProgram, oldNextProgram;
 
     {
-        const ScopedLock sl (getPropertyLock());
-        renderingOps.swapWith (oldOps);
+        // keeps the audio thread out while the program goes
+        const SpinLock::ScopedLockType sl (renderLock);
+        lookAheadRenderer.setTarget (nullptr);
+        oldProgram.reset (program);
+        program = nullptr;
+        oldNextProgram.reset (nextProgram.exchange (nullptr));
+        // nothing compiled before now is rendered
+        compiledSerial.store (snapshotSerial);
+        installedSerial.store (snapshotSerial);
     }
 
-    deleteRenderOpArray (oldOps);
+    oldProgram.reset();
+    oldNextProgram.reset();
+    compiler->reclaim();
 }
 
 bool GraphNode::isAnInputTo (const uint32 possibleInputId,
@@ -387,139 +554,660 @@ bool GraphNode::isAnInputTo (const uint32 possibleInputId,
     return false;
 }
 
-void GraphNode::buildRenderingSequence()
+std::unique_ptr<GraphSnapshot> GraphNode::createSnapshot()
 {
-    Array<void*> newRenderingOps;
-    int numRenderingBuffersNeeded = 2;
-    int numMidiBuffersNeeded = 1;
+    std::unique_ptr<GraphSnapshot> snapshot (new GraphSnapshot());
+    snapshot->sampleRate = getSampleRate();
+    snapshot->blockSize = getBlockSize();
+    snapshot->doublePrecision = isUsingDoublePrecision();
 
+    // nothing is rendered while the nodes are changed offline
+    if (holdingNodes > 0)
     {
-        //XXX:
-        MessageManagerLock mml;
+        snapshot->incremental = false;
+        fullRebuild = true;
+        return snapshot;
+    }
 
-        Array<void*> orderedNodes;
+    Array<GraphNode*> subgraphs;
 
+    for (auto* const node : nodes)
+    {
+        // nodes are prepared when added, only ones which missed a change in
+        // rate or block size need it again.  frozen ones aren't rendered
+        if (! isNodeFrozen (node->nodeId)
+            && (! node->isPrepared || node->getSampleRate() != getSampleRate() || node->getBlockSize() != getBlockSize()))
+            node->prepare (getSampleRate(), getBlockSize(), this);
+        snapshot->addNode (node);
+
+        if (auto* const graph = dynamic_cast<GraphNode*> (node))
         {
-            const LookupTable table (connections);
+            bool feedsItself = false;
+            for (const auto* const c : connections)
+                feedsItself |= c->sourceNode == node->nodeId && c->destNode == node->nodeId;
+
+            graph->renderedInline = ! feedsItself && ! isNodeFrozen (node->nodeId) && ! freezingNodes.contains (node->nodeId)
+                                    && graph->canRenderInline();
+            if (graph->renderedInline)
+                subgraphs.add (graph);
+        }
+    }
 
-            for (int i = 0; i < nodes.size(); ++i)
-            {
-                NodeObject* const node = nodes.getUnchecked (i);
-                // TODO: necessary?
-                node->prepare (getSampleRate(), getBlockSize(), this);
+    for (const auto* const c : connections)
+        snapshot->connections.add (new Arc (c->sourceNode, c->sourcePort, c->destNode, c->destPort));
+
+    // subgraphs are rendered by this graph's program where they can be, so
+    // their IO nodes drop out and their nodes are scheduled with ours
+    uint32 nextId = lastNodeId + 1;
+    for (auto* const graph : subgraphs)
+    {
+        // its own program is still kept up to date
+        const bool rebuildSubgraph = graph->fullRebuild;
+        nextId = GraphCompiler::inlineSubgraph (*snapshot, graph->nodeId, *graph, *graph->createSnapshot(), nextId);
+        graph->fullRebuild = rebuildSubgraph;
+    }
 
-                int j = 0;
-                for (; j < orderedNodes.size(); ++j)
-                    if (table.isAnInputTo (node->nodeId, ((NodeObject*) orderedNodes.getUnchecked (j))->nodeId))
-                        break;
+    snapshot->lookAheadBlocks = getLookAheadBlocks();
+    snapshot->frozen = frozenNodes;
+    snapshot->freezing = freezingNodes;
+    snapshot->incremental = ! fullRebuild;
+    fullRebuild = false;
 
-                orderedNodes.insert (j, node);
-            }
-        }
+    return snapshot;
+}
 
-        GraphBuilder builder (*this, orderedNodes, newRenderingOps);
-        numRenderingBuffersNeeded = builder.buffersNeeded (PortType::Audio);
-        numMidiBuffersNeeded = builder.buffersNeeded (PortType::Midi);
-        setLatencySamples (builder.getTotalLatencySamples());
+void GraphNode::setCompiledProgram (std::unique_ptr<RenderProgram> newProgram)
+{
+    {
+        EL_ASSERT_NOT_RENDERING();
+        const ScopedLock sl (schedulerLock);
+        scheduler.prepare (newProgram->tasks);
     }
 
+    compiledLatency.store (newProgram->latencySamples);
+    compiledSerial.store (newProgram->serial);
+
+    // replaces a program the audio thread never saw, so it's safe to delete
+    std::unique_ptr<RenderProgram> unused (nextProgram.exchange (newProgram.release()));
+    compiled.triggerAsyncUpdate();
+}
+
+void GraphNode::handleProgramCompiled()
+{
+    setLatencySamples (compiledLatency.load());
+    renderingSequenceChanged();
+}
+
+void GraphNode::buildRenderingSequence()
+{
+    // compiles on the calling thread when the graph is prepared, edits use
+    // the compiler thread instead. see handleAsyncUpdate()
+    cancelPendingUpdate();
+    compiler->cancel (*this);
+
+    std::unique_ptr<GraphSnapshot> snapshot;
+
     {
-        // swap over to the new rendering sequence..
-        // const ScopedLock sl (getCallbackLock());
-        renderingBuffers.setSize (numRenderingBuffersNeeded, 4096);
-        renderingBuffers.clear();
+        // the graph is edited on the message thread, this can be called
+        // from the device's when it starts
+        MessageManagerLock mml;
+        snapshot = createSnapshot();
+        snapshot->serial = ++snapshotSerial;
+    }
 
-        for (int i = midiBuffers.size(); --i >= 0;)
-            midiBuffers.getUnchecked (i)->clear();
+    auto newProgram = GraphCompiler::build (*snapshot, &compileCache);
+    newProgram->serial = snapshot->serial;
+    setCompiledProgram (std::move (newProgram));
+    compiled.handleUpdateNowIfNeeded();
+}
 
-        while (midiBuffers.size() < numMidiBuffersNeeded)
-            midiBuffers.add (new MidiBuffer());
+void GraphNode::installNextProgram() noexcept
+{
+    if (auto* const next = nextProgram.exchange (nullptr))
+    {
+        // doesn't wait, the old look-ahead waits for its renderer when deleted
+        lookAheadRenderer.setTarget (next->lookAhead.get());
+        compiler->retire (program);
+        program = next;
+        installedSerial.store (next->serial);
+    }
+}
 
-        renderingOps.swapWith (newRenderingOps);
+void GraphNode::afterProgramSwap (std::function<void()> action)
+{
+    // the graphs rendering this one's nodes, up to the first which renders
+    // its own program.  each has to pick up a program compiled from a
+    // snapshot taken after now
+    PendingSwap swap;
+    for (auto* graph = this; graph != nullptr; graph = graph->renderedInline ? graph->getParentGraph() : nullptr)
+    {
+        swap.graphs.add (graph);
+        swap.serials.add (graph->snapshotSerial + 1);
     }
 
-    // delete the old ones..
-    deleteRenderOpArray (newRenderingOps);
+    swap.action = std::move (action);
+    pendingSwaps.add (std::move (swap));
+    if (! swapWatcher.isTimerRunning())
+        swapWatcher.startTimer (5);
+}
 
-    renderingSequenceChanged();
+bool GraphNode::hasInstalled (const uint32 serial)
+{
+    if (installedSerial.load() >= serial)
+        return true;
+
+    // a graph which hasn't rendered for a few blocks isn't being rendered,
+    // its program is picked up here in place of the audio thread
+    const double blockMillis = getSampleRate() > 0.0 ? 1000.0 * getBlockSize() / getSampleRate() : 0.0;
+    const auto timeout = (uint32) jmax (20, roundToInt (4.0 * blockMillis));
+    if (nextProgram.load() != nullptr && Time::getMillisecondCounter() - lastRenderTime.load() > timeout)
+    {
+        const SpinLock::ScopedTryLockType stl (renderLock);
+        if (stl.isLocked())
+            installNextProgram();
+    }
+
+    return installedSerial.load() >= serial;
 }
 
-void GraphNode::getOrderedNodes (ReferenceCountedArray<NodeObject>& orderedNodes)
+void GraphNode::handlePendingSwaps()
 {
-    const LookupTable table (connections);
-    for (int i = 0; i < nodes.size(); ++i)
+    // in order, an edit can depend on the ones before it
+    while (! pendingSwaps.isEmpty())
     {
-        NodeObject* const node = nodes.getUnchecked (i);
+        const auto& swap = pendingSwaps.getReference (0);
+        for (int i = 0; i < swap.graphs.size(); ++i)
+        {
+            // a graph rendered inline doesn't render its own program
+            auto* const graph = swap.graphs.getUnchecked (i);
+            if (! graph->renderedInline && ! graph->hasInstalled (swap.serials.getUnchecked (i)))
+                return;
+        }
+
+        const auto action = swap.action;
+        pendingSwaps.remove (0);
+        action();
+    }
 
-        int j = 0;
-        for (; j < orderedNodes.size(); ++j)
-            if (table.isAnInputTo (node->nodeId, ((NodeObject*) orderedNodes.getUnchecked (j))->nodeId))
-                break;
+    swapWatcher.stopTimer();
+}
 
-        orderedNodes.insert (j, node);
+void GraphNode::flushPendingSwaps()
+{
+    while (! pendingSwaps.isEmpty())
+    {
+        const auto action = pendingSwaps.getReference (0).action;
+        pendingSwaps.remove (0);
+        action();
     }
+
+    swapWatcher.stopTimer();
+    for (auto* const node : nodes)
+        if (auto* const graph = dynamic_cast<GraphNode*> (node))
+            graph->flushPendingSwaps();
+}
+
+bool GraphNode::hasPendingEdits() const
+{
+    return isUpdatePending() || compiledSerial.load() != snapshotSerial || ! pendingSwaps.isEmpty();
+}
+
+void GraphNode::waitForEdits()
+{
+    while (hasPendingEdits())
+        MessageManager::getInstance()->runDispatchLoopUntil (1);
+}
+
+Array<NodeObject*> GraphNode::getRenderedNodes()
+{
+    EL_ASSERT_NOT_RENDERING();
+    Array<NodeObject*> rendered;
+    const SpinLock::ScopedLockType sl (renderLock);
+    if (program != nullptr)
+        for (auto* const op : program->ops)
+            if (auto* const node = op->getRenderedNode())
+                rendered.add (node);
+    return rendered;
+}
+
+void GraphNode::getOrderedNodes (ReferenceCountedArray<NodeObject>& orderedNodes)
+{
+    Array<uint32> nodeIds;
+    nodeIds.ensureStorageAllocated (nodes.size());
+    for (auto* const node : nodes)
+        nodeIds.add (node->nodeId);
+
+    for (const auto index : sortTopologically (nodeIds, connections))
+        orderedNodes.add (nodes.getUnchecked (index));
 }
 
 void GraphNode::handleAsyncUpdate()
 {
-    buildRenderingSequence();
+    auto snapshot = createSnapshot();
+    snapshot->serial = ++snapshotSerial;
+    compiler->compile (*this, std::move (snapshot));
+}
+
+void GraphNode::triggerRebuild()
+{
+    fullRebuild = true;
+    if (renderedInline)
+        if (auto* const graph = getParentGraph())
+            graph->triggerRebuild();
+    graphChanged();
+}
+
+void GraphNode::graphChanged()
+{
+    if (isInBatch())
+    {
+        batchChanged = true;
+        return;
+    }
+
+    triggerAsyncUpdate();
+    if (renderedInline)
+        if (auto* const graph = getParentGraph())
+            graph->graphChanged();
+}
+
+bool GraphNode::canRenderInline()
+{
+    if (getParentGraph() == nullptr || ! isEnabled() || isSuspended() || ! frozenNodes.isEmpty() || ! freezingNodes.isEmpty())
+        return false;
+
+    // none of what's done to a node's signals can be done to it inline
+    if (isMuted() || isMetering() || getGain() != 1.f || getInputGain() != 1.f || getOversamplingFactor() > 1)
+        return false;
+
+    const auto keyRange = getKeyRange();
+    if ((keyRange.getLength() > 0 && (keyRange.getStart() > 0 || keyRange.getEnd() < 127))
+        || getTransposeOffset() != 0 || ! getMidiChannels().isOmni() || areMidiProgramsEnabled())
+        return false;
+
+    return midiChannels.isOmni() && velocityCurve.getMode() == VelocityCurve::Linear;
 }
 
 void GraphNode::prepareToRender (double sampleRate, int estimatedSamplesPerBlock)
 {
+    // a node being frozen may be prepared again, it's rendered from the start
+    readyToRender = false;
+    cancelFreeze (true);
+
+    if (auto* const parentGraph = getParentGraph())
+        doublePrecision = parentGraph->isUsingDoublePrecision();
+
+    // buffers for both precisions, so changing it never resizes them while
+    // the graph is rendered
+    const int numChannels = jmax (1, getNumAudioInputs(), getNumAudioOutputs());
     currentAudioInputBuffer = nullptr;
-    currentAudioOutputBuffer.setSize (jmax (1, getNumAudioOutputs()), estimatedSamplesPerBlock);
+    currentDoubleInputBuffer = nullptr;
+    currentAudioOutputBuffer.setSize (numChannels, estimatedSamplesPerBlock);
+    currentDoubleOutputBuffer.setSize (numChannels, estimatedSamplesPerBlock);
+    doubleBlock.setSize (numChannels, estimatedSamplesPerBlock);
+    floatBlock.setSize (numChannels, estimatedSamplesPerBlock);
     currentMidiInputBuffer = nullptr;
     currentMidiOutputBuffer.clear();
+    blockMidiInput.ensureSize (4096);
+    blockMidiOutput.ensureSize (4096);
     clearRenderingSequence();
 
     if (getSampleRate() != sampleRate || getBlockSize() != estimatedSamplesPerBlock)
         setRenderDetails (sampleRate, estimatedSamplesPerBlock);
 
     for (int i = 0; i < nodes.size(); ++i)
-        nodes.getUnchecked (i)->prepare (sampleRate, estimatedSamplesPerBlock, this);
+        if (! isNodeFrozen (nodes.getUnchecked (i)->nodeId))
+            nodes.getUnchecked (i)->prepare (sampleRate, estimatedSamplesPerBlock, this);
 
     buildRenderingSequence();
+
+    readyToRender = true;
+    if (! freezeQueue.isEmpty())
+        freezer.triggerAsyncUpdate();
 }
 
 void GraphNode::releaseResources()
 {
+    readyToRender = false;
+    cancelFreeze (true);
+    clearRenderingSequence();
+
     for (int i = 0; i < nodes.size(); ++i)
         nodes.getUnchecked (i)->unprepare();
 
-    renderingBuffers.setSize (1, 1);
-    midiBuffers.clear();
-
     currentAudioInputBuffer = nullptr;
     currentAudioOutputBuffer.setSize (1, 1);
+    currentDoubleInputBuffer = nullptr;
+    currentDoubleOutputBuffer.setSize (1, 1);
+    floatBlock.setSize (1, 1);
+    doubleBlock.setSize (1, 1);
     currentMidiInputBuffer = nullptr;
     currentMidiOutputBuffer.clear();
 }
 
+void GraphNode::updateNodesOffline (const std::function<void()>& update)
+{
+    if (! isPrepared)
+    {
+        update();
+        return;
+    }
+
+    // the nodes are updated once a program without them is swapped in and
+    // are silent until they're compiled back in.  a freeze in progress
+    // starts again after
+    cancelFreeze (true);
+    ++holdingNodes;
+    triggerRebuild();
+
+    afterProgramSwap ([this, update]() {
+        update();
+        --holdingNodes;
+        triggerRebuild();
+    });
+}
+
+void GraphNode::setDoublePrecision (const bool shouldUseDoublePrecision)
+{
+    if (doublePrecision.load() == shouldUseDoublePrecision)
+        return;
+
+    // programs render in the precision they were built with, plugins can
+    // only change it while they're released
+    doublePrecision = shouldUseDoublePrecision;
+    updateNodesOffline ([this]() {
+        for (auto* const node : nodes)
+        {
+            if (! node->isPrepared || isNodeFrozen (node->nodeId))
+                continue;
+            node->unprepare();
+            node->prepare (getSampleRate(), getBlockSize(), this);
+        }
+    });
+}
+
+void GraphNode::setLookAheadBlocks (int numBlocks)
+{
+    numBlocks = jlimit (0, 32, numBlocks);
+    if (numBlocks == lookAheadBlocks.load())
+        return;
+
+    lookAheadBlocks = numBlocks;
+    lookAheadRenderer.setEnabled (numBlocks > 0);
+    triggerRebuild();
+}
+
+//==============================================================================
+namespace {
+/** True if a node needs live input, other than what a graph is fed with */
+bool needsLiveInput (NodeObject& node)
+{
+    if (auto* const graph = dynamic_cast<GraphNode*> (&node))
+    {
+        for (int i = 0; i < graph->getNumNodes(); ++i)
+        {
+            auto* const child = graph->getNode (i);
+            if (! child->isA<IONode>() && needsLiveInput (*child))
+                return true;
+        }
+
+        return false;
+    }
+
+    return node.rendersLive();
+}
+} // namespace
+
+std::unique_ptr<GraphSnapshot> GraphNode::createFreezeSnapshot (const uint32 nodeId, String& error) const
+{
+    // the node and everything feeding it, up to nodes which are frozen
+    SortedSet<uint32> upstream;
+    Array<uint32> pending;
+    pending.add (nodeId);
+    while (! pending.isEmpty())
+    {
+        const auto id = pending.removeAndReturn (pending.size() - 1);
+        if (upstream.contains (id))
+            continue;
+        upstream.add (id);
+        if (id != nodeId && isNodeFrozen (id))
+            continue;
+
+        for (const auto* const c : connections)
+            if (c->destNode == id)
+                pending.add (c->sourceNode);
+    }
+
+    std::unique_ptr<GraphSnapshot> snapshot (new GraphSnapshot());
+    for (const auto id : upstream)
+    {
+        auto* const node = getNodeForId (id);
+        if (! isNodeFrozen (id) && needsLiveInput (*node))
+        {
+            error = node->getName() + " depends on live input and can't be frozen";
+            return nullptr;
+        }
+
+        snapshot->addNode (node);
+    }
+
+    for (const auto* const c : connections)
+        if (upstream.contains (c->sourceNode) && upstream.contains (c->destNode))
+            snapshot->connections.add (new Arc (c->sourceNode, c->sourcePort, c->destNode, c->destPort));
+
+    snapshot->sampleRate = getSampleRate();
+    snapshot->blockSize = getBlockSize();
+    snapshot->frozen = frozenNodes;
+    snapshot->incremental = false;
+    return snapshot;
+}
+
+Result GraphNode::freezeNode (const uint32 nodeId, const double seconds, const bool releaseNode)
+{
+    if (getNodeForId (nodeId) == nullptr)
+        return Result::fail ("There's no node to freeze");
+    if (isNodeFrozen (nodeId) || isNodeFreezing (nodeId))
+        return Result::ok();
+    if (seconds <= 0.0)
+        return Result::fail ("There's nothing to render");
+
+    // checked again when it starts, the graph can change until then
+    String error;
+    if (createFreezeSnapshot (nodeId, error) == nullptr)
+        return Result::fail (error);
+
+    FreezeRequest request;
+    request.nodeId = nodeId;
+    request.seconds = seconds;
+    request.releaseNode = releaseNode;
+    freezeQueue.add (request);
+    freezer.triggerAsyncUpdate();
+    return Result::ok();
+}
+
+bool GraphNode::unfreezeNode (const uint32 nodeId)
+{
+    bool wasFreezing = false;
+    for (int i = freezeQueue.size(); --i >= 0;)
+    {
+        if (freezeQueue.getReference (i).nodeId == nodeId)
+        {
+            freezeQueue.remove (i);
+            wasFreezing = true;
+        }
+    }
+
+    if (freezeRender != nullptr && freezeRender->request.nodeId == nodeId)
+    {
+        cancelFreeze (false);
+        triggerRebuild();
+        return true;
+    }
+
+    for (int i = frozenNodes.size(); --i >= 0;)
+    {
+        if (frozenNodes.getUnchecked (i)->getNodeId() == nodeId)
+        {
+            // the program streaming it holds on to the audio until it's retired,
+            // the node is prepared again when the graph is compiled
+            frozenNodes.remove (i);
+            triggerRebuild();
+            return true;
+        }
+    }
+
+    return wasFreezing;
+}
+
+bool GraphNode::isNodeFrozen (const uint32 nodeId) const
+{
+    for (const auto* const audio : frozenNodes)
+        if (audio->getNodeId() == nodeId)
+            return true;
+    return false;
+}
+
+bool GraphNode::isNodeFreezing (const uint32 nodeId) const
+{
+    if (freezeRender != nullptr && freezeRender->request.nodeId == nodeId)
+        return true;
+    for (const auto& request : freezeQueue)
+        if (request.nodeId == nodeId)
+            return true;
+    return false;
+}
+
+void GraphNode::waitForFreezing()
+{
+    // renders start once their nodes are out of the program and finish on
+    // the message thread, see handleFreezeUpdate()
+    startNextFreeze();
+    while (freezeRender != nullptr || hasPendingEdits())
+        MessageManager::getInstance()->runDispatchLoopUntil (1);
+}
+
+void GraphNode::handleFreezeUpdate()
+{
+    if (freezeRender != nullptr)
+    {
+        if (! freezeRender->finished.load())
+            return;
+        finishFreeze();
+    }
+
+    startNextFreeze();
+}
+
+void GraphNode::startNextFreeze()
+{
+    while (freezeRender == nullptr && readyToRender && ! freezeQueue.isEmpty())
+    {
+        const auto request = freezeQueue.removeAndReturn (0);
+        if (getNodeForId (request.nodeId) == nullptr || isNodeFrozen (request.nodeId))
+            continue;
+
+        String error;
+        auto snapshot = createFreezeSnapshot (request.nodeId, error);
+        if (snapshot == nullptr)
+        {
+            nodeFrozen (request.nodeId, Result::fail (error));
+            continue;
+        }
+
+        for (auto* const n : snapshot->nodes)
+            if (! isNodeFrozen (n->nodeId))
+                freezingNodes.add (n->nodeId);
+        triggerRebuild();
+        freezeRender.reset (new FreezeRender (*this, request, std::move (snapshot)));
+
+        // the nodes have to be out of the program before they're rendered
+        afterProgramSwap ([this, id = freezeRender->id]() {
+            if (freezeRender != nullptr && freezeRender->id == id)
+                freezeRender->startThread();
+        });
+    }
+}
+
+void GraphNode::finishFreeze()
+{
+    std::unique_ptr<FreezeRender> render (std::move (freezeRender));
+    render->waitForThreadToExit (-1);
+    freezingNodes.clear();
+
+    const auto nodeId = render->request.nodeId;
+    if (render->audio != nullptr)
+    {
+        frozenNodes.add (render->audio);
+        if (render->request.releaseNode)
+            if (auto* const node = getNodeForId (nodeId))
+                node->unprepare();
+    }
+
+    triggerRebuild();
+    nodeFrozen (nodeId, render->audio != nullptr ? Result::ok() : Result::fail (render->error));
+}
+
+void GraphNode::cancelFreeze (const bool requeue)
+{
+    if (freezeRender == nullptr)
+        return;
+
+    std::unique_ptr<FreezeRender> render (std::move (freezeRender));
+    render->stopThread (-1);
+    freezingNodes.clear();
+    fullRebuild = true;
+
+    if (requeue)
+        freezeQueue.insert (0, render->request);
+    if (! freezeQueue.isEmpty())
+        freezer.triggerAsyncUpdate();
+}
+
 void GraphNode::reset()
 {
-    const ScopedLock sl (getPropertyLock());
-    for (auto node : nodes)
-        if (auto* const proc = node->getAudioProcessor())
-            proc->reset();
+    updateNodesOffline ([this]() {
+        for (auto node : nodes)
+            if (auto* const proc = node->getAudioProcessor())
+                proc->reset();
+    });
 }
 
 // MARK: Process Graph
 
 void GraphNode::render (AudioSampleBuffer& buffer, MidiPipe& midi)
 {
-    const int32 numSamples = buffer.getNumSamples();
-    auto& midiMessages = *midi.getWriteBuffer (0);
-    currentAudioInputBuffer = &buffer;
-    currentAudioOutputBuffer.setSize (jmax (1, buffer.getNumChannels()), numSamples);
-    currentAudioOutputBuffer.clear();
+    renderGraph (buffer, midi);
+}
 
-    if (midiChannels.isOmni() && velocityCurve.getMode() == VelocityCurve::Linear)
+void GraphNode::render (AudioBuffer<double>& buffer, MidiPipe& midi)
+{
+    renderGraph (buffer, midi);
+}
+
+template <typename SampleType>
+void GraphNode::renderGraph (AudioBuffer<SampleType>& buffer, MidiPipe& midi)
+{
+    // only held by other threads to install a program while the graph
+    // isn't being rendered, or to clear it
+    const SpinLock::ScopedTryLockType stl (renderLock);
+    if (! stl.isLocked())
     {
-        currentMidiInputBuffer = &midiMessages;
+        buffer.clear();
+        midi.clear();
+        return;
     }
-    else
+
+    lastRenderTime.store (Time::getMillisecondCounter(), std::memory_order_relaxed);
+    installNextProgram();
+
+    const int32 numSamples = buffer.getNumSamples();
+    auto& midiMessages = *midi.getWriteBuffer (0);
+    MidiBuffer* midiInput = &midiMessages;
+
+    const auto& filter = inputFilter.read();
+    if (! filter.midiChannels.isOmni() || filter.velocityCurve.getMode() != VelocityCurve::Linear)
     {
+        auto curve = filter.velocityCurve;
         filteredMidi.clear();
         MidiBuffer::Iterator iter (midiMessages);
         MidiMessage msg;
@@ -528,33 +1216,114 @@ void GraphNode::render (AudioSampleBuffer& buffer, MidiPipe& midi)
         while (iter.getNextEvent (msg, frame))
         {
             chan = msg.getChannel();
-            if (chan > 0 && midiChannels.isOff (chan))
+            if (chan > 0 && filter.midiChannels.isOff (chan))
                 continue;
 
             if (msg.isNoteOn())
             {
-                msg.setVelocity (velocityCurve.process (msg.getFloatVelocity()));
+                msg.setVelocity (curve.process (msg.getFloatVelocity()));
             }
 
             filteredMidi.addEvent (msg, frame);
         }
 
-        currentMidiInputBuffer = &filteredMidi;
+        midiInput = &filteredMidi;
+    }
+
+    const int32 blockSize = program != nullptr ? program->getBlockSize() : numSamples;
+
+    if (numSamples <= blockSize)
+    {
+        renderBlock (buffer, *midiInput);
+        midiMessages.clear();
+        midiMessages.addEvents (currentMidiOutputBuffer, 0, numSamples, 0);
+        return;
     }
 
+    // bigger than prepared for, render in sub-blocks with MIDI moved to suit
+    blockMidiOutput.clear();
+
+    for (int32 start = 0; start < numSamples; start += blockSize)
+    {
+        const int32 numBlockSamples = jmin (blockSize, numSamples - start);
+        AudioBuffer<SampleType> block (buffer.getArrayOfWritePointers(), buffer.getNumChannels(), start, numBlockSamples);
+
+        blockMidiInput.clear();
+        blockMidiInput.addEvents (*midiInput, start, numBlockSamples, -start);
+        renderBlock (block, blockMidiInput);
+        blockMidiOutput.addEvents (currentMidiOutputBuffer, 0, numBlockSamples, start);
+    }
+
+    midiMessages.swapWith (blockMidiOutput);
+    blockMidiOutput.clear();
+}
+
+void GraphNode::renderBlock (AudioSampleBuffer& buffer, MidiBuffer& midiInput)
+{
+    if (program == nullptr || ! program->doublePrecision)
+    {
+        renderProgram (buffer, midiInput);
+        return;
+    }
+
+    // the graph is the edge of a double precision island
+    doubleBlock.makeCopyOf (buffer, true);
+    renderProgram (doubleBlock, midiInput);
+    buffer.makeCopyOf (doubleBlock, true);
+}
+
+void GraphNode::renderBlock (AudioBuffer<double>& buffer, MidiBuffer& midiInput)
+{
+    if (program == nullptr || program->doublePrecision)
+    {
+        renderProgram (buffer, midiInput);
+        return;
+    }
+
+    floatBlock.makeCopyOf (buffer, true);
+    renderProgram (floatBlock, midiInput);
+    buffer.makeCopyOf (floatBlock, true);
+}
+
+template <typename SampleType>
+void GraphNode::renderProgram (AudioBuffer<SampleType>& buffer, MidiBuffer& midiInput)
+{
+    const int32 numSamples = buffer.getNumSamples();
+    auto& output = beginIO (buffer);
+    output.setSize (jmax (1, buffer.getNumChannels()), numSamples, false, false, true);
+    output.clear();
+    currentMidiInputBuffer = &midiInput;
     currentMidiOutputBuffer.clear();
 
-    for (int i = 0; i < renderingOps.size(); ++i)
+    if (program != nullptr)
     {
-        GraphOp* const op = static_cast<GraphOp*> (renderingOps.getUnchecked (i));
-        op->perform (renderingBuffers, midiBuffers, numSamples);
+        if (program->lookAhead != nullptr)
+        {
+            auto* const source = playhead.load();
+            lookAheadRenderer.beginRead (source != nullptr ? source->getPosition() : Optional<AudioPlayHead::PositionInfo>(),
+                                         getSampleRate(),
+                                         numSamples);
+        }
+
+        program->beginBlock (numSamples);
+
+        // the scheduler is only locked while it's resized, render serially then
+        const ScopedTryLock stl (schedulerLock);
+        if (stl.isLocked() && scheduler.getNumThreads() > 1 && program->tasks.size() > 1)
+        {
+            scheduler.perform (*program, numSamples);
+        }
+        else
+        {
+            program->perform (0, program->code.size(), numSamples);
+        }
+
+        if (program->lookAhead != nullptr)
+            lookAheadRenderer.endRead (numSamples);
     }
 
     for (int i = 0; i < buffer.getNumChannels(); ++i)
-        buffer.copyFrom (i, 0, currentAudioOutputBuffer, i, 0, numSamples);
-
-    midiMessages.clear();
-    midiMessages.addEvents (currentMidiOutputBuffer, 0, numSamples, 0);
+        buffer.copyFrom (i, 0, output, i, 0, numSamples);
 }
 
 void GraphNode::getPluginDescription (PluginDescription& d) const
@@ -575,7 +1344,7 @@ void GraphNode::setPlayHead (AudioPlayHead* newPlayHead)
 {
     playhead = newPlayHead;
     for (auto* const node : nodes)
-        node->setPlayHead (playhead);
+        node->setPlayHead (getNodePlayHead());
 }
 
 } // namespace element
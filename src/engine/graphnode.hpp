@@ -20,7 +20,10 @@
 #pragma once
 
 #include "ElementApp.h"
+#include "engine/graphcompiler.hpp"
+#include "engine/lookahead.hpp"
 #include "engine/nodeobject.hpp"
+#include "engine/renderscheduler.hpp"
 #include "engine/velocitycurve.hpp"
 #include "arc.hpp"
 #include "signals.hpp"
@@ -33,6 +36,10 @@ class GraphNode : public NodeObject,
 public:
     Signal<void()> renderingSequenceChanged;
 
+    /** Emitted on the message thread when a node has been frozen, or with
+        the error if it couldn't be */
+    Signal<void (uint32, const Result&)> nodeFrozen;
+
     /** Creates an empty graph. */
     GraphNode();
 
@@ -61,7 +68,8 @@ public:
     */
     void clear();
 
-    /** Reset all nodes in the graph */
+    /** Reset all nodes in the graph.  If it's prepared they're taken out of
+        the program while they're reset, so the graph is briefly silent. */
     void reset();
 
     /** Returns the number of nodes in the graph. */
@@ -95,6 +103,8 @@ public:
     /** Deletes a node within the graph which has the specified ID.
 
         This will also delete any connections that are attached to this node.
+        The node is detached and released once the audio thread has swapped in
+        a program without it.
     */
     bool removeNode (uint32 nodeId);
 
@@ -155,6 +165,26 @@ public:
     */
     bool removeIllegalConnections();
 
+    /** Starts a batch of edits.
+
+        Nodes and connections changed during a batch aren't compiled until
+        the matching commit(), so a script or preset making many edits only
+        compiles the graph once.  Batches can be nested.
+    */
+    void beginBatch();
+
+    /** Ends a batch started with beginBatch().
+
+        When the outermost batch ends, connections made illegal by the edits
+        are removed and the graph is compiled once.  Removed nodes are
+        detached and released once the audio thread has swapped in a program
+        without them.
+    */
+    void commit();
+
+    /** Returns true if edits are being batched */
+    bool isInBatch() const noexcept { return batchDepth > 0; }
+
     /** Set the allowed MIDI channel of this Graph */
     void setMidiChannel (const int channel) noexcept;
 
@@ -170,6 +200,84 @@ public:
     /** Set the MIDI curve of this graph */
     void setVelocityCurveMode (const VelocityCurve::Mode) noexcept;
 
+    /** Set the number of threads used to render this graph.  Nodes which
+        don't share buffers are then rendered in parallel. One renders nodes
+        serially in their sorted order.
+    */
+    void setNumRenderThreads (int numThreads);
+
+    /** Returns the number of threads used to render this graph */
+    int getNumRenderThreads() const noexcept { return scheduler.getNumThreads(); }
+
+    /** Renders the graph with 64 bit buffers.  Plugins supporting double
+        precision process doubles, anything else is converted to float and
+        back around it.  Graphs inside this one follow it.
+
+        If the graph is prepared its nodes are taken out of the program and
+        prepared again in the new precision, the graph is silent meanwhile.
+    */
+    void setDoublePrecision (bool shouldUseDoublePrecision);
+
+    /** Returns true if the graph renders with 64 bit buffers */
+    bool isUsingDoublePrecision() const noexcept { return doublePrecision.load(); }
+
+    /** Renders the nodes which don't depend on live input this many blocks
+        ahead of the device on a background thread.  This absorbs spikes in
+        their load without delaying live input, but they hear parameter
+        changes late.  Zero renders everything live.
+    */
+    void setLookAheadBlocks (int numBlocks);
+
+    /** Returns the number of blocks rendered ahead, zero if none are */
+    int getLookAheadBlocks() const noexcept { return lookAheadBlocks.load(); }
+
+    /** Returns the number of blocks the nodes rendered ahead were silent for
+        because they weren't ready in time */
+    int getNumLookAheadUnderruns() const noexcept { return lookAheadRenderer.getNumUnderruns(); }
+
+    /** Freezes a node.  Its output is rendered from the start of the
+        transport to a file, which is streamed in its place until it's
+        unfrozen.  Neither the node nor what feeds it can depend on live
+        input, they're rendered on a background thread and are silent until
+        it's done.  Nodes are frozen one at a time once the graph is
+        prepared, nodeFrozen is emitted for each.
+
+        With releaseNode the node's resources are released while it's
+        frozen, so a plugin frees its buffers and voices.
+     */
+    Result freezeNode (uint32 nodeId, double seconds, bool releaseNode = false);
+
+    /** Renders a frozen node again and deletes the audio it was frozen to,
+        or stops it being frozen.  Returns false if it was neither.
+     */
+    bool unfreezeNode (uint32 nodeId);
+
+    /** Returns true if a node is frozen */
+    bool isNodeFrozen (uint32 nodeId) const;
+
+    /** Returns true if a node is waiting to be frozen or being rendered */
+    bool isNodeFreezing (uint32 nodeId) const;
+
+    /** Waits for the nodes waiting to be frozen and swaps them in.  Call on
+        the message thread.
+     */
+    void waitForFreezing();
+
+    /** Runs the message loop until edits are compiled and nodes removed from
+        the program are released.  Call on the message thread, this is for
+        tests and tools which can block it.
+     */
+    void waitForEdits();
+
+    /** Returns the nodes the program being rendered calls, in order.  Nodes
+        of subgraphs rendered inline are included instead of the subgraph.
+        This is for tests and tools, call it when the graph isn't rendering.
+     */
+    Array<NodeObject*> getRenderedNodes();
+
+    /** Returns the playhead the nodes of this graph see */
+    AudioPlayHead& getPlayHeadForNodes() noexcept { return nodePlayHead; }
+
     //==========================================================================
     void prepareToRender (double sampleRate, int estimatedBlockSize) override;
     void releaseResources() override;
@@ -178,6 +286,12 @@ public:
     void render (AudioSampleBuffer& audio, MidiPipe& midi) override;
     void renderBypassed (AudioSampleBuffer&, MidiPipe&) override {}
 
+    bool supportsDoublePrecisionRender() const override { return isUsingDoublePrecision(); }
+    // a graph can hold device nodes, never render it ahead
+    bool rendersLive() const override { return true; }
+    void render (AudioBuffer<double>& audio, MidiPipe& midi) override;
+    void renderBypassed (AudioBuffer<double>&, MidiPipe&) override {}
+
     int getNumPrograms() const override { return 1; }
     int getCurrentProgram() const override { return 0; }
     const String getProgramName (int index) const override { return "program"; }
@@ -203,6 +317,7 @@ protected:
 private:
     friend class GraphPort;
     friend class IONode;
+    friend class GraphCompiler;
     friend class GraphManager;
     friend class NodeObject;
     friend class NodeObjectSync;
@@ -210,28 +325,183 @@ private:
 
     typedef ArcTable<Connection> LookupTable;
     ReferenceCountedArray<NodeObject> nodes;
+    HashMap<uint32, NodeObject*> nodeMap;
     OwnedArray<Connection> connections;
     uint32 ioNodes[10];
 
     uint32 lastNodeId;
-    AudioSampleBuffer renderingBuffers;
-    OwnedArray<MidiBuffer> midiBuffers;
-    Array<void*> renderingOps;
+
+    // the program being rendered, only touched with the render lock held
+    RenderProgram* program = nullptr;
+    // a newly compiled program waiting for the audio thread to pick it up
+    std::atomic<RenderProgram*> nextProgram { nullptr };
+    // held by the audio thread while rendering, other threads only take it
+    // when the graph isn't being rendered
+    SpinLock renderLock;
+    std::atomic<uint32> lastRenderTime { 0 };
+    // snapshots compiled for this graph are numbered, programs carry the
+    // number of their snapshot
+    uint32 snapshotSerial = 0;
+    std::atomic<uint32> compiledSerial { 0 };
+    std::atomic<uint32> installedSerial { 0 };
+    std::atomic<int> compiledLatency { 0 };
+    SharedResourcePointer<GraphCompiler> compiler;
+    // the last build, only used by whoever holds the compiler for this graph
+    CompileCache compileCache;
+    bool fullRebuild = false;
+    // non zero while the nodes are out of the program to be changed offline
+    int holdingNodes = 0;
+
+    int batchDepth = 0;
+    bool batchChanged = false;
+    // removed during a batch, released once they're out of the program
+    ReferenceCountedArray<NodeObject> batchRemoved;
+
+    // an edit waiting for the graphs rendering this one's nodes to swap in
+    // a program built after it
+    struct PendingSwap
+    {
+        Array<GraphNode*> graphs;
+        Array<uint32> serials;
+        std::function<void()> action;
+    };
+    Array<PendingSwap> pendingSwaps;
+
+    struct SwapWatcher : public Timer
+    {
+        explicit SwapWatcher (GraphNode& g) : graph (g) {}
+        void timerCallback() override { graph.handlePendingSwaps(); }
+        GraphNode& graph;
+    } swapWatcher { *this };
+
+    struct CompiledNotifier : public AsyncUpdater
+    {
+        explicit CompiledNotifier (GraphNode& g) : graph (g) {}
+        void handleAsyncUpdate() override { graph.handleProgramCompiled(); }
+        GraphNode& graph;
+    } compiled { *this };
+
+    CriticalSection schedulerLock;
+    RenderScheduler scheduler;
 
     AudioSampleBuffer* currentAudioInputBuffer;
     AudioSampleBuffer currentAudioOutputBuffer;
+    // the IO buffers of a double precision program
+    AudioBuffer<double>* currentDoubleInputBuffer = nullptr;
+    AudioBuffer<double> currentDoubleOutputBuffer;
+    // a caller's block converted to the program's precision
+    AudioSampleBuffer floatBlock;
+    AudioBuffer<double> doubleBlock;
+    std::atomic<bool> doublePrecision { false };
     MidiBuffer* currentMidiInputBuffer;
     MidiBuffer currentMidiOutputBuffer;
 
     MidiChannels midiChannels;
     VelocityCurve velocityCurve;
+
+    // what the render thread uses of the above
+    struct InputFilter
+    {
+        MidiChannels midiChannels;
+        VelocityCurve velocityCurve;
+    };
+    mutable TripleBuffer<InputFilter> inputFilter;
+    void publishInputFilter();
     MidiBuffer filteredMidi;
+    MidiBuffer blockMidiInput, blockMidiOutput;
 
     std::atomic<AudioPlayHead*> playhead { nullptr };
 
+    // the playhead nodes see, moved to the block being rendered ahead on
+    // the look-ahead thread
+    struct NodePlayHead : public AudioPlayHead
+    {
+        explicit NodePlayHead (const std::atomic<AudioPlayHead*>& s) : source (s) {}
+        Optional<PositionInfo> getPosition() const override
+        {
+            if (const auto* const position = LookAhead::getRenderPosition())
+                return *position;
+            if (auto* const p = source.load())
+                return p->getPosition();
+            return {};
+        }
+        const std::atomic<AudioPlayHead*>& source;
+    } nodePlayHead { playhead };
+    AudioPlayHead* getNodePlayHead() noexcept { return playhead.load() != nullptr ? &nodePlayHead : nullptr; }
+
+    std::atomic<int> lookAheadBlocks { 0 };
+    LookAheadRenderer lookAheadRenderer;
+
+    ReferenceCountedArray<FrozenAudio> frozenNodes;
+    // taken out of the program while they're rendered to be frozen
+    SortedSet<uint32> freezingNodes;
+
+    // nodes waiting to be frozen, and the one being rendered
+    struct FreezeRequest
+    {
+        uint32 nodeId = EL_INVALID_NODE;
+        double seconds = 0.0;
+        bool releaseNode = false;
+    };
+    Array<FreezeRequest> freezeQueue;
+    class FreezeRender;
+    std::unique_ptr<FreezeRender> freezeRender;
+    uint32 numFreezes = 0;
+
+    struct FreezeNotifier : public AsyncUpdater
+    {
+        explicit FreezeNotifier (GraphNode& g) : graph (g) {}
+        void handleAsyncUpdate() override { graph.handleFreezeUpdate(); }
+        GraphNode& graph;
+    } freezer { *this };
+
+    // between prepareToRender() and releaseResources()
+    bool readyToRender = false;
+
+    void handleFreezeUpdate();
+    void startNextFreeze();
+    void finishFreeze();
+    void cancelFreeze (bool requeue);
+
+    // true while the parent renders the nodes of this graph in its own
+    // program instead of rendering it as a node
+    std::atomic<bool> renderedInline { false };
+    bool canRenderInline();
+
+    template <typename SampleType>
+    void renderGraph (AudioBuffer<SampleType>& buffer, MidiPipe& midi);
+    void renderBlock (AudioSampleBuffer& buffer, MidiBuffer& midiInput);
+    void renderBlock (AudioBuffer<double>& buffer, MidiBuffer& midiInput);
+    template <typename SampleType>
+    void renderProgram (AudioBuffer<SampleType>& buffer, MidiBuffer& midiInput);
+    AudioSampleBuffer& beginIO (AudioSampleBuffer& input) noexcept
+    {
+        currentAudioInputBuffer = &input;
+        return currentAudioOutputBuffer;
+    }
+    AudioBuffer<double>& beginIO (AudioBuffer<double>& input) noexcept
+    {
+        currentDoubleInputBuffer = &input;
+        return currentDoubleOutputBuffer;
+    }
     void handleAsyncUpdate() override;
+    void triggerRebuild();
+    void graphChanged();
+    void detachNode (NodeObject& node);
+    void releaseNodes (const ReferenceCountedArray<NodeObject>& removed);
     void clearRenderingSequence();
     void buildRenderingSequence();
+    std::unique_ptr<GraphSnapshot> createSnapshot();
+    std::unique_ptr<GraphSnapshot> createFreezeSnapshot (uint32 nodeId, String& error) const;
+    void setCompiledProgram (std::unique_ptr<RenderProgram> newProgram);
+    void updateNodesOffline (const std::function<void()>& update);
+    void installNextProgram() noexcept;
+    void afterProgramSwap (std::function<void()> action);
+    bool hasInstalled (uint32 serial);
+    void handlePendingSwaps();
+    void flushPendingSwaps();
+    bool hasPendingEdits() const;
+    void handleProgramCompiled();
     bool isAnInputTo (uint32 possibleInputId, uint32 possibleDestinationId, int recursionCheck) const;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (GraphNode)
@@ -93,27 +93,41 @@ void IONode::releaseResources() {}
 void IONode::render (AudioSampleBuffer& buffer, MidiPipe& midiPipe)
 {
     jassert (graph != nullptr);
+    renderIO (buffer, midiPipe, graph->currentAudioInputBuffer, graph->currentAudioOutputBuffer);
+}
+
+void IONode::render (AudioBuffer<double>& buffer, MidiPipe& midiPipe)
+{
+    jassert (graph != nullptr);
+    renderIO (buffer, midiPipe, graph->currentDoubleInputBuffer, graph->currentDoubleOutputBuffer);
+}
+
+template <typename SampleType>
+void IONode::renderIO (AudioBuffer<SampleType>& buffer, MidiPipe& midiPipe,
+                       const AudioBuffer<SampleType>* graphInput,
+                       AudioBuffer<SampleType>& graphOutput)
+{
     // jassert (midiPipe.getNumBuffers() > 0);
     auto& midiMessages = *midiPipe.getWriteBuffer (0);
     switch (type)
     {
         case audioOutputNode: {
-            for (int i = jmin (graph->currentAudioOutputBuffer.getNumChannels(),
+            for (int i = jmin (graphOutput.getNumChannels(),
                                buffer.getNumChannels());
                  --i >= 0;)
             {
-                graph->currentAudioOutputBuffer.addFrom (i, 0, buffer, i, 0, buffer.getNumSamples());
+                graphOutput.addFrom (i, 0, buffer, i, 0, buffer.getNumSamples());
             }
 
             break;
         }
 
         case audioInputNode: {
-            for (int i = jmin (graph->currentAudioInputBuffer->getNumChannels(),
+            for (int i = jmin (graphInput->getNumChannels(),
                                buffer.getNumChannels());
                  --i >= 0;)
             {
-                buffer.copyFrom (i, 0, *graph->currentAudioInputBuffer, i, 0, buffer.getNumSamples());
+                buffer.copyFrom (i, 0, *graphInput, i, 0, buffer.getNumSamples());
             }
 
             break;
@@ -72,6 +72,9 @@ public:
     void prepareToRender (double, int) override;
     void releaseResources() override;
     void render (AudioSampleBuffer&, MidiPipe&) override;
+    bool supportsDoublePrecisionRender() const override { return true; }
+    void render (AudioBuffer<double>&, MidiPipe&) override;
+    bool rendersLive() const override { return true; }
     void getState (MemoryBlock&) override {}
     void setState (const void*, int sizeInBytes) override {}
 
@@ -83,6 +86,10 @@ private:
     const IODeviceType type;
     GraphNode* graph;
     void updateName();
+    template <typename SampleType>
+    void renderIO (AudioBuffer<SampleType>& buffer, MidiPipe& midiPipe,
+                   const AudioBuffer<SampleType>* graphInput,
+                   AudioBuffer<SampleType>& graphOutput);
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (IONode)
 };
 
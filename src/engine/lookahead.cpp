@@ -0,0 +1,371 @@
+/*
+    This file is part of Element
+    Copyright (C) 2021  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+
+#include "engine/lookahead.hpp"
+#include "engine/renderguard.hpp"
+
+namespace element {
+
+namespace {
+const AudioPlayHead::PositionInfo*& renderPositionForThread() noexcept
+{
+    static thread_local const AudioPlayHead::PositionInfo* position = nullptr;
+    return position;
+}
+} // namespace
+
+//==============================================================================
+LookAhead::LookAhead (const int blocks)
+    : numBlocks (jmax (1, blocks)),
+      numSlots (numBlocks + 1) // the block being read plus the ones ahead of it
+{
+}
+
+LookAhead::~LookAhead()
+{
+    if (renderer != nullptr)
+        while (renderer->busy.load() == this)
+            Thread::yield();
+}
+
+void LookAhead::addPort (const uint32 nodeId, const uint32 port, PortType type)
+{
+    int index = 0;
+    for (const auto& p : ports)
+    {
+        if (p.node == nodeId && p.port == port)
+            return;
+        if (p.type == type)
+            ++index;
+    }
+
+    Port p;
+    p.node = nodeId;
+    p.port = port;
+    p.type = type;
+    p.index = index;
+    ports.add (p);
+
+    if (type == PortType::Audio)
+        numAudio = index + 1;
+    else if (type == PortType::Midi)
+        numMidi = index + 1;
+}
+
+void LookAhead::setProgram (std::unique_ptr<RenderProgram> newProgram)
+{
+    program = std::move (newProgram);
+    blockSize = jmax (1, program->getBlockSize());
+
+    const int numChannels = jmax (1, numAudio * numSlots);
+    const bool useDouble = program->doublePrecision;
+    audioSlots.setSize (useDouble ? 1 : numChannels, useDouble ? 1 : blockSize);
+    doubleSlots.setSize (useDouble ? numChannels : 1, useDouble ? blockSize : 1);
+    silentSlots.malloc ((size_t) numChannels);
+    std::fill_n (silentSlots.get(), numChannels, true);
+
+    midiSlots.clear();
+    for (int i = numMidi * numSlots; --i >= 0;)
+        midiSlots.add (new MidiEventBuffer());
+
+    blocksWritten.store (0);
+    samplesRead.store (0);
+}
+
+//==============================================================================
+Optional<AudioPlayHead::PositionInfo> LookAhead::getPositionAt (const int64 sample) const noexcept
+{
+    if (! start.hasValue())
+        return {};
+
+    auto pos = *start;
+    const int64 offset = sample - startSample;
+    if (offset == 0 || ! pos.getIsPlaying())
+        return pos;
+
+    const double seconds = (double) offset / sampleRate;
+    if (const auto time = pos.getTimeInSamples())
+        pos.setTimeInSamples (*time + offset);
+    if (const auto time = pos.getTimeInSeconds())
+        pos.setTimeInSeconds (*time + seconds);
+    if (const auto ppq = pos.getPpqPosition())
+        if (const auto bpm = pos.getBpm())
+            pos.setPpqPosition (*ppq + seconds * *bpm / 60.0);
+    return pos;
+}
+
+bool LookAhead::isInSync (const Optional<AudioPlayHead::PositionInfo>& position) const noexcept
+{
+    const auto expected = getPositionAt (samplesRead.load (std::memory_order_relaxed));
+    if (! position.hasValue() || ! expected.hasValue())
+        return position.hasValue() == expected.hasValue();
+
+    if (position->getIsPlaying() != expected->getIsPlaying() || position->getBpm() != expected->getBpm())
+        return false;
+
+    // a stopped transport renders the same wherever it is
+    return ! position->getIsPlaying() || position->getTimeInSamples() == expected->getTimeInSamples();
+}
+
+void LookAhead::restart (const Optional<AudioPlayHead::PositionInfo>& position, const double newSampleRate) noexcept
+{
+    // note offs in the dropped blocks will never be read
+    releaseNotes = blocksWritten.load() > 0;
+    start = position;
+    startSample = 0;
+    sampleRate = newSampleRate > 0.0 ? newSampleRate : 44100.0;
+    blocksWritten.store (0);
+    samplesRead.store (0);
+}
+
+//==============================================================================
+template <typename SampleType>
+bool LookAhead::read (const int index, SampleType* dest, const int numSamples) const noexcept
+{
+    const auto& slots = [this]() -> const AudioBuffer<SampleType>& {
+        if constexpr (std::is_same<SampleType, double>::value)
+            return doubleSlots;
+        else
+            return audioSlots;
+    }();
+
+    if (skipped)
+        return true;
+
+    const int64 first = samplesRead.load (std::memory_order_relaxed);
+    bool silent = true;
+    for (int64 pos = first; pos < first + numSamples; pos = (pos / blockSize + 1) * blockSize)
+        silent = silent && silentSlots[getSlot (pos) * numAudio + index];
+
+    if (silent)
+        return true;
+
+    for (int done = 0; done < numSamples;)
+    {
+        const int64 pos = first + done;
+        const int offset = (int) (pos % blockSize);
+        const int num = jmin (numSamples - done, blockSize - offset);
+        const int channel = getSlot (pos) * numAudio + index;
+
+        if (silentSlots[channel])
+            FloatVectorOperations::clear (dest + done, num);
+        else
+            FloatVectorOperations::copy (dest + done, slots.getReadPointer (channel, offset), num);
+
+        done += num;
+    }
+
+    return false;
+}
+
+template bool LookAhead::read (int, float*, int) const noexcept;
+template bool LookAhead::read (int, double*, int) const noexcept;
+
+void LookAhead::readMidi (const int index, MidiBuffer& dest, const int numSamples) const
+{
+    if (skipped)
+        return;
+
+    if (releaseNotes)
+        for (int channel = 1; channel <= 16; ++channel)
+            dest.addEvent (MidiMessage::allNotesOff (channel), 0);
+
+    const int64 first = samplesRead.load (std::memory_order_relaxed);
+    for (int done = 0; done < numSamples;)
+    {
+        const int64 pos = first + done;
+        const int offset = (int) (pos % blockSize);
+        const int num = jmin (numSamples - done, blockSize - offset);
+        midiSlots.getUnchecked (getSlot (pos) * numMidi + index)->getView (offset, num).addTo (dest, done - offset);
+        done += num;
+    }
+}
+
+//==============================================================================
+void LookAhead::renderNextBlock() noexcept
+{
+    jassert (canWrite());
+    const int64 block = blocksWritten.load (std::memory_order_relaxed);
+
+    auto& current = renderPositionForThread();
+    const auto* const previous = current;
+    const auto position = getPositionAt (block * blockSize);
+    if (position.hasValue())
+    {
+        renderPosition = *position;
+        current = &renderPosition;
+    }
+
+    program->beginBlock (blockSize);
+    program->perform (0, program->code.size(), blockSize);
+
+    current = previous;
+    blocksWritten.store (block + 1, std::memory_order_release);
+}
+
+template <typename SampleType>
+void LookAhead::write (const int index, const SampleType* src, const bool silent) noexcept
+{
+    const int channel = getSlot (blocksWritten.load (std::memory_order_relaxed) * blockSize) * numAudio + index;
+    silentSlots[channel] = silent;
+    if (silent)
+        return;
+
+    if constexpr (std::is_same<SampleType, double>::value)
+        doubleSlots.copyFrom (channel, 0, src, blockSize);
+    else
+        audioSlots.copyFrom (channel, 0, src, blockSize);
+}
+
+template void LookAhead::write (int, const float*, bool) noexcept;
+template void LookAhead::write (int, const double*, bool) noexcept;
+
+void LookAhead::writeMidi (const int index, const MidiBuffer& src)
+{
+    auto& slot = *midiSlots.getUnchecked (getSlot (blocksWritten.load (std::memory_order_relaxed) * blockSize) * numMidi + index);
+    slot.copyFrom (src);
+}
+
+const AudioPlayHead::PositionInfo* LookAhead::getRenderPosition() noexcept
+{
+    return renderPositionForThread();
+}
+
+//==============================================================================
+LookAheadRenderer::LookAheadRenderer()
+    : Thread ("element: look-ahead renderer") {}
+
+LookAheadRenderer::~LookAheadRenderer()
+{
+    setEnabled (false);
+}
+
+void LookAheadRenderer::setEnabled (const bool shouldBeEnabled)
+{
+    if (shouldBeEnabled == isThreadRunning())
+        return;
+
+    if (shouldBeEnabled)
+    {
+        startThread (9);
+        return;
+    }
+
+    signalThreadShouldExit();
+    wakeup.post();
+    stopThread (1000);
+}
+
+void LookAheadRenderer::setTarget (LookAhead* const newTarget) noexcept
+{
+    if (newTarget != nullptr)
+        newTarget->renderer = this;
+    target.store (newTarget);
+    if (newTarget != nullptr && isThreadRunning())
+        wakeup.post();
+}
+
+void LookAheadRenderer::beginRead (const Optional<AudioPlayHead::PositionInfo>& position,
+                                   const double sampleRate,
+                                   const int numSamples) noexcept
+{
+    // only the thread rendering the graph changes the target
+    auto* const ahead = target.load (std::memory_order_relaxed);
+    if (ahead == nullptr)
+        return;
+
+    ahead->skipped = false;
+    if (ahead->isInSync (position) && ahead->canRead (numSamples))
+        return;
+
+    // behind or out of sync, take over from the background thread unless
+    // it's in the middle of a block
+    const SpinLock::ScopedTryLockType stl (ahead->lock);
+    if (stl.isLocked())
+    {
+        if (! ahead->isInSync (position))
+            ahead->restart (position, sampleRate);
+        while (! ahead->canRead (numSamples) && ahead->canWrite())
+            ahead->renderNextBlock();
+    }
+
+    if (! stl.isLocked() || ! ahead->canRead (numSamples))
+    {
+        // read later, or dropped if the transport moves on meanwhile
+        ahead->skipped = true;
+        underruns.fetch_add (1, std::memory_order_relaxed);
+    }
+}
+
+void LookAheadRenderer::endRead (const int numSamples) noexcept
+{
+    auto* const ahead = target.load (std::memory_order_relaxed);
+    if (ahead == nullptr)
+        return;
+
+    if (! ahead->skipped)
+        ahead->advance (numSamples);
+    if (isThreadRunning())
+        wakeup.post();
+}
+
+void LookAheadRenderer::run()
+{
+    ScopedNoDenormals denormals;
+
+    while (! threadShouldExit())
+    {
+        wakeup.wait();
+
+        while (! threadShouldExit())
+        {
+            // mark the target busy before checking it's still the target, a
+            // look-ahead swapped out meanwhile is either skipped here or
+            // waited for when it's deleted
+            auto* const ahead = target.load();
+            busy.store (ahead);
+            if (ahead == nullptr || ahead != target.load())
+            {
+                busy.store (nullptr);
+                if (ahead == nullptr)
+                    break;
+                continue;
+            }
+
+            bool rendered = false;
+            {
+                // the audio thread only tries this lock, see beginRead()
+                EL_ASSERT_NOT_RENDERING();
+                const SpinLock::ScopedLockType sl (ahead->lock);
+                if (ahead->canWrite())
+                {
+                    ahead->renderNextBlock();
+                    rendered = true;
+                }
+            }
+
+            busy.store (nullptr);
+            if (! rendered)
+                break;
+        }
+    }
+}
+
+} // namespace element
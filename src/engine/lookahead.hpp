@@ -0,0 +1,228 @@
+/*
+    This file is part of Element
+    Copyright (C) 2021  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+
+#pragma once
+
+#include "ElementApp.h"
+#include "engine/graphbuilder.hpp"
+#include "engine/midieventbuffer.hpp"
+#include "semaphore.hpp"
+
+namespace element {
+
+class LookAheadRenderer;
+
+/** The nodes of a graph which don't depend on live input, rendered ahead of
+    the device in to a ring of blocks.  The live program reads their outputs
+    back as it needs them.
+
+    Blocks are written by one thread at a time, whoever holds the look-ahead's
+    lock, see LookAheadRenderer.  Only the audio thread reads.
+ */
+class LookAhead
+{
+public:
+    /** An output of a node rendered ahead which a live node reads */
+    struct Port
+    {
+        uint32 node = EL_INVALID_NODE;
+        uint32 port = EL_INVALID_PORT;
+        PortType type { PortType::Unknown };
+
+        /** Index of the port's ring, per type */
+        int index = 0;
+
+        /** Latency of the output when it was rendered */
+        int delay = 0;
+    };
+
+    /** Creates a look-ahead which renders up to numBlocks ahead */
+    explicit LookAhead (int numBlocks);
+
+    /** Waits for a block the renderer's background thread is rendering */
+    ~LookAhead();
+
+    //==========================================================================
+    /** Marks a node as rendered ahead */
+    void addNode (uint32 nodeId) { nodes.add (nodeId); }
+
+    /** Returns true if the node is rendered ahead */
+    bool rendersAhead (uint32 nodeId) const noexcept { return nodes.contains (nodeId); }
+
+    /** Adds an output read by live nodes, does nothing if it's already added */
+    void addPort (uint32 nodeId, uint32 port, PortType type);
+
+    /** Returns the outputs read by live nodes */
+    Array<Port>& getPorts() noexcept { return ports; }
+    const Array<Port>& getPorts() const noexcept { return ports; }
+
+    /** Takes the program rendering the nodes ahead and allocates blocks the
+        size of its buffers.  Call once the ports are added. */
+    void setProgram (std::unique_ptr<RenderProgram> newProgram);
+
+    /** Returns the program rendering the nodes ahead */
+    RenderProgram* getProgram() const noexcept { return program.get(); }
+
+    /** Returns how many blocks are rendered ahead */
+    int getNumBlocks() const noexcept { return numBlocks; }
+
+    //==========================================================================
+    /** True if the blocks ready to read were rendered for this position */
+    bool isInSync (const Optional<AudioPlayHead::PositionInfo>& position) const noexcept;
+
+    /** True if numSamples are ready to read */
+    bool canRead (int numSamples) const noexcept
+    {
+        return blocksWritten.load (std::memory_order_acquire) * blockSize - samplesRead.load (std::memory_order_relaxed) >= numSamples;
+    }
+
+    /** Reads the next samples of an audio port.  Returns true if they're
+        silent, the destination isn't written then.  Ports are silent for a
+        block the renderer couldn't make ready. */
+    template <typename SampleType>
+    bool read (int index, SampleType* dest, int numSamples) const noexcept;
+
+    /** Appends the next events of a MIDI port to an empty buffer */
+    void readMidi (int index, MidiBuffer& dest, int numSamples) const;
+
+    /** Moves past samples which have been read */
+    void advance (int numSamples) noexcept
+    {
+        releaseNotes = false;
+        samplesRead.fetch_add (numSamples, std::memory_order_release);
+    }
+
+    //==========================================================================
+    /** Drops every block rendered and starts again from a position.  The
+        caller must hold the lock. */
+    void restart (const Optional<AudioPlayHead::PositionInfo>& position, double sampleRate) noexcept;
+
+    /** True if a block is free to render in to */
+    bool canWrite() const noexcept
+    {
+        return samplesRead.load (std::memory_order_acquire) >= (blocksWritten.load (std::memory_order_relaxed) + 1 - numSlots) * blockSize;
+    }
+
+    /** Renders the next block with the program.  The caller must hold the
+        lock and check there's room with canWrite() first. */
+    void renderNextBlock() noexcept;
+
+    /** Writes a block of an audio port, called by the program's ops */
+    template <typename SampleType>
+    void write (int index, const SampleType* src, bool silent) noexcept;
+
+    /** Writes a block of a MIDI port, called by the program's ops */
+    void writeMidi (int index, const MidiBuffer& src);
+
+    /** Returns the transport position of the block being rendered by the
+        calling thread, or nullptr if it isn't rendering ahead. */
+    static const AudioPlayHead::PositionInfo* getRenderPosition() noexcept;
+
+private:
+    friend class LookAheadRenderer;
+    const int numBlocks;
+    const int numSlots;
+    int blockSize = 1;
+    int numAudio = 0, numMidi = 0;
+
+    SortedSet<uint32> nodes;
+    Array<Port> ports;
+    std::unique_ptr<RenderProgram> program;
+
+    // one channel per audio port and slot, in the program's precision
+    AudioSampleBuffer audioSlots;
+    AudioBuffer<double> doubleSlots;
+    HeapBlock<bool> silentSlots;
+    OwnedArray<MidiEventBuffer> midiSlots;
+
+    std::atomic<int64> blocksWritten { 0 };
+    std::atomic<int64> samplesRead { 0 };
+
+    // where the transport was when rendering (re)started
+    Optional<AudioPlayHead::PositionInfo> start;
+    int64 startSample = 0;
+    double sampleRate = 44100.0;
+    AudioPlayHead::PositionInfo renderPosition;
+    bool releaseNotes = false;
+
+    // set on the audio thread for a block which wasn't ready to read
+    bool skipped = false;
+
+    // held while a block is rendered, and the renderer last targeting this
+    SpinLock lock;
+    LookAheadRenderer* renderer = nullptr;
+
+    Optional<AudioPlayHead::PositionInfo> getPositionAt (int64 sample) const noexcept;
+    int getSlot (int64 sample) const noexcept { return (int) ((sample / blockSize) % numSlots); }
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (LookAhead)
+};
+
+//==============================================================================
+/** Renders the blocks of a LookAhead on a background thread, and on the
+    audio thread when the background thread falls behind.
+ */
+class LookAheadRenderer : private Thread
+{
+public:
+    LookAheadRenderer();
+    ~LookAheadRenderer();
+
+    /** Starts or stops the background thread.  Not realtime safe. */
+    void setEnabled (bool shouldBeEnabled);
+
+    /** Changes the look-ahead rendered.  This doesn't wait, the background
+        thread picks up the new one between blocks and the old one waits for
+        a block in progress when it's deleted.  Look-aheads which have been
+        targeted must be deleted before the renderer.
+     */
+    void setTarget (LookAhead* newTarget) noexcept;
+
+    /** Makes sure the next numSamples of the target are ready to read,
+        rendering what's missing on the calling thread.  Blocks rendered for
+        a different transport position are dropped first.
+
+        This never waits for the background thread.  If it's rendering a
+        block the ports read silence and nothing is read, which counts as an
+        underrun.
+     */
+    void beginRead (const Optional<AudioPlayHead::PositionInfo>& position, double sampleRate, int numSamples) noexcept;
+
+    /** Marks numSamples read and wakes the background thread */
+    void endRead (int numSamples) noexcept;
+
+    /** Returns the number of blocks the target wasn't ready for */
+    int getNumUnderruns() const noexcept { return underruns.load (std::memory_order_relaxed); }
+
+private:
+    friend class LookAhead;
+    std::atomic<LookAhead*> target { nullptr };
+
+    // the look-ahead the background thread is rendering, if any
+    std::atomic<LookAhead*> busy { nullptr };
+    Semaphore wakeup;
+    std::atomic<int> underruns { 0 };
+
+    void run() override;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (LookAheadRenderer)
+};
+
+} // namespace element
@@ -94,12 +94,8 @@ struct MidiNoteControllerMap : public ControllerMapHandler,
     {
         const bool isInverse = inverse.get() == 1;
 
-        {
-            SpinLock::ScopedLockType sl (eventLock);
-            lastEvent = message;
-        }
-
         jassert (message.isNoteOnOrOff());
+        lastNoteOn.set (message.isNoteOn() ? 1 : 0);
 
         if (parameter != nullptr)
         {
@@ -124,12 +120,7 @@ struct MidiNoteControllerMap : public ControllerMapHandler,
 
     void handleAsyncUpdate() override
     {
-        MidiMessage event;
-
-        {
-            SpinLock::ScopedLockType sl (eventLock);
-            event = lastEvent;
-        }
+        const bool isNoteOn = lastNoteOn.get() == 1;
 
         if (momentary.get() == 0)
         {
@@ -150,23 +141,22 @@ struct MidiNoteControllerMap : public ControllerMapHandler,
         }
         else
         {
-            jassert (event.isNoteOnOrOff());
-            // DBG("async note off: " << (int) event.isNoteOff());
+            // DBG("async note off: " << (int) ! isNoteOn);
             const bool isInverse = inverse.get() == 1;
 
             if (parameterIndex == NodeObject::EnabledParameter)
             {
-                node->setEnabled (isInverse ? event.isNoteOff() : event.isNoteOn());
+                node->setEnabled (isInverse ? ! isNoteOn : isNoteOn);
                 model.setProperty (Tags::enabled, node->isEnabled());
             }
             else if (parameterIndex == NodeObject::BypassParameter)
             {
-                node->suspendProcessing (isInverse ? event.isNoteOn() : event.isNoteOff());
+                node->suspendProcessing (isInverse ? isNoteOn : ! isNoteOn);
                 model.setProperty (Tags::bypass, node->isSuspended());
             }
             else if (parameterIndex == NodeObject::MuteParameter)
             {
-                model.setMuted (isInverse ? event.isNoteOff() : event.isNoteOn());
+                model.setMuted (isInverse ? ! isNoteOn : isNoteOn);
             }
         }
     }
@@ -189,8 +179,8 @@ private:
 
     const int noteNumber;
 
-    SpinLock eventLock;
-    MidiMessage lastEvent;
+    // only notes are handled, so the last one is all the async update needs
+    Atomic<int> lastNoteOn { 0 };
 
     void valueChanged (Value& value) override
     {
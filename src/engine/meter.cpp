@@ -0,0 +1,157 @@
+/*
+    This file is part of Element
+    Copyright (C) 2021  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+
+#include "engine/meter.hpp"
+
+namespace element {
+
+namespace {
+/** The shared pass behind measureLevels() and applyGainAndMeasure(). With
+    ApplyGain the samples are scaled by a linear ramp, the same way
+    AudioBuffer::applyGainRamp does it, before being measured. */
+template <typename SampleType, bool ApplyGain>
+MeterLevels processLevels (SampleType* data, const int numSamples, const float startGain, const float endGain) noexcept
+{
+    using Vec = dsp::SIMDRegister<SampleType>;
+    using Mask = typename Vec::vMaskType;
+    static constexpr int width = (int) Vec::SIMDNumElements;
+
+    MeterLevels levels;
+    if (numSamples <= 0)
+        return levels;
+
+    const auto start = (SampleType) startGain;
+    const auto increment = ((SampleType) endGain - start) / (SampleType) numSamples;
+    SampleType high = 0, low = 0, sum = 0;
+    int clips = 0;
+
+    auto processSample = [&] (const int index) noexcept {
+        auto sample = data[index];
+        if (ApplyGain)
+            data[index] = sample *= start + increment * (SampleType) index;
+        high = jmax (high, sample);
+        low = jmin (low, sample);
+        sum += sample * sample;
+        if (sample > SampleType (1) || sample < SampleType (-1))
+            ++clips;
+    };
+
+    int i = 0;
+    for (; i < numSamples && ! Vec::isSIMDAligned (data + i); ++i)
+        processSample (i);
+
+    if (numSamples - i >= width)
+    {
+        const auto one = Vec::expand (SampleType (1));
+        const auto minusOne = Vec::expand (SampleType (-1));
+        auto vhigh = Vec::expand (SampleType (0));
+        auto vlow = Vec::expand (SampleType (0));
+        auto vsum = Vec::expand (SampleType (0));
+        auto vclips = Mask::expand (0);
+
+        auto laneRamp = Vec::expand (SampleType (0));
+        for (size_t lane = 0; lane < Vec::SIMDNumElements; ++lane)
+            laneRamp.set (lane, increment * (SampleType) lane);
+
+        for (; i + width <= numSamples; i += width)
+        {
+            auto samples = Vec::fromRawArray (data + i);
+            if (ApplyGain)
+            {
+                samples *= laneRamp + (start + increment * (SampleType) i);
+                samples.copyToRawArray (data + i);
+            }
+
+            vhigh = Vec::max (vhigh, samples);
+            vlow = Vec::min (vlow, samples);
+            vsum += samples * samples;
+
+            // comparisons set true lanes to all ones, which is -1
+            vclips -= Vec::greaterThan (samples, one);
+            vclips -= Vec::lessThan (samples, minusOne);
+        }
+
+        for (size_t lane = 0; lane < Vec::SIMDNumElements; ++lane)
+        {
+            high = jmax (high, vhigh.get (lane));
+            low = jmin (low, vlow.get (lane));
+        }
+
+        sum += vsum.sum();
+        clips += (int) vclips.sum();
+    }
+
+    for (; i < numSamples; ++i)
+        processSample (i);
+
+    levels.peak = (float) jmax (high, -low);
+    levels.rms = (float) std::sqrt (sum / (SampleType) numSamples);
+    levels.clips = clips;
+    return levels;
+}
+
+template <typename SampleType>
+MeterLevels processGain (SampleType* data, const int numSamples, const float startGain, const float endGain) noexcept
+{
+    if (startGain == 0.f && endGain == 0.f)
+    {
+        FloatVectorOperations::clear (data, numSamples);
+        return {};
+    }
+
+    if (startGain == 1.f && endGain == 1.f)
+        return processLevels<SampleType, false> (data, numSamples, 1.f, 1.f);
+
+    return processLevels<SampleType, true> (data, numSamples, startGain, endGain);
+}
+} // namespace
+
+// nothing is written without a gain to apply
+MeterLevels measureLevels (const float* data, int numSamples) noexcept { return processLevels<float, false> (const_cast<float*> (data), numSamples, 1.f, 1.f); }
+MeterLevels measureLevels (const double* data, int numSamples) noexcept { return processLevels<double, false> (const_cast<double*> (data), numSamples, 1.f, 1.f); }
+
+MeterLevels applyGainAndMeasure (float* data, int numSamples, float startGain, float endGain) noexcept { return processGain (data, numSamples, startGain, endGain); }
+MeterLevels applyGainAndMeasure (double* data, int numSamples, float startGain, float endGain) noexcept { return processGain (data, numSamples, startGain, endGain); }
+
+//==============================================================================
+void MeterBlock::resize (int numInputs, int numOutputs)
+{
+    numInputs = jmax (0, numInputs);
+    numOutputs = jmax (0, numOutputs);
+
+    if (numInputs + numOutputs != numIns + numOuts)
+        channels.reset (numInputs + numOutputs > 0 ? new Channel[(size_t) (numInputs + numOutputs)] : nullptr);
+
+    numIns = numInputs;
+    numOuts = numOutputs;
+    clear();
+}
+
+void MeterBlock::clear() noexcept
+{
+    for (int i = 0; i < numIns + numOuts; ++i)
+    {
+        channels[i].peak.store (0.f, std::memory_order_relaxed);
+        channels[i].rms.store (0.f, std::memory_order_relaxed);
+        channels[i].clips.store (0, std::memory_order_relaxed);
+    }
+}
+
+} // namespace element
@@ -0,0 +1,135 @@
+/*
+    This file is part of Element
+    Copyright (C) 2021  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+
+
+#pragma once
+
+#include "JuceHeader.h"
+
+namespace element {
+
+/** Levels of one channel over one block */
+struct MeterLevels
+{
+    float peak = 0.f;
+    float rms = 0.f;
+    int clips = 0;
+};
+
+/** Measures the peak, RMS and number of clipped samples of a channel in a
+    single SIMD pass. */
+MeterLevels measureLevels (const float* data, int numSamples) noexcept;
+MeterLevels measureLevels (const double* data, int numSamples) noexcept;
+
+/** Scales a channel by a gain ramping from startGain to endGain and
+    measures the result, both in the same pass.  The ramp matches
+    AudioBuffer::applyGainRamp(). */
+MeterLevels applyGainAndMeasure (float* data, int numSamples, float startGain, float endGain) noexcept;
+MeterLevels applyGainAndMeasure (double* data, int numSamples, float startGain, float endGain) noexcept;
+
+/** Returns true if every sample is zero.  Cheaper than measuring levels,
+    used when nobody is watching the meters. */
+template <typename SampleType>
+bool isSilent (const SampleType* data, int numSamples) noexcept
+{
+    const auto range = FloatVectorOperations::findMinAndMax (data, numSamples);
+    return range.getStart() == SampleType (0) && range.getEnd() == SampleType (0);
+}
+
+/** Meters for a node's input and output channels, kept in one allocation.
+
+    The audio thread writes levels, any thread can read them.  Clip counts
+    accumulate until reset.  Resizing isn't realtime safe.
+ */
+class MeterBlock
+{
+public:
+    MeterBlock() = default;
+
+    /** Sets the number of channels and clears all levels */
+    void resize (int numInputs, int numOutputs);
+
+    /** Resets every level and clip count to zero */
+    void clear() noexcept;
+
+    int getNumInputs() const noexcept { return numIns; }
+    int getNumOutputs() const noexcept { return numOuts; }
+
+    /** Sets the levels of a channel.  Ports can change after the meters
+        were sized, channels out of range are ignored.
+     */
+    void setInput (int channel, const MeterLevels& levels) noexcept
+    {
+        if (isPositiveAndBelow (channel, numIns))
+            set (channel, levels);
+    }
+
+    void setOutput (int channel, const MeterLevels& levels) noexcept
+    {
+        if (isPositiveAndBelow (channel, numOuts))
+            set (numIns + channel, levels);
+    }
+
+    /** Zeros the input levels, clip counts are kept */
+    void clearInputs() noexcept { clearRange (0, numIns); }
+    /** Zeros the output levels, clip counts are kept */
+    void clearOutputs() noexcept { clearRange (numIns, numOuts); }
+
+    float getInputRMS (int channel) const noexcept { return isPositiveAndBelow (channel, numIns) ? channels[channel].rms.load (std::memory_order_relaxed) : 0.f; }
+    float getInputPeak (int channel) const noexcept { return isPositiveAndBelow (channel, numIns) ? channels[channel].peak.load (std::memory_order_relaxed) : 0.f; }
+    int getInputClips (int channel) const noexcept { return isPositiveAndBelow (channel, numIns) ? channels[channel].clips.load (std::memory_order_relaxed) : 0; }
+
+    float getOutputRMS (int channel) const noexcept { return isPositiveAndBelow (channel, numOuts) ? channels[numIns + channel].rms.load (std::memory_order_relaxed) : 0.f; }
+    float getOutputPeak (int channel) const noexcept { return isPositiveAndBelow (channel, numOuts) ? channels[numIns + channel].peak.load (std::memory_order_relaxed) : 0.f; }
+    int getOutputClips (int channel) const noexcept { return isPositiveAndBelow (channel, numOuts) ? channels[numIns + channel].clips.load (std::memory_order_relaxed) : 0; }
+
+private:
+    struct Channel
+    {
+        std::atomic<float> peak { 0.f };
+        std::atomic<float> rms { 0.f };
+        std::atomic<int> clips { 0 };
+    };
+
+    std::unique_ptr<Channel[]> channels;
+    int numIns = 0, numOuts = 0;
+
+    void set (int index, const MeterLevels& levels) noexcept
+    {
+        auto& channel = channels[index];
+        channel.peak.store (levels.peak, std::memory_order_relaxed);
+        channel.rms.store (levels.rms, std::memory_order_relaxed);
+        if (levels.clips > 0)
+            channel.clips.fetch_add (levels.clips, std::memory_order_relaxed);
+    }
+
+    void clearRange (int start, int num) noexcept
+    {
+        for (int i = start; i < start + num; ++i)
+        {
+            channels[i].peak.store (0.f, std::memory_order_relaxed);
+            channels[i].rms.store (0.f, std::memory_order_relaxed);
+        }
+    }
+
+    JUCE_DECLARE_NON_COPYABLE (MeterBlock)
+};
+
+} // namespace element
@@ -18,6 +18,7 @@
 */
 
 #include "engine/midiengine.hpp"
+#include "engine/renderguard.hpp"
 #include "settings.hpp"
 
 namespace element {
@@ -58,7 +59,7 @@ void MidiEngine::writeSettings (Settings& settings)
     {
         ValueTree input ("input");
         input.setProperty (Tags::name, holder->input->getName(), nullptr)
-            .setProperty (Tags::active, holder->active, nullptr);
+            .setProperty (Tags::active, holder->active.load(), nullptr);
         data.appendChild (input, nullptr);
     }
 
@@ -140,6 +141,10 @@ void MidiEngine::MidiInputHolder::handleIncomingMidiMessage (MidiInput* source,
         return;
 
     jassert (source == input.get());
+    if (active)
+        queue.push (message);
+
+    EL_ASSERT_NOT_RENDERING();
     const ScopedLock sl (engine.midiCallbackLock);
 
     for (auto& mc : engine.midiCallbacks)
@@ -155,6 +160,8 @@ MidiEngine::MidiEngine()
 
 MidiEngine::~MidiEngine()
 {
+    outputScheduler.setOutput (nullptr);
+    numInputQueues.store (0);
     callbackHandler.reset (nullptr);
 }
 
@@ -177,6 +184,18 @@ MidiEngine::MidiInputHolder* MidiEngine::getMidiInput (const String& deviceName,
         {
             holder->input.reset (midiIn.release());
             holder->input->start();
+
+            const int numQueues = numInputQueues.load (std::memory_order_relaxed);
+            if (numQueues < maxInputQueues)
+            {
+                inputQueues[numQueues] = &holder->queue;
+                numInputQueues.store (numQueues + 1, std::memory_order_release);
+            }
+            else
+            {
+                jassertfalse; // the audio engine won't hear this one
+            }
+
             return openMidiInputs.add (holder.release());
         }
     }
@@ -230,6 +249,7 @@ void MidiEngine::addMidiInputCallback (const String& name, MidiInputCallback* ca
         mc.callback = callbackToAdd;
         mc.consumer = consumer;
 
+        EL_ASSERT_NOT_RENDERING();
         const ScopedLock sl (midiCallbackLock);
         midiCallbacks.add (mc);
     }
@@ -243,6 +263,7 @@ void MidiEngine::removeMidiInputCallback (const String& name, MidiInputCallback*
 
         if (mc.callback == callbackToRemove && mc.deviceName == name)
         {
+            EL_ASSERT_NOT_RENDERING();
             const ScopedLock sl (midiCallbackLock);
             midiCallbacks.remove (i);
         }
@@ -257,6 +278,7 @@ void MidiEngine::removeMidiInputCallback (MidiInputCallback* callbackToRemove)
 
         if (mc.callback == callbackToRemove)
         {
+            EL_ASSERT_NOT_RENDERING();
             const ScopedLock sl (midiCallbackLock);
             midiCallbacks.remove (i);
         }
@@ -267,6 +289,7 @@ void MidiEngine::handleIncomingMidiMessageInt (MidiInput* source, const MidiMess
 {
     if (! message.isActiveSense())
     {
+        EL_ASSERT_NOT_RENDERING();
         const ScopedLock sl (midiCallbackLock);
 
         for (auto& mc : midiCallbacks)
@@ -282,7 +305,11 @@ void MidiEngine::processMidiBuffer (const MidiBuffer& buffer, int nframes, doubl
     int frame = 0;
     const double timeNow = 1.5 + Time::getMillisecondCounterHiRes();
 
-    const ScopedLock sl (midiCallbackLock);
+    // called while rendering, so a block arriving while the callbacks change
+    // isn't passed on
+    const ScopedTryLock sl (midiCallbackLock);
+    if (! sl.isLocked())
+        return;
 
     while (iter.getNextEvent (message, frame))
     {
@@ -295,6 +322,18 @@ void MidiEngine::processMidiBuffer (const MidiBuffer& buffer, int nframes, doubl
     }
 }
 
+void MidiEngine::collectMidiInput (MidiBuffer& dest, const MidiBlockClock& clock, const int numSamples) noexcept
+{
+    const int numQueues = numInputQueues.load (std::memory_order_acquire);
+    for (int i = 0; i < numQueues; ++i)
+        inputQueues[i]->collect (dest, clock, numSamples);
+}
+
+void MidiEngine::sendMidiOutput (const MidiBuffer& messages, const double blockTime, const double samplePeriod) noexcept
+{
+    outputScheduler.addBlock (messages, blockTime, samplePeriod);
+}
+
 int MidiEngine::getNumActiveMidiInputs() const
 {
     int total = 0;
@@ -316,17 +355,9 @@ void MidiEngine::setDefaultMidiOutput (const String& deviceName)
 
         if (newMidiOut)
         {
-            newMidiOut->startBackgroundThread();
-            {
-                ScopedLock sl (midiOutputLock);
-                defaultMidiOutput.swap (newMidiOut);
-            }
-
-            if (newMidiOut) // is now the old output
-            {
-                newMidiOut->stopBackgroundThread();
-                newMidiOut.reset();
-            }
+            outputScheduler.setOutput (newMidiOut.get());
+            defaultMidiOutput.swap (newMidiOut);
+            newMidiOut.reset(); // is now the old output, the scheduler is done with it
         }
 
         defaultMidiOutputName = deviceName;
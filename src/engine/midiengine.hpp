@@ -18,6 +18,8 @@
 */
 
 #include "JuceHeader.h"
+#include "engine/midiinputqueue.hpp"
+#include "engine/midioutputscheduler.hpp"
 
 #pragma once
 
@@ -114,9 +116,26 @@ public:
     */
     MidiOutput* getDefaultMidiOutput() const noexcept { return defaultMidiOutput.get(); }
 
+    /** Returns true if there's a default output to send to.  Realtime safe. */
+    bool hasDefaultMidiOutput() const noexcept { return outputScheduler.hasOutput(); }
+
+    /** Queues a block of messages for the default output, sent by the output
+        scheduler's thread when each is due.  Audio thread only.
+
+        @param messages     The block, by sample offset
+        @param blockTime    System time in seconds the block's first sample
+                            is heard
+        @param samplePeriod Length of a sample in system time
+     */
+    void sendMidiOutput (const MidiBuffer& messages, double blockTime, double samplePeriod) noexcept;
+
     void processMidiBuffer (const MidiBuffer& buffer, int nframes, double sampleRate);
 
-    CriticalSection& getMidiOutputLock() { return midiOutputLock; }
+    /** Adds the messages from enabled inputs which arrived in the span of the
+        clock's block, at the offsets they arrived at.  Audio thread only, this
+        doesn't lock against the threads the devices deliver on.
+     */
+    void collectMidiInput (MidiBuffer& dest, const MidiBlockClock& clock, int numSamples) noexcept;
 
 private:
     struct MidiCallbackInfo
@@ -138,7 +157,8 @@ private:
             : engine (e) {}
 
         std::unique_ptr<MidiInput> input;
-        bool active = false; // if true, then will feed to audio engine
+        std::atomic<bool> active { false }; // if true, then will feed to audio engine
+        MidiInputQueue queue;
 
         void handleIncomingMidiMessage (MidiInput* source, const MidiMessage& message) override;
 
@@ -148,11 +168,18 @@ private:
 
     StringArray midiInsFromXml;
     OwnedArray<MidiInputHolder> openMidiInputs;
+
+    // inputs are only closed with the engine, so the audio thread reads the
+    // queues of the first numInputQueues without locking
+    static constexpr int maxInputQueues = 64;
+    MidiInputQueue* inputQueues[maxInputQueues] {};
+    std::atomic<int> numInputQueues { 0 };
     Array<MidiCallbackInfo> midiCallbacks;
 
     String defaultMidiOutputName;
     std::unique_ptr<MidiOutput> defaultMidiOutput;
-    CriticalSection audioCallbackLock, midiCallbackLock, midiOutputLock;
+    MidiOutputScheduler outputScheduler;
+    CriticalSection audioCallbackLock, midiCallbackLock;
 
     class CallbackHandler;
     std::unique_ptr<CallbackHandler> callbackHandler;
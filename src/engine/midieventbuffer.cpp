@@ -0,0 +1,178 @@
+/*
+    This file is part of Element
+    Copyright (C) 2021  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+
+
+#include "engine/midieventbuffer.hpp"
+
+namespace element {
+
+//==============================================================================
+void MidiEventBuffer::View::addTo (MidiBuffer& dest, const int frameOffset) const
+{
+    for (const auto& event : *this)
+        appendMidiEvent (dest, getData (event), event.size, event.frame + frameOffset);
+}
+
+//==============================================================================
+MidiEventBuffer::MidiEventBuffer (const int maxEvents, const int maxSysExBytes)
+    : capacity (jmax (1, maxEvents)),
+      arenaSize (jmax (0, maxSysExBytes))
+{
+    events.malloc ((size_t) capacity);
+    arena.malloc ((size_t) jmax (1, arenaSize));
+}
+
+MidiEventBuffer::~MidiEventBuffer() {}
+
+bool MidiEventBuffer::append (const uint8* data, const int size, const int frame) noexcept
+{
+    if (numEvents >= capacity || size <= 0)
+        return false;
+
+    auto& event = events[numEvents];
+    event.frame = frame;
+    event.size = size;
+
+    if (size <= 4)
+    {
+        std::memcpy (event.bytes, data, (size_t) size);
+    }
+    else
+    {
+        if (arenaUsed + size > arenaSize)
+            return false;
+        event.offset = arenaUsed;
+        std::memcpy (arena + arenaUsed, data, (size_t) size);
+        arenaUsed += size;
+    }
+
+    ++numEvents;
+    return true;
+}
+
+bool MidiEventBuffer::addEvent (const uint8* data, const int size, const int frame) noexcept
+{
+    if (numEvents == 0 || events[numEvents - 1].frame <= frame)
+        return append (data, size, frame);
+
+    // out of order, append then move it back past later events
+    if (! append (data, size, frame))
+        return false;
+
+    const auto event = events[numEvents - 1];
+    auto* const first = events.get();
+    auto* const pos = std::upper_bound (first, first + numEvents - 1, frame, [] (int f, const Event& e) { return f < e.frame; });
+    std::move_backward (pos, first + numEvents - 1, first + numEvents);
+    *pos = event;
+    return true;
+}
+
+void MidiEventBuffer::addEvents (const View& source, const int frameOffset) noexcept
+{
+    for (const auto& event : source)
+        if (! addEvent (source.getData (event), event.size, event.frame + frameOffset))
+            break;
+}
+
+void MidiEventBuffer::merge (const View& a, const View& b, const int frameOffset) noexcept
+{
+    jassert (a.buffer != this && b.buffer != this);
+    clear();
+
+    auto ia = a.begin();
+    auto ib = b.begin();
+    while (ia != a.end() || ib != b.end())
+    {
+        const bool takeA = ib == b.end() || (ia != a.end() && ia->frame <= ib->frame);
+        const auto& view = takeA ? a : b;
+        const auto& event = takeA ? *ia++ : *ib++;
+        if (! append (view.getData (event), event.size, event.frame + frameOffset))
+            break;
+    }
+}
+
+MidiEventBuffer::View MidiEventBuffer::getView (const int startFrame, const int numFrames) const noexcept
+{
+    const auto byFrame = [] (const Event& e, int f) { return e.frame < f; };
+    const auto* const first = std::lower_bound (begin(), end(), startFrame, byFrame);
+    const auto* const last = std::lower_bound (first, end(), startFrame + numFrames, byFrame);
+    return { this, first, last };
+}
+
+void MidiEventBuffer::copyFrom (const MidiBuffer& source) noexcept
+{
+    clear();
+    for (const auto metadata : source)
+        if (! append (metadata.data, metadata.numBytes, metadata.samplePosition))
+            break;
+}
+
+//==============================================================================
+void appendMidiEvent (MidiBuffer& dest, const uint8* data, const int size, const int frame)
+{
+    // same layout as MidiBuffer::addEvent: sample position, size, then the bytes
+    const auto time = (int32) frame;
+    const auto numBytes = (uint16) size;
+    auto& raw = dest.data;
+    raw.ensureStorageAllocated (raw.size() + (int) (sizeof (time) + sizeof (numBytes)) + size);
+    raw.addArray (reinterpret_cast<const uint8*> (&time), (int) sizeof (time));
+    raw.addArray (reinterpret_cast<const uint8*> (&numBytes), (int) sizeof (numBytes));
+    raw.addArray (data, size);
+}
+
+void copyMidiEvents (const MidiBuffer& source, MidiBuffer& dest)
+{
+    dest.data.clearQuick();
+    dest.data.addArray (source.data);
+}
+
+void mergeMidiEvents (MidiBuffer& dest, const MidiBuffer& source, MidiBuffer& scratch, const int numSamples)
+{
+    if (source.isEmpty())
+        return;
+
+    scratch.data.clearQuick();
+
+    auto a = dest.cbegin();
+    auto b = source.cbegin();
+    const auto aEnd = dest.cend();
+    const auto bEnd = source.cend();
+
+    while (a != aEnd || b != bEnd)
+    {
+        if (b != bEnd && ((*b).samplePosition < 0 || (*b).samplePosition >= numSamples))
+        {
+            ++b;
+            continue;
+        }
+
+        const bool takeA = b == bEnd || (a != aEnd && (*a).samplePosition <= (*b).samplePosition);
+        const auto metadata = takeA ? *a : *b;
+        appendMidiEvent (scratch, metadata.data, metadata.numBytes, metadata.samplePosition);
+        if (takeA)
+            ++a;
+        else
+            ++b;
+    }
+
+    dest.swapWith (scratch);
+}
+
+} // namespace element
@@ -0,0 +1,158 @@
+/*
+    This file is part of Element
+    Copyright (C) 2021  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+
+
+#pragma once
+
+#include "JuceHeader.h"
+
+namespace element {
+
+/** A preallocated buffer of timestamped MIDI events, kept in order of time.
+
+    Messages of up to four bytes are stored in the event itself, longer ones
+    (SysEx) in a side arena, so a buffer of note and controller data is one
+    flat array.  Nothing allocates after construction: adding to a full
+    buffer drops the event and returns false.  Appending in order takes
+    constant time, sorted streams merge in one pass and a View reads a range
+    of frames without copying.
+ */
+class MidiEventBuffer
+{
+public:
+    struct Event
+    {
+        int frame;
+        int size;
+        union
+        {
+            uint8 bytes[4]; // size <= 4
+            int offset; // in the arena otherwise
+        };
+    };
+
+    /** A range of events in a buffer, valid until the buffer changes */
+    class View
+    {
+    public:
+        View() = default;
+
+        const Event* begin() const noexcept { return first; }
+        const Event* end() const noexcept { return last; }
+        int size() const noexcept { return (int) (last - first); }
+        bool isEmpty() const noexcept { return first == last; }
+
+        /** Returns the bytes of an event in the view */
+        const uint8* getData (const Event& event) const noexcept { return buffer->getData (event); }
+
+        /** Appends the events to a MidiBuffer, moved by frameOffset.  They
+            must go after any events already in it. */
+        void addTo (MidiBuffer& dest, int frameOffset = 0) const;
+
+    private:
+        friend class MidiEventBuffer;
+        View (const MidiEventBuffer* b, const Event* f, const Event* l) noexcept
+            : buffer (b), first (f), last (l) {}
+
+        const MidiEventBuffer* buffer = nullptr;
+        const Event* first = nullptr;
+        const Event* last = nullptr;
+    };
+
+    /** Creates a buffer holding up to maxEvents, and up to maxSysExBytes of
+        messages longer than four bytes. */
+    explicit MidiEventBuffer (int maxEvents = 1024, int maxSysExBytes = 8192);
+    ~MidiEventBuffer();
+
+    //==========================================================================
+    /** Removes every event, keeping the storage */
+    void clear() noexcept
+    {
+        numEvents = 0;
+        arenaUsed = 0;
+    }
+
+    int size() const noexcept { return numEvents; }
+    bool isEmpty() const noexcept { return numEvents == 0; }
+    int getCapacity() const noexcept { return capacity; }
+
+    const Event* begin() const noexcept { return events.get(); }
+    const Event* end() const noexcept { return events.get() + numEvents; }
+
+    /** Returns the bytes of an event */
+    const uint8* getData (const Event& event) const noexcept
+    {
+        return event.size <= 4 ? event.bytes : arena.get() + event.offset;
+    }
+
+    //==========================================================================
+    /** Adds an event after any others at the same frame.  Returns false if
+        the buffer is full. */
+    bool addEvent (const uint8* data, int size, int frame) noexcept;
+    bool addEvent (const MidiMessage& message, int frame) noexcept
+    {
+        return addEvent (message.getRawData(), message.getRawDataSize(), frame);
+    }
+
+    /** Adds the events of a view, moved by frameOffset */
+    void addEvents (const View& source, int frameOffset = 0) noexcept;
+
+    /** Replaces the contents with two views merged in one pass, moved by
+        frameOffset.  Events of a go before events of b at the same frame.
+        Neither may be a view of this buffer.
+     */
+    void merge (const View& a, const View& b, int frameOffset = 0) noexcept;
+
+    /** Returns a view of every event */
+    View getView() const noexcept { return { this, begin(), end() }; }
+
+    /** Returns a view of the events in a range of frames */
+    View getView (int startFrame, int numFrames) const noexcept;
+
+    //==========================================================================
+    /** Replaces the contents with the events of a MidiBuffer */
+    void copyFrom (const MidiBuffer& source) noexcept;
+
+private:
+    const int capacity, arenaSize;
+    HeapBlock<Event> events;
+    HeapBlock<uint8> arena;
+    int numEvents = 0;
+    int arenaUsed = 0;
+
+    bool append (const uint8* data, int size, int frame) noexcept;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MidiEventBuffer)
+};
+
+//==============================================================================
+/** Appends an event to a MidiBuffer without searching for its place, which
+    is after every event already in it. */
+void appendMidiEvent (MidiBuffer& dest, const uint8* data, int size, int frame);
+
+/** Copies a MidiBuffer, reusing the destination's storage */
+void copyMidiEvents (const MidiBuffer& source, MidiBuffer& dest);
+
+/** Merges the events of source in [0, numSamples) in to dest in one pass.
+    The result is built in scratch and swapped with dest.
+ */
+void mergeMidiEvents (MidiBuffer& dest, const MidiBuffer& source, MidiBuffer& scratch, int numSamples);
+
+} // namespace element
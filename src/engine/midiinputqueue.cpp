@@ -0,0 +1,167 @@
+/*
+    This file is part of Element
+    Copyright (C) 2021  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+
+
+#include "engine/midiinputqueue.hpp"
+
+namespace element {
+
+namespace {
+struct EventHeader
+{
+    double time;
+    int size;
+};
+
+// how quickly the clock follows the callbacks, lower is smoother
+constexpr double clockBandwidth = 0.5;
+} // namespace
+
+//==============================================================================
+void MidiBlockClock::reset (const double newSampleRate, const int blockSize) noexcept
+{
+    sampleRate = newSampleRate > 0.0 ? newSampleRate : 44100.0;
+    samplePeriod = 1.0 / sampleRate;
+
+    const double blockPeriod = jmax (1, blockSize) * samplePeriod;
+    const double omega = MathConstants<double>::twoPi * clockBandwidth * blockPeriod;
+    b = MathConstants<double>::sqrt2 * omega;
+    c = omega * omega;
+
+    // anything past scheduling jitter means the callbacks stalled
+    resetThreshold = jmax (0.01, 2.0 * blockPeriod);
+    running = false;
+    restarted = true;
+}
+
+void MidiBlockClock::advance (const double now, const int numSamples) noexcept
+{
+    const double error = now - nextTime;
+    restarted = ! running || std::abs (error) > resetThreshold;
+
+    if (restarted)
+    {
+        samplePeriod = 1.0 / sampleRate;
+        endTime = now;
+        nextTime = now + numSamples * samplePeriod;
+        running = true;
+    }
+    else
+    {
+        endTime = nextTime;
+        nextTime += b * error + numSamples * samplePeriod;
+        if (numSamples > 0)
+            samplePeriod += c * error / numSamples;
+    }
+
+    startTime = endTime - numSamples * samplePeriod;
+}
+
+//==============================================================================
+MidiInputQueue::MidiInputQueue (const int capacityInBytes)
+    : capacity (jmax (256, capacityInBytes)),
+      fifo (capacity)
+{
+    data.calloc ((size_t) capacity);
+    scratch.calloc ((size_t) capacity);
+}
+
+MidiInputQueue::~MidiInputQueue() {}
+
+void MidiInputQueue::write (const int index, const void* src, const int numBytes) noexcept
+{
+    const int first = jmin (numBytes, capacity - index);
+    memcpy (data + index, src, (size_t) first);
+    memcpy (data, static_cast<const uint8*> (src) + first, (size_t) (numBytes - first));
+}
+
+void MidiInputQueue::read (const int index, void* dest, const int numBytes) const noexcept
+{
+    const int first = jmin (numBytes, capacity - index);
+    memcpy (dest, data + index, (size_t) first);
+    memcpy (static_cast<uint8*> (dest) + first, data, (size_t) (numBytes - first));
+}
+
+bool MidiInputQueue::push (const MidiMessage& message) noexcept
+{
+    EventHeader header;
+    header.size = message.getRawDataSize();
+    const int total = (int) sizeof (EventHeader) + header.size;
+    if (header.size <= 0 || fifo.getFreeSpace() < total)
+        return false;
+
+    // devices which don't stamp messages, or not on the system clock
+    const double now = Time::getMillisecondCounterHiRes() * 0.001;
+    header.time = message.getTimeStamp();
+    if (! (header.time > now - 1.0 && header.time <= now))
+        header.time = now;
+
+    int start1, size1, start2, size2;
+    fifo.prepareToWrite (total, start1, size1, start2, size2);
+    write (start1, &header, (int) sizeof (EventHeader));
+    write ((start1 + (int) sizeof (EventHeader)) % capacity, message.getRawData(), header.size);
+    fifo.finishedWrite (total);
+    return true;
+}
+
+void MidiInputQueue::collect (MidiBuffer& dest, const MidiBlockClock& clock, const int numSamples) noexcept
+{
+    while (fifo.getNumReady() >= (int) sizeof (EventHeader))
+    {
+        int start1, size1, start2, size2;
+        fifo.prepareToRead ((int) sizeof (EventHeader), start1, size1, start2, size2);
+
+        EventHeader header;
+        read (start1, &header, (int) sizeof (EventHeader));
+        if (header.time >= clock.getEndTime())
+            break;
+
+        // late ones play at the top of the block, unless they were queued
+        // while the device wasn't running at all
+        if (! clock.wasRestarted() || header.time >= clock.getStartTime())
+        {
+            read ((start1 + (int) sizeof (EventHeader)) % capacity, scratch, header.size);
+            dest.addEvent (scratch, header.size, clock.getSampleOffset (header.time, numSamples));
+        }
+
+        fifo.finishedRead ((int) sizeof (EventHeader) + header.size);
+    }
+}
+
+int MidiInputQueue::collectAll (MidiBuffer& dest) noexcept
+{
+    int numCollected = 0;
+    while (fifo.getNumReady() >= (int) sizeof (EventHeader))
+    {
+        int start1, size1, start2, size2;
+        fifo.prepareToRead ((int) sizeof (EventHeader), start1, size1, start2, size2);
+
+        EventHeader header;
+        read (start1, &header, (int) sizeof (EventHeader));
+        read ((start1 + (int) sizeof (EventHeader)) % capacity, scratch, header.size);
+        dest.addEvent (scratch, header.size, 0);
+        fifo.finishedRead ((int) sizeof (EventHeader) + header.size);
+        ++numCollected;
+    }
+
+    return numCollected;
+}
+
+} // namespace element
@@ -0,0 +1,124 @@
+/*
+    This file is part of Element
+    Copyright (C) 2021  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+
+
+#pragma once
+
+#include "JuceHeader.h"
+
+namespace element {
+
+/** Follows the audio device's callbacks on the system clock, so events
+    timestamped by a MIDI device can be placed in a block by when they
+    arrived instead of by when the audio thread got to them.
+
+    Callback times jitter with scheduling, so they're smoothed with a second
+    order delay-locked loop which also tracks the drift between the audio
+    and system clocks.  Each block covers the span of system time which
+    ended at the (filtered) start of its callback, a constant one block
+    behind the device.
+ */
+class MidiBlockClock
+{
+public:
+    MidiBlockClock() = default;
+
+    /** Restarts the clock for a new device configuration */
+    void reset (double sampleRate, int blockSize) noexcept;
+
+    /** Call at the start of each audio callback with the system time in
+        seconds, e.g. Time::getMillisecondCounterHiRes() * 0.001
+     */
+    void advance (double now, int numSamples) noexcept;
+
+    /** Start of the span of system time the current block covers */
+    double getStartTime() const noexcept { return startTime; }
+
+    /** End of the span of system time the current block covers */
+    double getEndTime() const noexcept { return endTime; }
+
+    /** True if the clock (re)started this block, after a reset or a stall.
+        Anything timestamped before it began belongs to no block. */
+    bool wasRestarted() const noexcept { return restarted; }
+
+    /** Returns the offset in the current block of an event at a time */
+    int getSampleOffset (double time, int numSamples) const noexcept
+    {
+        return jlimit (0, jmax (0, numSamples - 1), (int) ((time - startTime) / samplePeriod));
+    }
+
+    /** Returns the estimated sample rate of the device in system time */
+    double getEstimatedSampleRate() const noexcept { return 1.0 / samplePeriod; }
+
+private:
+    double sampleRate = 44100.0;
+    double samplePeriod = 1.0 / 44100.0;
+    double b = 0.0, c = 0.0, resetThreshold = 0.0;
+    double startTime = 0.0, endTime = 0.0, nextTime = 0.0;
+    bool running = false;
+    bool restarted = true;
+};
+
+//==============================================================================
+/** Timestamped messages from a single MIDI input device, pushed by the
+    thread the device delivers on and collected by the audio thread with no
+    lock between them.  Any one producer and one consumer can use it the same
+    way, e.g. a node passing what it rendered to a timer.
+ */
+class MidiInputQueue
+{
+public:
+    /** Creates a queue holding up to capacityInBytes of messages and headers */
+    explicit MidiInputQueue (int capacityInBytes = 16384);
+    ~MidiInputQueue();
+
+    /** Adds a message, called from the device's thread only.  Messages
+        without a timestamp on the system clock are stamped as they arrive.
+        Returns false and drops the message if the queue is full.
+     */
+    bool push (const MidiMessage& message) noexcept;
+
+    /** Moves the messages which arrived in the span of the clock's block in
+        to a buffer at their sample offsets, called from the audio thread only.
+        Messages which arrived after it stay queued for the next block.
+     */
+    void collect (MidiBuffer& dest, const MidiBlockClock& clock, int numSamples) noexcept;
+
+    /** Moves every message queued in to a buffer at offset zero, in the
+        order they were pushed.  For consumers which aren't rendering, e.g.
+        a timer reading what a node saw.  Returns the number moved.
+     */
+    int collectAll (MidiBuffer& dest) noexcept;
+
+    /** Drops every message queued, called from the consumer's thread only */
+    void clear() noexcept { fifo.finishedRead (fifo.getNumReady()); }
+
+private:
+    const int capacity;
+    AbstractFifo fifo;
+    HeapBlock<uint8> data, scratch;
+
+    void write (int index, const void* src, int numBytes) noexcept;
+    void read (int index, void* dest, int numBytes) const noexcept;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MidiInputQueue)
+};
+
+} // namespace element
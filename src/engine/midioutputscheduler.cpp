@@ -0,0 +1,164 @@
+/*
+    This file is part of Element
+    Copyright (C) 2021  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+
+
+#include "engine/midioutputscheduler.hpp"
+#include "engine/renderguard.hpp"
+
+namespace element {
+
+namespace {
+struct EventHeader
+{
+    double time;
+    int size;
+};
+
+// longest the thread sleeps before checking if it should exit
+constexpr double maxSleepSeconds = 0.01;
+} // namespace
+
+MidiOutputScheduler::MidiOutputScheduler (const int capacityInBytes)
+    : Thread ("element: midi output"),
+      capacity (jmax (256, capacityInBytes)),
+      fifo (capacity)
+{
+    data.calloc ((size_t) capacity);
+    scratch.calloc ((size_t) capacity);
+}
+
+MidiOutputScheduler::~MidiOutputScheduler()
+{
+    setOutput (nullptr);
+}
+
+void MidiOutputScheduler::setOutput (MidiOutput* const newOutput)
+{
+    EL_ASSERT_NOT_RENDERING();
+    {
+        const ScopedLock sl (outputLock);
+        output.store (newOutput);
+        dropPending.store (true);
+    }
+
+    if (newOutput != nullptr && ! isThreadRunning())
+    {
+        startThread (9);
+    }
+    else if (newOutput == nullptr && isThreadRunning())
+    {
+        signalThreadShouldExit();
+        wakeup.post();
+        stopThread (1000);
+    }
+}
+
+//==============================================================================
+void MidiOutputScheduler::write (const int index, const void* src, const int numBytes) noexcept
+{
+    const int first = jmin (numBytes, capacity - index);
+    memcpy (data + index, src, (size_t) first);
+    memcpy (data, static_cast<const uint8*> (src) + first, (size_t) (numBytes - first));
+}
+
+void MidiOutputScheduler::read (const int index, void* dest, const int numBytes) const noexcept
+{
+    const int first = jmin (numBytes, capacity - index);
+    memcpy (dest, data + index, (size_t) first);
+    memcpy (static_cast<uint8*> (dest) + first, data, (size_t) (numBytes - first));
+}
+
+bool MidiOutputScheduler::push (const uint8* bytes, const int size, const double time) noexcept
+{
+    const int total = (int) sizeof (EventHeader) + size;
+    if (size <= 0 || fifo.getFreeSpace() < total)
+        return false;
+
+    EventHeader header;
+    header.time = time;
+    header.size = size;
+
+    int start1, size1, start2, size2;
+    fifo.prepareToWrite (total, start1, size1, start2, size2);
+    write (start1, &header, (int) sizeof (EventHeader));
+    write ((start1 + (int) sizeof (EventHeader)) % capacity, bytes, size);
+    fifo.finishedWrite (total);
+    return true;
+}
+
+void MidiOutputScheduler::addBlock (const MidiBuffer& messages, const double blockTime, const double samplePeriod) noexcept
+{
+    if (messages.isEmpty() || ! hasOutput())
+        return;
+
+    for (const auto metadata : messages)
+        if (! push (metadata.data, metadata.numBytes, blockTime + metadata.samplePosition * samplePeriod))
+            break;
+
+    wakeup.post();
+}
+
+//==============================================================================
+void MidiOutputScheduler::run()
+{
+    while (! threadShouldExit())
+    {
+        if (dropPending.exchange (false))
+            fifo.finishedRead (fifo.getNumReady());
+
+        if (fifo.getNumReady() < (int) sizeof (EventHeader))
+        {
+            // one wake up covers every block posted meanwhile
+            wakeup.wait();
+            while (wakeup.tryWait())
+                continue;
+            continue;
+        }
+
+        int start1, size1, start2, size2;
+        fifo.prepareToRead ((int) sizeof (EventHeader), start1, size1, start2, size2);
+        EventHeader header;
+        read (start1, &header, (int) sizeof (EventHeader));
+
+        // sleep most of the way, then yield until it's due
+        const double wait = header.time - Time::getMillisecondCounterHiRes() * 0.001;
+        if (wait > 0.002)
+        {
+            Thread::sleep (roundToInt (1000.0 * jmin (maxSleepSeconds, wait - 0.001)));
+            continue;
+        }
+        if (wait > 0.0)
+        {
+            Thread::yield();
+            continue;
+        }
+
+        read ((start1 + (int) sizeof (EventHeader)) % capacity, scratch, header.size);
+        fifo.finishedRead ((int) sizeof (EventHeader) + header.size);
+
+        EL_ASSERT_NOT_RENDERING();
+const ScopedLock sl (outputLock);
+        if (auto* const out = output.load())
+            if (! dropPending.load())
+                out->sendMessageNow (MidiMessage (scratch, header.size));
+    }
+}
+
+} // namespace element
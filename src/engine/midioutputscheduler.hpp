@@ -0,0 +1,79 @@
+/*
+    This file is part of Element
+    Copyright (C) 2021  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+
+
+#pragma once
+
+#include "JuceHeader.h"
+#include "semaphore.hpp"
+
+namespace element {
+
+/** Sends MIDI rendered by the audio thread to a device at the time each
+    message should be heard, from a thread of its own.
+
+    The audio thread queues each block with the system time its first sample
+    reaches the speakers, without locking or touching the device.  The
+    scheduler thread sleeps until each message is due and sends it.
+ */
+class MidiOutputScheduler : private Thread
+{
+public:
+    /** Creates a scheduler holding up to capacityInBytes of messages */
+    explicit MidiOutputScheduler (int capacityInBytes = 65536);
+    ~MidiOutputScheduler();
+
+    /** Changes the device messages are sent to, starting or stopping the
+        thread as needed.  Messages pending for the last device are dropped.
+        Message thread only, the scheduler doesn't own the device.
+     */
+    void setOutput (MidiOutput* newOutput);
+
+    /** True if there's a device to send to.  Realtime safe. */
+    bool hasOutput() const noexcept { return output.load (std::memory_order_relaxed) != nullptr; }
+
+    /** Queues a block of messages, called from the audio thread only.
+
+        @param messages     The block, by sample offset
+        @param blockTime    System time in seconds the block's first sample
+                            is heard, see Time::getMillisecondCounterHiRes()
+        @param samplePeriod Length of a sample in system time
+     */
+    void addBlock (const MidiBuffer& messages, double blockTime, double samplePeriod) noexcept;
+
+private:
+    const int capacity;
+    AbstractFifo fifo;
+    HeapBlock<uint8> data, scratch;
+    Semaphore wakeup;
+
+    CriticalSection outputLock;
+    std::atomic<MidiOutput*> output { nullptr };
+    std::atomic<bool> dropPending { false };
+
+    bool push (const uint8* bytes, int size, double time) noexcept;
+    void write (int index, const void* src, int numBytes) noexcept;
+    void read (int index, void* dest, int numBytes) const noexcept;
+    void run() override;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MidiOutputScheduler)
+};
+
+} // namespace element
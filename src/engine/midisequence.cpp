@@ -0,0 +1,112 @@
+/*
+    This file is part of Element
+    Copyright (C) 2021  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+
+
+#include "engine/midisequence.hpp"
+
+namespace element {
+
+MidiSequence::MidiSequence (const MidiFile& file)
+{
+    MidiMessageSequence merged;
+    for (int i = 0; i < file.getNumTracks(); ++i)
+        merged.addSequence (*file.getTrack (i), 0.0);
+
+    // ticks per quarter note, or per second for SMPTE time
+    const short timeFormat = file.getTimeFormat();
+    const bool smpte = timeFormat < 0;
+    double ticksPerQuarter = 960.0, secondsPerTick = 0.5 / ticksPerQuarter;
+    if (smpte)
+    {
+        const int framesPerSecond = -(timeFormat >> 8);
+        const int subframes = timeFormat & 0xff;
+        const double ticksPerSecond = (framesPerSecond == 29 ? 29.97 : (double) jmax (1, framesPerSecond)) * jmax (1, subframes);
+        secondsPerTick = 1.0 / ticksPerSecond;
+        ticksPerQuarter = ticksPerSecond * 0.5; // beats are at 120 bpm
+    }
+    else
+    {
+        if (timeFormat > 0)
+            ticksPerQuarter = (double) timeFormat;
+        secondsPerTick = 0.5 / ticksPerQuarter;
+    }
+
+    events.ensureStorageAllocated (merged.getNumEvents());
+    double lastTick = 0.0, seconds = 0.0;
+    for (const auto* const holder : merged)
+    {
+        const auto& message = holder->message;
+        const double tick = message.getTimeStamp();
+        seconds += (tick - lastTick) * secondsPerTick;
+        lastTick = tick;
+
+        if (message.isTempoMetaEvent())
+        {
+            if (! smpte)
+                secondsPerTick = message.getTempoSecondsPerQuarterNote() / ticksPerQuarter;
+            continue;
+        }
+
+        if (message.isMetaEvent())
+            continue;
+
+        Event event;
+        event.beat = tick / ticksPerQuarter;
+        event.seconds = seconds;
+        event.offset = data.size();
+        event.size = message.getRawDataSize();
+        data.addArray (message.getRawData(), event.size);
+        events.add (event);
+    }
+
+    // the end of the longest track, usually its end-of-track event
+    lengthInBeats = lastTick / ticksPerQuarter;
+    lengthInSeconds = seconds;
+}
+
+std::unique_ptr<MidiSequence> MidiSequence::load (const File& file, String& error)
+{
+    FileInputStream stream (file);
+    if (! stream.openedOk())
+    {
+        error = "Could not open " + file.getFileName();
+        return nullptr;
+    }
+
+    MidiFile midiFile;
+    if (! midiFile.readFrom (stream))
+    {
+        error = file.getFileName() + " is not a MIDI file";
+        return nullptr;
+    }
+
+    return std::make_unique<MidiSequence> (midiFile);
+}
+
+int MidiSequence::indexOf (const double position, const bool inSeconds) const noexcept
+{
+    const auto* const first = events.begin();
+    const auto* const found = std::lower_bound (first, events.end(), position, [inSeconds] (const Event& event, double pos) {
+        return getPosition (event, inSeconds) < pos;
+    });
+    return (int) (found - first);
+}
+
+} // namespace element
@@ -0,0 +1,96 @@
+/*
+    This file is part of Element
+    Copyright (C) 2021  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+
+
+#pragma once
+
+#include "JuceHeader.h"
+
+namespace element {
+
+/** The events of a Standard MIDI File merged in to one flat array, sorted by
+    time and indexed both in beats and in seconds of the file's tempo map.
+
+    Built once when a file is loaded, read by the audio thread without
+    allocating: finding where to start playing is a binary search, after
+    that events are read in order.  Meta events are dropped.
+ */
+class MidiSequence
+{
+public:
+    struct Event
+    {
+        /** Position in quarter notes from the start of the file */
+        double beat = 0.0;
+
+        /** Position in seconds, following the file's tempo changes */
+        double seconds = 0.0;
+
+        /** Where the message's bytes are in the sequence's data */
+        int offset = 0;
+        int size = 0;
+    };
+
+    MidiSequence() = default;
+
+    /** Builds a sequence from every track of a parsed file */
+    explicit MidiSequence (const MidiFile& file);
+
+    /** Reads and parses a file, returns nullptr and sets the error if it
+        isn't a Standard MIDI File */
+    static std::unique_ptr<MidiSequence> load (const File& file, String& error);
+
+    //==========================================================================
+    /** Returns the number of events */
+    int size() const noexcept { return events.size(); }
+
+    /** Returns true if there are no events */
+    bool isEmpty() const noexcept { return events.isEmpty(); }
+
+    /** Returns an event by index */
+    const Event& getEvent (int index) const noexcept { return events.getReference (index); }
+
+    /** Returns the bytes of an event's message */
+    const uint8* getData (const Event& event) const noexcept { return data.begin() + event.offset; }
+
+    /** Returns where the file ends, which may be after its last event */
+    double getLengthInBeats() const noexcept { return lengthInBeats; }
+    double getLengthInSeconds() const noexcept { return lengthInSeconds; }
+
+    /** Returns the index of the first event at or after a position, in beats
+        or in seconds.  Returns size() if there are none. */
+    int indexOf (double position, bool inSeconds) const noexcept;
+
+    /** Returns an event's position in beats or seconds */
+    static double getPosition (const Event& event, bool inSeconds) noexcept
+    {
+        return inSeconds ? event.seconds : event.beat;
+    }
+
+private:
+    Array<Event> events;
+    Array<uint8> data;
+    double lengthInBeats = 0.0;
+    double lengthInSeconds = 0.0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MidiSequence)
+};
+
+} // namespace element
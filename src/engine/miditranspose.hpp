@@ -20,6 +20,7 @@
 #pragma once
 
 #include "JuceHeader.h"
+#include "engine/midieventbuffer.hpp"
 
 namespace element {
 
@@ -56,23 +57,36 @@ public:
             message.setNoteNumber (offset.get() + message.getNoteNumber());
     }
 
+    /** Process the raw bytes of a single event in place */
+    inline static void process (uint8* data, const int size, const int offset) noexcept
+    {
+        const int status = size >= 2 ? (data[0] & 0xf0) : 0;
+        if (status == 0x80 || status == 0x90)
+            data[1] = (uint8) ((offset + data[1]) & 127);
+    }
+
     /** Process a MidiBuffer */
     inline void process (MidiBuffer& midi, int numSamples)
     {
         if (0 == offset.get())
             return;
 
-        MidiBuffer::Iterator iter (midi);
-        MidiMessage msg;
-        int frame = 0;
-
-        while (iter.getNextEvent (msg, frame))
+        output.clear();
+        for (const auto metadata : midi)
         {
-            if (frame >= numSamples)
+            if (metadata.samplePosition >= numSamples)
                 break;
-            if (msg.isNoteOnOrOff())
-                msg.setNoteNumber (offset.get() + msg.getNoteNumber());
-            output.addEvent (msg, frame);
+
+            if (metadata.numBytes > 3)
+            {
+                appendMidiEvent (output, metadata.data, metadata.numBytes, metadata.samplePosition);
+                continue;
+            }
+
+            uint8 bytes[3];
+            std::memcpy (bytes, metadata.data, (size_t) metadata.numBytes);
+            process (bytes, metadata.numBytes, offset.get());
+            appendMidiEvent (output, bytes, metadata.numBytes, metadata.samplePosition);
         }
 
         midi.swapWith (output);
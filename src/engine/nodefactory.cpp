@@ -22,6 +22,7 @@
 #include "engine/nodes/AudioRouterNode.h"
 #include "engine/nodes/LuaNode.h"
 #include "engine/nodes/MidiChannelSplitterNode.h"
+#include "engine/nodes/MidiFilePlayerNode.h"
 #include "engine/nodes/MidiMonitorNode.h"
 #include "engine/nodes/MidiProgramMapNode.h"
 #include "engine/nodes/MidiRouterNode.h"
@@ -39,6 +40,7 @@ NodeFactory::NodeFactory()
     add<AudioRouterNode> (EL_INTERNAL_ID_AUDIO_ROUTER);
     add<LuaNode> (EL_INTERNAL_ID_LUA);
     add<MidiChannelSplitterNode> (EL_INTERNAL_ID_MIDI_CHANNEL_SPLITTER);
+    add<MidiFilePlayerNode> (EL_INTERNAL_ID_MIDI_FILE_PLAYER);
     add<MidiMonitorNode> (EL_INTERNAL_ID_MIDI_MONITOR);
     add<MidiProgramMapNode> (EL_INTERNAL_ID_MIDI_PROGRAM_MAP);
     add<MidiRouterNode> (EL_INTERNAL_ID_MIDI_ROUTER);
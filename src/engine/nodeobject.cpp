@@ -126,11 +126,13 @@ bool NodeObject::containsParameter (const int index) const
 void NodeObject::setInputGain (const float f)
 {
     inputGain.set (f);
+    checkInlineRendering();
 }
 
 void NodeObject::setGain (const float f)
 {
     gain.set (f);
+    checkInlineRendering();
 }
 
 void NodeObject::getPluginDescription (PluginDescription& desc) const
@@ -207,16 +209,33 @@ bool NodeObject::isMidiDeviceNode() const
 int NodeObject::getNumAudioInputs() const { return ports.size (PortType::Audio, true); }
 int NodeObject::getNumAudioOutputs() const { return ports.size (PortType::Audio, false); }
 
-void NodeObject::setInputRMS (int chan, float val)
+void NodeObject::addMeterSubscriber()
 {
-    if (chan < inRMS.size())
-        inRMS.getUnchecked (chan)->set (val);
+    ++meterSubscribers;
+    checkInlineRendering();
 }
 
-void NodeObject::setOutputRMS (int chan, float val)
+void NodeObject::removeMeterSubscriber()
 {
-    if (chan < outRMS.size())
-        outRMS.getUnchecked (chan)->set (val);
+    jassert (meterSubscribers.get() > 0);
+    if (--meterSubscribers <= 0)
+    {
+        // levels stop updating, don't leave the last ones showing
+        meterSubscribers = 0;
+        meters.clear();
+    }
+
+    checkInlineRendering();
+}
+
+void NodeObject::checkInlineRendering()
+{
+    // a subgraph's parent renders its nodes inline only while the subgraph
+    // does nothing to their signals as a node
+    if (auto* const graph = dynamic_cast<GraphNode*> (this))
+        if (auto* const parentGraph = getParentGraph())
+            if (graph->canRenderInline() != graph->renderedInline.load())
+                parentGraph->graphChanged();
 }
 
 bool NodeObject::isSuspended() const
@@ -243,7 +262,12 @@ void NodeObject::suspendProcessing (const bool shouldBeSuspended)
     }
 
     if (isSuspended() != wasSuspeneded)
+    {
+        // bypassed nodes are compiled as a route around them
+        if (auto* const graph = getParentGraph())
+            graph->graphChanged();
         bypassChanged (this);
+    }
 }
 
 bool NodeObject::isGraph() const noexcept { return isA<GraphNode>(); }
@@ -330,6 +354,15 @@ void NodeObject::prepare (const double newSampleRate,
         oversampler->prepare (jmax (getNumPorts (PortType::Audio, true),
                                     getNumPorts (PortType::Audio, false)),
                               blockSize);
+        // plugins can only change precision while they're released
+        if (auto* const proc = getAudioProcessor())
+        {
+            const bool useDouble = parentGraph != nullptr && parentGraph->isUsingDoublePrecision()
+                                   && proc->supportsDoublePrecisionProcessing();
+            proc->setProcessingPrecision (useDouble ? AudioProcessor::doublePrecision
+                                                    : AudioProcessor::singlePrecision);
+        }
+
         const int osFactor = jmax (1, getOversamplingFactor());
         prepareToRender (sampleRate * osFactor, blockSize * osFactor);
 
@@ -339,21 +372,7 @@ void NodeObject::prepare (const double newSampleRate,
         // if (! isAudioIONode() && ! isMidiIONode())
         //     refreshPorts();
 
-        inRMS.clearQuick (true);
-        for (int i = 0; i < getNumAudioInputs(); ++i)
-        {
-            AtomicValue<float>* avf = new AtomicValue<float>();
-            avf->set (0);
-            inRMS.add (avf);
-        }
-
-        outRMS.clearQuick (true);
-        for (int i = 0; i < getNumAudioOutputs(); ++i)
-        {
-            AtomicValue<float>* avf = new AtomicValue<float>();
-            avf->set (0);
-            outRMS.add (avf);
-        }
+        meters.resize (getNumAudioInputs(), getNumAudioOutputs());
     }
 }
 
@@ -364,8 +383,7 @@ void NodeObject::unprepare()
         isPrepared = false;
         releaseResources();
         oversampler->reset();
-        inRMS.clear (true);
-        outRMS.clear (true);
+        meters.resize (0, 0);
     }
 }
 
@@ -399,6 +417,9 @@ void NodeObject::setEnabled (const bool shouldBeEnabled)
         unprepare();
     }
 
+    // disabled nodes are compiled out of the parent's program
+    if (auto* const graph = getParentGraph())
+        graph->graphChanged();
     enablementChanged (this);
 }
 
@@ -546,6 +567,19 @@ void NodeObject::MidiProgramLoader::handleAsyncUpdate()
         // the property is still relavent.
 }
 
+void NodeObject::publishRenderProperties()
+{
+    // the lock only keeps writers apart, the render thread never takes it
+    ScopedLock sl (getPropertyLock());
+    auto& props = renderProperties.write();
+    props.keyRange = getKeyRange();
+    props.transposeOffset = getTransposeOffset();
+    props.midiChannels = midiChannels;
+    props.midiProgramsEnabled = areMidiProgramsEnabled();
+    renderProperties.publish();
+    checkInlineRendering();
+}
+
 void NodeObject::setMidiProgram (const int program)
 {
     if (program < 0 || program > 127)
@@ -639,6 +673,12 @@ void NodeObject::renderBypassed (AudioSampleBuffer& audio, MidiPipe& midi)
     midi.clear();
 }
 
+void NodeObject::renderBypassed (AudioBuffer<double>& audio, MidiPipe& midi)
+{
+    audio.clear (0, audio.getNumSamples());
+    midi.clear();
+}
+
 //=============================================================================
 void NodeObject::setPorts (const PortList& newPorts)
 {
@@ -707,7 +747,10 @@ void NodeObject::setMuted (bool muted)
     bool wasMuted = isMuted();
     mute.set (muted ? 1 : 0);
     if (wasMuted != isMuted())
+    {
+        checkInlineRendering();
         muteChanged (this);
+    }
 }
 
 dsp::Oversampling<float>* NodeObject::getOversamplingProcessor()
@@ -738,7 +781,7 @@ void NodeObject::setOversamplingFactor (int osFactor)
     }
 
     if (auto* g = getParentGraph())
-        g->triggerAsyncUpdate();
+        g->triggerRebuild();
 }
 
 int NodeObject::getOversamplingFactor()
@@ -20,9 +20,11 @@
 #pragma once
 
 #include "ElementApp.h"
+#include "engine/meter.hpp"
 #include "engine/midipipe.hpp"
 #include "engine/oversampler.hpp"
 #include "engine/parameter.hpp"
+#include "engine/renderguard.hpp"
 #include "atomic.hpp"
 #include "portcount.hpp"
 #include "midichannels.hpp"
@@ -34,6 +36,7 @@ namespace GraphRender {
     class ProcessBufferOp;
 }
 
+class BypassOp;
 class GraphNode;
 class ProcessBufferOp;
 
@@ -93,6 +96,10 @@ public:
     /** Returns the processor as an Audio Plugin Instance */
     AudioPluginInstance* getAudioPluginInstance() const noexcept { return processor<AudioPluginInstance>(); }
 
+    /** Returns the number of parameter and state changes the processor has
+        reported.  Safe to call from any thread. */
+    uint32 getProcessorChangeCount() const noexcept { return processorChanges.load (std::memory_order_relaxed); }
+
     /** Set the audio play head */
     virtual void setPlayHead (AudioPlayHead*) {}
 
@@ -104,6 +111,17 @@ public:
     virtual void render (AudioSampleBuffer&, MidiPipe&) {}
     virtual void renderBypassed (AudioSampleBuffer&, MidiPipe&);
 
+    /** Returns true if the node renders double buffers itself.  Otherwise a
+        double precision graph converts to float around it. */
+    virtual bool supportsDoublePrecisionRender() const { return false; }
+    virtual void render (AudioBuffer<double>&, MidiPipe&) {}
+    virtual void renderBypassed (AudioBuffer<double>&, MidiPipe&);
+
+    /** Returns true if the node has to render in step with the audio device,
+        because it takes live input or talks to hardware.  Nodes it feeds are
+        rendered live too, the rest of a graph may be rendered ahead. */
+    virtual bool rendersLive() const { return false; }
+
     /** Returns the total number of audio inputs */
     int getNumAudioInputs() const;
 
@@ -223,10 +241,23 @@ public:
      */
     GraphNode* getParentGraph() const;
 
-    void setInputRMS (int chan, float val);
-    float getInputRMS (int chan) const { return (chan < inRMS.size()) ? inRMS.getUnchecked (chan)->get() : 0.0f; }
-    void setOutputRMS (int chan, float val);
-    float getOutputRMS (int chan) const { return (chan < outRMS.size()) ? outRMS.getUnchecked (chan)->get() : 0.0f; }
+    //=========================================================================
+    /** Asks the engine to measure this node's levels.  Meters are only
+        updated while the node has at least one subscriber, call
+        removeMeterSubscriber() once for every call to this. */
+    void addMeterSubscriber();
+
+    /** Stops measuring levels for one subscriber */
+    void removeMeterSubscriber();
+
+    /** Returns true if anybody is watching this node's meters */
+    bool isMetering() const noexcept { return meterSubscribers.get() > 0; }
+
+    /** Returns the node's input and output levels */
+    const MeterBlock& getMeters() const noexcept { return meters; }
+
+    float getInputRMS (int chan) const { return meters.getInputRMS (chan); }
+    float getOutputRMS (int chan) const { return meters.getOutputRMS (chan); }
 
     //=========================================================================
     /** Connect this node's output audio to another node's input audio */
@@ -247,6 +278,7 @@ public:
         jassert (isPositiveAndBelow (high, 128));
         keyRangeLow.set (low);
         keyRangeHigh.set (high);
+        publishRenderProperties();
     }
 
     inline void setKeyRange (const Range<int>& range) { setKeyRange (range.getStart(), range.getEnd()); }
@@ -258,11 +290,34 @@ public:
     {
         jassert (value >= -24 && value <= 24);
         transposeOffset.set (value);
+        publishRenderProperties();
     }
 
     inline int getTransposeOffset() const { return transposeOffset.get(); }
 
-    const CriticalSection& getPropertyLock() const { return propertyLock; }
+    /** Returns the lock for properties changed while the node is running.
+        This must never be taken while rendering.
+     */
+    const CriticalSection& getPropertyLock() const
+    {
+        EL_ASSERT_NOT_RENDERING();
+        return propertyLock;
+    }
+
+    //=========================================================================
+    /** Properties used by the graph while rendering this node */
+    struct RenderProperties
+    {
+        Range<int> keyRange { 0, 127 };
+        int transposeOffset = 0;
+        MidiChannels midiChannels;
+        bool midiProgramsEnabled = false;
+    };
+
+    /** Returns the latest render properties without locking.  Only call this
+        from the thread rendering the node.
+     */
+    inline const RenderProperties& getRenderProperties() noexcept { return renderProperties.read(); }
 
     //=========================================================================
     /** Returns the file used for the current global MIDI Program */
@@ -279,7 +334,11 @@ public:
     inline bool areMidiProgramsEnabled() const { return midiProgramsEnabled.get() == 1; }
 
     /** Enable or disable changing midi programs */
-    inline void setMidiProgramsEnabled (bool enabled) { midiProgramsEnabled.set (enabled ? 1 : 0); }
+    inline void setMidiProgramsEnabled (bool enabled)
+    {
+        midiProgramsEnabled.set (enabled ? 1 : 0);
+        publishRenderProperties();
+    }
 
     /** Returns the active midi program */
     inline int getMidiProgram() const { return midiProgram.get(); }
@@ -315,8 +374,9 @@ public:
     //=========================================================================
     inline void setMidiChannels (const BigInteger& ch)
     {
-        ScopedLock sl (propertyLock);
+        ScopedLock sl (getPropertyLock());
         midiChannels.setChannels (ch);
+        publishRenderProperties();
     }
 
     inline const MidiChannels& getMidiChannels() const { return midiChannels; }
@@ -416,6 +476,9 @@ protected:
     /** Set latency samples */
     void setLatencySamples (int latency);
 
+    /** Call when the processor reports a parameter or state change */
+    void processorChanged() noexcept { processorChanges.fetch_add (1, std::memory_order_relaxed); }
+
     //==========================================================================
     virtual Parameter::Ptr getParameter (const PortDescription& port) { return nullptr; }
 
@@ -423,12 +486,14 @@ protected:
     void triggerPortReset();
 
 private:
+    friend class BypassOp;
     friend class EngineService;
     friend class GraphRender::ProcessBufferOp;
     friend class ProcessBufferOp;
     friend class GraphManager;
     friend class GraphNode;
     friend class Node;
+    friend struct NodeState;
 
     PortList ports;
     GraphNode* parent = nullptr;
@@ -436,6 +501,9 @@ private:
 
     Atomic<int> enabled { 1 };
     Atomic<int> bypassed { 0 };
+
+    // true if the last block was routed around the node, render thread only
+    bool renderedBypassed = false;
     Atomic<int> mute { 0 };
     Atomic<int> muteInput { 0 };
 
@@ -447,7 +515,8 @@ private:
     ParameterArray parameters;
 
     Atomic<float> gain, lastGain, inputGain, lastInputGain;
-    OwnedArray<AtomicValue<float>> inRMS, outRMS;
+    MeterBlock meters;
+    Atomic<int> meterSubscribers { 0 };
 
     Atomic<int> keyRangeLow { 0 };
     Atomic<int> keyRangeHigh { 127 };
@@ -459,7 +528,12 @@ private:
     Atomic<int> midiProgramsEnabled { 0 };
     Atomic<int> globalMidiPrograms { 0 };
 
+    std::atomic<uint32> processorChanges { 0 };
+
     CriticalSection propertyLock;
+    TripleBuffer<RenderProperties> renderProperties;
+    void publishRenderProperties();
+    void checkInlineRendering();
     struct EnablementUpdater : public AsyncUpdater
     {
         EnablementUpdater (NodeObject& g) : graph (g) {}
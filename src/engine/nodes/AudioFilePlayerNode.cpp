@@ -395,6 +395,7 @@ void AudioFilePlayerNode::openFile (const File& file)
         audioFile = file;
         player.setSource (reader.get(), 1024 * 8, &thread, newReader->sampleRate, 2);
 
+        EL_ASSERT_NOT_RENDERING();
         ScopedLock sl (getCallbackLock());
         reader->setLooping (*looping);
         player.setLooping (*looping);
@@ -459,7 +460,12 @@ void AudioFilePlayerNode::processBlock (AudioBuffer<float>& buffer, MidiBuffer&
     AudioSourceChannelInfo info;
     info.buffer = &buffer;
 
-    ScopedLock sl (getCallbackLock());
+    // the buffer's already clear, so skip the block rather than wait on a
+    // file being opened
+    const ScopedTryLock sl (getCallbackLock());
+    if (! sl.isLocked())
+        return;
+
     if (midiStartStopContinue.get() == 1)
     {
         while (iter.getNextEvent (msg, frame))
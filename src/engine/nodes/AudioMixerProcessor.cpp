@@ -362,6 +362,7 @@ AudioMixerProcessor::~AudioMixerProcessor()
 {
     Array<Track*> oldTracks;
     {
+        EL_ASSERT_NOT_RENDERING();
         ScopedLock sl (getCallbackLock());
         masterMute = nullptr;
         masterVolume = nullptr;
@@ -376,6 +377,7 @@ AudioMixerProcessor::MonitorPtr AudioMixerProcessor::getMonitor (const int track
 {
     if (track < 0)
         return masterMonitor;
+    EL_ASSERT_NOT_RENDERING();
     ScopedLock sl (getCallbackLock());
     if (! isPositiveAndBelow (track, tracks.size()))
         return nullptr;
@@ -418,6 +420,7 @@ void AudioMixerProcessor::addStereoTrack()
         track->mute = false;
         track->monitor = new Monitor (track->index, track->numOutputs);
 
+        EL_ASSERT_NOT_RENDERING();
         ScopedLock sl (getCallbackLock());
         tracks.add (track);
         numTracks = tracks.size();
@@ -447,9 +450,11 @@ void AudioMixerProcessor::processBlock (AudioSampleBuffer& audio, MidiBuffer& mi
 {
     midi.clear();
 
-    ScopedLock sl (getCallbackLock());
+    // tracks only change on the message thread, a block which would wait
+    // for one is silent instead
+    const ScopedTryLock sl (getCallbackLock());
 
-    if (tracks.size() <= 0)
+    if (! sl.isLocked() || tracks.size() <= 0)
     {
         audio.clear();
         return;
@@ -543,6 +548,7 @@ void AudioMixerProcessor::setTrackGain (const int track, const float gain)
 {
     if (! isPositiveAndBelow (track, numTracks))
         return;
+    EL_ASSERT_NOT_RENDERING();
     ScopedLock sl (getCallbackLock());
     tracks.getUnchecked (track)->gain = gain;
 }
@@ -551,6 +557,7 @@ void AudioMixerProcessor::setTrackMuted (const int track, const bool mute)
 {
     if (! isPositiveAndBelow (track, numTracks))
         return;
+    EL_ASSERT_NOT_RENDERING();
     ScopedLock sl (getCallbackLock());
     tracks.getUnchecked (track)->mute = mute;
 }
@@ -559,6 +566,7 @@ bool AudioMixerProcessor::isTrackMuted (const int track) const
 {
     if (! isPositiveAndBelow (track, numTracks))
         return false;
+    EL_ASSERT_NOT_RENDERING();
     ScopedLock sl (getCallbackLock());
     return tracks.getUnchecked (track)->mute;
 }
@@ -567,6 +575,7 @@ float AudioMixerProcessor::getTrackGain (const int track) const
 {
     if (! isPositiveAndBelow (track, numTracks))
         return 1.f;
+    EL_ASSERT_NOT_RENDERING();
     ScopedLock sl (getCallbackLock());
     return tracks.getUnchecked (track)->gain;
 }
@@ -579,6 +588,7 @@ void AudioMixerProcessor::getStateInformation (juce::MemoryBlock& block)
     float volume = 0.0f;
     bool mute = false;
     {
+        EL_ASSERT_NOT_RENDERING();
         ScopedLock sl (getCallbackLock());
         for (int i = 0; i < numTracks; ++i)
             t.getUnchecked (i)->update (tracks.getUnchecked (i));
@@ -642,6 +652,7 @@ void AudioMixerProcessor::setStateInformation (const void* data, int size)
     }
 
     {
+        EL_ASSERT_NOT_RENDERING();
         ScopedLock sl (getCallbackLock());
         *masterVolume = (float) state.getProperty (Tags::volume, 0.0);
         *masterMute = (bool) state.getProperty ("mute", false);
@@ -155,6 +155,7 @@ public:
 
     int getNumTracks() const
     {
+        EL_ASSERT_NOT_RENDERING();
         ScopedLock sl (getCallbackLock());
         return tracks.size();
     }
@@ -125,6 +125,12 @@ void AudioProcessorNode::releaseResources()
     proc->releaseResources();
 }
 
+bool AudioProcessorNode::rendersLive() const
+{
+    // MIDI devices are read and written as the device plays
+    return dynamic_cast<MidiDeviceProcessor*> (proc.get()) != nullptr;
+}
+
 void AudioProcessorNode::EnablementUpdater::handleAsyncUpdate()
 {
     node.setEnabled (! node.isEnabled());
@@ -145,10 +151,15 @@ AudioProcessorNode::AudioProcessorNode (uint32 nodeId, AudioProcessor* processor
 
     for (auto* param : proc->getParameters())
         params.add (new AudioProcessorNodeParameter (*param));
+
+    // counted for nodes idling on silence, they wake when this changes
+    proc->addListener (this);
 }
 
 AudioProcessorNode::~AudioProcessorNode()
 {
+    if (proc != nullptr)
+        proc->removeListener (this);
     params.clear();
     NodeObject::clearParameters();
     enablement.cancelPendingUpdate();
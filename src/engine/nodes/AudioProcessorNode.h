@@ -25,7 +25,8 @@ namespace element {
 
 class MidiPipe;
 
-class AudioProcessorNode : public NodeObject
+class AudioProcessorNode : public NodeObject,
+                           private AudioProcessorListener
 {
 public:
     AudioProcessorNode (uint32 nodeId, AudioProcessor* processor);
@@ -47,6 +48,7 @@ public:
     void prepareToRender (double sampleRate, int maxBufferSize) override;
     void releaseResources() override;
     void refreshPorts() override;
+    bool rendersLive() const override;
 
 protected:
     Parameter::Ptr getParameter (const PortDescription& port) override;
@@ -65,6 +67,9 @@ private:
         AudioProcessorNode& node;
     } enablement;
 
+    void audioProcessorParameterChanged (AudioProcessor*, int, float) override { processorChanged(); }
+    void audioProcessorChanged (AudioProcessor*, const ChangeDetails&) override { processorChanged(); }
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (AudioProcessorNode);
 };
 
@@ -93,6 +93,7 @@ void AudioRouterNode::applyMatrix (const MatrixState& matrix)
     jassert (matrix.sameSizeAs (state));
     ToggleGrid newPatches (matrix);
     {
+        EL_ASSERT_NOT_RENDERING();
         ScopedLock sl (getLock());
         nextToggles.swapWith (newPatches);
         togglesChanged = true; // initiate the crossfade
@@ -105,6 +106,7 @@ String AudioRouterNode::getSizeString() const
 {
     int s = 0, d = 0;
     {
+        EL_ASSERT_NOT_RENDERING();
         ScopedLock sl (lock);
         s = numSources;
         d = numDestinations;
@@ -121,6 +123,7 @@ void AudioRouterNode::setSize (int newIns, int newOuts)
     newOuts = jmax (1, newOuts);
 
     {
+        EL_ASSERT_NOT_RENDERING();
         ScopedLock sl1 (getLock());
         if (newIns == numSources && newOuts == numDestinations)
             return;
@@ -131,6 +134,7 @@ void AudioRouterNode::setSize (int newIns, int newOuts)
     ToggleGrid newNextPatches (state);
 
     {
+        EL_ASSERT_NOT_RENDERING();
         ScopedLock sl (getLock());
         nextToggles.swapWith (newNextPatches);
         toggles.swapWith (newPatches);
@@ -180,6 +184,16 @@ void AudioRouterNode::render (AudioSampleBuffer& audio, MidiPipe& midi)
     tempAudio.setSize (numChannels, numFrames, false, false, true);
     tempAudio.clear (0, numFrames);
 
+    // the patches are only locked while they're swapped, a block which
+    // would wait for that is silent instead
+    const ScopedTryLock sl (lock);
+    if (! sl.isLocked())
+    {
+        audio.clear();
+        midi.clear();
+        return;
+    }
+
     if (sizeChanged)
     {
         fadeIn.reset();
@@ -209,7 +223,6 @@ void AudioRouterNode::render (AudioSampleBuffer& audio, MidiPipe& midi)
     {
         auto framesToProcess = numFrames;
         int frame = 0;
-        ScopedLock sl (lock);
 
         float fadeInGain = 0.0f;
         float fadeOutGain = 1.0f;
@@ -304,7 +317,6 @@ void AudioRouterNode::render (AudioSampleBuffer& audio, MidiPipe& midi)
     }
     else
     {
-        ScopedLock sl (lock);
         for (int i = 0; i < numSources; ++i)
             for (int j = 0; j < numDestinations; ++j)
                 if (toggles.get (i, j))
@@ -338,6 +350,7 @@ void AudioRouterNode::setState (const void* data, int sizeInBytes)
             ToggleGrid newPatches (state);
             ToggleGrid newNextPatches (state);
             {
+                EL_ASSERT_NOT_RENDERING();
                 ScopedLock sl (getLock());
                 numSources = matrix.getNumRows();
                 numDestinations = matrix.getNumColumns();
@@ -370,6 +383,7 @@ void AudioRouterNode::set (int src, int dst, bool patched)
 void AudioRouterNode::clearPatches()
 {
     {
+        EL_ASSERT_NOT_RENDERING();
         ScopedLock sl (getLock());
         toggles.clear();
         nextToggles.clear();
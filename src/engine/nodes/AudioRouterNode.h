@@ -61,6 +61,7 @@ public:
     void setFadeLength (double seconds)
     {
         seconds = jlimit (0.001, 5.0, seconds);
+        EL_ASSERT_NOT_RENDERING();
         ScopedLock sl (lock);
         fadeLengthSeconds = seconds;
         fadeIn.setLength (static_cast<float> (fadeLengthSeconds));
@@ -21,6 +21,7 @@
 
 #include "JuceHeader.h"
 #include "engine/nodes/NodeTypes.h"
+#include "engine/renderguard.hpp"
 
 namespace element {
 
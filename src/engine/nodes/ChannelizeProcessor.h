@@ -114,6 +114,7 @@ public:
     {
         int chtoWrite = 1;
         {
+            EL_ASSERT_NOT_RENDERING();
             ScopedLock sl (getCallbackLock());
             chtoWrite = *channel;
         }
@@ -124,6 +125,7 @@ public:
     inline void setStateInformation (const void* data, int sizeInBytes) override
     {
         MemoryBlock block (data, sizeInBytes);
+        EL_ASSERT_NOT_RENDERING();
         ScopedLock sl (getCallbackLock());
         *channel = *reinterpret_cast<int*> (block.getData());
     }
@@ -760,6 +760,7 @@ Result LuaNode::loadScript (const String& newScript)
         if (prepared)
             newContext->prepare (sampleRate, blockSize);
         triggerPortReset();
+        EL_ASSERT_NOT_RENDERING();
         ScopedLock sl (lock);
         if (context != nullptr)
             newContext->copyParameterValues (*context);
@@ -810,7 +811,15 @@ void LuaNode::releaseResources()
 
 void LuaNode::render (AudioSampleBuffer& audio, MidiPipe& midi)
 {
-    ScopedLock sl (lock);
+    // silent while a script is swapped in, rather than wait for it
+    const ScopedTryLock sl (lock);
+    if (! sl.isLocked())
+    {
+        audio.clear();
+        midi.clear();
+        return;
+    }
+
     context->render (audio, midi);
 }
 
@@ -869,6 +878,7 @@ void LuaNode::getState (MemoryBlock& block)
 
 void LuaNode::setParameter (int index, float value)
 {
+    EL_ASSERT_NOT_RENDERING();
     ScopedLock sl (lock);
     context->setParameter (index, value);
 }
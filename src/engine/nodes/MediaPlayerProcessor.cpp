@@ -225,6 +225,7 @@ void MediaPlayerProcessor::openFile (const File& file)
         reader.reset (new AudioFormatReaderSource (newReader, true));
         audioFile = file;
         player.setSource (reader.get(), 1024 * 8, &thread, getSampleRate(), 2);
+        EL_ASSERT_NOT_RENDERING();
         ScopedLock sl (getCallbackLock());
         player.setLooping (true);
         reader->setLooping (true);
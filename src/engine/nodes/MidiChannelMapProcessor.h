@@ -57,6 +57,7 @@ public:
     void parameterValueChanged (int parameterIndex, float newValue) override
     {
         jassert (isPositiveAndBelow (parameterIndex, params.size()));
+        EL_ASSERT_NOT_RENDERING();
         ScopedLock sl (getCallbackLock());
         channels.set (parameterIndex + 1, *params.getUnchecked (parameterIndex));
     }
@@ -91,8 +92,10 @@ public:
 
     inline void processBlock (AudioBuffer<float>&, MidiBuffer& midiMessages) override
     {
-        ScopedLock sl (getCallbackLock());
-        channels.render (midiMessages);
+        // passes the block through unmapped rather than wait on a change
+        const ScopedTryLock sl (getCallbackLock());
+        if (sl.isLocked())
+            channels.render (midiMessages);
     }
 
     inline double getTailLengthSeconds() const override { return 0; }
@@ -107,6 +110,7 @@ public:
         int chans[16] = { 0 };
 
         {
+            EL_ASSERT_NOT_RENDERING();
             ScopedLock sl (getCallbackLock());
             for (int ch = 0; ch < 16; ++ch)
                 chans[ch] = *params.getUnchecked (ch);
@@ -138,6 +142,7 @@ public:
         }
 
         {
+            EL_ASSERT_NOT_RENDERING();
             ScopedLock sl (getCallbackLock());
             for (int ch = 0; ch < 16; ++ch)
                 *params.getUnchecked (ch) = chans[ch];
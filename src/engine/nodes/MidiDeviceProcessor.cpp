@@ -19,6 +19,7 @@
 
 #include "engine/nodes/MidiDeviceProcessor.h"
 #include "engine/midiengine.hpp"
+#include "engine/renderguard.hpp"
 #include "gui/LookAndFeel.h"
 
 namespace element {
@@ -177,6 +178,7 @@ void MidiDeviceProcessor::setCurrentDevice (const String& device)
 
 bool MidiDeviceProcessor::isDeviceOpen() const
 {
+    EL_ASSERT_NOT_RENDERING();
     ScopedLock sl (getCallbackLock());
     return inputDevice ? deviceName.isNotEmpty() : output != nullptr;
 }
@@ -193,7 +195,8 @@ const String MidiDeviceProcessor::getName() const
 
 void MidiDeviceProcessor::prepareToPlay (double sampleRate, int maximumExpectedSamplesPerBlock)
 {
-    inputMessages.reset (sampleRate);
+    inputMessages.clear();
+    inputClock.reset (sampleRate, maximumExpectedSamplesPerBlock);
     if (prepared)
         return;
 
@@ -213,8 +216,7 @@ void MidiDeviceProcessor::prepareToPlay (double sampleRate, int maximumExpectedS
         output = MidiOutput::openDevice (deviceIdx);
         if (output)
         {
-            output->clearAllPendingMessages();
-            output->startBackgroundThread();
+            outputScheduler.setOutput (output.get());
         }
         else
         {
@@ -232,19 +234,18 @@ void MidiDeviceProcessor::processBlock (AudioBuffer<float>& audio, MidiBuffer& m
     if (inputDevice)
     {
         midi.clear (0, nframes);
-        inputMessages.removeNextBlockOfMessages (midi, nframes);
+        inputClock.advance (Time::getMillisecondCounterHiRes() * 0.001, nframes);
+        inputMessages.collect (midi, inputClock, nframes);
     }
     else
     {
-        if (output && ! midi.isEmpty())
+        // the device is only written from the scheduler's thread
+        if (outputScheduler.hasOutput() && ! midi.isEmpty())
         {
             const auto delayMs = midiOutLatency.get();
-#if JUCE_WINDOWS
-            output->sendBlockOfMessagesNow (midi);
-#else
-            output->sendBlockOfMessages (
-                midi, delayMs + Time::getMillisecondCounterHiRes(), getSampleRate());
-#endif
+            outputScheduler.addBlock (midi,
+                                      (delayMs + Time::getMillisecondCounterHiRes()) * 0.001,
+                                      1.0 / getSampleRate());
         }
 
         midi.clear (0, nframes);
@@ -254,8 +255,8 @@ void MidiDeviceProcessor::processBlock (AudioBuffer<float>& audio, MidiBuffer& m
 void MidiDeviceProcessor::releaseResources()
 {
     prepared = false;
-    inputMessages.reset (getSampleRate());
     midi.removeMidiInputCallback (this);
+    inputMessages.clear();
 
     if (input)
     {
@@ -265,7 +266,7 @@ void MidiDeviceProcessor::releaseResources()
 
     if (output)
     {
-        output->stopBackgroundThread();
+        outputScheduler.setOutput (nullptr);
         output = nullptr;
     }
 }
@@ -306,7 +307,8 @@ void MidiDeviceProcessor::handleIncomingMidiMessage (MidiInput* source, const Mi
 {
     if (message.isActiveSense())
         return;
-    inputMessages.addMessageToQueue (message);
+    // the midi engine calls back one at a time under its callback lock
+    inputMessages.push (message);
 }
 
 void MidiDeviceProcessor::handlePartialSysexMessage (MidiInput* source, const uint8* messageData, int numBytesSoFar, double timestamp)
@@ -20,6 +20,8 @@
 #pragma once
 
 #include "engine/nodes/BaseProcessor.h"
+#include "engine/midiinputqueue.hpp"
+#include "engine/midioutputscheduler.hpp"
 
 namespace element {
 
@@ -148,9 +150,11 @@ private:
     MidiEngine& midi;
     bool prepared = false;
     String deviceName;
-    MidiMessageCollector inputMessages;
+    MidiInputQueue inputMessages;
+    MidiBlockClock inputClock;
     std::unique_ptr<MidiInput> input;
     std::unique_ptr<MidiOutput> output;
+    MidiOutputScheduler outputScheduler;
     Atomic<double> midiOutLatency { 0.0 };
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MidiDeviceProcessor);
 };
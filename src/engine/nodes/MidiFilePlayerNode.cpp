@@ -0,0 +1,216 @@
+/*
+    This file is part of Element
+    Copyright (C) 2021  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+
+#include "engine/nodes/MidiFilePlayerNode.h"
+#include "engine/midipipe.hpp"
+
+namespace element {
+
+MidiFilePlayerNode::MidiFilePlayerNode()
+    : NodeObject (0) {}
+
+MidiFilePlayerNode::~MidiFilePlayerNode() {}
+
+void MidiFilePlayerNode::prepareToRender (double newSampleRate, int maxBufferSize)
+{
+    ignoreUnused (maxBufferSize);
+    sampleRate = newSampleRate > 0.0 ? newSampleRate : 44100.0;
+    wasPlaying = false;
+}
+
+//==============================================================================
+void MidiFilePlayerNode::render (AudioSampleBuffer& audio, MidiPipe& midi)
+{
+    auto& out = *midi.getWriteBuffer (0);
+    out.clear();
+
+    const int numSamples = audio.getNumSamples();
+
+    // the sequence is only locked while it's swapped, when the block is empty
+    // and playback picks up from the next one
+    const SpinLock::ScopedTryLockType sl (lock);
+    if (! sl.isLocked())
+        return;
+
+    Optional<AudioPlayHead::PositionInfo> position;
+    if (auto* const ph = playhead.load())
+        position = ph->getPosition();
+
+    if (sequence == nullptr || numSamples <= 0 || ! position.hasValue() || ! position->getIsPlaying())
+    {
+        if (wasPlaying)
+            releaseNotes (out, 0);
+        wasPlaying = false;
+        return;
+    }
+
+    // where the transport is in the file, and how far a sample moves it
+    const bool inSeconds = followFileTempo.load();
+    const double bpm = position->getBpm().orFallback (120.0);
+    const double seconds = position->getTimeInSeconds().orFallback ((double) position->getTimeInSamples().orFallback (0) / sampleRate);
+    const double start = inSeconds ? seconds : position->getPpqPosition().orFallback (seconds * bpm / 60.0);
+    const double perSample = inSeconds ? 1.0 / sampleRate : bpm / (60.0 * sampleRate);
+    const double length = inSeconds ? sequence->getLengthInSeconds() : sequence->getLengthInBeats();
+    const bool loop = looping.load() && length > 0.0;
+
+    double pos = loop ? start - length * std::floor (start / length) : start;
+    if (! wasPlaying || sequenceChanged || inSeconds != wasInSeconds || std::abs (pos - nextPosition) > 0.5 * perSample)
+    {
+        // started, or the transport jumped somewhere else
+        if (wasPlaying)
+            releaseNotes (out, 0);
+        nextIndex = sequence->indexOf (pos, inSeconds);
+        sequenceChanged = false;
+    }
+
+    for (int done = 0; done < numSamples;)
+    {
+        int num = numSamples - done;
+        double end = pos + num * perSample;
+        const bool wraps = loop && end >= length;
+        if (wraps)
+        {
+            num = jlimit (1, num, (int) std::ceil ((length - pos) / perSample));
+            end = length;
+        }
+
+        for (const int last = sequence->size(); nextIndex < last; ++nextIndex)
+        {
+            const auto& event = sequence->getEvent (nextIndex);
+            const double at = MidiSequence::getPosition (event, inSeconds);
+            if (at >= end)
+                break;
+
+            const auto* const data = sequence->getData (event);
+            out.addEvent (data, event.size, done + jlimit (0, num - 1, roundToInt ((at - pos) / perSample)));
+            trackNotes (data, event.size);
+        }
+
+        done += num;
+        if (wraps)
+        {
+            // nothing may hang over the start of the loop
+            releaseNotes (out, done - 1);
+            pos += num * perSample - length;
+            nextIndex = sequence->indexOf (pos, inSeconds);
+        }
+        else
+        {
+            pos = end;
+        }
+    }
+
+    nextPosition = pos;
+    wasPlaying = true;
+    wasInSeconds = inSeconds;
+}
+
+void MidiFilePlayerNode::trackNotes (const uint8* data, const int size) noexcept
+{
+    if (size < 3)
+        return;
+
+    const int status = data[0] & 0xf0;
+    const int channel = data[0] & 0x0f;
+    if (status == 0x90 && data[2] > 0)
+        activeNotes[channel].set (data[1] & 0x7f);
+    else if (status == 0x80 || status == 0x90)
+        activeNotes[channel].reset (data[1] & 0x7f);
+    else if (status == 0xb0 && data[1] == 64)
+        sustainedChannels.set ((size_t) channel, data[2] >= 64);
+}
+
+void MidiFilePlayerNode::releaseNotes (MidiBuffer& out, const int frame)
+{
+    for (int channel = 0; channel < 16; ++channel)
+    {
+        if (sustainedChannels[(size_t) channel])
+            out.addEvent (MidiMessage::controllerEvent (channel + 1, 64, 0), frame);
+
+        if (activeNotes[channel].none())
+            continue;
+
+        for (int note = 0; note < 128; ++note)
+            if (activeNotes[channel][(size_t) note])
+                out.addEvent (MidiMessage::noteOff (channel + 1, note), frame);
+        activeNotes[channel].reset();
+    }
+
+    sustainedChannels.reset();
+}
+
+//==============================================================================
+Result MidiFilePlayerNode::loadFile (const File& newFile)
+{
+    String error;
+    auto newSequence = MidiSequence::load (newFile, error);
+    if (newSequence == nullptr)
+        return Result::fail (error);
+
+    setSequence (std::move (newSequence), newFile);
+    return Result::ok();
+}
+
+void MidiFilePlayerNode::clearFile()
+{
+    setSequence (nullptr, File());
+}
+
+void MidiFilePlayerNode::setSequence (std::unique_ptr<MidiSequence> newSequence, const File& newFile)
+{
+    {
+        EL_ASSERT_NOT_RENDERING();
+        const SpinLock::ScopedLockType sl (lock);
+        sequence.swap (newSequence);
+        sequenceChanged = true;
+    }
+
+    // the old sequence is deleted here, outside the lock
+    newSequence.reset();
+    file = newFile;
+    fileChanged();
+}
+
+void MidiFilePlayerNode::getState (MemoryBlock& block)
+{
+    ValueTree state ("MidiFilePlayer");
+    state.setProperty ("file", file.getFullPathName(), nullptr)
+        .setProperty ("looping", isLooping(), nullptr)
+        .setProperty ("followFileTempo", isFollowingFileTempo(), nullptr);
+    MemoryOutputStream stream (block, false);
+    state.writeToStream (stream);
+}
+
+void MidiFilePlayerNode::setState (const void* data, int sizeInBytes)
+{
+    const auto state = ValueTree::readFromData (data, (size_t) sizeInBytes);
+    if (! state.isValid())
+        return;
+
+    setLooping ((bool) state.getProperty ("looping", false));
+    setFollowingFileTempo ((bool) state.getProperty ("followFileTempo", false));
+
+    const auto path = state.getProperty ("file").toString();
+    if (path.isNotEmpty() && File::isAbsolutePath (path) && loadFile (File (path)).wasOk())
+        return;
+    clearFile();
+}
+
+} // namespace element
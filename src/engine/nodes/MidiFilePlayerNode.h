@@ -0,0 +1,125 @@
+/*
+    This file is part of Element
+    Copyright (C) 2021  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+
+#pragma once
+
+#include <bitset>
+
+#include "engine/nodes/NodeTypes.h"
+#include "engine/midisequence.hpp"
+#include "engine/nodeobject.hpp"
+#include "signals.hpp"
+
+namespace element {
+
+/** Plays a Standard MIDI File in time with the transport.
+
+    The file is parsed once in to a MidiSequence.  Each block the transport's
+    position picks up where the last block left off, or seeks when it jumped,
+    and the events in the block are copied to the MIDI output at their sample
+    offsets.  Positions are in beats, so the file follows the transport's
+    tempo, or in seconds when following the file's own tempo map.
+ */
+class MidiFilePlayerNode : public NodeObject
+{
+public:
+    MidiFilePlayerNode();
+    ~MidiFilePlayerNode();
+
+    void getPluginDescription (PluginDescription& desc) const override
+    {
+        desc.name = "MIDI File Player";
+        desc.fileOrIdentifier = EL_INTERNAL_ID_MIDI_FILE_PLAYER;
+        desc.uniqueId = EL_INTERNAL_UID_MIDI_FILE_PLAYER;
+        desc.descriptiveName = "Plays a MIDI file with the transport";
+        desc.numInputChannels = 0;
+        desc.numOutputChannels = 0;
+        desc.hasSharedContainer = false;
+        desc.isInstrument = false;
+        desc.manufacturerName = "Element";
+        desc.pluginFormatName = "Element";
+        desc.version = "1.0.0";
+    }
+
+    void refreshPorts() override
+    {
+        if (getNumPorts() > 0)
+            return;
+        PortList newPorts;
+        newPorts.add (PortType::Midi, 0, 0, "midi_out", "MIDI Out", false);
+        setPorts (newPorts);
+    }
+
+    void prepareToRender (double sampleRate, int maxBufferSize) override;
+    void releaseResources() override {}
+
+    inline bool wantsMidiPipe() const override { return true; }
+    void render (AudioSampleBuffer&, MidiPipe&) override;
+    void setPlayHead (AudioPlayHead* newPlayHead) override { playhead.store (newPlayHead); }
+
+    void getState (MemoryBlock&) override;
+    void setState (const void*, int sizeInBytes) override;
+
+    //==========================================================================
+    /** Loads a file, replacing the one playing.  Message thread only. */
+    Result loadFile (const File& file);
+
+    /** Stops playing the file */
+    void clearFile();
+
+    /** Returns the file loaded */
+    const File& getFile() const noexcept { return file; }
+
+    /** Plays the file again from the start when it ends */
+    void setLooping (bool shouldLoop) { looping.store (shouldLoop); }
+    bool isLooping() const noexcept { return looping.load(); }
+
+    /** Follows the tempo map of the file instead of the transport's tempo */
+    void setFollowingFileTempo (bool shouldFollow) { followFileTempo.store (shouldFollow); }
+    bool isFollowingFileTempo() const noexcept { return followFileTempo.load(); }
+
+    Signal<void()> fileChanged;
+
+private:
+    SpinLock lock;
+    std::unique_ptr<MidiSequence> sequence;
+    File file;
+    std::atomic<AudioPlayHead*> playhead { nullptr };
+    std::atomic<bool> looping { false };
+    std::atomic<bool> followFileTempo { false };
+    double sampleRate = 44100.0;
+
+    // render thread only
+    bool wasPlaying = false;
+    bool wasInSeconds = false;
+    bool sequenceChanged = false;
+    double nextPosition = 0.0;
+    int nextIndex = 0;
+    std::bitset<128> activeNotes[16];
+    std::bitset<16> sustainedChannels;
+
+    void setSequence (std::unique_ptr<MidiSequence>, const File&);
+    void trackNotes (const uint8* data, int size) noexcept;
+    void releaseNotes (MidiBuffer& out, int frame);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MidiFilePlayerNode)
+};
+
+} // namespace element
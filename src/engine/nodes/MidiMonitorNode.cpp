@@ -36,9 +36,8 @@ MidiMonitorNode::~MidiMonitorNode()
 
 void MidiMonitorNode::prepareToRender (double sampleRate, int maxBufferSize)
 {
-    inputMessages.reset (sampleRate);
-    currentSampleRate = sampleRate;
-    numSamples = 0;
+    ignoreUnused (sampleRate, maxBufferSize);
+    inputMessages.clear();
     startTimerHz (refreshRateHz);
 };
 
@@ -49,44 +48,23 @@ void MidiMonitorNode::releaseResources()
 
 void MidiMonitorNode::render (AudioSampleBuffer& audio, MidiPipe& midi)
 {
-    auto timestamp = Time::getMillisecondCounterHiRes();
-    const auto nframes = audio.getNumSamples();
-
-    if (nframes == 0)
+    if (audio.getNumSamples() == 0)
         return;
 
-    auto* const midiIn = midi.getWriteBuffer (0);
-    MidiBuffer::Iterator iter (*midiIn);
-    MidiMessage msg;
-    int frame;
-
-    ScopedLock sl (lock);
-    while (iter.getNextEvent (msg, frame))
-    {
-        msg.setTimeStamp (timestamp + (1000.0 * (static_cast<double> (frame) / currentSampleRate)));
-        inputMessages.addMessageToQueue (msg);
-    }
-
-    numSamples += nframes;
+    // a full queue drops messages from the log, never from the output
+    for (const auto metadata : *midi.getReadBuffer (0))
+        inputMessages.push (metadata.getMessage());
 }
 
 void MidiMonitorNode::getMessages (MidiBuffer& destBuffer)
 {
-    ScopedLock sl (lock);
-    if (numSamples <= 0)
-        return;
-    inputMessages.removeNextBlockOfMessages (destBuffer, numSamples);
-    numSamples = 0;
+    inputMessages.collectAll (destBuffer);
 }
 
 void MidiMonitorNode::clearMessages()
 {
     midiLog.clearQuick();
-    {
-        ScopedLock sl (lock);
-        inputMessages.reset (currentSampleRate);
-        numSamples = 0;
-    }
+    inputMessages.clear();
     messagesLogged();
 }
 
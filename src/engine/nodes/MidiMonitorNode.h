@@ -20,6 +20,7 @@
 
 #pragma once
 
+#include "engine/midiinputqueue.hpp"
 #include "engine/midipipe.hpp"
 #include "engine/nodes/BaseProcessor.h"
 #include "engine/nodes/MidiFilterNode.h"
@@ -78,11 +79,9 @@ public:
 private:
     friend class MidiMonitorNodeEditor;
     Signal<void()> messagesLogged;
-    double currentSampleRate = 44100.0;
-    int numSamples = 0;
-    MidiMessageCollector inputMessages;
+    // pushed while rendering and read by the timer
+    MidiInputQueue inputMessages;
     bool createdPorts = false;
-    CriticalSection lock;
 
     MidiBuffer midiTemp;
     StringArray midiLog;
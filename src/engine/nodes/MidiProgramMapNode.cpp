@@ -29,6 +29,7 @@ MidiProgramMapNode::~MidiProgramMapNode() {}
 void MidiProgramMapNode::clear()
 {
     entries.clearQuick (true);
+    EL_ASSERT_NOT_RENDERING();
     ScopedLock sl (lock);
     for (int i = 0; i < 128; ++i)
         programMap[i] = -1;
@@ -39,6 +40,7 @@ void MidiProgramMapNode::prepareToRender (double sampleRate, int maxBufferSize)
     ignoreUnused (sampleRate, maxBufferSize);
 
     {
+        EL_ASSERT_NOT_RENDERING();
         ScopedLock sl (lock);
         for (int i = 0; i < 128; ++i)
             programMap[i] = -1;
@@ -65,7 +67,12 @@ void MidiProgramMapNode::render (AudioSampleBuffer& audio, MidiPipe& midi)
 
     auto* const midiIn = midi.getWriteBuffer (0);
 
-    ScopedLock sl (lock);
+    // the map is only locked while it's edited, the block passes through
+    // unmapped rather than wait for that
+    const ScopedTryLock sl (lock);
+    if (! sl.isLocked())
+        return;
+
     MidiMessage msg;
     int frame = 0;
 
@@ -109,6 +116,7 @@ void MidiProgramMapNode::render (AudioSampleBuffer& audio, MidiPipe& midi)
 void MidiProgramMapNode::sendProgramChange (int program, int channel)
 {
     const auto msg (MidiMessage::programChange (channel, program));
+    EL_ASSERT_NOT_RENDERING();
     ScopedLock sl (lock);
     toSendMidi.addEvent (msg, 0);
 }
@@ -146,6 +154,7 @@ void MidiProgramMapNode::addProgramEntry (const String& name, int programIn, int
     entry->out = programOut;
     sendChangeMessage();
 
+    EL_ASSERT_NOT_RENDERING();
     ScopedLock sl (lock);
     programMap[entry->in] = entry->out;
 }
@@ -157,6 +166,7 @@ void MidiProgramMapNode::editProgramEntry (int index, const String& name, int in
         entry->name = name.isNotEmpty() ? name : entry->name;
         entry->in = inProgram;
         entry->out = outProgram;
+        EL_ASSERT_NOT_RENDERING();
         ScopedLock sl (lock);
         programMap[entry->in] = entry->out;
         sendChangeMessage();
@@ -170,6 +180,7 @@ void MidiProgramMapNode::removeProgramEntry (int index)
     {
         entries.remove (index, false);
         deleter.reset (entry);
+        EL_ASSERT_NOT_RENDERING();
         ScopedLock sl (lock);
         programMap[entry->in] = -1;
         sendChangeMessage();
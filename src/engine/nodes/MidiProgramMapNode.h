@@ -86,6 +86,7 @@ public:
 
     inline int getLastProgram() const
     {
+        EL_ASSERT_NOT_RENDERING();
         ScopedLock sl (lock);
         return lastProgram;
     }
@@ -112,6 +113,7 @@ public:
         }
 
         {
+            EL_ASSERT_NOT_RENDERING();
             ScopedLock sl (lock);
             for (const auto* const entry : entries)
                 programMap[entry->in] = entry->out;
@@ -85,6 +85,7 @@ void MidiRouterNode::setMatrixState (const MatrixState& matrix)
     ToggleGrid newPatches (state);
 
     {
+        EL_ASSERT_NOT_RENDERING();
         ScopedLock sl (getLock());
         toggles.swapWith (newPatches);
         togglesChanged = true; // initiate the crossfade
@@ -106,7 +107,15 @@ void MidiRouterNode::render (AudioSampleBuffer& audio, MidiPipe& midi)
     const auto nbuffers = midi.getNumBuffers();
     audio.clear();
 
-    ScopedLock sl (getLock());
+    // the patches are only locked while they're swapped, a block which
+    // would wait for that has no MIDI instead
+    const ScopedTryLock sl (getLock());
+    if (! sl.isLocked())
+    {
+        midi.clear();
+        return;
+    }
+
     for (int src = 0; src < numSources; ++src)
     {
         if (src >= nbuffers)
@@ -162,6 +171,7 @@ void MidiRouterNode::set (int src, int dst, bool patched)
 void MidiRouterNode::clearPatches()
 {
     {
+        EL_ASSERT_NOT_RENDERING();
         ScopedLock sl (getLock());
         toggles.clear();
         nextToggles.clear();
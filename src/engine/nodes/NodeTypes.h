@@ -44,6 +44,7 @@
 #define EL_INTERNAL_ID_GRAPH "element.graph"
 #define EL_INTERNAL_ID_LUA "element.lua"
 #define EL_INTERNAL_ID_MIDI_CHANNEL_SPLITTER "element.midiChannelSplitter"
+#define EL_INTERNAL_ID_MIDI_FILE_PLAYER "element.midiFilePlayer"
 #define EL_INTERNAL_ID_MIDI_MONITOR "element.midiMonitor"
 #define EL_INTERNAL_ID_MIDI_PROGRAM_MAP "element.programChangeMap"
 #define EL_INTERNAL_ID_MIDI_ROUTER "element.midiRouter"
@@ -80,3 +81,4 @@
 #define EL_INTERNAL_UID_SCRIPT 1024
 #define EL_INTERNAL_UID_ALLPASS_FILTER 1025
 #define EL_INTERNAL_UID_VOLUME 1026
+#define EL_INTERNAL_UID_MIDI_FILE_PLAYER 1027
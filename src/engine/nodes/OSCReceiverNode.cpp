@@ -91,12 +91,7 @@ inline void OSCReceiverNode::refreshPorts()
 
 void OSCReceiverNode::prepareToRender (double sampleRate, int maxBufferSize)
 {
-    if (! outputMidiMessagesInitDone)
-    {
-        outputMidiMessages.reset (sampleRate);
-        currentSampleRate = sampleRate;
-        outputMidiMessagesInitDone = true;
-    }
+    outputClock.reset (sampleRate, maxBufferSize);
 }
 
 void OSCReceiverNode::render (AudioSampleBuffer& audio, MidiPipe& midi)
@@ -106,7 +101,8 @@ void OSCReceiverNode::render (AudioSampleBuffer& audio, MidiPipe& midi)
         return;
 
     midi.clear();
-    outputMidiMessages.removeNextBlockOfMessages (*midi.getWriteBuffer (0), nframes);
+    outputClock.advance (Time::getMillisecondCounterHiRes() * 0.001, nframes);
+    outputMidiMessages.collect (*midi.getWriteBuffer (0), outputClock, nframes);
 }
 
 /** OSCReceiver real-time callbacks */
@@ -116,12 +112,10 @@ void OSCReceiverNode::oscMessageReceived (const OSCMessage& message)
     if (paused)
         return;
 
-    auto timestamp = Time::getMillisecondCounterHiRes();
-
     MidiMessage midiMsg = Util::processOscToMidiMessage (message);
-    midiMsg.setTimeStamp (timestamp);
+    midiMsg.setTimeStamp (Time::getMillisecondCounterHiRes() * 0.001);
 
-    outputMidiMessages.addMessageToQueue (midiMsg);
+    outputMidiMessages.push (midiMsg);
 };
 
 void OSCReceiverNode::oscBundleReceived (const OSCBundle& bundle) {};
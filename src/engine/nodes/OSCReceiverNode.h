@@ -20,6 +20,7 @@
 
 #pragma once
 
+#include "engine/midiinputqueue.hpp"
 #include "engine/midipipe.hpp"
 #include "engine/nodes/BaseProcessor.h"
 #include "engine/nodes/MidiFilterNode.h"
@@ -54,6 +55,7 @@ public:
     void prepareToRender (double sampleRate, int maxBufferSize) override;
     void releaseResources() override {};
     void render (AudioSampleBuffer& audio, MidiPipe& midi) override;
+    bool rendersLive() const override { return true; }
     void setState (const void* data, int size) override;
     void getState (MemoryBlock& block) override;
 
@@ -76,9 +78,9 @@ public:
 private:
     /** MIDI */
     bool createdPorts = false;
-    double currentSampleRate;
-    bool outputMidiMessagesInitDone = false;
-    MidiMessageCollector outputMidiMessages;
+    // pushed by the receiver's thread, placed in blocks by when they arrived
+    MidiInputQueue outputMidiMessages;
+    MidiBlockClock outputClock;
 
     /** OSC */
     OSCReceiver oscReceiver;
@@ -88,14 +88,13 @@ void OSCSenderNode::run()
         /** MIDI queue -> OSC messages */
 
         MidiBuffer messages;
-
-        midiMessageQueue.removeNextBlockOfMessages (messages, numSamples.get());
-        numSamples = 0;
+        midiMessageQueue.collectAll (messages);
 
         MidiBuffer::Iterator iter1 (messages);
         MidiMessage msg;
         int frame;
 
+        EL_ASSERT_NOT_RENDERING();
         ScopedLock sl (lock);
 
         while (iter1.getNextEvent (msg, frame))
@@ -139,12 +138,7 @@ inline void OSCSenderNode::refreshPorts()
 
 void OSCSenderNode::prepareToRender (double sampleRate, int maxBufferSize)
 {
-    if (! midiMessageQueueInitDone)
-    {
-        midiMessageQueue.reset (sampleRate);
-        currentSampleRate = sampleRate;
-        midiMessageQueueInitDone = true;
-    }
+    ignoreUnused (sampleRate, maxBufferSize);
 };
 
 void OSCSenderNode::render (AudioSampleBuffer& audio, MidiPipe& midi)
@@ -158,18 +152,10 @@ void OSCSenderNode::render (AudioSampleBuffer& audio, MidiPipe& midi)
         return;
     }
 
-    MidiBuffer::Iterator iter1 (*midiIn);
-    MidiMessage msg;
-    int frame;
-    auto timestamp = Time::getMillisecondCounterHiRes();
-
-    while (iter1.getNextEvent (msg, frame))
-    {
-        msg.setTimeStamp (timestamp + (1000.0 * (static_cast<double> (frame) / currentSampleRate)));
-        midiMessageQueue.addMessageToQueue (msg);
-    }
+    // the sender's thread sends them in order as soon as it wakes
+    for (const auto metadata : *midiIn)
+        midiMessageQueue.push (metadata.getMessage());
 
-    numSamples += nframes;
     sem.post();
     midiIn->clear();
 }
@@ -251,6 +237,7 @@ std::vector<OSCMessage> OSCSenderNode::getOscMessages()
     std::vector<OSCMessage> copied;
 
     {
+        EL_ASSERT_NOT_RENDERING();
         ScopedLock sl (lock);
         std::copy (oscMessagesToLog.begin(), oscMessagesToLog.end(), std::back_inserter (copied));
         oscMessagesToLog.clear();
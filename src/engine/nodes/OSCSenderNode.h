@@ -20,6 +20,7 @@
 
 #pragma once
 
+#include "engine/midiinputqueue.hpp"
 #include "engine/midipipe.hpp"
 #include "engine/nodes/BaseProcessor.h"
 #include "engine/nodes/MidiFilterNode.h"
@@ -65,6 +66,7 @@ public:
     void prepareToRender (double sampleRate, int maxBufferSize) override;
     void render (AudioSampleBuffer& audio, MidiPipe& midi) override;
     void releaseResources() override {};
+    bool rendersLive() const override { return true; }
 
     void refreshPorts() override;
 
@@ -107,12 +109,8 @@ private:
     /** GUI */
     std::vector<OSCMessage> oscMessagesToLog;
 
-    /** To be processed and sent as OSC messages */
-    MidiMessageCollector midiMessageQueue;
-
-    Atomic<int> numSamples = 0;
-    double currentSampleRate = 0;
-    bool midiMessageQueueInitDone = false;
+    /** To be processed and sent as OSC messages, pushed while rendering */
+    MidiInputQueue midiMessageQueue;
 };
 
 } // namespace element
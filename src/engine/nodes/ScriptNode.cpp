@@ -105,6 +105,7 @@ Result ScriptNode::loadScript (const String& newCode)
         if (prepared)
             newScript->prepare (sampleRate, blockSize);
         triggerPortReset();
+        EL_ASSERT_NOT_RENDERING();
         ScopedLock sl (lock);
         if (script != nullptr)
             newScript->copyParameterValues (*script);
@@ -156,7 +157,15 @@ void ScriptNode::releaseResources()
 
 void ScriptNode::render (AudioSampleBuffer& audio, MidiPipe& midi)
 {
-    ScopedLock sl (lock);
+    // silent while a script is swapped in, rather than wait for it
+    const ScopedTryLock sl (lock);
+    if (! sl.isLocked())
+    {
+        audio.clear();
+        midi.clear();
+        return;
+    }
+
     script->process (audio, midi);
 }
 
@@ -206,6 +215,7 @@ void ScriptNode::getState (MemoryBlock& out)
 
 void ScriptNode::setParameter (int index, float value)
 {
+    EL_ASSERT_NOT_RENDERING();
     ScopedLock sl (lock);
 }
 
@@ -20,6 +20,7 @@
 */
 
 #include "engine/parameter.hpp"
+#include "engine/renderguard.hpp"
 
 namespace element {
 
@@ -75,7 +76,11 @@ void Parameter::endChangeGesture()
 
 void Parameter::sendValueChangedMessageToListeners (float newValue)
 {
-    ScopedLock lock (listenerLock);
+    // values can change on the audio thread, which skips the listeners
+    // rather than wait on one being added or removed
+    const ScopedTryLock lock (listenerLock);
+    if (! lock.isLocked())
+        return;
     for (int i = listeners.size(); --i >= 0;)
         if (auto* l = listeners[i])
             l->controlValueChanged (getParameterIndex(), newValue);
@@ -83,7 +88,9 @@ void Parameter::sendValueChangedMessageToListeners (float newValue)
 
 void Parameter::sendGestureChangedMessageToListeners (bool touched)
 {
-    ScopedLock lock (listenerLock);
+    const ScopedTryLock lock (listenerLock);
+    if (! lock.isLocked())
+        return;
     for (int i = listeners.size(); --i >= 0;)
         if (auto* l = listeners[i])
             l->controlTouched (getParameterIndex(), touched);
@@ -122,12 +129,14 @@ StringArray Parameter::getValueStrings() const
 
 void Parameter::addListener (Parameter::Listener* newListener)
 {
+    EL_ASSERT_NOT_RENDERING();
     const ScopedLock sl (listenerLock);
     listeners.addIfNotAlreadyThere (newListener);
 }
 
 void Parameter::removeListener (Parameter::Listener* listenerToRemove)
 {
+    EL_ASSERT_NOT_RENDERING();
     const ScopedLock sl (listenerLock);
     listeners.removeFirstMatchingValue (listenerToRemove);
 }
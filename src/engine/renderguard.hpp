@@ -0,0 +1,65 @@
+/*
+    This file is part of Element
+    Copyright (C) 2021  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+
+#pragma once
+
+#include "ElementApp.h"
+
+namespace element {
+
+/** Marks the calling thread as rendering while in scope.
+
+    Debug builds use this to catch locks taken while rendering, which can
+    block the audio thread on a lower priority one.  Code which locks
+    should assert that isRendering() is false.
+*/
+class ScopedRenderGuard
+{
+public:
+#if JUCE_DEBUG
+    ScopedRenderGuard() noexcept { ++getDepth(); }
+    ~ScopedRenderGuard() noexcept { --getDepth(); }
+
+    /** True if the calling thread is inside a ScopedRenderGuard */
+    static bool isRendering() noexcept { return getDepth() > 0; }
+
+private:
+    static int& getDepth() noexcept
+    {
+        static thread_local int depth = 0;
+        return depth;
+    }
+#else
+    ScopedRenderGuard() noexcept {}
+    ~ScopedRenderGuard() noexcept {}
+
+    static constexpr bool isRendering() noexcept { return false; }
+#endif
+
+    JUCE_DECLARE_NON_COPYABLE (ScopedRenderGuard)
+};
+
+} // namespace element
+
+/** Asserts the calling thread isn't rendering.  Put this before every lock
+    which can block, rendering code should try the lock and carry on without
+    it instead.
+*/
+#define EL_ASSERT_NOT_RENDERING() jassert (! element::ScopedRenderGuard::isRendering())
@@ -0,0 +1,277 @@
+/*
+    This file is part of Element
+    Copyright (C) 2021  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+
+#include <thread>
+
+#include "engine/renderscheduler.hpp"
+
+namespace element {
+
+//==============================================================================
+/** A bounded work stealing deque (Chase-Lev).  Only the owning thread may
+    push and pop, any thread may steal.  Capacity is fixed when preparing so
+    nothing is allocated while rendering.
+ */
+class RenderScheduler::TaskQueue
+{
+public:
+    TaskQueue() = default;
+
+    void setCapacity (const int newCapacity)
+    {
+        const int newSize = nextPowerOfTwo (jmax (1, newCapacity));
+        if (newSize != size)
+        {
+            size = newSize;
+            slots.reset (new std::atomic<int>[(size_t) size]);
+        }
+
+        reset();
+    }
+
+    void reset() noexcept
+    {
+        top.store (0);
+        bottom.store (0);
+    }
+
+    void push (const int task) noexcept
+    {
+        const int64 b = bottom.load (std::memory_order_relaxed);
+        slots[(size_t) (b & (size - 1))].store (task, std::memory_order_relaxed);
+        std::atomic_thread_fence (std::memory_order_release);
+        bottom.store (b + 1, std::memory_order_relaxed);
+    }
+
+    int pop() noexcept
+    {
+        const int64 b = bottom.load (std::memory_order_relaxed) - 1;
+        bottom.store (b, std::memory_order_relaxed);
+        std::atomic_thread_fence (std::memory_order_seq_cst);
+        int64 t = top.load (std::memory_order_relaxed);
+
+        if (t > b)
+        {
+            bottom.store (b + 1, std::memory_order_relaxed);
+            return -1;
+        }
+
+        int task = slots[(size_t) (b & (size - 1))].load (std::memory_order_relaxed);
+
+        if (t == b)
+        {
+            // last item, race against thieves for it
+            if (! top.compare_exchange_strong (t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                task = -1;
+            bottom.store (b + 1, std::memory_order_relaxed);
+        }
+
+        return task;
+    }
+
+    int steal() noexcept
+    {
+        int64 t = top.load (std::memory_order_acquire);
+        std::atomic_thread_fence (std::memory_order_seq_cst);
+        const int64 b = bottom.load (std::memory_order_acquire);
+
+        if (t >= b)
+            return -1;
+
+        const int task = slots[(size_t) (t & (size - 1))].load (std::memory_order_relaxed);
+        if (! top.compare_exchange_strong (t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            return -1;
+
+        return task;
+    }
+
+private:
+    std::unique_ptr<std::atomic<int>[]> slots;
+    int size = 0;
+    std::atomic<int64> top { 0 }, bottom { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE (TaskQueue)
+};
+
+//==============================================================================
+class RenderScheduler::Worker : public Thread
+{
+public:
+    Worker (RenderScheduler& s, const int index)
+        : Thread ("element: render worker " + String (index)),
+          scheduler (s),
+          threadIndex (index) {}
+
+    void run() override
+    {
+        while (! threadShouldExit())
+        {
+            scheduler.wakeup.wait();
+            if (threadShouldExit())
+                break;
+            scheduler.participate (threadIndex);
+        }
+    }
+
+private:
+    RenderScheduler& scheduler;
+    const int threadIndex;
+};
+
+//==============================================================================
+RenderScheduler::RenderScheduler()
+{
+    queues.add (new TaskQueue());
+}
+
+RenderScheduler::~RenderScheduler()
+{
+    stopWorkers();
+}
+
+void RenderScheduler::setNumThreads (int newNumThreads)
+{
+    newNumThreads = jlimit (1, jmax (1, SystemStats::getNumCpus()), newNumThreads);
+    if (newNumThreads == numThreads)
+        return;
+
+    stopWorkers();
+    numThreads = newNumThreads;
+
+    queues.clear();
+    for (int i = 0; i < numThreads; ++i)
+        queues.add (new TaskQueue())->setCapacity (capacity);
+
+    for (int i = 1; i < numThreads; ++i)
+        workers.add (new Worker (*this, i))->startThread (10);
+}
+
+void RenderScheduler::prepare (const Array<GraphTask>& tasks)
+{
+    if (tasks.size() <= capacity)
+        return;
+
+    capacity = tasks.size();
+    pending.reset (new std::atomic<int>[(size_t) capacity]);
+    for (auto* queue : queues)
+        queue->setCapacity (capacity);
+}
+
+void RenderScheduler::perform (RenderProgram& program, const int numSamples)
+{
+    programJob.program = &program;
+    programJob.numSamples = numSamples;
+    perform (program.tasks, programJob);
+}
+
+void RenderScheduler::perform (const Array<GraphTask>& tasks, Job& job)
+{
+    jassert (tasks.size() <= capacity);
+    currentTasks = &tasks;
+    currentJob = &job;
+
+    for (auto* queue : queues)
+        queue->reset();
+
+    auto& queue = *queues.getUnchecked (0);
+    for (int i = 0; i < tasks.size(); ++i)
+    {
+        const int numDependencies = tasks.getReference (i).numDependencies;
+        pending[(size_t) i].store (numDependencies, std::memory_order_relaxed);
+        if (numDependencies == 0)
+            queue.push (i);
+    }
+
+    remaining.store (tasks.size());
+    running.store (true);
+
+    for (int i = workers.size(); --i >= 0;)
+        wakeup.post();
+
+    work (0);
+
+    // workers may still be looking for tasks, they need to be out before
+    // the queues are touched again.
+    running.store (false);
+    while (active.load() > 0)
+        std::this_thread::yield();
+}
+
+void RenderScheduler::stopWorkers()
+{
+    for (auto* worker : workers)
+        worker->signalThreadShouldExit();
+    for (int i = workers.size(); --i >= 0;)
+        wakeup.post();
+    for (auto* worker : workers)
+        worker->stopThread (1000);
+    workers.clear();
+}
+
+void RenderScheduler::participate (const int threadIndex)
+{
+    ScopedNoDenormals denormals;
+    active.fetch_add (1);
+    if (running.load())
+        work (threadIndex);
+    active.fetch_sub (1);
+}
+
+void RenderScheduler::work (const int threadIndex)
+{
+    auto& queue = *queues.getUnchecked (threadIndex);
+    const int numQueues = queues.size();
+
+    while (remaining.load() > 0)
+    {
+        int task = queue.pop();
+
+        for (int i = 1; task < 0 && i < numQueues; ++i)
+            task = queues.getUnchecked ((threadIndex + i) % numQueues)->steal();
+
+        if (task < 0)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        performTask (threadIndex, task);
+    }
+}
+
+void RenderScheduler::performTask (const int threadIndex, const int taskIndex)
+{
+    currentJob->performTask (taskIndex);
+
+    auto& queue = *queues.getUnchecked (threadIndex);
+    for (const auto dependent : currentTasks->getReference (taskIndex).dependents)
+        if (pending[(size_t) dependent].fetch_sub (1) == 1)
+            queue.push (dependent);
+
+    remaining.fetch_sub (1);
+}
+
+void RenderScheduler::ProgramJob::performTask (const int taskIndex)
+{
+    const auto& task = program->tasks.getReference (taskIndex);
+    program->perform (task.firstOp, task.numOps, numSamples);
+}
+
+} // namespace element
@@ -0,0 +1,108 @@
+/*
+    This file is part of Element
+    Copyright (C) 2021  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+
+#pragma once
+
+#include "ElementApp.h"
+#include "engine/graphbuilder.hpp"
+#include "semaphore.hpp"
+
+namespace element {
+
+/** Performs the tasks of a rendering sequence on a pool of realtime threads.
+
+    The thread calling perform() takes part in rendering, so a scheduler
+    using N threads runs N - 1 workers.  Tasks made ready by a thread are
+    pushed on to that thread's queue, idle threads steal from the others.
+ */
+class RenderScheduler
+{
+public:
+    RenderScheduler();
+    ~RenderScheduler();
+
+    /** Change the number of threads used to render, including the calling
+        thread.  One means tasks should be performed serially.  This must
+        not be called while perform() is running.  Not realtime safe.
+     */
+    void setNumThreads (int numThreads);
+
+    /** Returns the number of threads used to render. */
+    int getNumThreads() const noexcept { return numThreads; }
+
+    /** Allocates storage for a set of tasks.  Not realtime safe. */
+    void prepare (const Array<GraphTask>& tasks);
+
+    /** Performs tasks by index on behalf of the scheduler */
+    class Job
+    {
+    public:
+        virtual ~Job() = default;
+
+        /** Perform a single task. This is called from any of the
+            scheduler's threads */
+        virtual void performTask (int taskIndex) = 0;
+    };
+
+    /** Performs all tasks with a job and returns when they are done.  The
+        tasks must have been passed to prepare() first.
+     */
+    void perform (const Array<GraphTask>& tasks, Job& job);
+
+    /** Performs all tasks of a program and returns when they are done.
+        The program's tasks must have been passed to prepare() first.
+     */
+    void perform (RenderProgram& program, const int numSamples);
+
+private:
+    class TaskQueue;
+    class Worker;
+
+    int numThreads = 1;
+    int capacity = 0;
+    OwnedArray<TaskQueue> queues;
+    OwnedArray<Worker> workers;
+    std::unique_ptr<std::atomic<int>[]> pending;
+
+    Semaphore wakeup;
+    std::atomic<bool> running { false };
+    std::atomic<int> remaining { 0 };
+    std::atomic<int> active { 0 };
+
+    const Array<GraphTask>* currentTasks = nullptr;
+    Job* currentJob = nullptr;
+
+    struct ProgramJob : public Job
+    {
+        RenderProgram* program = nullptr;
+        int numSamples = 0;
+
+        void performTask (int taskIndex) override;
+    } programJob;
+
+    void stopWorkers();
+    void participate (int threadIndex);
+    void work (int threadIndex);
+    void performTask (int threadIndex, int taskIndex);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (RenderScheduler)
+};
+
+} // namespace element
@@ -200,6 +200,9 @@ public:
         int index = 30000;
         NodeObjectPtr ptr = node.getObject();
         menu.addItem (index++, "Mute input ports", ptr != nullptr, ptr && ptr->isMutingInputs());
+        const bool canFreeze = ptr != nullptr && ptr->getParentGraph() != nullptr && ! ptr->isAudioIONode() && ! ptr->isMidiIONode();
+        menu.addItem (index++, "Freeze", canFreeze, node.isFrozen());
+        menu.addItem (index++, "Freeze and unload", canFreeze && ! node.isFrozen());
         addOversamplingSubmenu (menu);
         addSubMenu (TRANS ("Options"), menu, ptr != nullptr);
     }
@@ -362,6 +365,13 @@ public:
                 case 0:
                     node.setMuteInput (! node.isMutingInputs());
                     break;
+                case 1:
+                case 2: {
+                    const auto result = node.setFrozen (! node.isFrozen(), index == 2);
+                    if (result.failed())
+                        AlertWindow::showMessageBoxAsync (AlertWindow::WarningIcon, "Freeze", result.getErrorMessage());
+                    break;
+                }
             }
         }
         else if (result >= 40000 && result < 50000)
@@ -59,6 +59,7 @@ public:
 
     ~NodeChannelStripComponent()
     {
+        setMeteredObject (nullptr);
         unbindSignals();
     }
 
@@ -125,6 +126,9 @@ public:
         auto& meter = channelStrip.getDigitalMeter();
         if (NodeObjectPtr ptr = node.getObject())
         {
+            // levels are only measured while the strip can be seen
+            setMeteredObject (isShowing() ? ptr : nullptr);
+
             const int startChannel = jmax (0, channelBox.getSelectedId() - 1);
             if (ptr->getNumAudioOutputs() == 1)
             {
@@ -156,6 +160,7 @@ public:
         }
         else
         {
+            setMeteredObject (nullptr);
             meter.resetPeaks();
             stopTimer();
         }
@@ -196,6 +201,7 @@ public:
     inline void setNode (const Node& newNode)
     {
         stopTimer();
+        setMeteredObject (nullptr);
         node = newNode;
         isAudioOutNode = node.isAudioOutputNode();
         isAudioInNode = node.isAudioInputNode();
@@ -266,6 +272,7 @@ private:
     bool monoMeter = false;
 
     Value displayName;
+    NodeObjectPtr meteredObject;
 
     SignalConnection nodeSelectedConnection;
     SignalConnection volumeChangedConnection;
@@ -276,6 +283,17 @@ private:
     inline bool isMonitoringInputs() const { return flowBox.getSelectedId() == 1; }
     inline bool isMonitoringOutputs() const { return flowBox.getSelectedId() == 2; }
 
+    void setMeteredObject (NodeObject* object)
+    {
+        if (meteredObject.get() == object)
+            return;
+        if (meteredObject != nullptr)
+            meteredObject->removeMeterSubscriber();
+        meteredObject = object;
+        if (meteredObject != nullptr)
+            meteredObject->addMeterSubscriber();
+    }
+
     void valueChanged (Value& value) override
     {
         if (value.refersToSameSourceAs (displayName))
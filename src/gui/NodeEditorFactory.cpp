@@ -5,6 +5,7 @@
 
 #include "gui/nodes/AudioIONodeEditor.h"
 #include "gui/nodes/AudioRouterEditor.h"
+#include "gui/nodes/MidiFilePlayerNodeEditor.h"
 #include "gui/nodes/MidiIONodeEditor.h"
 #include "gui/nodes/MidiMonitorNodeEditor.h"
 #include "gui/nodes/MidiProgramMapEditor.h"
@@ -66,6 +67,10 @@ private:
         {
             return new MidiMonitorNodeEditor (node);
         }
+        else if (NID == EL_INTERNAL_ID_MIDI_FILE_PLAYER)
+        {
+            return new MidiFilePlayerNodeEditor (node);
+        }
         else if (NID == EL_INTERNAL_ID_OSC_RECEIVER)
         {
             return new OSCReceiverNodeEditor (node);
@@ -0,0 +1,105 @@
+/*
+    This file is part of Element
+    Copyright (C) 2021  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+
+#include "engine/nodes/MidiFilePlayerNode.h"
+#include "gui/nodes/MidiFilePlayerNodeEditor.h"
+
+namespace element {
+
+MidiFilePlayerNodeEditor::MidiFilePlayerNodeEditor (const Node& node)
+    : NodeEditorComponent (node),
+      fileChooser ("MIDI File", File(), false, false, false, "*.mid;*.midi;*.smf", "", "Choose a MIDI file")
+{
+    setOpaque (true);
+
+    addAndMakeVisible (fileChooser);
+    fileChooser.addListener (this);
+
+    addAndMakeVisible (loopButton);
+    loopButton.setButtonText ("Loop");
+    loopButton.onClick = [this]() {
+        if (auto* player = getNodeObjectOfType<MidiFilePlayerNode>())
+            player->setLooping (loopButton.getToggleState());
+    };
+
+    addAndMakeVisible (fileTempoButton);
+    fileTempoButton.setButtonText ("Follow file tempo");
+    fileTempoButton.onClick = [this]() {
+        if (auto* player = getNodeObjectOfType<MidiFilePlayerNode>())
+            player->setFollowingFileTempo (fileTempoButton.getToggleState());
+    };
+
+    addAndMakeVisible (errorLabel);
+    errorLabel.setFont (Font (12.f));
+
+    if (auto* player = getNodeObjectOfType<MidiFilePlayerNode>())
+        fileChangedConnection = player->fileChanged.connect (
+            std::bind (&MidiFilePlayerNodeEditor::updateControls, this));
+
+    updateControls();
+    setSize (320, 90);
+}
+
+MidiFilePlayerNodeEditor::~MidiFilePlayerNodeEditor()
+{
+    fileChangedConnection.disconnect();
+    fileChooser.removeListener (this);
+}
+
+void MidiFilePlayerNodeEditor::updateControls()
+{
+    if (auto* player = getNodeObjectOfType<MidiFilePlayerNode>())
+    {
+        fileChooser.setCurrentFile (player->getFile(), false, dontSendNotification);
+        loopButton.setToggleState (player->isLooping(), dontSendNotification);
+        fileTempoButton.setToggleState (player->isFollowingFileTempo(), dontSendNotification);
+    }
+}
+
+void MidiFilePlayerNodeEditor::filenameComponentChanged (FilenameComponent*)
+{
+    auto* player = getNodeObjectOfType<MidiFilePlayerNode>();
+    if (player == nullptr)
+        return;
+
+    const auto file = fileChooser.getCurrentFile();
+    if (file == player->getFile())
+        return;
+
+    const auto result = file.existsAsFile() ? player->loadFile (file)
+                                            : Result::fail ("File not found");
+    errorLabel.setText (result.getErrorMessage(), dontSendNotification);
+    if (result.failed())
+        updateControls();
+}
+
+void MidiFilePlayerNodeEditor::resized()
+{
+    auto r = getLocalBounds().reduced (4);
+    fileChooser.setBounds (r.removeFromTop (24));
+    r.removeFromTop (4);
+    auto row = r.removeFromTop (24);
+    loopButton.setBounds (row.removeFromLeft (80));
+    fileTempoButton.setBounds (row.removeFromLeft (160));
+    r.removeFromTop (4);
+    errorLabel.setBounds (r.removeFromTop (20));
+}
+
+} // namespace element
@@ -0,0 +1,48 @@
+/*
+    This file is part of Element
+    Copyright (C) 2021  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+
+#pragma once
+
+#include "gui/nodes/NodeEditorComponent.h"
+#include "signals.hpp"
+
+namespace element {
+
+class MidiFilePlayerNodeEditor : public NodeEditorComponent,
+                                 private FilenameComponentListener
+{
+public:
+    MidiFilePlayerNodeEditor (const Node& node);
+    ~MidiFilePlayerNodeEditor();
+
+    void paint (Graphics& g) override { g.fillAll (findColour (TextEditor::backgroundColourId).darker()); }
+    void resized() override;
+
+private:
+    FilenameComponent fileChooser;
+    ToggleButton loopButton, fileTempoButton;
+    Label errorLabel;
+    SignalConnection fileChangedConnection;
+
+    void filenameComponentChanged (FilenameComponent*) override;
+    void updateControls();
+};
+
+} // namespace element
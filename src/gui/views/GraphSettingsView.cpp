@@ -96,6 +96,90 @@ protected:
     Node graph;
 };
 
+class RenderThreadsPropertyComponent : public SliderPropertyComponent
+{
+public:
+    RenderThreadsPropertyComponent (const Node& g)
+        : SliderPropertyComponent ("Render Threads", 1.0, (double) jmax (1, SystemStats::getNumCpus()), 1.0, 1.0, false),
+          graph (g)
+    {
+        jassert (graph.isRootGraph());
+        slider.updateText();
+    }
+
+    void setValue (double v) override
+    {
+        const int numThreads = roundToInt (v);
+        graph.setProperty (Tags::renderThreads, numThreads);
+        if (auto* root = dynamic_cast<RootGraph*> (graph.getObject()))
+            root->setNumRenderThreads (numThreads);
+    }
+
+    double getValue() const override
+    {
+        return (double) graph.getProperty (Tags::renderThreads, 1);
+    }
+
+private:
+    Node graph;
+};
+
+class LookAheadPropertyComponent : public SliderPropertyComponent
+{
+public:
+    LookAheadPropertyComponent (const Node& g)
+        : SliderPropertyComponent ("Look-ahead Blocks", 0.0, 16.0, 1.0, 1.0, false),
+          graph (g)
+    {
+        jassert (graph.isRootGraph());
+        slider.updateText();
+    }
+
+    void setValue (double v) override
+    {
+        const int numBlocks = roundToInt (v);
+        graph.setProperty (Tags::lookAheadBlocks, numBlocks);
+        if (auto* root = dynamic_cast<RootGraph*> (graph.getObject()))
+            root->setLookAheadBlocks (numBlocks);
+    }
+
+    double getValue() const override
+    {
+        return (double) graph.getProperty (Tags::lookAheadBlocks, 0);
+    }
+
+private:
+    Node graph;
+};
+
+class DoublePrecisionPropertyComponent : public BooleanPropertyComponent
+{
+public:
+    DoublePrecisionPropertyComponent (const Node& g)
+        : BooleanPropertyComponent ("64-bit Processing", "Enabled", "Disabled"),
+          graph (g)
+    {
+        jassert (graph.isRootGraph());
+        refresh();
+    }
+
+    void setState (bool newState) override
+    {
+        graph.setProperty (Tags::doublePrecision, newState);
+        if (auto* root = dynamic_cast<RootGraph*> (graph.getObject()))
+            root->setDoublePrecision (newState);
+        refresh();
+    }
+
+    bool getState() const override
+    {
+        return (bool) graph.getProperty (Tags::doublePrecision, false);
+    }
+
+private:
+    Node graph;
+};
+
 class VelocityCurvePropertyComponent : public ChoicePropertyComponent
 {
 public:
@@ -392,6 +476,9 @@ private:
                                               false));
 #ifndef EL_SOLO
         props.add (new RenderModePropertyComponent (g));
+        props.add (new RenderThreadsPropertyComponent (g));
+        props.add (new LookAheadPropertyComponent (g));
+        props.add (new DoublePrecisionPropertyComponent (g));
         props.add (new VelocityCurvePropertyComponent (g));
 #endif
 
@@ -74,9 +74,13 @@ struct RootGraphHolder
             const auto mode = modeStr == "single" ? RootGraph::SingleGraph : RootGraph::Parallel;
             const auto channels = model.getMidiChannels();
             const auto program = (int) model.getProperty ("midiProgram", -1);
+            const auto numThreads = (int) model.getProperty (Tags::renderThreads, 1);
 
             root->setPlayConfigFor (devices);
             root->setRenderMode (mode);
+            root->setNumRenderThreads (numThreads);
+            root->setDoublePrecision ((bool) model.getProperty (Tags::doublePrecision, false));
+            root->setLookAheadBlocks ((int) model.getProperty (Tags::lookAheadBlocks, 0));
             root->setMidiChannels (channels);
             root->setMidiProgram (program);
 
@@ -439,6 +443,18 @@ void EngineService::removeConnection (const uint32 s, const uint32 sp, const uin
         controller->removeConnection (s, sp, d, dp);
 }
 
+void EngineService::beginBatch (const Node& graph)
+{
+    if (auto* controller = graphs->findGraphManagerFor (graph))
+        controller->beginBatch();
+}
+
+void EngineService::commit (const Node& graph)
+{
+    if (auto* controller = graphs->findGraphManagerFor (graph))
+        controller->commit();
+}
+
 Node EngineService::addNode (const Node& node, const Node& target, const ConnectionBuilder& builder)
 {
     if (auto* controller = graphs->findGraphManagerFor (target))
@@ -102,6 +102,14 @@ public:
     /** Remove a connection on the specified graph */
     void removeConnection (const uint32, const uint32, const uint32, const uint32, const Node& target);
 
+    /** Starts a batch of edits on a graph.  The graph is compiled and its
+        model updated once, when the matching commit() is called.
+     */
+    void beginBatch (const Node& graph);
+
+    /** Ends a batch of edits on a graph started with beginBatch() */
+    void commit (const Node& graph);
+
     /** Disconnect the provided node */
     void disconnectNode (const Node& node, const bool inputs = true, const bool outputs = true, const bool audio = true, const bool midi = true);
 
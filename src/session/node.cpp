@@ -842,6 +842,12 @@ void Node::restorePluginState()
 
         obj->setOversamplingFactor (jmax (1, (int) getProperty (Tags::oversamplingFactor, 1)));
         obj->setDelayCompensation (getProperty (Tags::delayCompensation, 0.0));
+
+        // rendered once the graph is connected and prepared
+        if (isFrozen())
+            if (auto* const graph = obj->getParentGraph())
+                if (graph->freezeNode (obj->nodeId, (double) getProperty (Tags::freezeLength, 300.0), (bool) getProperty (Tags::freezeUnloads, false)).failed())
+                    setProperty (Tags::frozen, false);
     }
 
     // this was originally here to help reduce memory usage
@@ -928,6 +934,30 @@ void Node::setMuteInput (bool shouldMuteInputs)
         obj->setMuteInput (isMutingInputs());
 }
 
+Result Node::setFrozen (const bool shouldBeFrozen, const bool unload)
+{
+    NodeObjectPtr obj = getObject();
+    auto* const graph = obj != nullptr ? obj->getParentGraph() : nullptr;
+    if (graph == nullptr)
+        return Result::fail ("Only nodes in a graph can be frozen");
+
+    if (! shouldBeFrozen)
+    {
+        graph->unfreezeNode (obj->nodeId);
+        setProperty (Tags::frozen, false);
+        return Result::ok();
+    }
+
+    const auto result = graph->freezeNode (obj->nodeId, (double) getProperty (Tags::freezeLength, 300.0), unload);
+    if (result.wasOk())
+    {
+        setProperty (Tags::frozen, true);
+        setProperty (Tags::freezeUnloads, unload);
+    }
+
+    return result;
+}
+
 void Node::setCurrentProgram (const int index)
 {
     if (auto* obj = getObject())
@@ -975,6 +1005,7 @@ void ConnectionBuilder::addConnections (GraphManager& controller, const uint32 t
     if (tgt)
     {
         bool anythingAdded = false;
+        controller.beginBatch();
         for (const auto* pc : portChannelMap)
         {
             NodeObjectPtr ptr = controller.getNodeForId (pc->nodeId);
@@ -995,6 +1026,7 @@ void ConnectionBuilder::addConnections (GraphManager& controller, const uint32 t
 
         if (anythingAdded)
             controller.syncArcsModel();
+        controller.commit();
     }
     else
     {
@@ -241,6 +241,18 @@ public:
     /** Change the mute status of inputs on this Node */
     void setMuteInput (bool);
 
+    //=========================================================================
+    /** Returns true if this Node is frozen, or will be once it's rendered */
+    bool isFrozen() const { return (bool) getProperty (Tags::frozen, false); }
+
+    /** Freezes or unfreezes this Node.  Its output is rendered in the
+        background for freezeLength seconds from the start of the transport
+        and streamed in its place.  With unload the plugin's resources are
+        released while it's frozen.  Frozen nodes are frozen again when the
+        session is loaded.
+     */
+    Result setFrozen (bool shouldBeFrozen, bool unload = false);
+
     //=========================================================================
     /** Returns the number of connections on this node */
     int getNumConnections() const;
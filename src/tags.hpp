@@ -80,6 +80,9 @@ static const juce::Identifier collapsed = "collapsed";
 static const juce::Identifier delayCompensation = "delayCompensation";
 static const juce::Identifier displayMode = "displayMode";
 static const juce::Identifier enabled = "enabled";
+static const juce::Identifier frozen = "frozen";
+static const juce::Identifier freezeLength = "freezeLength";
+static const juce::Identifier freezeUnloads = "freezeUnloads";
 static const juce::Identifier gain = "gain";
 static const juce::Identifier graphs = "graphs";
 static const juce::Identifier hiddenPorts = "hiddenPorts";
@@ -125,6 +128,9 @@ static const juce::Identifier midiProgramsEnabled = "midiProgramsEnabled";
 static const juce::Identifier globalMidiPrograms = "globalMidiPrograms";
 static const juce::Identifier midiProgramsState = "midiProgramsState";
 static const juce::Identifier renderMode = "renderMode";
+static const juce::Identifier renderThreads = "renderThreads";
+static const juce::Identifier doublePrecision = "doublePrecision";
+static const juce::Identifier lookAheadBlocks = "lookAheadBlocks";
 
 static const juce::Identifier staticPos = "staticPos";
 
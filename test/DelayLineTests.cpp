@@ -0,0 +1,125 @@
+#include <boost/test/unit_test.hpp>
+#include "engine/delayline.hpp"
+
+using namespace element;
+
+namespace {
+/** The sample at a time delay the render program used to have, kept as a
+    reference for the block based one */
+class SampleDelay
+{
+public:
+    SampleDelay (int delay)
+        : bufferSize (delay + 1), writeIndex (delay)
+    {
+        buffer.calloc ((size_t) bufferSize);
+    }
+
+    void process (float* data, int numSamples)
+    {
+        for (int i = numSamples; --i >= 0;)
+        {
+            buffer[writeIndex] = *data;
+            *data++ = buffer[readIndex];
+
+            if (++readIndex >= bufferSize)
+                readIndex = 0;
+            if (++writeIndex >= bufferSize)
+                writeIndex = 0;
+        }
+    }
+
+private:
+    HeapBlock<float> buffer;
+    int bufferSize, readIndex = 0, writeIndex;
+};
+
+void fillRamp (float* data, int numSamples, int start)
+{
+    for (int i = 0; i < numSamples; ++i)
+        data[i] = (float) (start + i + 1);
+}
+} // namespace
+
+BOOST_AUTO_TEST_SUITE (DelayLineTests)
+
+BOOST_AUTO_TEST_CASE (MatchesSampleDelay)
+{
+    // block sizes smaller than, equal to and bigger than the one prepared for
+    const int blockSizes[] = { 64, 17, 64, 1, 200, 64, 3 };
+
+    for (const int delay : { 0, 1, 63, 64, 65, 1000 })
+    {
+        DelayLine<float> line;
+        line.setDelay (delay, 64);
+        SampleDelay reference (delay);
+
+        HeapBlock<float> expected (256), inPlace (256), input (256), output (256);
+        int position = 0;
+        for (const int numSamples : blockSizes)
+        {
+            fillRamp (expected, numSamples, position);
+            fillRamp (input, numSamples, position);
+            position += numSamples;
+
+            reference.process (expected, numSamples);
+            line.process (input, output, numSamples);
+
+            for (int i = 0; i < numSamples; ++i)
+                BOOST_REQUIRE_EQUAL (output[i], expected[i]);
+        }
+
+        // the same again, in place
+        DelayLine<float> inPlaceLine;
+        inPlaceLine.setDelay (delay, 64);
+        SampleDelay inPlaceReference (delay);
+        position = 0;
+        for (const int numSamples : blockSizes)
+        {
+            fillRamp (expected, numSamples, position);
+            fillRamp (inPlace, numSamples, position);
+            position += numSamples;
+
+            inPlaceReference.process (expected, numSamples);
+            inPlaceLine.process (inPlace, inPlace, numSamples);
+
+            for (int i = 0; i < numSamples; ++i)
+                BOOST_REQUIRE_EQUAL (inPlace[i], expected[i]);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE (DelayLineBenchmarks, *boost::unit_test::disabled())
+
+BOOST_AUTO_TEST_CASE (ProcessTime)
+{
+    const int numBlocks = 20000;
+
+    for (const int numSamples : { 64, 512 })
+    {
+        for (const int delay : { 64, 4096, 48000 })
+        {
+            HeapBlock<float> data ((size_t) numSamples, true);
+
+            SampleDelay reference (delay);
+            double start = Time::getMillisecondCounterHiRes();
+            for (int block = 0; block < numBlocks; ++block)
+                reference.process (data, numSamples);
+            const double sampleNs = (Time::getMillisecondCounterHiRes() - start) * 1.0e6 / numBlocks;
+
+            DelayLine<float> line;
+            line.setDelay (delay, numSamples);
+            start = Time::getMillisecondCounterHiRes();
+            for (int block = 0; block < numBlocks; ++block)
+                line.process (data, data, numSamples);
+            const double blockNs = (Time::getMillisecondCounterHiRes() - start) * 1.0e6 / numBlocks;
+
+            BOOST_TEST_MESSAGE (numSamples << " samples, " << delay << " delay: sample at a time "
+                                           << sampleNs << " ns/block, block copies " << blockNs << " ns/block");
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,517 @@
+#include <boost/test/unit_test.hpp>
+#include "fixture/PreparedGraph.h"
+#include "fixture/TestNode.h"
+#include "engine/graphcompiler.hpp"
+#include "engine/graphnode.hpp"
+#include "engine/lookahead.hpp"
+
+using namespace element;
+
+namespace {
+std::unique_ptr<GraphSnapshot> makeSnapshot (GraphNode& graph)
+{
+    std::unique_ptr<GraphSnapshot> snapshot (new GraphSnapshot());
+    for (int i = 0; i < graph.getNumNodes(); ++i)
+        snapshot->addNode (graph.getNode (i));
+    for (int i = 0; i < graph.getNumConnections(); ++i)
+    {
+        const auto* c = graph.getConnection (i);
+        snapshot->connections.add (new Arc (c->sourceNode, c->sourcePort, c->destNode, c->destPort));
+    }
+    return snapshot;
+}
+
+Array<void*> orderNodes (const GraphSnapshot& snapshot)
+{
+    Array<uint32> ids;
+    for (auto* node : snapshot.nodes)
+        ids.add (node->nodeId);
+
+    Array<void*> ordered;
+    for (const auto index : sortTopologically (ids, snapshot.connections))
+        ordered.add (snapshot.nodes.getUnchecked (index));
+    return ordered;
+}
+
+/** Each node is fed by the one before it and the one eight places back */
+void buildLayeredGraph (GraphNode& graph, int numNodes)
+{
+    Array<uint32> ids;
+    for (int i = 0; i < numNodes; ++i)
+        ids.add (graph.addNode (new TestNode (2, 2, 1, 1))->nodeId);
+
+    for (int i = 1; i < numNodes; ++i)
+    {
+        graph.connectChannels (PortType::Audio, ids[i - 1], 0, ids[i], 0);
+        graph.connectChannels (PortType::Midi, ids[i - 1], 0, ids[i], 0);
+        if (i >= 8)
+            graph.connectChannels (PortType::Audio, ids[i - 8], 1, ids[i], 1);
+    }
+}
+
+/** Writes ones and a note on every block */
+class SourceNode : public TestNode
+{
+public:
+    SourceNode() : TestNode (0, 1, 0, 1) {}
+
+    void render (AudioSampleBuffer& audio, MidiPipe& midi) override
+    {
+        FloatVectorOperations::fill (audio.getWritePointer (0), 1.f, audio.getNumSamples());
+        midi.getWriteBuffer (0)->clear();
+        midi.getWriteBuffer (0)->addEvent (MidiMessage::noteOn (1, 60, 1.f), 0);
+        ++numBlocks;
+    }
+
+    int numBlocks = 0;
+};
+
+/** Takes live input and remembers what it was fed */
+class LiveNode : public TestNode
+{
+public:
+    LiveNode() : TestNode (1, 1, 1, 1) {}
+
+    bool rendersLive() const override { return true; }
+
+    void render (AudioSampleBuffer& audio, MidiPipe& midi) override
+    {
+        lastSample = audio.getSample (0, audio.getNumSamples() - 1);
+        numEvents = midi.getReadBuffer (0)->getNumEvents();
+    }
+
+    float lastSample = 0.f;
+    int numEvents = 0;
+};
+
+/** Writes a note every few frames, starting at an offset */
+class NoteSourceNode : public TestNode
+{
+public:
+    NoteSourceNode (int channel_, int start_, int step_)
+        : TestNode (0, 0, 0, 1), channel (channel_), start (start_), step (step_) {}
+
+    void render (AudioSampleBuffer& audio, MidiPipe& midi) override
+    {
+        auto* const buffer = midi.getWriteBuffer (0);
+        buffer->clear();
+        for (int frame = start; frame < audio.getNumSamples(); frame += step)
+            buffer->addEvent (MidiMessage::noteOn (channel, 60, 1.f), frame);
+    }
+
+    const int channel, start, step;
+};
+
+/** Keeps a copy of the MIDI it was fed */
+class MidiSinkNode : public TestNode
+{
+public:
+    MidiSinkNode() : TestNode (0, 0, 1, 0) {}
+
+    void render (AudioSampleBuffer&, MidiPipe& midi) override
+    {
+        received = *midi.getReadBuffer (0);
+    }
+
+    MidiBuffer received;
+};
+
+/** A chain has one rendering order, so both programs must be the same */
+bool haveSameCode (const RenderProgram& a, const RenderProgram& b)
+{
+    if (a.code.size() != b.code.size() || a.tasks.size() != b.tasks.size())
+        return false;
+    for (int i = 0; i < a.code.size(); ++i)
+    {
+        const auto& x = a.code.getReference (i);
+        const auto& y = b.code.getReference (i);
+        if (x.type != y.type || x.src != y.src || x.src2 != y.src2 || x.dst != y.dst)
+            return false;
+    }
+    for (int i = 0; i < a.tasks.size(); ++i)
+        if (a.tasks[i].numDependencies != b.tasks[i].numDependencies)
+            return false;
+    return a.latencySamples == b.latencySamples
+           && a.buffers.getNumChannels() == b.buffers.getNumChannels()
+           && a.midiBuffers.size() == b.midiBuffers.size();
+}
+} // namespace
+
+BOOST_AUTO_TEST_SUITE (GraphCompilerTests)
+
+BOOST_AUTO_TEST_CASE (TopologicalSort)
+{
+    Array<uint32> ids ({ 1, 2, 3, 4, 5, 6 });
+    OwnedArray<Arc> arcs;
+    arcs.add (new Arc (3, 0, 1, 0));
+    arcs.add (new Arc (1, 0, 2, 0));
+    arcs.add (new Arc (1, 1, 2, 1));
+    arcs.add (new Arc (2, 0, 4, 0));
+    // feedback loop
+    arcs.add (new Arc (5, 0, 6, 0));
+    arcs.add (new Arc (6, 0, 5, 0));
+
+    const auto order = sortTopologically (ids, arcs);
+    BOOST_REQUIRE_EQUAL (order.size(), ids.size());
+    BOOST_REQUIRE (order.indexOf (2) < order.indexOf (0)); // 3 before 1
+    BOOST_REQUIRE (order.indexOf (0) < order.indexOf (1)); // 1 before 2
+    BOOST_REQUIRE (order.indexOf (1) < order.indexOf (3)); // 2 before 4
+    BOOST_REQUIRE (order.contains (4) && order.contains (5));
+}
+
+BOOST_AUTO_TEST_CASE (BuildProgram)
+{
+    PreparedGraph fix;
+    buildLayeredGraph (fix.graph, 64);
+    auto program = GraphCompiler::build (*makeSnapshot (fix.graph));
+    BOOST_REQUIRE (program != nullptr);
+    BOOST_REQUIRE (program->code.size() >= fix.graph.getNumNodes());
+    BOOST_REQUIRE_EQUAL (program->ops.size(), fix.graph.getNumNodes());
+    BOOST_REQUIRE (program->buffers.getNumChannels() > 1);
+}
+
+BOOST_AUTO_TEST_CASE (BufferReuse)
+{
+    PreparedGraph fix;
+    auto& graph = fix.graph;
+    uint32 lastId = EL_INVALID_NODE;
+    for (int i = 0; i < 32; ++i)
+    {
+        const auto nodeId = graph.addNode (new TestNode (2, 2, 1, 1))->nodeId;
+        if (lastId != EL_INVALID_NODE)
+        {
+            graph.connectChannels (PortType::Audio, lastId, 0, nodeId, 0);
+            graph.connectChannels (PortType::Audio, lastId, 1, nodeId, 1);
+            graph.connectChannels (PortType::Midi, lastId, 0, nodeId, 0);
+        }
+        lastId = nodeId;
+    }
+
+    // a chain is processed in place: the zero buffer plus one per channel
+    auto program = GraphCompiler::build (*makeSnapshot (graph));
+    BOOST_REQUIRE_EQUAL (program->buffers.getNumChannels(), 3);
+    BOOST_REQUIRE_EQUAL (program->midiBuffers.size(), 2);
+}
+
+BOOST_AUTO_TEST_CASE (IncrementalBuild)
+{
+    PreparedGraph fix;
+    auto& graph = fix.graph;
+    Array<uint32> ids;
+    for (int i = 0; i < 100; ++i)
+    {
+        ids.add (graph.addNode (new TestNode (2, 2, 1, 1))->nodeId);
+        if (i > 0)
+        {
+            graph.connectChannels (PortType::Audio, ids[i - 1], 0, ids[i], 0);
+            graph.connectChannels (PortType::Audio, ids[i - 1], 1, ids[i], 1);
+            graph.connectChannels (PortType::Midi, ids[i - 1], 0, ids[i], 0);
+        }
+    }
+
+    CompileCache cache;
+    auto first = GraphCompiler::build (*makeSnapshot (graph), &cache);
+
+    // add a node to the end
+    ids.add (graph.addNode (new TestNode (2, 2, 1, 1))->nodeId);
+    graph.connectChannels (PortType::Audio, ids[99], 0, ids[100], 0);
+    auto second = GraphCompiler::build (*makeSnapshot (graph), &cache);
+    BOOST_REQUIRE (haveSameCode (*second, *GraphCompiler::build (*makeSnapshot (graph))));
+    BOOST_REQUIRE_EQUAL (second->ops.size(), graph.getNumNodes());
+    BOOST_REQUIRE (second->ops.getFirst() == first->ops.getFirst());
+
+    // remove a connection in the middle
+    for (int i = 0; i < graph.getNumConnections(); ++i)
+    {
+        const auto* c = graph.getConnection (i);
+        if (c->destNode == ids[60])
+        {
+            graph.removeConnection (c->sourceNode, c->sourcePort, c->destNode, c->destPort);
+            break;
+        }
+    }
+
+    auto third = GraphCompiler::build (*makeSnapshot (graph), &cache);
+    BOOST_REQUIRE (haveSameCode (*third, *GraphCompiler::build (*makeSnapshot (graph))));
+    BOOST_REQUIRE (third->ops.getFirst() == first->ops.getFirst());
+    BOOST_REQUIRE (third->ops.getLast() != second->ops.getLast());
+}
+
+BOOST_AUTO_TEST_CASE (SilenceFlags)
+{
+    const int numSamples = 64;
+    RenderProgram program;
+    program.allocateBuffers (4, 0, numSamples);
+    for (int ch = 0; ch < 4; ++ch)
+        BOOST_REQUIRE (program.silentChannels[ch]);
+
+    // pretend buffer 1 was rendered to
+    FloatVectorOperations::fill (program.buffers.getWritePointer (1), 0.5f, numSamples);
+    program.silentChannels[1] = false;
+
+    const auto addOp = [&program] (RenderOp::Type type, int src, int dst) {
+        RenderOp r;
+        r.type = type;
+        r.src = src;
+        r.dst = dst;
+        program.code.add (r);
+    };
+
+    addOp (RenderOp::copyChannel, 1, 2); // 2 = sound
+    addOp (RenderOp::addChannel, 3, 2); // adding silence changes nothing
+    addOp (RenderOp::copyChannel, 0, 3); // 3 = silence
+    program.beginBlock (numSamples);
+    program.perform (0, program.code.size(), numSamples);
+
+    BOOST_REQUIRE (! program.silentChannels[2]);
+    BOOST_REQUIRE (program.silentChannels[3]);
+    BOOST_REQUIRE_EQUAL (program.buffers.getSample (2, numSamples - 1), 0.5f);
+    BOOST_REQUIRE_EQUAL (program.buffers.getMagnitude (3, 0, numSamples), 0.f);
+
+    // clearing marks silence, a bigger block drops everything but the zeros
+    program.code.clearQuick();
+    addOp (RenderOp::clearChannel, 0, 2);
+    program.perform (0, program.code.size(), numSamples);
+    BOOST_REQUIRE (program.silentChannels[2]);
+    BOOST_REQUIRE_EQUAL (program.buffers.getMagnitude (2, 0, numSamples), 0.f);
+
+    program.beginBlock (numSamples * 2);
+    BOOST_REQUIRE (program.silentChannels[0]);
+    for (int ch = 1; ch < 4; ++ch)
+        BOOST_REQUIRE (! program.silentChannels[ch]);
+}
+
+BOOST_AUTO_TEST_CASE (DoublePrecision)
+{
+    const int numSamples = 64;
+    RenderProgram program;
+    program.doublePrecision = true;
+    program.allocateBuffers (3, 0, numSamples);
+    BOOST_REQUIRE_EQUAL (program.doubleBuffers.getNumChannels(), 3);
+    BOOST_REQUIRE_EQUAL (program.getBlockSize(), numSamples);
+    BOOST_REQUIRE_EQUAL (program.buffers.getNumChannels(), 1);
+
+    // a value a float can't hold survives a copy and an add
+    const double value = 1.0 + 1.0e-12;
+    FloatVectorOperations::fill (program.doubleBuffers.getWritePointer (1), value, numSamples);
+    program.silentChannels[1] = false;
+
+    RenderOp r;
+    r.type = RenderOp::copyChannel;
+    r.src = 1;
+    r.dst = 2;
+    program.code.add (r);
+    r.type = RenderOp::addChannel;
+    program.code.add (r);
+    program.beginBlock (numSamples);
+    program.perform (0, program.code.size(), numSamples);
+
+    BOOST_REQUIRE (! program.silentChannels[2]);
+    BOOST_REQUIRE_EQUAL (program.doubleBuffers.getSample (2, numSamples - 1), value * 2.0);
+}
+
+BOOST_AUTO_TEST_CASE (MidiMerge)
+{
+    const int numSamples = 64;
+    PreparedGraph fix (44100.0, numSamples);
+    auto& graph = fix.graph;
+    auto* const first = new NoteSourceNode (1, 0, 3);
+    auto* const second = new NoteSourceNode (2, 1, 4);
+    auto* const sink = new MidiSinkNode();
+    graph.addNode (first);
+    graph.addNode (second);
+    graph.addNode (sink);
+    graph.connectChannels (PortType::Midi, first->nodeId, 0, sink->nodeId, 0);
+    graph.connectChannels (PortType::Midi, second->nodeId, 0, sink->nodeId, 0);
+
+    auto snapshot = makeSnapshot (graph);
+    snapshot->blockSize = numSamples;
+    auto program = GraphCompiler::build (*snapshot);
+    BOOST_REQUIRE_EQUAL (program->ops.size(), graph.getNumNodes());
+
+    int numMerges = 0;
+    for (const auto& r : program->code)
+        if (r.type == RenderOp::addMidi)
+            ++numMerges;
+    BOOST_REQUIRE_EQUAL (numMerges, 1);
+    BOOST_REQUIRE_EQUAL (program->midiScratch.size(), 1);
+
+    // both sources arrive in the one input, in order of time
+    for (int block = 0; block < 2; ++block)
+    {
+        program->beginBlock (numSamples);
+        program->perform (0, program->code.size(), numSamples);
+
+        int numFirst = 0, numSecond = 0, last = 0;
+        for (const auto metadata : sink->received)
+        {
+            BOOST_REQUIRE (metadata.samplePosition >= last);
+            last = metadata.samplePosition;
+            const auto channel = metadata.getMessage().getChannel();
+            if (channel == 1)
+                ++numFirst;
+            else if (channel == 2)
+                ++numSecond;
+        }
+
+        BOOST_REQUIRE_EQUAL (numFirst, (numSamples + 2) / 3);
+        BOOST_REQUIRE_EQUAL (numSecond, (numSamples + 2) / 4);
+    }
+}
+
+BOOST_AUTO_TEST_CASE (LookAhead)
+{
+    const int numSamples = 64;
+    PreparedGraph fix (44100.0, numSamples);
+    auto& graph = fix.graph;
+    auto* const source = new SourceNode();
+    auto* const unread = new SourceNode();
+    auto* const live = new LiveNode();
+    graph.addNode (source);
+    graph.addNode (unread);
+    graph.addNode (live);
+    graph.connectChannels (PortType::Audio, source->nodeId, 0, live->nodeId, 0);
+    graph.connectChannels (PortType::Midi, source->nodeId, 0, live->nodeId, 0);
+
+    auto snapshot = makeSnapshot (graph);
+    const auto liveNodes = GraphBuilder::findLiveNodes (snapshot->connections, orderNodes (*snapshot));
+    BOOST_REQUIRE (liveNodes.contains (live->nodeId));
+    BOOST_REQUIRE (! liveNodes.contains (source->nodeId) && ! liveNodes.contains (unread->nodeId));
+
+    snapshot->blockSize = numSamples;
+    snapshot->lookAheadBlocks = 2;
+    auto program = GraphCompiler::build (*snapshot);
+    BOOST_REQUIRE (program->lookAhead != nullptr);
+    BOOST_REQUIRE_EQUAL (program->lookAhead->getPorts().size(), 2);
+
+    // the first block is rendered on this thread, reading half blocks
+    // spans the ones rendered ahead
+    LookAheadRenderer renderer;
+    renderer.setTarget (program->lookAhead.get());
+    for (int block = 0; block < 4; ++block)
+    {
+        const int blockSamples = numSamples / 2;
+        renderer.beginRead ({}, 44100.0, blockSamples);
+        program->beginBlock (blockSamples);
+        program->perform (0, program->code.size(), blockSamples);
+        renderer.endRead (blockSamples);
+
+        BOOST_REQUIRE_EQUAL (live->lastSample, 1.f);
+        BOOST_REQUIRE_EQUAL (live->numEvents, block % 2 == 0 ? 1 : 0);
+    }
+
+    BOOST_REQUIRE_EQUAL (source->numBlocks, 2);
+    BOOST_REQUIRE_EQUAL (unread->numBlocks, 2);
+    renderer.setTarget (nullptr);
+    program.reset(); // before the renderer it was targeted by
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+// run with: test_element -t GraphCompilerBenchmarks
+BOOST_AUTO_TEST_SUITE (GraphCompilerBenchmarks, *boost::unit_test::disabled())
+
+BOOST_AUTO_TEST_CASE (CompileTime)
+{
+    for (const int numNodes : { 1000, 2500, 5000, 10000 })
+    {
+        PreparedGraph fix;
+        buildLayeredGraph (fix.graph, numNodes);
+        const auto snapshot = makeSnapshot (fix.graph);
+
+        const double start = Time::getMillisecondCounterHiRes();
+        auto program = GraphCompiler::build (*snapshot);
+        const double elapsed = Time::getMillisecondCounterHiRes() - start;
+
+        BOOST_TEST_MESSAGE ("compiled " << numNodes << " nodes, "
+                                        << fix.graph.getNumConnections() << " connections, "
+                                        << program->code.size() << " ops in "
+                                        << elapsed << " ms, peak buffers: "
+                                        << program->buffers.getNumChannels() << " audio "
+                                        << program->midiBuffers.size() << " midi");
+        BOOST_REQUIRE (program->code.size() >= numNodes);
+    }
+}
+
+BOOST_AUTO_TEST_CASE (EditTime)
+{
+    for (const int numNodes : { 300, 3000 })
+    {
+        PreparedGraph fix;
+        buildLayeredGraph (fix.graph, numNodes);
+        CompileCache cache;
+        GraphCompiler::build (*makeSnapshot (fix.graph), &cache);
+
+        // one connection near the end of the session
+        const auto* c = fix.graph.getConnection (fix.graph.getNumConnections() - 1);
+        fix.graph.removeConnection (c->sourceNode, c->sourcePort, c->destNode, c->destPort);
+        const auto snapshot = makeSnapshot (fix.graph);
+
+        double start = Time::getMillisecondCounterHiRes();
+        GraphCompiler::build (*snapshot);
+        const double fullMs = Time::getMillisecondCounterHiRes() - start;
+
+        start = Time::getMillisecondCounterHiRes();
+        GraphCompiler::build (*snapshot, &cache);
+        const double incrementalMs = Time::getMillisecondCounterHiRes() - start;
+
+        BOOST_TEST_MESSAGE (numNodes << " nodes, one edge removed: full build "
+                                     << fullMs << " ms, incremental " << incrementalMs << " ms");
+    }
+}
+
+BOOST_AUTO_TEST_CASE (PerformTime)
+{
+    const int numSamples = 64;
+    const int numBlocks = 200;
+
+    for (const int numNodes : { 1000, 10000 })
+    {
+        PreparedGraph fix;
+        buildLayeredGraph (fix.graph, numNodes);
+        const auto snapshot = makeSnapshot (fix.graph);
+
+        // one virtual call per heap allocated op, buffer moves only run as
+        // program instructions
+        const auto ordered = orderNodes (*snapshot);
+        Array<const NodeState*> states;
+        for (auto* const node : ordered)
+            states.add (snapshot->states.getUnchecked (snapshot->nodes.indexOf ((NodeObject*) node)));
+        Array<void*> ops;
+        Array<GraphTask> tasks;
+        GraphBuilder builder (snapshot->connections, ordered, states, ops, tasks);
+        Array<GraphOp*> calls;
+        for (auto* op : ops)
+            if (static_cast<GraphOp*> (op)->getRenderOp().type == RenderOp::performOp)
+                calls.add (static_cast<GraphOp*> (op));
+        AudioSampleBuffer audio (builder.buffersNeeded (PortType::Audio), numSamples);
+        audio.clear();
+        OwnedArray<MidiBuffer> midi;
+        for (int i = builder.buffersNeeded (PortType::Midi); --i >= 0;)
+            midi.add (new MidiBuffer());
+        HeapBlock<bool> silent ((size_t) audio.getNumChannels(), true); // nothing known to be silent
+
+        double start = Time::getMillisecondCounterHiRes();
+        for (int block = 0; block < numBlocks; ++block)
+            for (auto* op : calls)
+                op->perform (audio, midi, silent, numSamples);
+        const double virtualNs = (Time::getMillisecondCounterHiRes() - start) * 1.0e6 / (double) (numBlocks * calls.size());
+        const int numVirtualOps = calls.size();
+
+        for (auto* op : ops)
+            delete static_cast<GraphOp*> (op);
+
+        // the assembled program
+        auto program = GraphCompiler::build (*snapshot);
+        start = Time::getMillisecondCounterHiRes();
+        for (int block = 0; block < numBlocks; ++block)
+            program->perform (0, program->code.size(), numSamples);
+        const double programNs = (Time::getMillisecondCounterHiRes() - start) * 1.0e6 / (double) (numBlocks * program->code.size());
+
+        BOOST_TEST_MESSAGE (numNodes << " nodes: "
+                                     << numVirtualOps << " virtual ops " << virtualNs << " ns/op, "
+                                     << program->code.size() << " program ops " << programNs << " ns/op");
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -2,10 +2,67 @@
 #include "fixture/PreparedGraph.h"
 #include "fixture/TestNode.h"
 #include "engine/graphnode.hpp"
+#include "engine/ionode.hpp"
 #include "utils.hpp"
 
 using namespace element;
 
+namespace {
+/** Outputs a constant and counts the blocks it renders */
+class ConstantNode : public TestNode
+{
+public:
+    explicit ConstantNode (int numIns = 0) : TestNode (numIns, 1, 0, 0) {}
+
+    void render (AudioSampleBuffer& audio, MidiPipe&) override
+    {
+        FloatVectorOperations::fill (audio.getWritePointer (0), 0.5f, audio.getNumSamples());
+        ++numBlocks;
+    }
+
+    int numBlocks = 0;
+};
+
+/** Sums its inputs through a one pole lowpass, so what it outputs depends
+    on every block before */
+class FilterNode : public TestNode
+{
+public:
+    FilterNode (int numIns, float coefficient)
+        : TestNode (numIns, 1, 0, 0), a (coefficient) {}
+
+    void render (AudioSampleBuffer& audio, MidiPipe&) override
+    {
+        auto* const data = audio.getWritePointer (0);
+        for (int ch = 1; ch < numAudioIns; ++ch)
+            FloatVectorOperations::add (data, audio.getReadPointer (ch), audio.getNumSamples());
+
+        for (int i = 0; i < audio.getNumSamples(); ++i)
+        {
+            z += a * (data[i] - z);
+            data[i] = z;
+        }
+    }
+
+private:
+    const float a;
+    float z = 0.f;
+};
+
+/** A transport playing from the start */
+struct PlayingHead : public AudioPlayHead
+{
+    Optional<PositionInfo> getPosition() const override
+    {
+        PositionInfo info;
+        info.setIsPlaying (true);
+        info.setTimeInSamples (0);
+        info.setBpm (120.0);
+        return info;
+    }
+};
+} // namespace
+
 BOOST_AUTO_TEST_SUITE (GraphNodeTests)
 
 BOOST_AUTO_TEST_CASE (IO)
@@ -74,4 +131,344 @@ BOOST_AUTO_TEST_CASE (AddRemove)
     BOOST_REQUIRE (graph.removeNode (node->nodeId));
 }
 
+BOOST_AUTO_TEST_CASE (BatchEdits)
+{
+    PreparedGraph fix;
+    GraphNode& graph = fix.graph;
+    NodeObjectPtr first = graph.addNode (new TestNode());
+
+    graph.beginBatch();
+    graph.beginBatch();
+    NodeObjectPtr second = graph.addNode (new TestNode());
+    graph.connectChannels (PortType::Audio, first->nodeId, 0, second->nodeId, 0);
+    BOOST_REQUIRE (graph.removeNode (first->nodeId));
+    graph.commit();
+    BOOST_REQUIRE (graph.isInBatch());
+
+    // removed nodes stay attached until they're out of the program
+    BOOST_REQUIRE (first->getParentGraph() == &graph);
+    graph.commit();
+    BOOST_REQUIRE (! graph.isInBatch());
+    BOOST_REQUIRE (first->getParentGraph() == &graph);
+    graph.waitForEdits();
+    BOOST_REQUIRE (first->getParentGraph() == nullptr);
+    BOOST_REQUIRE_EQUAL (graph.getNumNodes(), 1);
+    BOOST_REQUIRE_EQUAL (graph.getNumConnections(), 0);
+}
+
+BOOST_AUTO_TEST_CASE (ParallelRender)
+{
+    // the same graph and input rendered with a number of threads
+    const auto renderWithThreads = [] (const int numThreads) {
+        PreparedGraph fix (44100.0, 256);
+        GraphNode& graph = fix.graph;
+        NodeObjectPtr audioIn = graph.addNode (new IONode (IONode::audioInputNode));
+        NodeObjectPtr audioOut = graph.addNode (new IONode (IONode::audioOutputNode));
+
+        // the input fans out to four chains, which are mixed two by two and
+        // then summed at the outputs
+        Array<NodeObjectPtr> chains, mixers;
+        for (int i = 0; i < 4; ++i)
+        {
+            NodeObjectPtr first = graph.addNode (new FilterNode (1, 0.1f + 0.2f * (float) i));
+            NodeObjectPtr second = graph.addNode (new FilterNode (1, 0.9f - 0.1f * (float) i));
+            graph.connectChannels (PortType::Audio, audioIn->nodeId, i % 2, first->nodeId, 0);
+            graph.connectChannels (PortType::Audio, first->nodeId, 0, second->nodeId, 0);
+            chains.add (second);
+            if (i == 0)
+                graph.connectChannels (PortType::Audio, first->nodeId, 0, audioOut->nodeId, 1);
+        }
+
+        for (int i = 0; i < 2; ++i)
+        {
+            NodeObjectPtr mixer = graph.addNode (new FilterNode (2, 0.5f));
+            graph.connectChannels (PortType::Audio, chains[i * 2]->nodeId, 0, mixer->nodeId, 0);
+            graph.connectChannels (PortType::Audio, chains[i * 2 + 1]->nodeId, 0, mixer->nodeId, 1);
+            mixers.add (mixer);
+        }
+
+        graph.connectChannels (PortType::Audio, mixers[0]->nodeId, 0, audioOut->nodeId, 0);
+        graph.connectChannels (PortType::Audio, mixers[1]->nodeId, 0, audioOut->nodeId, 0);
+        graph.connectChannels (PortType::Audio, mixers[1]->nodeId, 0, audioOut->nodeId, 1);
+
+        graph.setNumRenderThreads (numThreads);
+        BOOST_REQUIRE_EQUAL (graph.getNumRenderThreads(), jmin (numThreads, SystemStats::getNumCpus()));
+        graph.prepareToRender (44100.0, 256);
+
+        AudioSampleBuffer output (2, 256 * 32);
+        AudioSampleBuffer audio (2, 256);
+        MidiBuffer midi;
+        MidiBuffer* buffers[] = { &midi };
+        MidiPipe pipe (buffers, 1);
+        for (int block = 0; block < 32; ++block)
+        {
+            for (int i = 0; i < 256; ++i)
+            {
+                const auto t = (float) (block * 256 + i);
+                audio.setSample (0, i, std::sin (t * 0.01f));
+                audio.setSample (1, i, std::fmod (t * 0.003f, 1.f) - 0.5f);
+            }
+
+            graph.render (audio, pipe);
+            for (int ch = 0; ch < 2; ++ch)
+                output.copyFrom (ch, block * 256, audio, ch, 0, 256);
+        }
+
+        return output;
+    };
+
+    const auto serial = renderWithThreads (1);
+    const auto parallel = renderWithThreads (4);
+    BOOST_REQUIRE (serial.getMagnitude (0, 0, serial.getNumSamples()) > 0.1f);
+    BOOST_REQUIRE (serial.getMagnitude (1, 0, serial.getNumSamples()) > 0.1f);
+    for (int ch = 0; ch < 2; ++ch)
+        for (int i = 0; i < serial.getNumSamples(); ++i)
+            BOOST_REQUIRE_EQUAL (serial.getSample (ch, i), parallel.getSample (ch, i));
+}
+
+BOOST_AUTO_TEST_CASE (LargeBlocks)
+{
+    PreparedGraph fix (44100.0, 512);
+    GraphNode& graph = fix.graph;
+    NodeObjectPtr audioIn = graph.addNode (new IONode (IONode::audioInputNode));
+    NodeObjectPtr audioOut = graph.addNode (new IONode (IONode::audioOutputNode));
+    NodeObjectPtr midiIn = graph.addNode (new IONode (IONode::midiInputNode));
+    NodeObjectPtr midiOut = graph.addNode (new IONode (IONode::midiOutputNode));
+    for (int ch = 0; ch < 2; ++ch)
+        BOOST_REQUIRE (graph.connectChannels (PortType::Audio, audioIn->nodeId, ch, audioOut->nodeId, ch));
+    BOOST_REQUIRE (graph.connectChannels (PortType::Midi, midiIn->nodeId, 0, midiOut->nodeId, 0));
+    graph.prepareToRender (44100.0, 512);
+
+    // several prepared blocks and a partial one
+    AudioSampleBuffer audio (2, 2000);
+    for (int ch = 0; ch < 2; ++ch)
+        for (int i = 0; i < audio.getNumSamples(); ++i)
+            audio.setSample (ch, i, (float) i / (float) audio.getNumSamples());
+
+    MidiBuffer midi;
+    midi.addEvent (MidiMessage::noteOn (1, 60, 1.f), 1500);
+    MidiBuffer* buffers[] = { &midi };
+    MidiPipe pipe (buffers, 1);
+    graph.render (audio, pipe);
+
+    for (int ch = 0; ch < 2; ++ch)
+        for (int i = 0; i < audio.getNumSamples(); ++i)
+            BOOST_REQUIRE_EQUAL (audio.getSample (ch, i), (float) i / (float) audio.getNumSamples());
+
+    BOOST_REQUIRE_EQUAL (midi.getNumEvents(), 1);
+    BOOST_REQUIRE_EQUAL (midi.getFirstEventTime(), 1500);
+}
+
+BOOST_AUTO_TEST_CASE (Freeze)
+{
+    PreparedGraph fix (44100.0, 512);
+    GraphNode& graph = fix.graph;
+    PlayingHead playhead;
+    graph.setPlayHead (&playhead);
+
+    auto* const source = new ConstantNode();
+    NodeObjectPtr sourcePtr = graph.addNode (source);
+    NodeObjectPtr audioIn = graph.addNode (new IONode (IONode::audioInputNode));
+    NodeObjectPtr audioOut = graph.addNode (new IONode (IONode::audioOutputNode));
+    NodeObjectPtr live = graph.addNode (new TestNode (1, 1, 0, 0));
+    BOOST_REQUIRE (graph.connectChannels (PortType::Audio, source->nodeId, 0, audioOut->nodeId, 0));
+    BOOST_REQUIRE (graph.connectChannels (PortType::Audio, audioIn->nodeId, 0, live->nodeId, 0));
+    graph.prepareToRender (44100.0, 512);
+
+    // a node fed by the device can't be rendered offline
+    const double seconds = 4096 / 44100.0;
+    BOOST_REQUIRE (graph.freezeNode (live->nodeId, seconds).failed());
+    BOOST_REQUIRE (! graph.isNodeFrozen (live->nodeId));
+
+    // rendered in the background, then buffered and swapped in
+    BOOST_REQUIRE (graph.freezeNode (source->nodeId, seconds, true).wasOk());
+    BOOST_REQUIRE (graph.isNodeFreezing (source->nodeId));
+    graph.waitForFreezing();
+    BOOST_REQUIRE (! graph.isNodeFreezing (source->nodeId));
+    BOOST_REQUIRE (graph.isNodeFrozen (source->nodeId));
+    BOOST_REQUIRE_EQUAL (source->numBlocks, 8);
+
+    // the frozen audio plays instead of the node
+    AudioSampleBuffer audio (2, 512);
+    audio.clear();
+    MidiBuffer midi;
+    MidiBuffer* buffers[] = { &midi };
+    MidiPipe pipe (buffers, 1);
+    graph.render (audio, pipe);
+    BOOST_REQUIRE_EQUAL (source->numBlocks, 8);
+    BOOST_REQUIRE_EQUAL (audio.getSample (0, 100), 0.5f);
+
+    BOOST_REQUIRE (graph.unfreezeNode (source->nodeId));
+    BOOST_REQUIRE (! graph.isNodeFrozen (source->nodeId));
+    graph.setPlayHead (nullptr);
+}
+
+BOOST_AUTO_TEST_CASE (DisabledAndBypassed)
+{
+    PreparedGraph fix (44100.0, 512);
+    GraphNode& graph = fix.graph;
+    auto* const source = new ConstantNode (1);
+    NodeObjectPtr sourcePtr = graph.addNode (source);
+    NodeObjectPtr audioIn = graph.addNode (new IONode (IONode::audioInputNode));
+    NodeObjectPtr audioOut = graph.addNode (new IONode (IONode::audioOutputNode));
+    BOOST_REQUIRE (graph.connectChannels (PortType::Audio, audioIn->nodeId, 0, source->nodeId, 0));
+    BOOST_REQUIRE (graph.connectChannels (PortType::Audio, source->nodeId, 0, audioOut->nodeId, 0));
+    graph.prepareToRender (44100.0, 512);
+
+    // the input is the dry signal, the node outputs 0.5 over it
+    AudioSampleBuffer audio (2, 512);
+    MidiBuffer midi;
+    MidiBuffer* buffers[] = { &midi };
+    MidiPipe pipe (buffers, 1);
+    const auto renderOnes = [&]() {
+        FloatVectorOperations::fill (audio.getWritePointer (0), 1.f, audio.getNumSamples());
+        audio.clear (1, 0, audio.getNumSamples());
+        graph.render (audio, pipe);
+    };
+
+    const auto requireCrossfade = [&] (const float from, const float to) {
+        BOOST_REQUIRE_EQUAL (audio.getSample (0, 0), from);
+        BOOST_REQUIRE_CLOSE (audio.getSample (0, audio.getNumSamples() - 1), to, 1.0);
+        for (int i = 1; i < audio.getNumSamples(); ++i)
+            BOOST_REQUIRE (std::abs (audio.getSample (0, i) - audio.getSample (0, i - 1)) < 0.01f);
+    };
+
+    renderOnes();
+    BOOST_REQUIRE_EQUAL (source->numBlocks, 1);
+    BOOST_REQUIRE_EQUAL (audio.getSample (0, 100), 0.5f);
+
+    // disabled nodes drop out straight away, then aren't in the program
+    source->setEnabled (false);
+    renderOnes();
+    BOOST_REQUIRE_EQUAL (source->numBlocks, 1);
+    BOOST_REQUIRE_EQUAL (audio.getSample (0, 100), 0.f);
+    graph.waitForEdits();
+    renderOnes();
+    BOOST_REQUIRE_EQUAL (source->numBlocks, 1);
+    BOOST_REQUIRE_EQUAL (audio.getSample (0, 100), 0.f);
+
+    // and come back once they're compiled in again
+    source->setEnabled (true);
+    graph.waitForEdits();
+    renderOnes();
+    BOOST_REQUIRE_EQUAL (source->numBlocks, 2);
+    BOOST_REQUIRE_EQUAL (audio.getSample (0, 100), 0.5f);
+
+    // bypassing crossfades to the dry inputs for a block...
+    source->suspendProcessing (true);
+    renderOnes();
+    BOOST_REQUIRE_EQUAL (source->numBlocks, 3);
+    requireCrossfade (0.5f, 1.f);
+
+    // ...then routes around the node
+    graph.waitForEdits();
+    renderOnes();
+    BOOST_REQUIRE_EQUAL (source->numBlocks, 3);
+    BOOST_REQUIRE_EQUAL (audio.getSample (0, 100), 1.f);
+
+    // the program routing around it crossfades back once it's swapped
+    source->suspendProcessing (false);
+    renderOnes();
+    BOOST_REQUIRE_EQUAL (source->numBlocks, 3);
+    BOOST_REQUIRE_EQUAL (audio.getSample (0, 100), 1.f);
+    graph.waitForEdits();
+    renderOnes();
+    BOOST_REQUIRE_EQUAL (source->numBlocks, 4);
+    requireCrossfade (1.f, 0.5f);
+
+    renderOnes();
+    BOOST_REQUIRE_EQUAL (source->numBlocks, 5);
+    BOOST_REQUIRE_EQUAL (audio.getSample (0, 100), 0.5f);
+}
+
+BOOST_AUTO_TEST_CASE (PrecisionChange)
+{
+    PreparedGraph fix (44100.0, 512);
+    GraphNode& graph = fix.graph;
+    auto* const source = new ConstantNode();
+    NodeObjectPtr sourcePtr = graph.addNode (source);
+    NodeObjectPtr audioOut = graph.addNode (new IONode (IONode::audioOutputNode));
+    BOOST_REQUIRE (graph.connectChannels (PortType::Audio, source->nodeId, 0, audioOut->nodeId, 0));
+    graph.prepareToRender (44100.0, 512);
+
+    AudioSampleBuffer audio (2, 512);
+    MidiBuffer midi;
+    MidiBuffer* buffers[] = { &midi };
+    MidiPipe pipe (buffers, 1);
+
+    // the nodes are prepared again once they're out of the program, then
+    // compiled back in
+    graph.setDoublePrecision (true);
+    BOOST_REQUIRE (graph.isUsingDoublePrecision());
+    graph.waitForEdits();
+    audio.clear();
+    graph.render (audio, pipe);
+    BOOST_REQUIRE_EQUAL (source->numBlocks, 1);
+    BOOST_REQUIRE_EQUAL (audio.getSample (0, 100), 0.5f);
+
+    graph.setDoublePrecision (false);
+    graph.waitForEdits();
+    audio.clear();
+    graph.render (audio, pipe);
+    BOOST_REQUIRE_EQUAL (source->numBlocks, 2);
+    BOOST_REQUIRE_EQUAL (audio.getSample (0, 100), 0.5f);
+}
+
+BOOST_AUTO_TEST_CASE (InlineSubgraph)
+{
+    PreparedGraph fix (44100.0, 512);
+    GraphNode& graph = fix.graph;
+    auto* const subgraph = new GraphNode();
+    auto* const source = new ConstantNode();
+    NodeObjectPtr subIn = subgraph->addNode (new IONode (IONode::audioInputNode));
+    NodeObjectPtr subOut = subgraph->addNode (new IONode (IONode::audioOutputNode));
+    NodeObjectPtr sourcePtr = subgraph->addNode (source);
+    BOOST_REQUIRE (subgraph->connectChannels (PortType::Audio, subIn->nodeId, 0, subOut->nodeId, 0));
+    BOOST_REQUIRE (subgraph->connectChannels (PortType::Audio, source->nodeId, 0, subOut->nodeId, 1));
+
+    NodeObjectPtr audioIn = graph.addNode (new IONode (IONode::audioInputNode));
+    NodeObjectPtr audioOut = graph.addNode (new IONode (IONode::audioOutputNode));
+    NodeObjectPtr subgraphPtr = graph.addNode (subgraph);
+    for (int ch = 0; ch < 2; ++ch)
+    {
+        BOOST_REQUIRE (graph.connectChannels (PortType::Audio, audioIn->nodeId, ch, subgraph->nodeId, ch));
+        BOOST_REQUIRE (graph.connectChannels (PortType::Audio, subgraph->nodeId, ch, audioOut->nodeId, ch));
+    }
+    graph.prepareToRender (44100.0, 512);
+
+    AudioSampleBuffer audio (2, 512);
+    MidiBuffer midi;
+    MidiBuffer* buffers[] = { &midi };
+    MidiPipe pipe (buffers, 1);
+    const auto renderRamp = [&]() {
+        for (int i = 0; i < audio.getNumSamples(); ++i)
+            audio.setSample (0, i, (float) i / (float) audio.getNumSamples());
+        audio.clear (1, 0, audio.getNumSamples());
+        graph.render (audio, pipe);
+    };
+
+    // the subgraph's nodes render in the parent's program, through the IO
+    renderRamp();
+    auto rendered = graph.getRenderedNodes();
+    BOOST_REQUIRE (rendered.contains (source));
+    BOOST_REQUIRE (! rendered.contains (subgraph));
+    BOOST_REQUIRE (! rendered.contains (subIn.get()));
+    BOOST_REQUIRE (! rendered.contains (subOut.get()));
+    BOOST_REQUIRE_EQUAL (source->numBlocks, 1);
+    BOOST_REQUIRE_EQUAL (audio.getSample (0, 100), 100.f / 512.f);
+    BOOST_REQUIRE_EQUAL (audio.getSample (1, 100), 0.5f);
+
+    // gain is applied to it as a node again
+    subgraph->setGain (0.5f);
+    graph.prepareToRender (44100.0, 512);
+    renderRamp();
+    renderRamp();
+    rendered = graph.getRenderedNodes();
+    BOOST_REQUIRE (rendered.contains (subgraph));
+    BOOST_REQUIRE (! rendered.contains (source));
+    BOOST_REQUIRE (subgraph->getRenderedNodes().contains (source));
+    BOOST_REQUIRE_EQUAL (source->numBlocks, 3);
+    BOOST_REQUIRE_EQUAL (audio.getSample (1, 100), 0.25f);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
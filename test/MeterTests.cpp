@@ -0,0 +1,108 @@
+#include <boost/test/unit_test.hpp>
+#include "engine/meter.hpp"
+
+using namespace element;
+
+BOOST_AUTO_TEST_SUITE (MeterTests)
+
+BOOST_AUTO_TEST_CASE (MeasureLevels)
+{
+    Random random (1234);
+    HeapBlock<float> data (520);
+    for (int i = 0; i < 520; ++i)
+        data[i] = random.nextFloat() * 2.4f - 1.2f;
+
+    // odd offsets and lengths so the unaligned head and tail get used
+    for (const int offset : { 0, 1, 3 })
+    {
+        for (const int numSamples : { 1, 3, 7, 64, 511 })
+        {
+            const float* samples = data + offset;
+            float peak = 0.f;
+            double sum = 0.0;
+            int clips = 0;
+            for (int i = 0; i < numSamples; ++i)
+            {
+                peak = jmax (peak, std::abs (samples[i]));
+                sum += samples[i] * samples[i];
+                if (std::abs (samples[i]) > 1.f)
+                    ++clips;
+            }
+
+            const auto levels = measureLevels (samples, numSamples);
+            BOOST_REQUIRE_EQUAL (levels.peak, peak);
+            BOOST_REQUIRE_EQUAL (levels.clips, clips);
+            BOOST_REQUIRE_CLOSE (levels.rms, std::sqrt (sum / numSamples), 0.01);
+        }
+    }
+
+    const auto silence = measureLevels (data + 1, 0);
+    BOOST_REQUIRE_EQUAL (silence.peak, 0.f);
+    BOOST_REQUIRE_EQUAL (silence.rms, 0.f);
+}
+
+BOOST_AUTO_TEST_CASE (ApplyGainAndMeasure)
+{
+    Random random (4321);
+    AudioSampleBuffer expected (1, 520), actual (1, 520);
+    for (int i = 0; i < 520; ++i)
+        expected.setSample (0, i, random.nextFloat() * 2.f - 1.f);
+
+    const float gains[][2] = { { 1.f, 1.f }, { 0.5f, 0.5f }, { 1.f, 0.f }, { 0.f, 2.f }, { 0.f, 0.f } };
+    for (const auto& gain : gains)
+    {
+        for (const int offset : { 0, 1, 5 })
+        {
+            const int numSamples = 512 - offset;
+            actual.makeCopyOf (expected);
+            AudioSampleBuffer reference;
+            reference.makeCopyOf (expected);
+            reference.applyGainRamp (0, offset, numSamples, gain[0], gain[1]);
+
+            const auto levels = applyGainAndMeasure (actual.getWritePointer (0, offset), numSamples, gain[0], gain[1]);
+            for (int i = 0; i < 520; ++i)
+                BOOST_REQUIRE_CLOSE (actual.getSample (0, i), reference.getSample (0, i), 0.0001);
+
+            BOOST_REQUIRE_CLOSE (levels.peak, reference.getMagnitude (0, offset, numSamples), 0.0001);
+            BOOST_REQUIRE_CLOSE (levels.rms, reference.getRMSLevel (0, offset, numSamples), 0.01);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE (MeterBlockLayout)
+{
+    MeterBlock meters;
+    meters.resize (2, 3);
+    BOOST_REQUIRE_EQUAL (meters.getNumInputs(), 2);
+    BOOST_REQUIRE_EQUAL (meters.getNumOutputs(), 3);
+
+    MeterLevels levels;
+    levels.peak = 1.5f;
+    levels.rms = 0.5f;
+    levels.clips = 2;
+    meters.setOutput (0, levels);
+    meters.setOutput (0, levels);
+
+    BOOST_REQUIRE_EQUAL (meters.getInputRMS (0), 0.f);
+    BOOST_REQUIRE_EQUAL (meters.getOutputRMS (0), 0.5f);
+    BOOST_REQUIRE_EQUAL (meters.getOutputPeak (0), 1.5f);
+    BOOST_REQUIRE_EQUAL (meters.getOutputClips (0), 4);
+    BOOST_REQUIRE_EQUAL (meters.getOutputRMS (3), 0.f);
+
+    // channels past the ports are ignored, an input never lands on an output
+    MeterLevels other;
+    other.rms = 0.25f;
+    meters.setInput (2, other);
+    meters.setInput (-1, other);
+    meters.setOutput (3, other);
+    BOOST_REQUIRE_EQUAL (meters.getOutputRMS (0), 0.5f);
+    BOOST_REQUIRE_EQUAL (meters.getOutputRMS (2), 0.f);
+
+    meters.clearOutputs();
+    BOOST_REQUIRE_EQUAL (meters.getOutputRMS (0), 0.f);
+    BOOST_REQUIRE_EQUAL (meters.getOutputClips (0), 4);
+    meters.clear();
+    BOOST_REQUIRE_EQUAL (meters.getOutputClips (0), 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
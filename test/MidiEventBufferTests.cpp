@@ -0,0 +1,74 @@
+#include <boost/test/unit_test.hpp>
+#include "engine/midieventbuffer.hpp"
+
+using namespace element;
+
+BOOST_AUTO_TEST_SUITE (MidiEventBufferTests)
+
+BOOST_AUTO_TEST_CASE (SortedAndViews)
+{
+    MidiEventBuffer events (4, 8);
+    const uint8 sysex[] = { 0xf0, 0x7e, 0x7f, 0x06, 0x01, 0xf7 };
+
+    BOOST_REQUIRE (events.addEvent (MidiMessage::noteOn (1, 60, (uint8) 100), 10));
+    BOOST_REQUIRE (events.addEvent (sysex, (int) sizeof (sysex), 5));
+    BOOST_REQUIRE (events.addEvent (MidiMessage::noteOff (1, 60), 10));
+    BOOST_REQUIRE (events.addEvent (MidiMessage::controllerEvent (1, 7, 64), 0));
+    BOOST_REQUIRE (! events.addEvent (MidiMessage::allNotesOff (1), 20));
+    BOOST_REQUIRE_EQUAL (events.size(), 4);
+
+    int last = 0;
+    for (const auto& event : events)
+    {
+        BOOST_REQUIRE (event.frame >= last);
+        last = event.frame;
+    }
+
+    const auto view = events.getView (5, 5);
+    BOOST_REQUIRE_EQUAL (view.size(), 1);
+    BOOST_REQUIRE_EQUAL (view.begin()->size, (int) sizeof (sysex));
+    BOOST_REQUIRE (std::memcmp (view.getData (*view.begin()), sysex, sizeof (sysex)) == 0);
+    BOOST_REQUIRE_EQUAL (events.getView (10, 1).size(), 2);
+    BOOST_REQUIRE (events.getView (11, 100).isEmpty());
+
+    MidiBuffer midi;
+    events.getView (5, 10).addTo (midi, 100);
+    BOOST_REQUIRE_EQUAL (midi.getNumEvents(), 3);
+    BOOST_REQUIRE_EQUAL (midi.getFirstEventTime(), 105);
+    BOOST_REQUIRE_EQUAL (midi.getLastEventTime(), 110);
+}
+
+BOOST_AUTO_TEST_CASE (Merge)
+{
+    MidiBuffer a, b, scratch;
+    for (int i = 0; i < 8; ++i)
+        a.addEvent (MidiMessage::noteOn (1, 60 + i, (uint8) 100), i * 2);
+    for (int i = 0; i < 8; ++i)
+        b.addEvent (MidiMessage::noteOn (2, 60 + i, (uint8) 100), i * 3);
+    b.addEvent (MidiMessage::noteOff (2, 60), 64);
+
+    MidiEventBuffer ea, eb, merged;
+    ea.copyFrom (a);
+    eb.copyFrom (b);
+    merged.merge (ea.getView(), eb.getView());
+    BOOST_REQUIRE_EQUAL (merged.size(), 17);
+
+    MidiBuffer expected (a);
+    expected.addEvents (b, 0, 32, 0);
+    mergeMidiEvents (a, b, scratch, 32);
+    BOOST_REQUIRE_EQUAL (a.getNumEvents(), 16);
+
+    auto e = expected.cbegin();
+    for (const auto metadata : a)
+    {
+        const auto other = *e++;
+        BOOST_REQUIRE_EQUAL (metadata.samplePosition, other.samplePosition);
+        BOOST_REQUIRE (metadata.getMessage().getChannel() == other.getMessage().getChannel());
+    }
+
+    MidiBuffer copy;
+    copyMidiEvents (a, copy);
+    BOOST_REQUIRE (copy.data == a.data);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,113 @@
+#include <boost/test/unit_test.hpp>
+#include "engine/midipipe.hpp"
+#include "engine/midisequence.hpp"
+#include "engine/nodes/MidiFilePlayerNode.h"
+
+using namespace element;
+
+namespace {
+/** Four beats: notes on beats 1 and 3, half tempo from beat 2 */
+MidiFile createFile()
+{
+    MidiMessageSequence track;
+    track.addEvent (MidiMessage::tempoMetaEvent (500000), 0);
+    track.addEvent (MidiMessage::noteOn (1, 60, 1.f), 480);
+    track.addEvent (MidiMessage::noteOff (1, 60), 960);
+    track.addEvent (MidiMessage::tempoMetaEvent (1000000), 960);
+    track.addEvent (MidiMessage::noteOn (1, 64, 1.f), 1440);
+    track.addEvent (MidiMessage::endOfTrack(), 1920);
+
+    MidiFile file;
+    file.setTicksPerQuarterNote (480);
+    file.addTrack (track);
+    return file;
+}
+
+struct SeekingHead : public AudioPlayHead
+{
+    Optional<PositionInfo> getPosition() const override
+    {
+        PositionInfo info;
+        info.setIsPlaying (true);
+        info.setBpm (120.0);
+        info.setPpqPosition (ppq);
+        info.setTimeInSeconds (ppq * 0.5);
+        return info;
+    }
+    double ppq = 0.0;
+};
+} // namespace
+
+BOOST_AUTO_TEST_SUITE (MidiFilePlayerTests)
+
+BOOST_AUTO_TEST_CASE (Sequence)
+{
+    MidiSequence sequence (createFile());
+    BOOST_REQUIRE_EQUAL (sequence.size(), 3);
+    BOOST_REQUIRE_EQUAL (sequence.getLengthInBeats(), 4.0);
+    BOOST_REQUIRE_CLOSE (sequence.getLengthInSeconds(), 3.0, 0.0001);
+
+    BOOST_REQUIRE_EQUAL (sequence.getEvent (0).beat, 1.0);
+    BOOST_REQUIRE_CLOSE (sequence.getEvent (0).seconds, 0.5, 0.0001);
+    BOOST_REQUIRE_CLOSE (sequence.getEvent (2).seconds, 2.0, 0.0001);
+    BOOST_REQUIRE_EQUAL (sequence.getData (sequence.getEvent (2))[1], 64);
+
+    BOOST_REQUIRE_EQUAL (sequence.indexOf (0.0, false), 0);
+    BOOST_REQUIRE_EQUAL (sequence.indexOf (1.5, false), 1);
+    BOOST_REQUIRE_EQUAL (sequence.indexOf (1.5, true), 2);
+    BOOST_REQUIRE_EQUAL (sequence.indexOf (5.0, false), 3);
+}
+
+BOOST_AUTO_TEST_CASE (PlayWithTransport)
+{
+    const auto tempFile = File::createTempFile (".mid");
+    {
+        FileOutputStream stream (tempFile);
+        BOOST_REQUIRE (createFile().writeTo (stream));
+    }
+
+    MidiFilePlayerNode player;
+    BOOST_REQUIRE (player.loadFile (tempFile).wasOk());
+    tempFile.deleteFile();
+
+    SeekingHead playhead;
+    player.setPlayHead (&playhead);
+    player.prepareToRender (48000.0, 512);
+
+    AudioSampleBuffer audio (1, 512);
+    MidiBuffer midi;
+    MidiBuffer* buffers[] = { &midi };
+    MidiPipe pipe (buffers, 1);
+    const auto renderAt = [&] (double ppq) {
+        playhead.ppq = ppq;
+        player.render (audio, pipe);
+    };
+
+    // a beat is 24000 samples, the first note is in the 47th block
+    int64 frame = 0;
+    int noteOnFrame = -1;
+    for (; frame < 48000 && noteOnFrame < 0; frame += 512)
+    {
+        renderAt ((double) frame / 24000.0);
+        for (const auto metadata : midi)
+            if (metadata.getMessage().isNoteOn())
+                noteOnFrame = (int) frame + metadata.samplePosition;
+    }
+    BOOST_REQUIRE_EQUAL (noteOnFrame, 24000);
+
+    // jumping past the note off releases the note
+    renderAt (2.5);
+    BOOST_REQUIRE_EQUAL (midi.getNumEvents(), 1);
+    BOOST_REQUIRE ((*midi.begin()).getMessage().isNoteOff());
+
+    // looping wraps the transport in to the file
+    player.setLooping (true);
+    renderAt (5.0);
+    BOOST_REQUIRE_EQUAL (midi.getNumEvents(), 1);
+    BOOST_REQUIRE_EQUAL ((*midi.begin()).samplePosition, 0);
+    BOOST_REQUIRE_EQUAL ((*midi.begin()).getMessage().getNoteNumber(), 60);
+
+    player.setPlayHead (nullptr);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,89 @@
+#include <boost/test/unit_test.hpp>
+#include "engine/midiinputqueue.hpp"
+
+using namespace element;
+
+BOOST_AUTO_TEST_SUITE (MidiInputQueueTests)
+
+BOOST_AUTO_TEST_CASE (ClockTracksCallbacks)
+{
+    MidiBlockClock clock;
+    clock.reset (48000.0, 480);
+
+    // callbacks every 10ms with jitter, on a device running 0.1% fast
+    Random random (4321);
+    const double period = 0.01 / 1.001;
+    for (int i = 0; i < 4000; ++i)
+    {
+        clock.advance (100.0 + i * period + random.nextDouble() * 0.002, 480);
+        BOOST_REQUIRE (clock.wasRestarted() == (i == 0));
+    }
+
+    BOOST_REQUIRE_CLOSE (clock.getEstimatedSampleRate(), 48048.0, 0.1);
+    BOOST_REQUIRE_CLOSE (clock.getEndTime() - clock.getStartTime(), period, 1.0);
+
+    // a stall starts it again
+    clock.advance (200.0, 480);
+    BOOST_REQUIRE (clock.wasRestarted());
+    BOOST_REQUIRE_EQUAL (clock.getEndTime(), 200.0);
+}
+
+BOOST_AUTO_TEST_CASE (CollectAtOffsets)
+{
+    MidiBlockClock clock;
+    clock.reset (44100.0, 441);
+    MidiInputQueue queue;
+    MidiBuffer midi;
+
+    const double now = Time::getMillisecondCounterHiRes() * 0.001;
+    clock.advance (now - 0.02, 441);
+    clock.advance (now - 0.01, 441);
+    clock.advance (now, 441);
+    BOOST_REQUIRE (! clock.wasRestarted());
+
+    // one in this block's span, one arriving after it
+    BOOST_REQUIRE (queue.push (MidiMessage::noteOn (1, 60, 1.f).withTimeStamp (clock.getStartTime() + 0.005)));
+    BOOST_REQUIRE (queue.push (MidiMessage::noteOn (1, 62, 1.f).withTimeStamp (clock.getEndTime() + 0.0001)));
+    queue.collect (midi, clock, 441);
+
+    BOOST_REQUIRE_EQUAL (midi.getNumEvents(), 1);
+    const auto first = *midi.begin();
+    BOOST_REQUIRE_EQUAL (first.getMessage().getNoteNumber(), 60);
+    BOOST_REQUIRE (std::abs (first.samplePosition - 220) <= 1);
+
+    // the later one is held for the next block
+    midi.clear();
+    clock.advance (now + 0.01, 441);
+    queue.collect (midi, clock, 441);
+    BOOST_REQUIRE_EQUAL (midi.getNumEvents(), 1);
+    BOOST_REQUIRE_EQUAL ((*midi.begin()).getMessage().getNoteNumber(), 62);
+
+    // messages without a timestamp are stamped when pushed
+    midi.clear();
+    BOOST_REQUIRE (queue.push (MidiMessage::noteOff (1, 60)));
+    clock.advance (Time::getMillisecondCounterHiRes() * 0.001 + 0.005, 441);
+    queue.collect (midi, clock, 441);
+    BOOST_REQUIRE_EQUAL (midi.getNumEvents(), 1);
+}
+
+BOOST_AUTO_TEST_CASE (CollectAllInOrder)
+{
+    MidiInputQueue queue;
+    MidiBuffer midi;
+
+    for (int note = 60; note < 64; ++note)
+        BOOST_REQUIRE (queue.push (MidiMessage::noteOn (1, note, 1.f)));
+
+    BOOST_REQUIRE_EQUAL (queue.collectAll (midi), 4);
+    BOOST_REQUIRE_EQUAL (midi.getNumEvents(), 4);
+    int note = 60;
+    for (const auto metadata : midi)
+    {
+        BOOST_REQUIRE_EQUAL (metadata.samplePosition, 0);
+        BOOST_REQUIRE_EQUAL (metadata.getMessage().getNoteNumber(), note++);
+    }
+
+    BOOST_REQUIRE_EQUAL (queue.collectAll (midi), 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -46,6 +46,30 @@ BOOST_AUTO_TEST_CASE (Enablement)
     node = nullptr;
 }
 
+BOOST_AUTO_TEST_CASE (RenderProperties)
+{
+    PreparedGraph fix;
+    NodeObjectPtr node = fix.graph.addNode (new TestNode());
+
+    BOOST_REQUIRE (node->getRenderProperties().keyRange == Range<int> (0, 127));
+    BOOST_REQUIRE (node->getRenderProperties().midiChannels.isOmni());
+
+    node->setKeyRange (36, 48);
+    node->setTransposeOffset (12);
+    node->setMidiProgramsEnabled (true);
+    BigInteger channels;
+    channels.setBit (3);
+    node->setMidiChannels (channels);
+
+    const auto& props = node->getRenderProperties();
+    BOOST_REQUIRE (props.keyRange == Range<int> (36, 48));
+    BOOST_REQUIRE_EQUAL (props.transposeOffset, 12);
+    BOOST_REQUIRE (props.midiProgramsEnabled);
+    BOOST_REQUIRE (props.midiChannels.isOn (3) && props.midiChannels.isOff (4));
+
+    node = nullptr;
+}
+
 BOOST_AUTO_TEST_CASE (PortChannelMapping)
 {
     PreparedGraph fix;